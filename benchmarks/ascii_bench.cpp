@@ -0,0 +1,745 @@
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ascii_image.hpp"
+#include "ascii_kernels.hpp"
+#include "ascii_recording.hpp"
+#include "batch_convert.hpp"
+#include "cell_sampler.hpp"
+#include "dense_ascii.hpp"
+#include "edge_ascii.hpp"
+#include "frame_renderer.hpp"
+#include "frame_source.hpp"
+#include "incremental_convert.hpp"
+#include "mosaic_compositor.hpp"
+#include "parallel_convert.hpp"
+#include "pixel_layout.hpp"
+#include "rainbow_animator.hpp"
+#include "shape_ascii.hpp"
+#include "strip_converter.hpp"
+#include "thread_pool.hpp"
+#include "yuv_image.hpp"
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+
+// Every benchmark reports
+//   items_per_second  input pixels per second
+//   bytes_per_second  output bytes per second
+//   bytes_per_frame   output size of one frame
+
+struct Resolution
+{
+  const char* name;
+  int width, height;
+};
+
+// 100x55 is what the webcam loop renders, the rest are capture sizes
+static const Resolution RESOLUTIONS[] = {
+  { "100x55", 100, 55 }, { "640x480", 640, 480 }, { "1080p", 1920, 1080 }, { "4K", 3840, 2160 }
+};
+
+// photo: the images/ directory tiled over the frame, real color runs
+// noise: synthetic noise, every cell changes color (worst case for SGR output)
+static const char* INPUTS[] = { "photo", "noise" };
+
+static RawImage makePhoto(int width, int height) {
+  std::vector<std::string> files = ImageSequenceSource::listDirectory(TOSTRING(IMAGE_DIR_PATH));
+  ImageSequenceSource images(files);
+  std::vector<Frame> tiles;
+  Frame tile;
+  while (images.read(tile)) tiles.push_back(tile);
+  if (tiles.empty()) throw std::runtime_error("No images found in " TOSTRING(IMAGE_DIR_PATH));
+
+  // Fixed 100 pixel grid, so every resolution sees the same mix of images
+  const int TILE = 100;
+  RawImage image(width, height, 3);
+  uint8_t* p = image.getData();
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x, p += 3) {
+      const Frame& t = tiles[(x / TILE + y / TILE * 7) % tiles.size()];
+      int sx = (x % TILE) * t.width / TILE;
+      int sy = (y % TILE) * t.height / TILE;
+      std::memcpy(p, t.pixels.getData() + (static_cast<size_t>(sy) * t.width + sx) * 3, 3);
+    }
+  }
+  return image;
+}
+
+static RawImage makeNoise(int width, int height) {
+  SyntheticSource source(width, height, SyntheticPattern::Noise);
+  Frame frame;
+  source.read(frame);
+  return RawImage(width, height, 3, frame.pixels.getData());
+}
+
+// Inputs are built once and shared by every benchmark using them
+static const RawImage& input(const std::string& kind, const Resolution& res) {
+  static std::map<std::string, RawImage> cache;
+  std::string key = kind + "/" + res.name;
+  auto it = cache.find(key);
+  if (it == cache.end()) {
+    RawImage image = kind == "photo" ? makePhoto(res.width, res.height) : makeNoise(res.width, res.height);
+    it = cache.emplace(key, std::move(image)).first;
+  }
+  return it->second;
+}
+
+static void reportThroughput(benchmark::State& state, const RawImage& image, size_t bytes_per_frame) {
+  size_t pixels = static_cast<size_t>(image.getWidth()) * image.getHeight();
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * pixels));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes_per_frame));
+  state.counters["bytes_per_frame"] = static_cast<double>(bytes_per_frame);
+}
+
+
+static void BM_GrayscaleToAscii(benchmark::State& state, const RawImage& image) {
+  size_t pixels = static_cast<size_t>(image.getWidth()) * image.getHeight();
+  std::vector<char> out(pixels);
+  for (auto _ : state) {
+    const uint8_t* p = image.getData();
+    for (size_t i = 0; i < pixels; ++i, p += 3) {
+      out[i] = pixelToAscii(getGrayscaleValue(p[0], p[1], p[2]));
+    }
+    benchmark::DoNotOptimize(out.data());
+    benchmark::ClobberMemory();
+  }
+  reportThroughput(state, image, pixels);
+}
+
+static void BM_AsciiKernel(benchmark::State& state, const RawImage& image, AsciiKernel kernel) {
+  if (!isAsciiKernelSupported(kernel)) {
+    state.SkipWithError("kernel not supported on this CPU");
+    return;
+  }
+  int width = image.getWidth();
+  size_t pixels = static_cast<size_t>(width) * image.getHeight();
+  std::vector<char> out(pixels);
+  for (auto _ : state) {
+    for (int y = 0; y < image.getHeight(); ++y) {
+      convertRowToAscii(kernel, image.getData() + static_cast<size_t>(y) * width * 3, width,
+                        out.data() + static_cast<size_t>(y) * width);
+    }
+    benchmark::DoNotOptimize(out.data());
+    benchmark::ClobberMemory();
+  }
+  reportThroughput(state, image, pixels);
+}
+
+static void BM_ConvertToAscii(benchmark::State& state, const RawImage& image) {
+  size_t bytes = 0;
+  for (auto _ : state) {
+    RawImage ascii = convertToAscii(image);
+    bytes = ascii.getSize() - 1;
+    benchmark::DoNotOptimize(ascii.getData());
+  }
+  reportThroughput(state, image, bytes);
+}
+
+static void BM_ConvertToColoredAscii(benchmark::State& state, const RawImage& image) {
+  RawImage target(static_cast<int>(coloredAsciiBufferSize(image.getWidth(), image.getHeight())), 1, 1);
+  size_t bytes = 0;
+  for (auto _ : state) {
+    bytes = convertToColoredAscii(image, target);
+    benchmark::DoNotOptimize(target.getData());
+  }
+  reportThroughput(state, image, bytes);
+}
+
+static void BM_ConvertToShapeAscii(benchmark::State& state, const RawImage& image) {
+  size_t bytes = 0;
+  for (auto _ : state) {
+    RawImage ascii = convertToShapeAscii(image);
+    bytes = ascii.getSize() - 1;
+    benchmark::DoNotOptimize(ascii.getData());
+  }
+  reportThroughput(state, image, bytes);
+}
+
+// Through a matcher of its own, so the share of cells served by its cache can be reported
+static void BM_ConvertToColoredShapeAscii(benchmark::State& state, const RawImage& image) {
+  RawImage target(static_cast<int>(coloredShapeAsciiBufferSize(image.getWidth(), image.getHeight())), 1, 1);
+  ShapeMatcher matcher;
+  char* begin = reinterpret_cast<char*>(target.getData());
+  size_t bytes = 0;
+  for (auto _ : state) {
+    bytes = static_cast<size_t>(writeColoredShapeText(image, begin, 0, matcher) - begin);
+    benchmark::DoNotOptimize(target.getData());
+  }
+  reportThroughput(state, image, bytes);
+  size_t lookups = matcher.hits() + matcher.misses();
+  state.counters["cache_hit_ratio"] = lookups ? static_cast<double>(matcher.hits()) / lookups : 0.0;
+}
+
+// The RGB input repacked as another layout, alpha and gray from the pixel's position and luma
+static RawImage repack(const RawImage& image, PixelLayout layout) {
+  int channels = pixelLayoutChannels(layout);
+  RawImage packed(image.getWidth(), image.getHeight(), channels);
+  size_t pixels = static_cast<size_t>(image.getWidth()) * image.getHeight();
+  const uint8_t* p = image.getData();
+  uint8_t* out = packed.getData();
+  for (size_t i = 0; i < pixels; ++i, p += 3, out += channels) {
+    uint8_t gray = static_cast<uint8_t>(lumaOf(p[0], p[1], p[2]));
+    uint8_t alpha = static_cast<uint8_t>(i * 7);
+    switch (layout) {
+      case PixelLayout::Gray: out[0] = gray; break;
+      case PixelLayout::GrayA: out[0] = gray; out[1] = alpha; break;
+      case PixelLayout::RGB: std::memcpy(out, p, 3); break;
+      case PixelLayout::RGBA: std::memcpy(out, p, 3); out[3] = alpha; break;
+      case PixelLayout::BGR: out[0] = p[2]; out[1] = p[1]; out[2] = p[0]; break;
+    }
+  }
+  return packed;
+}
+
+// convertToAscii (colored = false) or truecolor convertToColoredAscii on one layout
+static void BM_ConvertLayout(benchmark::State& state, const RawImage& image, PixelLayout layout, bool colored) {
+  RawImage packed = repack(image, layout);
+  RawImage target(static_cast<int>(coloredAsciiBufferSize(image.getWidth(), image.getHeight())), 1, 1);
+  size_t bytes = 0;
+  for (auto _ : state) {
+    if (colored) {
+      bytes = convertToColoredAscii(packed, target, ColorMode::Truecolor, 0, layout);
+    } else {
+      RawImage ascii = convertToAscii(packed, layout);
+      bytes = ascii.getSize() - 1;
+      benchmark::DoNotOptimize(ascii.getData());
+    }
+    benchmark::DoNotOptimize(target.getData());
+  }
+  reportThroughput(state, image, bytes);
+}
+
+// The frame as a camera would deliver it, BT.601 limited range with the
+// chroma of the top left pixel of each pair or 2x2 block
+static std::vector<uint8_t> toYuv(const RawImage& image, YuvFormat format) {
+  int width = image.getWidth();
+  int height = image.getHeight();
+  std::vector<uint8_t> data(yuvFrameSize(format, width, height));
+  YuvImageView view(data.data(), width, height, format);
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* p = image.getData() + static_cast<size_t>(y) * width * 3;
+    uint8_t* luma = const_cast<uint8_t*>(view.lumaRow(y));
+    for (int x = 0; x < width; ++x, p += 3) {
+      luma[x * view.lumaStep()] = static_cast<uint8_t>(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+    }
+  }
+  for (int cy = 0; cy < view.chromaHeight(); ++cy) {
+    const uint8_t* row = image.getData() + static_cast<size_t>(cy << view.chromaShift()) * width * 3;
+    uint8_t* u = const_cast<uint8_t*>(view.uRow(cy));
+    uint8_t* v = const_cast<uint8_t*>(view.vRow(cy));
+    for (int cx = 0; cx < view.chromaWidth(); ++cx) {
+      const uint8_t* p = row + static_cast<size_t>(cx) * 6;
+      u[cx * view.chromaStep()] = static_cast<uint8_t>(((-38 * p[0] - 74 * p[1] + 112 * p[2] + 128) >> 8) + 128);
+      v[cx * view.chromaStep()] = static_cast<uint8_t>(((112 * p[0] - 94 * p[1] - 18 * p[2] + 128) >> 8) + 128);
+    }
+  }
+  return data;
+}
+
+enum class YuvOutput { Gray, Colored, Cells };
+
+// A YUV frame to gray text, colored text or a 200 column cell grid, either
+// natively or (decode = true) the old way: converted to RGB first, then the RGB converter
+static void BM_YuvConvert(benchmark::State& state, const RawImage& image, YuvFormat format, YuvOutput output,
+                          bool decode) {
+  int width = image.getWidth();
+  int height = image.getHeight();
+  std::vector<uint8_t> data = toYuv(image, format);
+  YuvImageView view(data.data(), width, height, format);
+  std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+  RawImageView rgb_view(rgb.data(), width, height, 3);
+  RawImage target(static_cast<int>(coloredAsciiBufferSize(width, height)), 1, 1);
+  CellSampler sampler;
+  CellGrid cells;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    if (decode) convertYuvToRgb(view, rgb.data());
+    switch (output) {
+      case YuvOutput::Gray: bytes = decode ? convertToAscii(rgb_view, target) : convertToAscii(view, target); break;
+      case YuvOutput::Colored:
+        bytes = decode ? convertToColoredAscii(rgb_view, target) : convertToColoredAscii(view, target);
+        break;
+      case YuvOutput::Cells:
+        if (decode) {
+          sampler.sample(rgb_view, PixelFormat::RGB24, 200, cells);
+        } else {
+          sampler.sample(view, 200, cells);
+        }
+        bytes = cells.cellCount();
+        break;
+    }
+    benchmark::DoNotOptimize(target.getData());
+    benchmark::DoNotOptimize(cells.glyphs.data());
+  }
+  reportThroughput(state, image, bytes);
+}
+
+static void BM_ConvertToPaletteAscii(benchmark::State& state, const RawImage& image, ColorMode mode) {
+  RawImage target(static_cast<int>(coloredAsciiBufferSize(image.getWidth(), image.getHeight(), mode)), 1, 1);
+  size_t bytes = 0;
+  for (auto _ : state) {
+    bytes = convertToColoredAscii(image, target, mode);
+    benchmark::DoNotOptimize(target.getData());
+  }
+  reportThroughput(state, image, bytes);
+}
+
+// Ramp glyphs plus the Sobel pass and the edge glyphs, on the shared pool
+static void BM_ConvertToEdgeAscii(benchmark::State& state, const RawImage& image) {
+  size_t bytes = 0;
+  for (auto _ : state) {
+    RawImage ascii = convertToEdgeAscii(image);
+    bytes = ascii.getSize() - 1;
+    benchmark::DoNotOptimize(ascii.getData());
+  }
+  reportThroughput(state, image, bytes);
+}
+
+static void BM_ConvertToColoredEdgeAscii(benchmark::State& state, const RawImage& image) {
+  RawImage target(static_cast<int>(coloredAsciiBufferSize(image.getWidth(), image.getHeight())), 1, 1);
+  size_t bytes = 0;
+  for (auto _ : state) {
+    bytes = convertToColoredEdgeAscii(image, target);
+    benchmark::DoNotOptimize(target.getData());
+  }
+  reportThroughput(state, image, bytes);
+}
+
+// A static scene: the input with a square a sixth of its height moving over
+// it, every frame reconverted by IncrementalConverter. dirty_ratio is the
+// share of 32x16 tiles that were reconverted.
+static std::vector<RawImage> makeMovingSquare(const RawImage& image) {
+  int width = image.getWidth();
+  int height = image.getHeight();
+  int size = std::max(1, height / 6);
+  std::vector<RawImage> frames;
+  for (int i = 0; i < 8; ++i) {
+    RawImage frame(width, height, 3);
+    std::memcpy(frame.getData(), image.getData(), image.getSize());
+    int x0 = (width - size) * i / 8;
+    for (int y = height / 3; y < height / 3 + size; ++y) {
+      std::memset(frame.getData() + (static_cast<size_t>(y) * width + x0) * 3, 255, static_cast<size_t>(size) * 3);
+    }
+    frames.push_back(std::move(frame));
+  }
+  return frames;
+}
+
+static void BM_IncrementalConvert(benchmark::State& state, const RawImage& image) {
+  int width = image.getWidth();
+  int height = image.getHeight();
+  std::vector<RawImage> frames = makeMovingSquare(image);
+  IncrementalConverter converter;
+  RawImage target(static_cast<int>(coloredAsciiBufferSize(width, height)), 1, 1);
+  converter.convert(frames[0], target);
+  IncrementalStats start = converter.totals();
+  size_t bytes = 0, index = 0;
+  for (auto _ : state) {
+    bytes = converter.convert(frames[++index % frames.size()], target);
+    benchmark::DoNotOptimize(target.getData());
+  }
+  reportThroughput(state, image, bytes);
+  state.counters["dirty_ratio"] = static_cast<double>(converter.totals().dirty_tiles - start.dirty_tiles) /
+                                  static_cast<double>(std::max<size_t>(1, converter.totals().tiles - start.tiles));
+}
+
+static void BM_ConvertToHalfBlockAscii(benchmark::State& state, const RawImage& image) {
+  RawImage target(static_cast<int>(halfBlockBufferSize(image.getWidth(), image.getHeight())), 1, 1);
+  size_t bytes = 0;
+  for (auto _ : state) {
+    bytes = convertToHalfBlockAscii(image, target);
+    benchmark::DoNotOptimize(target.getData());
+  }
+  reportThroughput(state, image, bytes);
+}
+
+static void BM_ConvertToColoredBraille(benchmark::State& state, const RawImage& image) {
+  RawImage target(static_cast<int>(coloredBrailleBufferSize(image.getWidth(), image.getHeight())), 1, 1);
+  size_t bytes = 0;
+  for (auto _ : state) {
+    bytes = convertToColoredBraille(image, target);
+    benchmark::DoNotOptimize(target.getData());
+  }
+  reportThroughput(state, image, bytes);
+}
+
+static void BM_ConvertToRainbowAscii(benchmark::State& state, const RawImage& image) {
+  RawImage target(static_cast<int>(coloredAsciiBufferSize(image.getWidth(), image.getHeight())), 1, 1);
+  size_t bytes = 0, total = 0;
+  int scroll_offset = 0;
+  for (auto _ : state) {
+    bytes = convertToRainbowAscii(image, scroll_offset++, target);
+    total += bytes;
+    benchmark::DoNotOptimize(target.getData());
+  }
+  reportThroughput(state, image, state.iterations() ? total / state.iterations() : bytes);
+}
+
+// Steady state of the rainbow animation, every frame of the period is cached after the first pass
+static void BM_RainbowAnimator(benchmark::State& state, const RawImage& image) {
+  RainbowAnimator animator(image, RenderMode::FullRepaint);
+  size_t bytes = 0, total = 0, index = 0;
+  for (auto _ : state) {
+    bytes = animator.frame(index++).size;
+    total += bytes;
+    benchmark::DoNotOptimize(bytes);
+  }
+  reportThroughput(state, image, state.iterations() ? total / state.iterations() : bytes);
+  state.counters["cached_bytes"] = static_cast<double>(animator.cachedBytes());
+}
+
+// Differential renderer on a sequence of frames where a tenth of the rows change
+static void BM_DiffRender(benchmark::State& state, const RawImage& image) {
+  int width = image.getWidth();
+  int height = image.getHeight();
+  CellGrid cells;
+  buildColoredCells(image, cells);
+  DiffRenderer renderer;
+  RawImage target(static_cast<int>(DiffRenderer::bufferSize(width, height)), 1, 1);
+  renderer.render(cells, target);
+
+  size_t total = 0;
+  int frame = 0;
+  for (auto _ : state) {
+    for (int y = frame % 10; y < height; y += 10) {
+      char* row = cells.glyphs.data() + static_cast<size_t>(y) * width;
+      for (int x = 0; x < width; ++x) row[x] = row[x] == '@' ? ' ' : '@';
+    }
+    ++frame;
+    total += renderer.render(cells, target).bytes_written;
+    benchmark::DoNotOptimize(target.getData());
+  }
+  reportThroughput(state, image, state.iterations() ? total / state.iterations() : 0);
+}
+
+// The DiffRender frame sequence as 120 recorded frames, keyframes every 60
+static std::vector<CellGrid> makeSession(const RawImage& image) {
+  std::vector<CellGrid> session(120);
+  buildColoredCells(image, session[0]);
+  for (size_t i = 1; i < session.size(); ++i) {
+    session[i] = session[i - 1];
+    for (int y = static_cast<int>(i % 10); y < image.getHeight(); y += 10) {
+      char* row = session[i].glyphs.data() + static_cast<size_t>(y) * image.getWidth();
+      for (int x = 0; x < image.getWidth(); ++x) row[x] = row[x] == '@' ? ' ' : '@';
+    }
+  }
+  return session;
+}
+
+static void BM_RecordFrames(benchmark::State& state, const RawImage& image) {
+  std::string path = (std::filesystem::temp_directory_path() / "ascii_bench_record.rec").string();
+  std::vector<CellGrid> session = makeSession(image);
+  auto start = std::chrono::steady_clock::now();
+  size_t frames = 0;
+  uint64_t bytes = 0;
+  {
+    AsciiRecorder recorder(path, ColorMode::Truecolor, GlyphMode::Ascii, 60);
+    for (auto _ : state) {
+      recorder.addFrame(session[frames % session.size()], start + std::chrono::milliseconds(33 * frames));
+      ++frames;
+    }
+    bytes = recorder.bytesWritten();
+  }
+  reportThroughput(state, image, frames ? bytes / frames : 0);
+  std::filesystem::remove(path);
+}
+
+// Decoding from the mapped file into the player's grid, rendering excluded
+static void BM_PlayRecording(benchmark::State& state, const RawImage& image) {
+  std::string path = (std::filesystem::temp_directory_path() / "ascii_bench_play.rec").string();
+  std::vector<CellGrid> session = makeSession(image);
+  {
+    AsciiRecorder recorder(path, ColorMode::Truecolor, GlyphMode::Ascii, 60);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < session.size(); ++i) recorder.addFrame(session[i], start + std::chrono::milliseconds(33 * i));
+  }
+  AsciiPlayer player(path);
+  for (auto _ : state) {
+    if (!player.next()) {
+      player.seek(0);
+      player.next();
+    }
+    benchmark::DoNotOptimize(player.cells().glyphs.data());
+  }
+  reportThroughput(state, image, std::filesystem::file_size(path) / session.size());
+  std::filesystem::remove(path);
+}
+
+static void BM_OutputAsciiToFile(benchmark::State& state, const RawImage& image) {
+  std::string path = (std::filesystem::temp_directory_path() / "ascii_bench_output.txt").string();
+  RawImage ascii = convertToAscii(image);
+  for (auto _ : state) {
+    outputAsciiToFile(ascii, path.c_str());
+  }
+  reportThroughput(state, image, ascii.getSize() - 1);
+  std::filesystem::remove(path);
+}
+
+// The frame as a PPM file converted from its mapping in 1 MB strips to 200 plain
+// columns, written to /dev/null
+static void BM_ConvertInStrips(benchmark::State& state, const RawImage& image) {
+  std::string path = (std::filesystem::temp_directory_path() / "ascii_bench_strips.ppm").string();
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << "P6\n" << image.getWidth() << " " << image.getHeight() << "\n255\n";
+    file.write(reinterpret_cast<const char*>(image.getData()), static_cast<std::streamsize>(image.getSize()));
+  }
+  StripImageFile strips(path);
+  StripConvertConfig config;
+  config.columns = 200;
+  config.strip_bytes = 1 << 20;
+  int out = ::open("/dev/null", O_WRONLY);
+  StripConvertStats stats;
+  for (auto _ : state) {
+    stats = convertInStrips(strips, config, out);
+  }
+  ::close(out);
+  reportThroughput(state, image, stats.output_bytes);
+  state.counters["peak_bytes"] = static_cast<double>(stats.peak_bytes);
+  std::filesystem::remove(path);
+}
+
+// Capture-size BGR frame to a `columns` wide cell grid: the cv::resize + cvtColor
+// + buildColoredCells chain against the fused CellSampler
+static void BM_ResizeThenCells(benchmark::State& state, const RawImage& image) {
+  int columns = static_cast<int>(state.range(0));
+  cv::Mat frame(image.getHeight(), image.getWidth(), CV_8UC3, const_cast<uint8_t*>(image.getData()));
+  cv::Mat resized_frame;
+  CellGrid cells;
+  for (auto _ : state) {
+    int rows = cellRowsFor(image.getWidth(), image.getHeight(), columns);
+    cv::resize(frame, resized_frame, cv::Size(columns, rows), 0, 0, cv::INTER_AREA);
+    cv::cvtColor(resized_frame, resized_frame, cv::COLOR_BGR2RGB);
+    buildColoredCells(matView(resized_frame), cells);
+    benchmark::DoNotOptimize(cells.glyphs.data());
+  }
+  reportThroughput(state, image, cells.cellCount());
+}
+
+static void BM_SampleCells(benchmark::State& state, const RawImage& image) {
+  int columns = static_cast<int>(state.range(0));
+  CellSampler sampler;
+  CellGrid cells;
+  for (auto _ : state) {
+    sampler.sample(image, PixelFormat::BGR24, columns, cells);
+    benchmark::DoNotOptimize(cells.glyphs.data());
+  }
+  reportThroughput(state, image, cells.cellCount());
+}
+
+// What --edges adds to the stream: SampleCells, then the Sobel on the luma of
+// the cell colors (applyEdgeGlyphs)
+static void BM_SampleEdgeCells(benchmark::State& state, const RawImage& image) {
+  int columns = static_cast<int>(state.range(0));
+  CellSampler sampler;
+  CellGrid cells;
+  for (auto _ : state) {
+    sampler.sample(image, PixelFormat::BGR24, columns, cells);
+    applyEdgeGlyphs(cells);
+    benchmark::DoNotOptimize(cells.glyphs.data());
+  }
+  reportThroughput(state, image, cells.cellCount());
+}
+
+// The --incremental stream against the plain one: the moving square sampled to
+// `columns` cells, whole or through IncrementalCellSampler, then drawn by the
+// differential renderer. dirty_ratio is the share of 8x4-cell tiles resampled.
+static void BM_StreamCells(benchmark::State& state, const RawImage& image, bool incremental) {
+  int columns = static_cast<int>(state.range(0));
+  std::vector<RawImage> frames = makeMovingSquare(image);
+  CellSampler sampler;
+  IncrementalCellSampler incremental_sampler;
+  CellGrid cells;
+  auto sample = [&](const RawImage& frame) {
+    if (incremental) {
+      incremental_sampler.sample(frame, PixelFormat::BGR24, columns, cells);
+    } else {
+      sampler.sample(frame, PixelFormat::BGR24, columns, cells);
+    }
+  };
+  sample(frames[0]);
+  DiffRenderer renderer;
+  RawImage target(static_cast<int>(DiffRenderer::bufferSize(cells.width, cells.height)), 1, 1);
+  renderer.render(cells, target);
+  IncrementalStats start = incremental_sampler.totals();
+
+  size_t total = 0, index = 0;
+  for (auto _ : state) {
+    sample(frames[++index % frames.size()]);
+    total += renderer.render(cells, target).bytes_written;
+    benchmark::DoNotOptimize(target.getData());
+  }
+  reportThroughput(state, image, state.iterations() ? total / state.iterations() : 0);
+  if (incremental) {
+    IncrementalStats totals = incremental_sampler.totals();
+    state.counters["dirty_ratio"] = static_cast<double>(totals.dirty_tiles - start.dirty_tiles) /
+                                    static_cast<double>(std::max<size_t>(1, totals.tiles - start.tiles));
+  }
+}
+
+static void BM_ConvertToColoredAsciiParallel(benchmark::State& state, const RawImage& image) {
+  ThreadPool pool(static_cast<size_t>(state.range(0)));
+  RawImage target(static_cast<int>(coloredAsciiBufferSize(image.getWidth(), image.getHeight())), 1, 1);
+  size_t bytes = 0;
+  for (auto _ : state) {
+    bytes = convertToColoredAsciiParallel(image, target, pool);
+    benchmark::DoNotOptimize(target.getData());
+  }
+  reportThroughput(state, image, bytes);
+}
+
+// 16 PPM copies of the frame decoded, converted to 200 columns and dropped, on `threads` workers.
+// bytes_per_second is the encoded input read.
+static void BM_ConvertBatch(benchmark::State& state, const RawImage& image) {
+  std::filesystem::path directory = std::filesystem::temp_directory_path() / "ascii_bench_batch";
+  std::filesystem::create_directories(directory);
+  std::vector<std::string> files;
+  for (int i = 0; i < 16; ++i) {
+    files.push_back((directory / ("frame" + std::to_string(i) + ".ppm")).string());
+    std::ofstream file(files.back(), std::ios::binary | std::ios::trunc);
+    file << "P6\n" << image.getWidth() << " " << image.getHeight() << "\n255\n";
+    file.write(reinterpret_cast<const char*>(image.getData()), static_cast<std::streamsize>(image.getSize()));
+  }
+  ThreadPool pool(static_cast<size_t>(state.range(0)));
+  BatchConfig config;
+  config.columns = 200;
+  BatchStats stats;
+  for (auto _ : state) {
+    stats = convertBatch(files, config, pool);
+  }
+  size_t pixels = static_cast<size_t>(image.getWidth()) * image.getHeight() * files.size();
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * pixels));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * stats.input_bytes));
+  state.counters["images_per_second"] = benchmark::Counter(static_cast<double>(state.iterations() * files.size()),
+                                                           benchmark::Counter::kIsRate);
+  std::filesystem::remove_all(directory);
+}
+
+// 16 synthetic 640x480 sources composed into 40 column tiles, 10 lockstep
+// refreshes per iteration on the shared pool. bytes_per_second is the output.
+static void BM_MosaicRefresh(benchmark::State& state) {
+  std::vector<std::unique_ptr<SyntheticSource>> sources;
+  std::vector<FrameSource*> pointers;
+  for (int i = 0; i < 16; ++i) {
+    sources.push_back(std::make_unique<SyntheticSource>(640, 480, i % 2 ? SyntheticPattern::Noise : SyntheticPattern::ColorBars));
+    pointers.push_back(sources.back().get());
+  }
+  MosaicConfig config;
+  config.refresh_fps = 0;
+  config.max_refreshes = 10;
+  MosaicStats stats;
+  uint64_t refreshes = 0, bytes = 0;
+  for (auto _ : state) {
+    MosaicCompositor compositor(config, pointers, [](const char* data, size_t) { benchmark::DoNotOptimize(data); });
+    compositor.run();
+    stats = compositor.stats();
+    refreshes += stats.refreshes;
+    bytes += stats.bytes_written;
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(refreshes * pointers.size() * 640 * 480));
+  state.SetBytesProcessed(static_cast<int64_t>(bytes));
+  state.counters["refreshes_per_second"] = benchmark::Counter(static_cast<double>(refreshes), benchmark::Counter::kIsRate);
+}
+
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  // Google Benchmark only records its own build type, compare_baseline.py checks this one
+  benchmark::AddCustomContext("ascii_webcam_build_type", TOSTRING(ASCII_WEBCAM_BUILD_TYPE));
+
+  size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (const Resolution& res : RESOLUTIONS) {
+    for (const char* kind : INPUTS) {
+      std::string suffix = std::string("/") + res.name + "/" + kind;
+      const RawImage& image = input(kind, res);
+
+      benchmark::RegisterBenchmark(("GrayscaleToAscii" + suffix).c_str(), BM_GrayscaleToAscii, image);
+      for (AsciiKernel kernel : { AsciiKernel::Scalar, AsciiKernel::SSSE3, AsciiKernel::AVX2 }) {
+        benchmark::RegisterBenchmark((std::string("AsciiKernel_") + asciiKernelName(kernel) + suffix).c_str(),
+                                     BM_AsciiKernel, image, kernel);
+      }
+      benchmark::RegisterBenchmark(("ConvertToAscii" + suffix).c_str(), BM_ConvertToAscii, image);
+      benchmark::RegisterBenchmark(("ConvertToShapeAscii" + suffix).c_str(), BM_ConvertToShapeAscii, image);
+      benchmark::RegisterBenchmark(("ConvertToColoredShapeAscii" + suffix).c_str(), BM_ConvertToColoredShapeAscii, image);
+      benchmark::RegisterBenchmark(("ConvertToColoredAscii" + suffix).c_str(), BM_ConvertToColoredAscii, image);
+      benchmark::RegisterBenchmark(("ConvertToColoredAscii256" + suffix).c_str(), BM_ConvertToPaletteAscii, image,
+                                   ColorMode::Xterm256);
+      benchmark::RegisterBenchmark(("ConvertToColoredAscii16" + suffix).c_str(), BM_ConvertToPaletteAscii, image,
+                                   ColorMode::Ansi16);
+      benchmark::RegisterBenchmark(("IncrementalConvert" + suffix).c_str(), BM_IncrementalConvert, image);
+      benchmark::RegisterBenchmark(("ConvertToEdgeAscii" + suffix).c_str(), BM_ConvertToEdgeAscii, image)->UseRealTime();
+      benchmark::RegisterBenchmark(("ConvertToColoredEdgeAscii" + suffix).c_str(), BM_ConvertToColoredEdgeAscii, image)
+        ->UseRealTime();
+      for (PixelLayout layout : { PixelLayout::Gray, PixelLayout::GrayA, PixelLayout::RGBA, PixelLayout::BGR }) {
+        std::string name = std::string("_") + pixelLayoutName(layout) + suffix;
+        benchmark::RegisterBenchmark(("ConvertLayout" + name).c_str(), BM_ConvertLayout, image, layout, false);
+        benchmark::RegisterBenchmark(("ConvertLayoutColored" + name).c_str(), BM_ConvertLayout, image, layout, true);
+      }
+      for (YuvFormat format : { YuvFormat::YUYV, YuvFormat::NV12, YuvFormat::I420 }) {
+        std::string name = std::string("_") + yuvFormatName(format) + suffix;
+        for (bool decode : { false, true }) {
+          std::string prefix = decode ? "YuvDecodeThen" : "Yuv";
+          benchmark::RegisterBenchmark((prefix + "Ascii" + name).c_str(), BM_YuvConvert, image, format,
+                                       YuvOutput::Gray, decode);
+          benchmark::RegisterBenchmark((prefix + "ColoredAscii" + name).c_str(), BM_YuvConvert, image, format,
+                                       YuvOutput::Colored, decode);
+          if (res.width >= 640) {
+            benchmark::RegisterBenchmark((prefix + "SampleCells" + name).c_str(), BM_YuvConvert, image, format,
+                                         YuvOutput::Cells, decode);
+          }
+        }
+      }
+      benchmark::RegisterBenchmark(("ConvertToHalfBlockAscii" + suffix).c_str(), BM_ConvertToHalfBlockAscii, image);
+      benchmark::RegisterBenchmark(("ConvertToColoredBraille" + suffix).c_str(), BM_ConvertToColoredBraille, image);
+      benchmark::RegisterBenchmark(("ConvertToRainbowAscii" + suffix).c_str(), BM_ConvertToRainbowAscii, image);
+      benchmark::RegisterBenchmark(("RainbowAnimator" + suffix).c_str(), BM_RainbowAnimator, image);
+      benchmark::RegisterBenchmark(("DiffRender" + suffix).c_str(), BM_DiffRender, image);
+      benchmark::RegisterBenchmark(("RecordFrames" + suffix).c_str(), BM_RecordFrames, image);
+      benchmark::RegisterBenchmark(("PlayRecording" + suffix).c_str(), BM_PlayRecording, image);
+      // File output mostly waits on the kernel, CPU time would hide it
+      benchmark::RegisterBenchmark(("OutputAsciiToFile" + suffix).c_str(), BM_OutputAsciiToFile, image)->UseRealTime();
+
+      // Downsampling only happens from capture sizes
+      if (res.width >= 640) {
+        benchmark::RegisterBenchmark(("ResizeThenCells" + suffix).c_str(), BM_ResizeThenCells, image)
+          ->Arg(100)->Arg(200)->Arg(300);
+        benchmark::RegisterBenchmark(("SampleCells" + suffix).c_str(), BM_SampleCells, image)
+          ->Arg(100)->Arg(200)->Arg(300);
+        benchmark::RegisterBenchmark(("SampleEdgeCells" + suffix).c_str(), BM_SampleEdgeCells, image)
+          ->Arg(100)->Arg(200)->Arg(300);
+        benchmark::RegisterBenchmark(("StreamCells" + suffix).c_str(), BM_StreamCells, image, false)
+          ->Arg(100)->Arg(200);
+        benchmark::RegisterBenchmark(("StreamIncrementalCells" + suffix).c_str(), BM_StreamCells, image, true)
+          ->Arg(100)->Arg(200);
+        benchmark::RegisterBenchmark(("ConvertInStrips" + suffix).c_str(), BM_ConvertInStrips, image)->UseRealTime();
+      }
+
+      // Thread scaling only matters for the large frames
+      if (res.width >= 1920) {
+        auto* parallel = benchmark::RegisterBenchmark(("ConvertToColoredAsciiParallel" + suffix).c_str(),
+                                                      BM_ConvertToColoredAsciiParallel, image);
+        for (size_t threads = 1; threads < hardware_threads; threads *= 2) parallel->Arg(static_cast<int64_t>(threads));
+        parallel->Arg(static_cast<int64_t>(hardware_threads))->UseRealTime();
+        auto* batch = benchmark::RegisterBenchmark(("ConvertBatch" + suffix).c_str(), BM_ConvertBatch, image);
+        for (size_t threads = 1; threads < hardware_threads; threads *= 2) batch->Arg(static_cast<int64_t>(threads));
+        batch->Arg(static_cast<int64_t>(hardware_threads))->UseRealTime();
+      }
+    }
+  }
+
+  benchmark::RegisterBenchmark("MosaicRefresh", BM_MosaicRefresh)->UseRealTime();
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
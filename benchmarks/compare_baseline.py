@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Compares an ascii_bench JSON result against a stored baseline.
+
+    ./bin/ascii_bench --benchmark_repetitions=3 --benchmark_report_aggregates_only=true \
+        --benchmark_out=current.json --benchmark_out_format=json
+    python3 ../benchmarks/compare_baseline.py ../benchmarks/baseline.json current.json
+
+Benchmarks are matched by name and compared on pixels per second
+(items_per_second). With repetitions the median is used, single runs are
+compared directly. Exits with status 1 when any benchmark is slower than
+the baseline by more than the threshold.
+
+Both files must come from a Release build of ascii_bench, and a warning is
+printed when they were recorded on different hosts or CPU counts.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    return data.get("context", {}), results(data)
+
+
+def results(data):
+    iterations, medians = {}, {}
+    for bench in data.get("benchmarks", []):
+        if bench.get("error_occurred") or "items_per_second" not in bench:
+            continue
+        if bench.get("run_type") == "aggregate":
+            if bench.get("aggregate_name") == "median":
+                medians[bench["run_name"]] = bench
+        else:
+            iterations.setdefault(bench.get("run_name", bench["name"]), bench)
+    iterations.update(medians)
+    return iterations
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="allowed slowdown as a fraction, default 0.10")
+    args = parser.parse_args()
+
+    baseline_context, baseline = load(args.baseline)
+    current_context, current = load(args.current)
+
+    for path, context in ((args.baseline, baseline_context), (args.current, current_context)):
+        build_type = context.get("ascii_webcam_build_type", "unknown")
+        if build_type.lower() != "release":
+            print(f"{path} was recorded with a {build_type} build, rebuild with -DCMAKE_BUILD_TYPE=Release")
+            return 2
+    for key in ("host_name", "num_cpus"):
+        if baseline_context.get(key) != current_context.get(key):
+            print(f"warning: {key} differs, {baseline_context.get(key)} in the baseline and "
+                  f"{current_context.get(key)} now, the numbers are not comparable")
+
+    regressions = 0
+    print(f"{'benchmark':<56} {'baseline Mpx/s':>14} {'current Mpx/s':>14} {'change':>8}")
+    for name in sorted(baseline.keys() & current.keys()):
+        before = baseline[name]["items_per_second"] / 1e6
+        after = current[name]["items_per_second"] / 1e6
+        change = after / before - 1.0 if before > 0 else 0.0
+        flag = ""
+        if change < -args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<56} {before:>14.1f} {after:>14.1f} {change:>+7.1%}{flag}")
+
+    for name in sorted(baseline.keys() - current.keys()):
+        print(f"{name:<56} missing from current results")
+    for name in sorted(current.keys() - baseline.keys()):
+        print(f"{name:<56} new, not in baseline")
+
+    if regressions:
+        print(f"\n{regressions} benchmark(s) regressed by more than {args.threshold:.0%}")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
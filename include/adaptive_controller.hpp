@@ -0,0 +1,106 @@
+#ifndef ADAPTIVE_CONTROLLER_HPP
+#define ADAPTIVE_CONTROLLER_HPP
+
+#include <csignal>
+#include <cstdint>
+#include "ansi_emitter.hpp"
+#include "cell_sampler.hpp"
+#include "stage_profiler.hpp"
+
+struct TerminalSize
+{
+  int columns = 0, rows = 0;
+};
+
+// TIOCGWINSZ on fd, {0, 0} when it is not a terminal
+TerminalSize queryTerminalSize(int fd);
+
+// Notes SIGWINCH while alive and restores the previous handler afterwards.
+// Only one watcher may exist at a time.
+class TerminalResizeWatcher
+{
+private:
+  struct sigaction m_previous;
+public:
+  TerminalResizeWatcher();
+  ~TerminalResizeWatcher();
+  TerminalResizeWatcher(const TerminalResizeWatcher&) = delete;
+  TerminalResizeWatcher& operator=(const TerminalResizeWatcher&) = delete;
+
+  // True once per burst of SIGWINCH since the last call
+  bool resized();
+};
+
+// What the stream renders with, from best to cheapest quality
+struct AdaptiveSettings
+{
+  int width = 100;                            // Output columns before the terminal limits
+  ColorMode color_mode = ColorMode::Truecolor;
+  int color_tolerance = 0;                    // Color changes up to this are not redrawn
+
+  bool operator==(const AdaptiveSettings& other) const {
+    return width == other.width && color_mode == other.color_mode && color_tolerance == other.color_tolerance;
+  }
+  bool operator!=(const AdaptiveSettings& other) const { return !(*this == other); }
+};
+
+struct AdaptiveConfig
+{
+  double target_fps = 30.0;
+  int min_width = 40;
+  int max_width = 200;                        // The terminal width limits it further
+  ColorMode best_color_mode = ColorMode::Truecolor;
+  float aspect_correction = DEFAULT_ASPECT_CORRECTION;
+  // Hysteresis: degrade after this many frames over the budget in a row,
+  // improve only after many more frames under upgrade_load of it
+  int downgrade_frames = 5;
+  int upgrade_frames = 60;
+  double upgrade_load = 0.6;
+};
+
+// Picks the output width, color mode and color tolerance that keep frames
+// within 1 / target_fps, from the stage times of every shown frame.
+//
+// When rendering and writing take most of the frame the bytes are the
+// problem: the tolerance goes up first (fewer cells redrawn), then the
+// color mode goes down (shorter escapes), and the width only after that.
+// Otherwise the per-cell work is, and the width shrinks with the square
+// root of the overload, as the cell count grows with its square. Quality
+// comes back one step at a time, width first, after a long stretch of
+// fast frames. Every change restarts both counts, so a step is judged on
+// frames rendered with it.
+class AdaptiveController
+{
+private:
+  AdaptiveConfig m_config;
+  AdaptiveSettings m_settings;
+  TerminalSize m_terminal;
+  uint64_t m_budget_ns;
+  int m_slow_frames = 0;
+  int m_fast_frames = 0;
+  double m_load = 0;        // Frame time over the budget, averaged over the current run
+  double m_output_share = 0; // Render and output part of the frame time, same average
+  uint64_t m_adjustments = 0;
+
+  void degrade();
+  void improve();
+public:
+  static constexpr int TOLERANCE_STEP = 8;
+  static constexpr int MAX_TOLERANCE = 24;
+
+  explicit AdaptiveController(const AdaptiveConfig& config = AdaptiveConfig());
+
+  // The grid has to fit in columns x (rows - 1), the last row is the status line.
+  // A size of 0 leaves that dimension unlimited.
+  void setTerminalSize(const TerminalSize& size) { m_terminal = size; }
+  // Feeds the stage times of a frame that was shown. True when settings() changed.
+  bool update(const FrameTiming& timing);
+  // Columns for a source of this size: the current width, limited by the terminal
+  int outputWidth(int source_width, int source_height) const;
+
+  const AdaptiveSettings& settings() const { return m_settings; }
+  const TerminalSize& terminalSize() const { return m_terminal; }
+  uint64_t adjustments() const { return m_adjustments; }
+};
+
+#endif // ADAPTIVE_CONTROLLER_HPP
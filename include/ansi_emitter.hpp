@@ -0,0 +1,195 @@
+#ifndef ANSI_EMITTER_HPP
+#define ANSI_EMITTER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+
+// Longest truecolor SGR: \033[38;2;255;255;255m
+constexpr size_t TRUECOLOR_SGR_MAX_SIZE = 19;
+// Longest xterm-256 SGR: \033[38;5;255m
+constexpr size_t XTERM256_SGR_MAX_SIZE = 11;
+// Every ANSI-16 SGR: \033[31m or \033[91m
+constexpr size_t ANSI16_SGR_SIZE = 5;
+// \033[0m
+constexpr size_t COLOR_RESET_SIZE = 4;
+// Longest cursor move: \033[99999;99999H
+constexpr size_t CURSOR_POSITION_MAX_SIZE = 14;
+
+// Truecolor writes 24-bit colors, the palette modes map every color to the
+// nearest entry of the xterm 256-color or the 16-color ANSI palette
+enum class ColorMode { Truecolor, Xterm256, Ansi16 };
+
+inline size_t colorSgrMaxSize(ColorMode mode) {
+  switch (mode) {
+    case ColorMode::Xterm256: return XTERM256_SGR_MAX_SIZE;
+    case ColorMode::Ansi16: return ANSI16_SGR_SIZE;
+    default: return TRUECOLOR_SGR_MAX_SIZE;
+  }
+}
+
+// Decimal text of 0..255 followed by ';', padded to 4 bytes so a value
+// can be written with one fixed-size copy. len counts digits plus ';'.
+struct DecimalTable
+{
+  char text[256][4] = {};
+  uint8_t len[256] = {};
+  constexpr DecimalTable() {
+    for (int v = 0; v < 256; ++v) {
+      int n = 0;
+      if (v >= 100) text[v][n++] = static_cast<char>('0' + v / 100);
+      if (v >= 10) text[v][n++] = static_cast<char>('0' + (v / 10) % 10);
+      text[v][n++] = static_cast<char>('0' + v % 10);
+      text[v][n++] = ';';
+      len[v] = static_cast<uint8_t>(n);
+    }
+  }
+};
+inline constexpr DecimalTable DECIMAL_TABLE{};
+
+// Writes \033[38;2;r;g;bm at p and returns the end pointer.
+// May scribble up to two bytes past the end, all inside the 19-byte worst case.
+inline char* writeTruecolorSgr(char* p, uint8_t r, uint8_t g, uint8_t b) {
+  std::memcpy(p, "\033[38;2;", 7);
+  p += 7;
+  std::memcpy(p, DECIMAL_TABLE.text[r], 4);
+  p += DECIMAL_TABLE.len[r];
+  std::memcpy(p, DECIMAL_TABLE.text[g], 4);
+  p += DECIMAL_TABLE.len[g];
+  std::memcpy(p, DECIMAL_TABLE.text[b], 4);
+  p += DECIMAL_TABLE.len[b];
+  p[-1] = 'm';
+  return p;
+}
+
+// Writes the background color \033[48;2;r;g;bm at p and returns the end pointer.
+// May scribble up to two bytes past the end, all inside the 19-byte worst case.
+inline char* writeTruecolorBackgroundSgr(char* p, uint8_t r, uint8_t g, uint8_t b) {
+  std::memcpy(p, "\033[48;2;", 7);
+  p += 7;
+  std::memcpy(p, DECIMAL_TABLE.text[r], 4);
+  p += DECIMAL_TABLE.len[r];
+  std::memcpy(p, DECIMAL_TABLE.text[g], 4);
+  p += DECIMAL_TABLE.len[g];
+  std::memcpy(p, DECIMAL_TABLE.text[b], 4);
+  p += DECIMAL_TABLE.len[b];
+  p[-1] = 'm';
+  return p;
+}
+
+// Writes \033[38;5;Nm at p and returns the end pointer.
+// May scribble up to two bytes past the end, all inside the 11-byte worst case.
+inline char* writeXterm256Sgr(char* p, uint8_t index) {
+  std::memcpy(p, "\033[38;5;", 7);
+  p += 7;
+  std::memcpy(p, DECIMAL_TABLE.text[index], 4);
+  p += DECIMAL_TABLE.len[index];
+  p[-1] = 'm';
+  return p;
+}
+
+// Writes \033[3Nm for colors 0-7 and \033[9Nm for the bright colors 8-15
+inline char* writeAnsi16Sgr(char* p, uint8_t index) {
+  p[0] = '\033';
+  p[1] = '[';
+  p[2] = index < 8 ? '3' : '9';
+  p[3] = static_cast<char>('0' + (index & 7));
+  p[4] = 'm';
+  return p + ANSI16_SGR_SIZE;
+}
+
+// Writes a non-negative integer as decimal text and returns the end pointer.
+inline char* writeDecimal(char* p, unsigned int value) {
+  char digits[10];
+  int n = 0;
+  do {
+    digits[n++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value);
+  while (n) *p++ = digits[--n];
+  return p;
+}
+
+// Writes \033[row;colH (1-based) at p and returns the end pointer.
+inline char* writeCursorPosition(char* p, int row, int col) {
+  *p++ = '\033';
+  *p++ = '[';
+  p = writeDecimal(p, static_cast<unsigned int>(row));
+  *p++ = ';';
+  p = writeDecimal(p, static_cast<unsigned int>(col));
+  *p++ = 'H';
+  return p;
+}
+
+// Appends colored glyphs to a caller-provided buffer.
+// An SGR sequence is only written when the cell color differs from the
+// last emitted color by more than `tolerance` on any channel, so the
+// error against the source color never exceeds the tolerance.
+class TruecolorEmitter
+{
+private:
+  char* m_begin;
+  char* m_p;
+  int m_tolerance;
+  bool m_has_color = false;
+  uint8_t m_r = 0, m_g = 0, m_b = 0;
+public:
+  explicit TruecolorEmitter(char* out, int tolerance = 0)
+  : m_begin(out), m_p(out), m_tolerance(tolerance) {}
+
+  // Writes the SGR for (r, g, b) unless the active color is within the tolerance
+  void setColor(uint8_t r, uint8_t g, uint8_t b) {
+    if (!m_has_color || std::abs(r - m_r) > m_tolerance || std::abs(g - m_g) > m_tolerance ||
+        std::abs(b - m_b) > m_tolerance) {
+      m_p = writeTruecolorSgr(m_p, r, g, b);
+      m_r = r;
+      m_g = g;
+      m_b = b;
+      m_has_color = true;
+    }
+  }
+  void put(uint8_t r, uint8_t g, uint8_t b, char glyph) {
+    setColor(r, g, b);
+    *m_p++ = glyph;
+  }
+  void putChar(char c) { *m_p++ = c; }
+  void putText(const char* text, size_t len) {
+    std::memcpy(m_p, text, len);
+    m_p += len;
+  }
+  void putCursorPosition(int row, int col) { m_p = writeCursorPosition(m_p, row, col); }
+  // Treats (r, g, b) as already active, e.g. when continuing a stream written elsewhere
+  void assumeColor(uint8_t r, uint8_t g, uint8_t b) {
+    m_r = r;
+    m_g = g;
+    m_b = b;
+    m_has_color = true;
+  }
+  // Forces the next put() to emit its color, e.g. after the terminal state is unknown
+  void forgetColor() { m_has_color = false; }
+  // Copies the color the terminal is drawing with, which can differ from the last put() by the tolerance
+  void activeColor(uint8_t* rgb) const {
+    rgb[0] = m_r;
+    rgb[1] = m_g;
+    rgb[2] = m_b;
+  }
+  // Writes the color reset and a terminating NUL (not counted in size())
+  void finish() {
+    std::memcpy(m_p, "\033[0m", COLOR_RESET_SIZE);
+    m_p += COLOR_RESET_SIZE;
+    *m_p = '\0';
+  }
+  size_t size() const { return static_cast<size_t>(m_p - m_begin); }
+  char* end() const { return m_p; }
+};
+
+// Worst-case buffer size for a width x height colored frame:
+// SGR + glyph per cell, '\n' per row, color reset and NUL.
+// The bound is reached when every cell changes to a color with the longest SGR.
+inline size_t coloredAsciiBufferSize(int width, int height, ColorMode mode = ColorMode::Truecolor) {
+  return static_cast<size_t>(height) * (static_cast<size_t>(width) * (colorSgrMaxSize(mode) + 1) + 1) +
+         COLOR_RESET_SIZE + 1;
+}
+
+#endif // ANSI_EMITTER_HPP
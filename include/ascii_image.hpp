@@ -7,6 +7,14 @@
 #include <cmath>
 #include <cstring>
 #include "raw_image.hpp"
+#include "raw_image_view.hpp"
+#include "buffer_pool.hpp"
+#include "ansi_emitter.hpp"
+#include "frame_renderer.hpp"
+#include "frame_source.hpp"
+#include "stage_profiler.hpp"
+#include "adaptive_controller.hpp"
+#include "pixel_layout.hpp"
 #include <opencv2/opencv.hpp>
 
 extern const char* ASCII_CHARS;
@@ -15,25 +23,70 @@ int getGrayscaleValue(uint8_t r, uint8_t g, uint8_t b);
 char pixelToAscii(int grayValue);
 
 
-RawImage convertToAscii(const RawImage &source_image) ;
+// Wraps a cv::Mat without copying, the Mat must outlive the view
+inline RawImageView matView(const cv::Mat& mat) {
+  return RawImageView(mat.data, mat.cols, mat.rows, mat.channels(), mat.step);
+}
 
 
+// Every converter takes 1 to 4 channel views (gray, gray + alpha, RGB, RGBA)
+// and picks the kernel for the layout once per call, alpha over black.
+RawImage convertToAscii(const RawImageView& source_image) ;
+// Same, for a layout the channel count cannot tell apart, like BGR
+RawImage convertToAscii(const RawImageView& source_image, PixelLayout layout);
+// Same, with the result drawn from the pool instead of the heap
+RawImage convertToAscii(const RawImageView& source_image, BufferPool& pool);
+// Same text into a caller buffer of at least (width + 1) * height + 1 bytes.
+// Returns the number of bytes written, excluding the terminating NUL.
+size_t convertToAscii(const RawImageView& source_image, RawImage& target);
+
+
+// The rainbow repeats every RAINBOW_PERIOD steps along x + y + scroll_offset,
+// the colors come from a table of one period
+const int RAINBOW_PERIOD = 63;
+
 void getRainbowColor(int width, int height, int scroll_offset, 
                     uint8_t& red, uint8_t& green, uint8_t& blue) ;
 
-void convertToRainbowAscii(const RawImage& img, int scroll_offset, RawImage& target);
+// Returns the number of bytes written, excluding the terminating NUL.
+// Target must hold at least coloredAsciiBufferSize(width, height) bytes.
+size_t convertToRainbowAscii(const RawImageView& img, int scroll_offset, RawImage& target, int color_tolerance = 0);
 
 
-void convertToColoredAscii(const RawImage &source_image, RawImage& target);
+// color_tolerance: skip the SGR sequence while every channel stays within
+// this distance of the last emitted color (0 = only identical colors).
+size_t convertToColoredAscii(const RawImageView& source_image, RawImage& target, int color_tolerance = 0);
+// Any color mode. The palette modes look each pixel up in the ColorCube in the
+// same pass as its glyph and only write an SGR when the palette index changes,
+// color_tolerance only applies to Truecolor.
+// Target must hold at least coloredAsciiBufferSize(width, height, mode) bytes.
+size_t convertToColoredAscii(const RawImageView& source_image, RawImage& target, ColorMode mode,
+                             int color_tolerance = 0);
+// Same, for an explicit layout
+size_t convertToColoredAscii(const RawImageView& source_image, RawImage& target, ColorMode mode, int color_tolerance,
+                             PixelLayout layout);
 
 
+// Writes the NUL-terminated text in img, or exactly `size` bytes of data, with a single write
 void outputAsciiToFile(const RawImage &img, const char* output_filename) ;
+void outputAsciiToFile(const char* data, size_t size, const char* output_filename);
+
+
+void outputRainbowAsciiAnimation(const RawImageView& img, size_t FRAMES_TO_PROCESS,
+                                 RenderMode mode = RenderMode::Differential);
 
 
-void outputRainbowAsciiAnimation(const RawImage& img, size_t FRAMES_TO_PROCESS);
+// Streams frames until FRAMES_TO_PROCESS were shown or the source ends (0 = until it ends).
+// With a profiler every stage of every frame is timed, and a summary is printed at the end.
+// Without a controller the output is 100 columns in truecolor. With one, the width, color
+// mode and color tolerance follow its settings, limited to the terminal size, which is
+// read again on every SIGWINCH.
+void outputAsciiStream(FrameSource& source, size_t FRAMES_TO_PROCESS, RenderMode mode = RenderMode::Differential,
+                       StageProfiler* profiler = nullptr, AdaptiveController* controller = nullptr);
 
 
-void outputWebcameAsciiStream(size_t FRAMES_TO_PROCESS);
+void outputWebcameAsciiStream(size_t FRAMES_TO_PROCESS, RenderMode mode = RenderMode::Differential,
+                              StageProfiler* profiler = nullptr, AdaptiveController* controller = nullptr);
   
 
 #endif // ASCII_IMAGE_HPP
\ No newline at end of file
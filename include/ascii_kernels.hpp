@@ -0,0 +1,27 @@
+#ifndef ASCII_KERNELS_HPP
+#define ASCII_KERNELS_HPP
+
+#include <cstdint>
+
+// Row kernels turning packed RGB pixels into ASCII glyphs.
+// The scalar kernel (getGrayscaleValue + pixelToAscii) is the reference,
+// the SIMD kernels must produce byte-identical output.
+enum class AsciiKernel { Scalar, SSSE3, AVX2 };
+
+const char* asciiKernelName(AsciiKernel kernel);
+bool isAsciiKernelSupported(AsciiKernel kernel);
+AsciiKernel detectBestAsciiKernel();
+
+// Kernel used by convertToAscii, picked once from the CPU features at startup.
+AsciiKernel getAsciiKernel();
+void setAsciiKernel(AsciiKernel kernel); // Throws if the CPU lacks the kernel
+
+// Writes exactly `width` glyphs to `out`, no '\n' and no terminator.
+void convertRowToAscii(const uint8_t* rgb, int width, char* out);
+void convertRowToAscii(AsciiKernel kernel, const uint8_t* rgb, int width, char* out);
+
+// Writes the luma of `width` pixels to `out`, the values getGrayscaleValue returns.
+void convertRowToGray(const uint8_t* rgb, int width, uint8_t* out);
+void convertRowToGray(AsciiKernel kernel, const uint8_t* rgb, int width, uint8_t* out);
+
+#endif // ASCII_KERNELS_HPP
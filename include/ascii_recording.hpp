@@ -0,0 +1,144 @@
+#ifndef ASCII_RECORDING_HPP
+#define ASCII_RECORDING_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "frame_renderer.hpp"
+#include "dense_ascii.hpp"
+
+// Binary recording of a session of CellGrid frames, all integers little endian:
+//   header    RECORDING_HEADER_SIZE bytes, see RecordingInfo
+//   frames    16 byte frame header (type, payload size, timestamp in us), payload
+//   index     one 24 byte entry (frame number, file offset, timestamp) per keyframe
+// A keyframe payload is the glyph plane (1 byte per cell) followed by the
+// color plane (3 bytes RGB per cell, or 1 byte palette index in the 256 and
+// 16 color modes). A delta payload is a list of runs of changed cells: the
+// unchanged cells skipped and the run length as varints, then the glyphs and
+// colors of the run. The header's index offset and counts are filled in by
+// close(); a recording that was never closed is still playable, the player
+// rebuilds the index by scanning the frames.
+constexpr char RECORDING_MAGIC[8] = { 'A', 'S', 'C', 'I', 'I', 'R', 'E', 'C' };
+constexpr uint16_t RECORDING_VERSION = 1;
+constexpr size_t RECORDING_HEADER_SIZE = 48;
+constexpr size_t RECORDING_FRAME_HEADER_SIZE = 16;
+constexpr size_t RECORDING_INDEX_ENTRY_SIZE = 24;
+
+enum class RecordedFrameType : uint8_t { Keyframe = 1, Delta = 2 };
+
+struct RecordingInfo
+{
+  int width = 0, height = 0; // Cells, or pixels in the dense glyph modes
+  ColorMode color_mode = ColorMode::Truecolor;
+  GlyphMode glyph_mode = GlyphMode::Ascii;
+  uint32_t keyframe_interval = 0;
+  uint32_t frame_count = 0;
+  uint32_t keyframe_count = 0;
+  uint64_t index_offset = 0; // 0 while the recording is open
+  uint64_t duration_us = 0;  // Timestamp of the last frame
+};
+
+struct RecordingKeyframe
+{
+  uint32_t frame = 0;
+  uint64_t offset = 0;
+  uint64_t timestamp_us = 0;
+};
+
+// Bytes per cell in the color plane
+inline size_t recordedColorSize(ColorMode mode) { return mode == ColorMode::Truecolor ? 3 : 1; }
+
+// Appends frames to a recording. The first frame fixes the grid size, later
+// frames of another size throw. Every keyframe_interval-th frame, and every
+// frame whose delta would not be smaller, is stored as a keyframe.
+class AsciiRecorder
+{
+private:
+  std::ofstream m_file;
+  RecordingInfo m_info;
+  std::vector<RecordingKeyframe> m_index;
+  std::vector<char> m_glyphs;     // Previous frame, as stored
+  std::vector<uint8_t> m_colors;
+  std::vector<uint8_t> m_plane;   // Color plane of the current frame
+  std::vector<uint8_t> m_payload;
+  std::chrono::steady_clock::time_point m_start;
+  uint64_t m_offset = 0;
+  uint64_t m_bytes = 0;
+
+  void writeHeader();
+  void fillColorPlane(const CellGrid& cells);
+  void encodeKeyframe(const CellGrid& cells);
+  void encodeDelta(const CellGrid& cells);
+public:
+  static constexpr uint32_t DEFAULT_KEYFRAME_INTERVAL = 120;
+
+  // Creates or truncates the file, throws when it cannot be opened
+  explicit AsciiRecorder(const std::string& filename, ColorMode color_mode = ColorMode::Truecolor,
+                         GlyphMode glyph_mode = GlyphMode::Ascii,
+                         uint32_t keyframe_interval = DEFAULT_KEYFRAME_INTERVAL);
+  ~AsciiRecorder(); // Closes the recording
+  AsciiRecorder(const AsciiRecorder&) = delete;
+  AsciiRecorder& operator=(const AsciiRecorder&) = delete;
+
+  // Timestamps are stored relative to the first frame
+  void addFrame(const CellGrid& cells, std::chrono::steady_clock::time_point captured_at);
+  // Writes the seek index and completes the header. Further frames throw.
+  void close();
+
+  const RecordingInfo& info() const { return m_info; }
+  uint64_t bytesWritten() const { return m_bytes; }
+};
+
+// Maps a recording into memory and decodes its frames into one CellGrid that
+// is allocated up front, so playing allocates nothing per frame. Palette
+// indices are decoded to an RGB color that renders as the same index.
+class AsciiPlayer
+{
+private:
+  const uint8_t* m_data = nullptr;
+  size_t m_size = 0;
+  RecordingInfo m_info;
+  std::vector<RecordingKeyframe> m_index;
+  CellGrid m_cells;
+  uint64_t m_position = 0;    // File offset of the next frame
+  uint32_t m_next_frame = 0;  // Number of the next frame
+  uint64_t m_timestamp_us = 0;
+  size_t m_changed_cells = 0;
+  std::array<uint8_t, 256 * 3> m_palette{}; // RGB of every palette index
+
+  void scanFrames();
+  void buildPalette();
+  void decodeColors(const uint8_t* plane, size_t first, size_t count);
+public:
+  // Throws when the file cannot be mapped or is not a recording
+  explicit AsciiPlayer(const std::string& filename);
+  ~AsciiPlayer();
+  AsciiPlayer(const AsciiPlayer&) = delete;
+  AsciiPlayer& operator=(const AsciiPlayer&) = delete;
+
+  // Decodes the next frame into cells(), false after the last one
+  bool next();
+  // Positions the player so that next() decodes `frame`, replaying from the
+  // nearest keyframe before it
+  void seek(uint32_t frame);
+  // Same for the first frame at or after the timestamp
+  void seekTime(uint64_t timestamp_us);
+
+  const RecordingInfo& info() const { return m_info; }
+  const std::vector<RecordingKeyframe>& keyframes() const { return m_index; }
+  const CellGrid& cells() const { return m_cells; }
+  // Of the frame decoded last
+  uint64_t timestamp() const { return m_timestamp_us; }
+  size_t changedCells() const { return m_changed_cells; }
+  uint32_t nextFrame() const { return m_next_frame; }
+};
+
+// Plays a recording to stdout at its recorded timing divided by `speed`,
+// or as fast as the terminal takes it when speed is 0
+void playRecording(const std::string& filename, double speed = 1.0);
+
+#endif // ASCII_RECORDING_HPP
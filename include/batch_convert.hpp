@@ -0,0 +1,70 @@
+#ifndef BATCH_CONVERT_HPP
+#define BATCH_CONVERT_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ansi_emitter.hpp"
+#include "thread_pool.hpp"
+
+struct BatchConfig
+{
+  std::string output_directory; // <path>.txt per image, empty converts without writing
+  int columns = 0;               // 0 keeps one glyph per pixel, otherwise box-averaged cells
+  bool color = false;            // Plain ASCII, or colored in color_mode
+  ColorMode color_mode = ColorMode::Truecolor;
+  size_t workers = 0;            // 0 uses every thread of the pool
+};
+
+struct BatchFileResult
+{
+  std::string path;
+  std::string output_name;       // Relative to output_directory
+  bool ok = false;
+  std::string error;             // Why the file was skipped
+  int width = 0, height = 0;     // Of the decoded image
+  uint64_t input_bytes = 0;      // Encoded file size
+  uint64_t output_bytes = 0;
+  uint64_t decode_ns = 0, convert_ns = 0, write_ns = 0;
+  size_t worker = 0;
+};
+
+struct BatchStats
+{
+  std::vector<BatchFileResult> files; // In input order
+  size_t converted = 0, failed = 0;
+  size_t workers = 0;
+  uint64_t input_bytes = 0;
+  uint64_t pixels = 0;
+  uint64_t output_bytes = 0;
+  uint64_t wall_ns = 0;
+
+  double imagesPerSecond() const { return wall_ns ? converted * 1e9 / wall_ns : 0; }
+  // Encoded input read per second
+  double megabytesPerSecond() const { return wall_ns ? input_bytes / 1e6 * 1e9 / wall_ns : 0; }
+};
+
+// Regular files of the directory, sorted
+std::vector<std::string> listBatchDirectory(const std::string& directory);
+// One path per line, blank lines and lines starting with # skipped
+std::vector<std::string> readBatchList(const std::string& list_file);
+
+// Converts every file to ASCII on the pool. Each worker claims the next
+// unconverted file from a shared counter, so a few large images never leave
+// the other workers idle, and runs the whole chain for it (read + decode,
+// convert, write) with its own text buffer, cell grid and sampler, reused
+// for every file it takes. Decoding on one worker overlaps converting and
+// writing on the others. Files that cannot be decoded or written are
+// reported in their BatchFileResult, they never stop the batch.
+// Output files keep the input paths relative to the deepest directory that
+// holds every input, so a/img.png and b/img.png write a/img.png.txt and
+// b/img.png.txt. A file listed twice is converted once, the repeat fails.
+BatchStats convertBatch(const std::vector<std::string>& files, const BatchConfig& config,
+                        ThreadPool& pool = sharedThreadPool());
+
+// Totals, images/s and MB/s, then one line per file when per_file is set
+void writeBatchReport(const BatchStats& stats, std::ostream& out, bool per_file = true);
+
+#endif // BATCH_CONVERT_HPP
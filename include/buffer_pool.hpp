@@ -0,0 +1,44 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// A fixed number of equally sized buffers carved out of one allocation.
+// acquire/release never touch the heap, so images drawn from the pool
+// cost nothing per frame once streaming reached steady state.
+// The pool must outlive every buffer it handed out. Thread safe.
+class BufferPool
+{
+private:
+  size_t m_buffer_size;
+  size_t m_buffer_count;
+  std::unique_ptr<uint8_t[]> m_storage;
+  std::vector<uint8_t*> m_free;
+  std::vector<bool> m_in_use; // Per buffer, catches a second release
+  size_t m_misses = 0;
+  mutable std::mutex m_mutex;
+public:
+  BufferPool(size_t buffer_size, size_t buffer_count);
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  // A buffer of at least `size` bytes, or nullptr when the request is
+  // larger than the buffer size or every buffer is in use
+  uint8_t* acquire(size_t size);
+  // Returns a buffer from acquire(). Releasing a buffer the pool does not
+  // own, or one that is already free, is a bug and aborts.
+  void release(uint8_t* buffer) noexcept;
+  bool owns(const uint8_t* buffer) const;
+
+  size_t bufferSize() const { return m_buffer_size; }
+  size_t capacity() const { return m_buffer_count; }
+  size_t available() const;
+  // Requests that could not be served and went to the heap instead
+  size_t misses() const;
+};
+
+#endif // BUFFER_POOL_HPP
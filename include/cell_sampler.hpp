@@ -0,0 +1,68 @@
+#ifndef CELL_SAMPLER_HPP
+#define CELL_SAMPLER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "raw_image_view.hpp"
+#include "frame_renderer.hpp"
+#include "frame_source.hpp"
+#include "yuv_image.hpp"
+
+// Terminal cells are about twice as tall as wide
+static constexpr float DEFAULT_ASPECT_CORRECTION = 0.55f;
+
+// Rows of a `columns` wide grid for a source of the given size, at least 1
+int cellRowsFor(int source_width, int source_height, int columns, float aspect_correction = DEFAULT_ASPECT_CORRECTION);
+// First source pixel of cell `index` when `size` pixels are split into `count` cells
+inline int cellStart(int size, int count, int index) {
+  return static_cast<int>(static_cast<int64_t>(index) * size / count);
+}
+
+// Fused downsample + color + glyph. Every cell is the box average of the
+// source pixels it covers, read straight from the full-resolution capture
+// buffer (BGR, RGB or gray) in a single pass over the source rows. Colors land in
+// the grid and the glyphs are computed from them, with no resized or
+// color-converted intermediate image. Replaces cv::resize + cvtColor +
+// buildColoredCells in the streaming loops.
+class CellSampler
+{
+private:
+  int m_source_width = 0, m_columns = 0, m_channels = 0;
+  std::vector<int> m_column_start; // columns + 1 source x boundaries
+  std::vector<uint64_t> m_sums;    // Per column B/G/R, R/G/B or gray sums of the current cell row
+  std::vector<uint16_t> m_vertical; // Per source byte sums over the cell row's source rows
+  uint64_t m_row_height = 0;        // Source rows added to the current cell row
+  std::vector<int> m_chroma_begin, m_chroma_end; // Per column chroma sample range of a YUV source
+  std::vector<uint16_t> m_chroma_vertical;
+
+  void prepareColumns(int source_width, int columns, int channels);
+  // addRows and finishRow for the cells [column_begin, column_end) of the row only
+  void addColumns(const RawImageView& band, int column_begin, int column_end);
+  void finishColumns(PixelFormat format, uint8_t* colors, char* glyphs, int column_begin, int column_end);
+public:
+  // Fills `cells` with a columns x cellRowsFor(...) grid. Columns wider than
+  // the source are clamped to the source width.
+  void sample(const RawImageView& source, PixelFormat format, int columns, CellGrid& cells,
+              float aspect_correction = DEFAULT_ASPECT_CORRECTION);
+  // Resamples only the cells [column_begin, column_end) x [row_begin, row_end)
+  // of a grid that sample() filled from a source of the same size and
+  // format, the other cells keep what they have.
+  void sampleRegion(const RawImageView& source, PixelFormat format, CellGrid& cells, int column_begin,
+                    int column_end, int row_begin, int row_end);
+  // The same grid from a YUV frame. Y, U and V are box averaged in their own
+  // planes, the glyph comes from the averaged Y and only the cell colors are
+  // converted to RGB, once per cell instead of once per pixel.
+  void sample(const YuvImageView& source, int columns, CellGrid& cells,
+              float aspect_correction = DEFAULT_ASPECT_CORRECTION);
+  // The same box averages one cell row at a time, for callers that only hold
+  // part of the source: beginRow, addRows for consecutive bands of the cell
+  // row's source rows, then finishRow writes `columns` RGB colors and glyphs.
+  void beginRow(int source_width, int channels, int columns);
+  void addRows(const RawImageView& band);
+  void finishRow(PixelFormat format, uint8_t* colors, char* glyphs);
+  // Bytes held by the column tables and sums
+  size_t scratchBytes() const;
+};
+
+#endif // CELL_SAMPLER_HPP
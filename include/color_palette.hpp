@@ -0,0 +1,86 @@
+#ifndef COLOR_PALETTE_HPP
+#define COLOR_PALETTE_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "ansi_emitter.hpp"
+
+// Palette index for every color, quantized to 5 bits per channel (32x32x32
+// entries, 32 KiB). Each entry holds the palette color nearest to the center
+// of its cell, so converting a pixel is one table load instead of a search.
+class ColorCube
+{
+public:
+  static const int BITS = 5;
+  static const size_t SIZE = size_t(1) << (3 * BITS);
+
+private:
+  std::array<uint8_t, SIZE> m_index;
+
+public:
+  // Palette modes only, Truecolor throws
+  explicit ColorCube(ColorMode mode);
+
+  static size_t cellFor(uint8_t r, uint8_t g, uint8_t b) {
+    return (static_cast<size_t>(r >> (8 - BITS)) << (2 * BITS)) | (static_cast<size_t>(g >> (8 - BITS)) << BITS) |
+           static_cast<size_t>(b >> (8 - BITS));
+  }
+  uint8_t lookup(uint8_t r, uint8_t g, uint8_t b) const { return m_index[cellFor(r, g, b)]; }
+};
+
+// Shared cubes, built on first use. Truecolor throws.
+const ColorCube& colorCube(ColorMode mode);
+
+// RGB of a palette entry as xterm shows it by default
+void paletteColor(ColorMode mode, uint8_t index, uint8_t& r, uint8_t& g, uint8_t& b);
+// Nearest palette entry by exhaustive search, the reference for the cube.
+// xterm-256 only uses the 6x6x6 cube and the gray ramp (16-255), entries
+// 0-15 follow the terminal theme and are left to the ANSI-16 mode.
+uint8_t nearestPaletteIndex(ColorMode mode, uint8_t r, uint8_t g, uint8_t b);
+
+// "truecolor"/"24bit", "256", "16"
+ColorMode parseColorMode(const std::string& name);
+const char* colorModeName(ColorMode mode);
+
+// Same interface as TruecolorEmitter for the palette modes. An SGR sequence
+// is only written when the palette index changes.
+class PaletteEmitter
+{
+private:
+  char* m_begin;
+  char* m_p;
+  const ColorCube& m_cube;
+  bool m_ansi16;
+  int m_index = -1;
+public:
+  PaletteEmitter(char* out, ColorMode mode)
+  : m_begin(out), m_p(out), m_cube(colorCube(mode)), m_ansi16(mode == ColorMode::Ansi16) {}
+
+  void putIndex(uint8_t index, char glyph) {
+    if (index != m_index) {
+      m_p = m_ansi16 ? writeAnsi16Sgr(m_p, index) : writeXterm256Sgr(m_p, index);
+      m_index = index;
+    }
+    *m_p++ = glyph;
+  }
+  void put(uint8_t r, uint8_t g, uint8_t b, char glyph) { putIndex(m_cube.lookup(r, g, b), glyph); }
+  void putChar(char c) { *m_p++ = c; }
+  void putText(const char* text, size_t len) {
+    std::memcpy(m_p, text, len);
+    m_p += len;
+  }
+  void putCursorPosition(int row, int col) { m_p = writeCursorPosition(m_p, row, col); }
+  void forgetColor() { m_index = -1; }
+  // Writes the color reset and a terminating NUL (not counted in size())
+  void finish() {
+    std::memcpy(m_p, "\033[0m", COLOR_RESET_SIZE);
+    m_p += COLOR_RESET_SIZE;
+    *m_p = '\0';
+  }
+  size_t size() const { return static_cast<size_t>(m_p - m_begin); }
+  char* end() const { return m_p; }
+};
+
+#endif // COLOR_PALETTE_HPP
@@ -0,0 +1,100 @@
+#ifndef DENSE_ASCII_HPP
+#define DENSE_ASCII_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "raw_image.hpp"
+#include "raw_image_view.hpp"
+#include "ascii_kernels.hpp"
+#include "frame_renderer.hpp"
+#include "shape_ascii.hpp"
+
+// Modes that put several pixels in one terminal cell.
+// Half-block: "▀" with the top pixel as foreground and the bottom pixel as
+// background color, 1x2 pixels per cell. Braille: U+2800-U+28FF, 2x4 dots
+// per cell, each dot on or off. Both glyphs are 3 bytes of UTF-8.
+// Shape: the ASCII glyph whose outline best matches the 4x8 pixels of the
+// cell, see shape_ascii.hpp.
+enum class GlyphMode { Ascii, HalfBlock, Braille, Shape };
+
+// "ascii", "half" / "halfblock", "braille", "shape"
+GlyphMode parseGlyphMode(const std::string& name);
+const char* glyphModeName(GlyphMode mode);
+
+// Source pixels covered by one cell
+inline int glyphCellWidth(GlyphMode mode) {
+  switch (mode) {
+    case GlyphMode::Braille: return 2;
+    case GlyphMode::Shape: return 4;
+    default: return 1;
+  }
+}
+inline int glyphCellHeight(GlyphMode mode) {
+  switch (mode) {
+    case GlyphMode::HalfBlock: return 2;
+    case GlyphMode::Braille: return 4;
+    case GlyphMode::Shape: return 8;
+    default: return 1;
+  }
+}
+
+constexpr size_t UNICODE_GLYPH_SIZE = 3;
+// \033[38;2;255;255;255;48;2;255;255;255m, foreground and background in one SGR
+constexpr size_t HALF_BLOCK_SGR_MAX_SIZE = 36;
+
+// Every cell as "▀" with both colors changed, a reset and '\n' per row, NUL.
+// Exact: a picture whose every cell needs both colors reaches it.
+size_t halfBlockBufferSize(int width, int height);
+// Width x height pixels as ceil(height / 2) rows of half blocks. Colors are
+// only written when they differ from the active ones by more than
+// color_tolerance; cells whose two pixels are within the tolerance of each
+// other become a space on the background color. Every row ends with a reset,
+// so the background never bleeds past the picture.
+// Returns the bytes written, excluding the terminating NUL.
+size_t convertToHalfBlockAscii(const RawImageView& img, RawImage& target, int color_tolerance = 0);
+
+// 3 bytes per cell, '\n' per row, NUL. Always exact.
+size_t brailleBufferSize(int width, int height);
+// Worst case of the colored variant: an SGR per cell, a reset and NUL at the end
+size_t coloredBrailleBufferSize(int width, int height);
+
+// Dot patterns of one row of Braille cells from 4 rows of luma (rows past
+// the image bottom are nullptr). A dot is on when its pixel is brighter than
+// the cell mean. Cells with less contrast than BRAILLE_MIN_CONTRAST are
+// dithered by brightness instead, so flat areas keep their tone.
+// Writes ceil(width / 2) bit patterns (bit n = dot n + 1 of the Unicode order).
+constexpr int BRAILLE_MIN_CONTRAST = 32;
+void packBrailleCells(const uint8_t* const gray[4], int width, uint8_t* patterns);
+void packBrailleCells(AsciiKernel kernel, const uint8_t* const gray[4], int width, uint8_t* patterns);
+
+// Monochrome Braille, ceil(width / 2) x ceil(height / 4) cells, NUL terminated
+RawImage convertToBrailleAscii(const RawImageView& img);
+// Braille with each cell colored by the mean color of its lit dots. The dots
+// carry the shape and the color the tone, so flat cells are fully lit.
+// Returns the bytes written, excluding the terminating NUL.
+size_t convertToColoredBraille(const RawImageView& img, RawImage& target, int color_tolerance = 0);
+
+// Renders grids of pixels (CellGrid::colors, one entry per pixel) in the
+// half-block, colored Braille or colored shape mode, the pipeline's counterpart of
+// DiffRenderer for those modes. Every frame is a full repaint from the top
+// left corner, the screen is only cleared when the geometry changes.
+class DenseRenderer
+{
+private:
+  GlyphMode m_mode;
+  int m_width = 0, m_height = 0;
+  bool m_valid = false;
+  ShapeMatcher m_matcher; // Keeps the shape cache warm across frames
+public:
+  explicit DenseRenderer(GlyphMode mode); // Throws for GlyphMode::Ascii
+
+  // Worst-case output size for a width x height pixel grid, NUL included
+  static size_t bufferSize(GlyphMode mode, int width, int height);
+  // Glyphs of `pixels` are ignored, only the colors are rendered
+  RenderStats render(const CellGrid& pixels, RawImage& target);
+  void invalidate() { m_valid = false; }
+  GlyphMode mode() const { return m_mode; }
+};
+
+#endif // DENSE_ASCII_HPP
@@ -0,0 +1,57 @@
+#ifndef EDGE_ASCII_HPP
+#define EDGE_ASCII_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "raw_image.hpp"
+#include "raw_image_view.hpp"
+#include "ascii_kernels.hpp"
+#include "ansi_emitter.hpp"
+#include "frame_renderer.hpp"
+#include "thread_pool.hpp"
+
+// Structure-aware glyphs: a 3x3 Sobel on the luma plane gives every cell a
+// gradient (gx, gy). Where |gx| + |gy| exceeds the threshold the cell shows
+// the edge running across the gradient, everywhere else the brightness ramp.
+//   |  gradient within ~22 degrees of horizontal
+//   -  gradient within ~22 degrees of vertical, brighter above
+//   _  same, brighter below (the top outline of a bright shape)
+//   /  \  diagonals
+// The magnitude ranges 0..2040, a step of contrast c reaches 4 * c.
+constexpr int EDGE_DEFAULT_THRESHOLD = 256;
+
+// --edges T, a whole number in 1..2040
+int parseEdgeThreshold(const std::string& text);
+
+// Edge glyph of one gradient, 0 when |gx| + |gy| is not above threshold
+char edgeGlyph(int gx, int gy, int threshold);
+
+// Overwrites glyphs[x] with the edge glyph wherever the Sobel of the three
+// luma rows is above threshold. Pixels past the left and right borders repeat
+// the border pixel; at the top and bottom pass the same row twice.
+// The threshold is clamped to 0..2040.
+// The SIMD kernels produce byte-identical output to the scalar one.
+void overlayEdgeGlyphs(const uint8_t* above, const uint8_t* row, const uint8_t* below, int width, int threshold,
+                       char* glyphs);
+void overlayEdgeGlyphs(AsciiKernel kernel, const uint8_t* above, const uint8_t* row, const uint8_t* below, int width,
+                       int threshold, char* glyphs);
+
+// convertToAscii with edge glyphs. Bands of rows are converted in parallel,
+// each computes the luma of its rows (and one more above and below) itself.
+RawImage convertToEdgeAscii(const RawImageView& source_image, int threshold = EDGE_DEFAULT_THRESHOLD,
+                            ThreadPool& pool = sharedThreadPool());
+
+// convertToColoredAscii with edge glyphs, colors unchanged. The glyph plane
+// is built in parallel bands, the text is then emitted in one pass.
+// Target must hold coloredAsciiBufferSize(width, height, mode) bytes.
+// Returns the bytes written, excluding the terminating NUL.
+size_t convertToColoredEdgeAscii(const RawImageView& source_image, RawImage& target,
+                                 ColorMode mode = ColorMode::Truecolor, int threshold = EDGE_DEFAULT_THRESHOLD,
+                                 ThreadPool& pool = sharedThreadPool());
+
+// Same on a grid of sampled cells, from the luma of the cell colors. This is
+// what the stream draws at 100 columns, where the ramp alone blurs outlines.
+void applyEdgeGlyphs(CellGrid& cells, int threshold = EDGE_DEFAULT_THRESHOLD);
+
+#endif // EDGE_ASCII_HPP
@@ -0,0 +1,159 @@
+#ifndef FRAME_PIPELINE_HPP
+#define FRAME_PIPELINE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include "raw_image.hpp"
+#include "frame_queue.hpp"
+#include "frame_renderer.hpp"
+#include "frame_source.hpp"
+#include "cell_sampler.hpp"
+#include "dense_ascii.hpp"
+#include "stage_profiler.hpp"
+#include "ascii_recording.hpp"
+#include "stream_server.hpp"
+#include "terminal_writer.hpp"
+#include <opencv2/opencv.hpp>
+
+// A frame travelling through the pipeline. `pixels` is allocated up front
+// with room for the largest expected frame, so reshape() never allocates.
+struct FrameSlot : Frame
+{
+  uint64_t sequence = 0;
+  std::chrono::steady_clock::time_point captured_at;
+  FrameTiming timing; // Filled in by each stage when profiling
+};
+
+struct CellSlot
+{
+  CellGrid cells;
+  uint64_t sequence = 0;
+  std::chrono::steady_clock::time_point captured_at;
+  FrameTiming timing;
+};
+
+// Receives every finished terminal frame and, separately, its status line
+using WriteFunction = std::function<void(const char* data, size_t size)>;
+
+struct PipelineConfig
+{
+  size_t queue_depth = 2;
+  // Slots are preallocated for this size, larger frames grow them once
+  int max_capture_width = 1920;
+  int max_capture_height = 1080;
+  int output_width = 100;
+  float aspect_correction = DEFAULT_ASPECT_CORRECTION;
+  // Box-average cells straight from the capture buffer (CellSampler) in the
+  // convert stage. The resize stage and its copy of every frame are skipped.
+  bool fused_sampling = true;
+  size_t max_frames = 0; // Frames to capture, 0 runs until the source ends or stop()
+  RenderMode render_mode = RenderMode::Differential;
+  ColorMode color_mode = ColorMode::Truecolor; // 256 and 16 colors for terminals without 24-bit color
+  // Half-block, Braille and shape sample 1x2, 2x4 or 4x8 pixels per terminal cell. They
+  // render in truecolor with a full repaint every frame.
+  GlyphMode glyph_mode = GlyphMode::Ascii;
+  // Draws | / - \ _ over the ramp where the cells' luma has an edge stronger
+  // than this (applyEdgeGlyphs), 0 draws none. ASCII glyph mode only.
+  int edge_threshold = 0;
+  // 0 or more samples the cells with an IncrementalCellSampler: only tiles
+  // whose capture pixels moved by more than this are box-averaged again.
+  // -1 samples every cell of every frame. Needs fused_sampling, YUV frames
+  // are always sampled whole.
+  int incremental_noise = -1;
+  bool show_status = true;
+  // Times every stage of every frame, must outlive run(). nullptr turns profiling off.
+  StageProfiler* profiler = nullptr;
+  // Records every frame that reaches the write stage, including those the
+  // terminal skips. Must outlive run(), nullptr records nothing.
+  AsciiRecorder* recorder = nullptr;
+  // Publishes every frame that reaches the write stage to the server's
+  // viewers. Must outlive run(), nullptr serves nothing.
+  StreamServer* server = nullptr;
+};
+
+enum PipelineStage { CAPTURE_STAGE, RESIZE_STAGE, CONVERT_STAGE, WRITE_STAGE, PIPELINE_STAGE_COUNT };
+
+struct PipelineStageStats
+{
+  const char* name = "";
+  uint64_t processed = 0;
+  uint64_t dropped = 0;     // Frames lost on the way in: input queue full or superseded by a newer frame
+  size_t occupancy = 0;     // Frames currently waiting in the stage's input queue
+  size_t max_occupancy = 0;
+};
+
+struct PipelineStats
+{
+  PipelineStageStats stages[PIPELINE_STAGE_COUNT];
+  uint64_t bytes_written = 0;
+  uint64_t tiles = 0, dirty_tiles = 0; // Of sampled frames, with incremental_noise only
+
+  double dirtyRatio() const { return tiles ? static_cast<double>(dirty_tiles) / tiles : 0; }
+};
+
+// Capture -> resize (+ BGR2RGB) -> glyph/color cells -> render + write,
+// or capture -> sampled cells -> render + write with fused_sampling,
+// each on its own thread with FrameQueues between them. The frame time
+// is bounded by the slowest stage instead of the sum of all stages, and
+// a slow writer drops frames rather than holding back capture.
+class FramePipeline
+{
+private:
+  PipelineConfig m_config;
+  FrameSource& m_source;
+  WriteFunction m_write;
+  TerminalWriter* m_writer = nullptr;
+  FrameQueue<FrameSlot> m_captured;
+  FrameQueue<FrameSlot> m_resized;
+  FrameQueue<CellSlot> m_converted;
+  std::atomic<bool> m_stop{false};
+  std::atomic<uint64_t> m_processed[PIPELINE_STAGE_COUNT] = {};
+  std::atomic<uint64_t> m_bytes_written{0};
+  std::atomic<uint64_t> m_write_skipped{0}; // Frames the writer could not take
+  std::atomic<uint64_t> m_tiles{0}, m_dirty_tiles{0};
+  FrameSlot m_scratch; // Capture target while the queue is full, keeps the source drained
+  std::mutex m_error_mutex;
+  std::exception_ptr m_error; // First exception of any stage, rethrown by run()
+
+  void allocate();
+  // Runs one stage loop. An exception stops capture and closes the stage's
+  // output, so the later stages drain and end instead of the exception
+  // escaping the thread. nullptr for the write stage, which has no output.
+  template <class Queue>
+  void runStage(void (FramePipeline::*loop)(), Queue* output);
+  void captureLoop();
+  void resizeLoop();
+  void convertLoop();
+  // Where the convert stage takes its frames from
+  FrameQueue<FrameSlot>& convertInput() { return m_config.fused_sampling ? m_captured : m_resized; }
+  const FrameQueue<FrameSlot>& convertInput() const { return m_config.fused_sampling ? m_captured : m_resized; }
+  void writeLoop();
+public:
+  // The source is only read from the capture thread and must outlive run().
+  // An empty write function renders nothing locally, e.g. while serving.
+  FramePipeline(const PipelineConfig& config, FrameSource& source, WriteFunction write);
+  // Frames and status lines go out through `writer` in one writev each. While
+  // it is still draining a frame, newer frames are dropped before rendering
+  // and counted as write stage drops.
+  FramePipeline(const PipelineConfig& config, FrameSource& source, TerminalWriter& writer);
+
+  // Runs all stages until the source ends, max_frames were captured or stop() is called.
+  // When a stage throws, the others are stopped and joined and the first
+  // exception is rethrown here.
+  void run();
+  void stop() { m_stop.store(true); }
+  PipelineStats stats() const;
+};
+
+// Streams any source to the terminal, FRAMES_TO_PROCESS = 0 runs until the source ends
+void outputAsciiPipeline(FrameSource& source, size_t FRAMES_TO_PROCESS, const PipelineConfig& config = PipelineConfig());
+// Runs the pipeline without local output, publishing every frame to config.server
+void serveAsciiPipeline(FrameSource& source, size_t FRAMES_TO_PROCESS, const PipelineConfig& config);
+void outputWebcameAsciiPipeline(size_t FRAMES_TO_PROCESS, const PipelineConfig& config = PipelineConfig());
+
+#endif // FRAME_PIPELINE_HPP
@@ -0,0 +1,151 @@
+#ifndef FRAME_QUEUE_HPP
+#define FRAME_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free ring for exactly one producer thread and one consumer thread.
+template <typename T>
+class SpscRing
+{
+private:
+  std::vector<T> m_items; // One spare entry tells full from empty
+  alignas(64) std::atomic<size_t> m_head{0}; // Next index to pop, owned by the consumer
+  alignas(64) std::atomic<size_t> m_tail{0}; // Next index to push, owned by the producer
+public:
+  explicit SpscRing(size_t capacity) : m_items(capacity + 1) {}
+
+  bool push(const T& item) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t next = (tail + 1) % m_items.size();
+    if (next == m_head.load(std::memory_order_acquire)) return false;
+    m_items[tail] = item;
+    m_tail.store(next, std::memory_order_release);
+    return true;
+  }
+  bool pop(T& item) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) return false;
+    item = m_items[head];
+    m_head.store((head + 1) % m_items.size(), std::memory_order_release);
+    return true;
+  }
+  size_t size() const {
+    size_t head = m_head.load(std::memory_order_acquire);
+    size_t tail = m_tail.load(std::memory_order_acquire);
+    return (tail + m_items.size() - head) % m_items.size();
+  }
+  size_t capacity() const { return m_items.size() - 1; }
+};
+
+// Preallocated frame slots handed between two pipeline stages.
+// Ready slots sit in `depth` atomic cells that the producer fills round
+// robin, free slots travel back through an SPSC ring, so no slot is ever
+// allocated after setup and neither side takes a lock.
+// Latest frame wins: the consumer always takes the newest ready slot and
+// recycles the older ones. When `depth` frames are already waiting the
+// producer overwrites the oldest one and reuses its slot for the next
+// capture, so a stalled consumer resumes with the most recent frames.
+template <typename Slot>
+class FrameQueue
+{
+private:
+  static constexpr size_t EMPTY = SIZE_MAX;
+  std::vector<Slot> m_slots; // depth ready + one held by each side
+  size_t m_depth;
+  std::unique_ptr<std::atomic<size_t>[]> m_ready; // Slot index per cell, or EMPTY
+  std::vector<uint64_t> m_order;                  // Publish number of each slot, newest wins
+  SpscRing<size_t> m_free;
+  size_t m_next = 0;         // Producer only: cell of the next publish
+  size_t m_spare = EMPTY;    // Producer only: slot of an overwritten frame
+  uint64_t m_sequence = 0;   // Producer only
+  std::atomic<size_t> m_occupancy{0};
+  std::atomic<bool> m_closed{false};
+  std::atomic<uint64_t> m_published{0};
+  std::atomic<uint64_t> m_dropped{0};
+  std::atomic<size_t> m_max_occupancy{0};
+
+  size_t indexOf(const Slot* slot) const { return static_cast<size_t>(slot - m_slots.data()); }
+public:
+  explicit FrameQueue(size_t depth)
+  : m_slots(depth + 2), m_depth(depth), m_ready(new std::atomic<size_t>[depth]), m_order(depth + 2),
+    m_free(depth + 2) {
+    for (size_t i = 0; i < depth; ++i) m_ready[i].store(EMPTY, std::memory_order_relaxed);
+    for (size_t i = 0; i < m_slots.size(); ++i) m_free.push(i);
+  }
+
+  // Setup only, before any thread uses the queue
+  std::vector<Slot>& slots() { return m_slots; }
+
+  // Producer side. Returns nullptr when no slot is free, the frame counts as dropped.
+  Slot* acquire() {
+    size_t index = m_spare;
+    if (index != EMPTY) {
+      m_spare = EMPTY;
+    } else if (!m_free.pop(index)) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    return &m_slots[index];
+  }
+  void publish(Slot* slot) {
+    size_t index = indexOf(slot);
+    m_order[index] = m_sequence++;
+    size_t occupancy = m_occupancy.fetch_add(1, std::memory_order_relaxed) + 1;
+    size_t old = m_ready[m_next].exchange(index, std::memory_order_acq_rel);
+    m_next = (m_next + 1) % m_depth;
+    if (old != EMPTY) {
+      // The oldest waiting frame, never seen by the consumer
+      m_spare = old;
+      m_occupancy.fetch_sub(1, std::memory_order_relaxed);
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      occupancy--;
+    }
+    // A frame the consumer took but has not counted out yet can show up here
+    occupancy = std::min(occupancy, m_depth);
+    m_published.fetch_add(1, std::memory_order_relaxed);
+    size_t seen = m_max_occupancy.load(std::memory_order_relaxed);
+    while (occupancy > seen && !m_max_occupancy.compare_exchange_weak(seen, occupancy)) {}
+  }
+  // Producer is done, consumers drain what is left
+  void close() { m_closed.store(true, std::memory_order_release); }
+
+  // Consumer side. Returns the newest ready slot or nullptr.
+  Slot* takeLatest() {
+    size_t newest = EMPTY;
+    for (size_t i = 0; i < m_depth; ++i) {
+      size_t index = m_ready[i].exchange(EMPTY, std::memory_order_acq_rel);
+      if (index == EMPTY) continue;
+      m_occupancy.fetch_sub(1, std::memory_order_relaxed);
+      if (newest != EMPTY) {
+        if (m_order[index] < m_order[newest]) std::swap(index, newest);
+        m_free.push(newest);
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+      newest = index;
+    }
+    return newest == EMPTY ? nullptr : &m_slots[newest];
+  }
+  void release(Slot* slot) { m_free.push(indexOf(slot)); }
+  // True once the producer closed the queue and every frame was taken
+  bool finished() const {
+    if (!m_closed.load(std::memory_order_acquire)) return false;
+    for (size_t i = 0; i < m_depth; ++i) {
+      if (m_ready[i].load(std::memory_order_acquire) != EMPTY) return false;
+    }
+    return true;
+  }
+
+  size_t depth() const { return m_depth; }
+  size_t occupancy() const { return m_occupancy.load(std::memory_order_relaxed); }
+  size_t maxOccupancy() const { return m_max_occupancy.load(std::memory_order_relaxed); }
+  uint64_t published() const { return m_published.load(std::memory_order_relaxed); }
+  uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+};
+
+#endif // FRAME_QUEUE_HPP
@@ -0,0 +1,82 @@
+#ifndef FRAME_RENDERER_HPP
+#define FRAME_RENDERER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "raw_image.hpp"
+#include "raw_image_view.hpp"
+#include "ansi_emitter.hpp"
+
+// Glyph and RGB color of every terminal cell of a frame
+struct CellGrid
+{
+  int width = 0, height = 0;
+  std::vector<char> glyphs;
+  std::vector<uint8_t> colors; // 3 bytes per cell
+
+  void resize(int w, int h);
+  size_t cellCount() const { return static_cast<size_t>(width) * height; }
+};
+
+void buildColoredCells(const RawImageView& source_image, CellGrid& cells);
+void buildColoredCells(const uint8_t* rgb, int width, int height, CellGrid& cells);
+void buildRainbowCells(const RawImageView& source_image, int scroll_offset, CellGrid& cells);
+
+enum class RenderMode { FullRepaint, Differential };
+
+struct RenderStats
+{
+  size_t bytes_written = 0;
+  size_t changed_cells = 0;
+  size_t total_cells = 0;
+  bool full_repaint = false;
+};
+
+// Keeps the grid that is currently on screen and only redraws the cells
+// that changed, positioning the cursor once per run of changed cells.
+// Falls back to a full repaint when the first frame arrives, the size
+// changes, or more than `full_repaint_threshold` of the cells changed.
+// Every frame leaves the cursor on the line below the grid.
+// In the palette color modes a cell only counts as changed when its glyph
+// or its palette index changed.
+class DiffRenderer
+{
+private:
+  CellGrid m_screen;
+  bool m_valid = false;
+  double m_full_repaint_threshold;
+  int m_color_tolerance;
+  ColorMode m_color_mode;
+  std::vector<uint8_t> m_changed;
+  RenderStats m_last_stats;
+
+  bool cellChanged(const CellGrid& cells, size_t index) const;
+  template <class Emitter>
+  void recordEmittedColor(const Emitter& emitter, size_t index);
+  template <class Emitter>
+  void emitFrame(Emitter& emitter, const CellGrid& cells, const RenderStats& stats, bool size_changed);
+public:
+  // Unchanged gaps up to this many cells are rewritten instead of moving the cursor
+  static constexpr int MAX_MERGED_GAP = 4;
+
+  explicit DiffRenderer(double full_repaint_threshold = 0.5, int color_tolerance = 0,
+                        ColorMode color_mode = ColorMode::Truecolor);
+
+  // Worst-case output size for a width x height frame, NUL included
+  static size_t bufferSize(int width, int height, ColorMode color_mode = ColorMode::Truecolor);
+
+  // Writes the escape stream that turns the screen into `cells` to target, NUL terminated
+  RenderStats render(const CellGrid& cells, RawImage& target);
+  // Forces a full repaint on the next frame, e.g. after other output scrolled the screen
+  void invalidate() { m_valid = false; }
+  // Takes `cells` as what the terminal shows now, e.g. after output rendered earlier was replayed
+  void assumeScreen(const CellGrid& cells) {
+    m_screen = cells;
+    m_valid = true;
+  }
+  const RenderStats& lastStats() const { return m_last_stats; }
+  ColorMode colorMode() const { return m_color_mode; }
+};
+
+#endif // FRAME_RENDERER_HPP
@@ -0,0 +1,151 @@
+#ifndef FRAME_SOURCE_HPP
+#define FRAME_SOURCE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "raw_image.hpp"
+#include "raw_image_view.hpp"
+#include "yuv_image.hpp"
+#include <opencv2/opencv.hpp>
+
+enum class PixelFormat { RGB24, BGR24, YUYV, NV12, I420 };
+
+inline bool isYuvFormat(PixelFormat format) {
+  return format == PixelFormat::YUYV || format == PixelFormat::NV12 || format == PixelFormat::I420;
+}
+inline YuvFormat yuvFormatOf(PixelFormat format) {
+  return format == PixelFormat::YUYV ? YuvFormat::YUYV : (format == PixelFormat::NV12 ? YuvFormat::NV12 : YuvFormat::I420);
+}
+
+// A frame in a reusable buffer. `pixels` only grows, so a source that
+// keeps returning the same size never allocates after the first frame.
+struct Frame
+{
+  RawImage pixels{0, 0, 0};
+  int width = 0, height = 0;
+  PixelFormat format = PixelFormat::RGB24;
+
+  size_t byteSize() const {
+    return isYuvFormat(format) ? yuvFrameSize(yuvFormatOf(format), width, height) : static_cast<size_t>(width) * height * 3;
+  }
+  // Packed RGB24 / BGR24 pixels
+  RawImageView view() const { return RawImageView(pixels.getData(), width, height, 3); }
+  // The planes of a YUV frame
+  YuvImageView yuvView() const { return YuvImageView(pixels.getData(), width, height, yuvFormatOf(format)); }
+  // Sets the geometry and makes sure the buffer can hold it
+  void reshape(int w, int h, PixelFormat pixel_format);
+};
+
+// Anything that produces frames for the streaming loops
+class FrameSource
+{
+public:
+  virtual ~FrameSource() = default;
+  // Fills `frame` with the next frame, returns false at end of stream
+  virtual bool read(Frame& frame) = 0;
+  virtual std::string name() const = 0;
+};
+
+// cv::VideoCapture backed sources, frames are BGR
+class VideoCaptureSource : public FrameSource
+{
+private:
+  cv::VideoCapture m_capture;
+  std::string m_name;
+public:
+  explicit VideoCaptureSource(int device);
+  explicit VideoCaptureSource(const std::string& filename);
+  bool read(Frame& frame) override;
+  std::string name() const override { return m_name; }
+};
+
+// Still images decoded with stb_image, one per frame
+class ImageSequenceSource : public FrameSource
+{
+private:
+  std::vector<std::string> m_files;
+  size_t m_next = 0;
+  bool m_loop;
+public:
+  ImageSequenceSource(std::vector<std::string> files, bool loop = false);
+  // Every regular file in the directory, sorted by name
+  static std::vector<std::string> listDirectory(const std::string& directory);
+  bool read(Frame& frame) override;
+  std::string name() const override { return "images"; }
+};
+
+enum class SyntheticPattern { Gradient, Checkerboard, ColorBars, Noise };
+
+// Deterministic moving test patterns, frame N is always the same picture
+class SyntheticSource : public FrameSource
+{
+private:
+  int m_width, m_height;
+  SyntheticPattern m_pattern;
+  size_t m_frame_count; // 0 = endless
+  uint64_t m_index = 0;
+public:
+  SyntheticSource(int width, int height, SyntheticPattern pattern = SyntheticPattern::Gradient,
+                  size_t frame_count = 0);
+  static SyntheticPattern parsePattern(const std::string& name);
+  bool read(Frame& frame) override;
+  std::string name() const override { return "synthetic"; }
+};
+
+// Headerless packed RGB24/BGR24 or YUYV/NV12/I420 frames from a file descriptor, e.g.
+// ffmpeg -i in.mp4 -f rawvideo -pix_fmt rgb24 - | ascii_webcam_app --source raw:640x480
+// ffmpeg -i in.mp4 -f rawvideo -pix_fmt nv12 - | ascii_webcam_app --source raw:640x480:nv12
+// Frames are read straight into the frame buffer, YUV frames stay YUV.
+class RawStreamSource : public FrameSource
+{
+private:
+  int m_fd;
+  bool m_owns_fd;
+  int m_width, m_height;
+  PixelFormat m_format;
+  size_t m_truncated_bytes = 0;
+public:
+  RawStreamSource(int fd, int width, int height, PixelFormat format = PixelFormat::RGB24);
+  RawStreamSource(const std::string& filename, int width, int height, PixelFormat format = PixelFormat::RGB24);
+  ~RawStreamSource() override;
+  // A partial last frame ends the stream and is dropped
+  bool read(Frame& frame) override;
+  std::string name() const override { return "raw"; }
+  // Bytes of the partial frame the stream ended with, 0 when it ended on a frame boundary
+  size_t truncatedBytes() const { return m_truncated_bytes; }
+};
+
+// YUV4MPEG2 stream (4:2:0 or mono) from a file descriptor, e.g.
+// ffmpeg -i in.mp4 -f yuv4mpegpipe - | ascii_webcam_app --source y4m
+// Planes are read into a reused buffer and converted to RGB in one pass.
+class Y4mSource : public FrameSource
+{
+private:
+  int m_fd;
+  bool m_owns_fd;
+  int m_width = 0, m_height = 0;
+  bool m_mono = false;
+  double m_fps = 0;
+  std::vector<uint8_t> m_planes;
+
+  void readHeader();
+public:
+  explicit Y4mSource(int fd);
+  explicit Y4mSource(const std::string& filename);
+  ~Y4mSource() override;
+  bool read(Frame& frame) override;
+  std::string name() const override { return "y4m"; }
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  double fps() const { return m_fps; }
+};
+
+// Builds a source from a command line spec:
+// webcam[:N], file:PATH, images:DIR, synthetic[:PATTERN[:WxH]],
+// raw:WxH[:rgb|bgr|yuyv|nv12|i420][:PATH], y4m[:PATH]
+std::unique_ptr<FrameSource> openFrameSource(const std::string& spec);
+
+#endif // FRAME_SOURCE_HPP
@@ -0,0 +1,140 @@
+#ifndef INCREMENTAL_CONVERT_HPP
+#define INCREMENTAL_CONVERT_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "raw_image.hpp"
+#include "raw_image_view.hpp"
+#include "ansi_emitter.hpp"
+#include "ascii_kernels.hpp"
+#include "cell_sampler.hpp"
+
+struct IncrementalConfig
+{
+  int tile_width = 32;      // Pixels, one glyph each
+  int tile_height = 16;
+  // A tile is dirty once any byte of it differs by more than this from the
+  // pixels its text was made from, 0 reconverts on any change. Drift below
+  // the threshold accumulates against those pixels, so it is never lost.
+  int noise_threshold = 8;
+  ColorMode color_mode = ColorMode::Truecolor;
+};
+
+struct IncrementalStats
+{
+  size_t tiles = 0;
+  size_t dirty_tiles = 0;
+  size_t bytes_written = 0;
+  bool full_convert = false; // First frame, size or layout change, invalidate()
+
+  double dirtyRatio() const { return tiles ? static_cast<double>(dirty_tiles) / tiles : 0; }
+};
+
+// --incremental NOISE, a whole number in 0..255
+int parseNoiseThreshold(const std::string& text);
+
+// Whether any byte of the two blocks of rows x row_bytes differs by more than threshold
+bool tileChanged(const uint8_t* a, size_t a_stride, const uint8_t* b, size_t b_stride, int row_bytes, int rows,
+                 int threshold);
+bool tileChanged(AsciiKernel kernel, const uint8_t* a, size_t a_stride, const uint8_t* b, size_t b_stride,
+                 int row_bytes, int rows, int threshold);
+
+// convertToColoredAscii for a stream of frames that mostly stay the same.
+// Frames are split into tiles. Each tile row keeps its colored text from the
+// last time the tile was dirty, as a segment that starts with its own SGR.
+// A frame compares every tile against the pixels of that conversion (SIMD,
+// stopping at the first changed byte), reconverts the dirty ones and joins
+// all segments into the target, dropping a segment's leading SGR when it
+// repeats the active color. The output is byte for byte that of
+// convertToColoredAscii, as of the last conversion of each tile.
+class IncrementalConverter
+{
+private:
+  IncrementalConfig m_config;
+  int m_width = 0, m_height = 0, m_channels = 0;
+  int m_columns = 0, m_rows = 0; // Tiles
+  bool m_valid = false;
+  std::vector<uint8_t> m_reference; // Pixels the cached text was converted from
+  std::vector<uint8_t> m_dirty;
+  std::vector<char> m_text;         // Segment (y, column) at y * m_row_capacity + column * m_segment_capacity
+
+  struct Segment
+  {
+    uint32_t size = 0;
+    uint8_t first_sgr = 0;      // Length of the leading SGR
+    uint8_t last_sgr_size = 0;
+    uint32_t last_sgr = 0;      // Offset of the SGR still active after the segment
+  };
+  std::vector<Segment> m_segments;
+  size_t m_row_capacity = 0, m_segment_capacity = 0;
+  IncrementalStats m_last_stats;
+  IncrementalStats m_totals;
+  size_t m_frames = 0;
+
+  void reset(int width, int height, int channels);
+  template <typename Emitter, typename Reader>
+  void convertTile(const RawImageView& frame, int column, int row);
+public:
+  explicit IncrementalConverter(const IncrementalConfig& config = IncrementalConfig()); // Throws on a bad config
+
+  // Target must hold coloredAsciiBufferSize(width, height, color_mode) bytes.
+  // Returns the bytes written, excluding the terminating NUL.
+  size_t convert(const RawImageView& frame, RawImage& target);
+  // Reconverts every tile on the next frame
+  void invalidate() { m_valid = false; }
+
+  const IncrementalStats& lastStats() const { return m_last_stats; }
+  // Tiles, dirty tiles and bytes summed over every frame so far
+  const IncrementalStats& totals() const { return m_totals; }
+  size_t frames() const { return m_frames; }
+  const IncrementalConfig& config() const { return m_config; }
+};
+
+struct IncrementalSamplerConfig
+{
+  int tile_columns = 8;    // Cells
+  int tile_rows = 4;
+  int noise_threshold = 8; // As in IncrementalConfig, on the source pixels
+};
+
+// CellSampler for a stream of frames that mostly stay the same. The grid is
+// split into tiles of cells. A frame compares the source pixels under every
+// tile against the pixels the tile was last sampled from (tileChanged) and
+// box-averages only the dirty tiles again, so a still background costs one
+// compare instead of a sampling pass. The grid is kept from frame to frame
+// and copied to the caller's. A new size, format or invalidate() samples
+// the whole frame.
+class IncrementalCellSampler
+{
+private:
+  IncrementalSamplerConfig m_config;
+  CellSampler m_sampler;
+  CellGrid m_cells;
+  std::vector<uint8_t> m_reference; // Packed source pixels the grid was sampled from
+  int m_width = 0, m_height = 0, m_channels = 0, m_columns = 0;
+  PixelFormat m_format = PixelFormat::RGB24;
+  float m_aspect_correction = 0;
+  bool m_valid = false;
+  IncrementalStats m_last_stats;
+  IncrementalStats m_totals;
+  size_t m_frames = 0;
+
+  void keepReference(const RawImageView& source, int x0, int x1, int y0, int y1);
+public:
+  explicit IncrementalCellSampler(const IncrementalSamplerConfig& config = IncrementalSamplerConfig()); // Throws on a bad config
+
+  // Fills `cells` like CellSampler::sample
+  void sample(const RawImageView& source, PixelFormat format, int columns, CellGrid& cells,
+              float aspect_correction = DEFAULT_ASPECT_CORRECTION);
+  // Samples every tile on the next frame
+  void invalidate() { m_valid = false; }
+
+  // bytes_written stays 0, full_convert marks a whole-frame sample
+  const IncrementalStats& lastStats() const { return m_last_stats; }
+  const IncrementalStats& totals() const { return m_totals; }
+  size_t frames() const { return m_frames; }
+};
+
+#endif // INCREMENTAL_CONVERT_HPP
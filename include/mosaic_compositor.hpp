@@ -0,0 +1,149 @@
+#ifndef MOSAIC_COMPOSITOR_HPP
+#define MOSAIC_COMPOSITOR_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "raw_image.hpp"
+#include "frame_renderer.hpp"
+#include "frame_source.hpp"
+#include "frame_pipeline.hpp"
+#include "cell_sampler.hpp"
+#include "terminal_writer.hpp"
+#include "thread_pool.hpp"
+
+struct MosaicConfig
+{
+  int tile_width = 40;  // Cells per tile row
+  int tile_height = 0;  // Cell rows per tile, 0 fits a 4:3 picture at tile_width
+  int grid_columns = 0; // Tiles per mosaic row, 0 makes the grid about square
+  float aspect_correction = DEFAULT_ASPECT_CORRECTION;
+  ColorMode color_mode = ColorMode::Truecolor;
+  // Refreshes per second. Sources that take longer than a refresh keep their
+  // last frame on screen. 0 waits for every source's next frame instead,
+  // each refresh then shows one new frame of every source.
+  double refresh_fps = 30;
+  size_t max_refreshes = 0; // 0 runs until every source ended or stop()
+  bool show_labels = true;  // Number, name, frame rate and latency above every tile
+};
+
+struct MosaicSourceStats
+{
+  std::string name;
+  uint64_t frames = 0;         // Captured and converted
+  uint64_t shown = 0;          // Frames that made it into a refresh, the rest were superseded
+  uint64_t busy_refreshes = 0; // Refreshes that found the source still on its previous frame
+  double fps = 0;              // Frames per second of the whole run
+  double mean_latency_ms = 0;  // Capture start to the refresh that first showed the frame
+  double max_latency_ms = 0;
+  bool ended = false;
+  std::string error;           // Why the source stopped early, empty at a normal end
+};
+
+struct MosaicStats
+{
+  std::vector<MosaicSourceStats> sources;
+  uint64_t refreshes = 0;
+  uint64_t skipped = 0; // Refreshes the terminal could not take
+  uint64_t bytes_written = 0;
+  uint64_t wall_ns = 0;
+
+  double refreshesPerSecond() const { return wall_ns ? refreshes * 1e9 / wall_ns : 0; }
+};
+
+// Lays out N sources as a grid of tiles in one terminal. Every refresh, each
+// source that is idle gets a task on the thread pool that reads its next
+// frame and samples it into the source's own cell grid. The refresh then
+// copies the latest finished grid of every tile into one mosaic grid and
+// renders it with a single DiffRenderer, so all tiles go out in one write
+// and only the cells that changed are redrawn. A slow source only slows its
+// own tile, the refresh never waits for it.
+class MosaicCompositor
+{
+private:
+  struct Tile
+  {
+    FrameSource* source;
+    std::string name;
+    Frame frame;
+    CellSampler sampler;
+    CellGrid back; // Written by the capture task
+    std::atomic<bool> busy{false};
+    std::atomic<bool> ended{false};
+    std::atomic<uint64_t> frames{0};
+
+    std::mutex mutex; // Guards the fields below, shared by the task and the refresh
+    CellGrid front;   // Latest finished frame
+    bool fresh = false;
+    std::chrono::steady_clock::time_point front_started;
+    std::string error;
+
+    // Only touched by the refresh
+    uint64_t shown = 0, busy_refreshes = 0;
+    double latency_sum_ms = 0, latency_max_ms = 0, last_latency_ms = 0;
+    uint64_t window_frames = 0;
+    std::chrono::steady_clock::time_point window_start;
+    double window_fps = 0;
+  };
+
+  MosaicConfig m_config;
+  std::vector<std::unique_ptr<Tile>> m_tiles;
+  ThreadPool& m_pool;
+  WriteFunction m_write;
+  TerminalWriter* m_writer = nullptr;
+  int m_grid_columns = 1, m_tile_height = 1, m_label_rows = 0;
+  CellGrid m_mosaic;
+  DiffRenderer m_renderer;
+  RawImage m_text{0, 0, 0};
+  std::atomic<bool> m_stop{false};
+  std::mutex m_mutex;
+  std::condition_variable m_idle;
+  size_t m_in_flight = 0;
+  uint64_t m_refreshes = 0, m_skipped = 0, m_bytes_written = 0, m_wall_ns = 0;
+
+  void layout();
+  void capture(Tile& tile);
+  void waitIdle();
+  // Copies every tile into the mosaic, returns false once every source ended
+  bool compose(std::chrono::steady_clock::time_point now);
+  void writeLabel(int tile_index, Tile& tile, std::chrono::steady_clock::time_point now);
+  void refresh();
+public:
+  // The sources are only read from pool tasks, one task per source at a time,
+  // and must outlive run(). An empty write function composes without output.
+  MosaicCompositor(const MosaicConfig& config, std::vector<FrameSource*> sources, WriteFunction write,
+                   ThreadPool& pool = sharedThreadPool());
+  // Refreshes go out through `writer` in one writev each. While it is still
+  // draining one, later refreshes are skipped before rendering.
+  MosaicCompositor(const MosaicConfig& config, std::vector<FrameSource*> sources, TerminalWriter& writer,
+                   ThreadPool& pool = sharedThreadPool());
+  ~MosaicCompositor(); // Waits for the capture tasks still running
+  MosaicCompositor(const MosaicCompositor&) = delete;
+  MosaicCompositor& operator= (const MosaicCompositor&) = delete;
+
+  // Refreshes until every source ended, max_refreshes were written or stop() is called
+  void run();
+  void stop() { m_stop.store(true); }
+  // Counters of the run so far, call it from the thread that runs run() or after it returned
+  MosaicStats stats() const;
+  // The grid of the last refresh, tiles and labels included
+  const CellGrid& mosaic() const { return m_mosaic; }
+  int gridColumns() const { return m_grid_columns; }
+  int tileHeight() const { return m_tile_height; }
+};
+
+// One line of totals, then frames, frame rate, latency and busy refreshes per source
+void writeMosaicReport(const MosaicStats& stats, std::ostream& out);
+
+// Opens every spec with openFrameSource and shows them as a mosaic on the
+// terminal, REFRESHES = 0 runs until every source ended
+void outputMosaic(const std::vector<std::string>& specs, size_t REFRESHES, const MosaicConfig& config = MosaicConfig());
+
+#endif // MOSAIC_COMPOSITOR_HPP
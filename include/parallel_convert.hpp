@@ -0,0 +1,40 @@
+#ifndef PARALLEL_CONVERT_HPP
+#define PARALLEL_CONVERT_HPP
+
+#include <cstddef>
+#include <vector>
+#include "raw_image.hpp"
+#include "raw_image_view.hpp"
+#include "thread_pool.hpp"
+#include "terminal_writer.hpp"
+
+// Row-band parallel versions of the converters. Each band of rows is
+// converted by one task straight into its own part of the target buffer.
+
+// Same layout and bytes as convertToAscii. Rows have a fixed size, so bands
+// write to their final position and nothing needs joining.
+RawImage convertToAsciiParallel(const RawImageView& source_image, ThreadPool& pool = sharedThreadPool());
+
+// Colored output varies in length, so every band writes at the worst-case
+// offset of its first row and the bands are described by `segments`
+// (the last one is the color reset). The segments can be written out with
+// TerminalWriter::writeFrame as they are, or joined in place with joinAsciiSegments.
+// Target must hold coloredAsciiBufferSize(width, height) bytes. Returns the total size.
+size_t convertToColoredAsciiBands(const RawImageView& source_image, RawImage& target,
+                                  std::vector<AsciiSegment>& segments, ThreadPool& pool = sharedThreadPool(),
+                                  int color_tolerance = 0);
+size_t convertToRainbowAsciiBands(const RawImageView& img, int scroll_offset, RawImage& target,
+                                  std::vector<AsciiSegment>& segments, ThreadPool& pool = sharedThreadPool(),
+                                  int color_tolerance = 0);
+
+// Moves the segments together at the start of target and NUL terminates it.
+// Returns the joined size, excluding the NUL.
+size_t joinAsciiSegments(RawImage& target, const std::vector<AsciiSegment>& segments);
+
+// Bands + join. With color_tolerance 0 the output is byte-identical to the sequential converters.
+size_t convertToColoredAsciiParallel(const RawImageView& source_image, RawImage& target,
+                                     ThreadPool& pool = sharedThreadPool(), int color_tolerance = 0);
+size_t convertToRainbowAsciiParallel(const RawImageView& img, int scroll_offset, RawImage& target,
+                                     ThreadPool& pool = sharedThreadPool(), int color_tolerance = 0);
+
+#endif // PARALLEL_CONVERT_HPP
@@ -0,0 +1,148 @@
+#ifndef PIXEL_LAYOUT_HPP
+#define PIXEL_LAYOUT_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include "raw_image.hpp"
+#include "raw_image_view.hpp"
+#include "ascii_kernels.hpp"
+
+// Channel order of packed 8-bit pixels. Alpha is composited over black,
+// the usual terminal background.
+enum class PixelLayout { Gray, GrayA, RGB, RGBA, BGR };
+
+constexpr int pixelLayoutChannels(PixelLayout layout) {
+  switch (layout) {
+    case PixelLayout::Gray: return 1;
+    case PixelLayout::GrayA: return 2;
+    case PixelLayout::RGB: return 3;
+    case PixelLayout::BGR: return 3;
+    case PixelLayout::RGBA: return 4;
+  }
+  return 0;
+}
+
+// What a decoder returns for 1 to 4 channels: gray, gray + alpha, RGB, RGBA. Throws otherwise.
+PixelLayout pixelLayoutFor(int channels);
+const char* pixelLayoutName(PixelLayout layout);
+
+// Glyph ramp from dark to bright, ASCII_CHARS points at it
+constexpr char ASCII_RAMP[] = " .`,:\"^`_-\'!Ii><~+*jftrxunvczXYUJCLQ0OZmwdbqkhao*#MW&8B%@$";
+
+// getGrayscaleValue as a constant expression
+constexpr int lumaOf(int r, int g, int b) { return (299 * r + 587 * g + 114 * b) / 1000; }
+
+// pixelToAscii for every luma value, built by the compiler
+constexpr std::array<char, 256> makeGlyphTable() {
+  std::array<char, 256> table{};
+  int len = static_cast<int>(sizeof(ASCII_RAMP)) - 2; // Index of the last glyph
+  for (int i = 0; i < 256; ++i) table[i] = ASCII_RAMP[(i * len) / 255];
+  return table;
+}
+inline constexpr std::array<char, 256> GLYPH_TABLE = makeGlyphTable();
+
+// value * alpha / 255, rounded, without a division
+constexpr uint8_t overBlack(int value, int alpha) {
+  int x = value * alpha + 128;
+  return static_cast<uint8_t>((x + (x >> 8)) >> 8);
+}
+
+// RGB and luma of one pixel of layout L. Each specialization is branch free.
+template <PixelLayout L> struct PixelReader;
+
+template <> struct PixelReader<PixelLayout::Gray>
+{
+  static constexpr int CHANNELS = 1;
+  static void rgb(const uint8_t* p, uint8_t& r, uint8_t& g, uint8_t& b) { r = g = b = p[0]; }
+  static int luma(const uint8_t* p) { return p[0]; }
+};
+
+template <> struct PixelReader<PixelLayout::GrayA>
+{
+  static constexpr int CHANNELS = 2;
+  static void rgb(const uint8_t* p, uint8_t& r, uint8_t& g, uint8_t& b) { r = g = b = overBlack(p[0], p[1]); }
+  static int luma(const uint8_t* p) { return overBlack(p[0], p[1]); }
+};
+
+template <> struct PixelReader<PixelLayout::RGB>
+{
+  static constexpr int CHANNELS = 3;
+  static void rgb(const uint8_t* p, uint8_t& r, uint8_t& g, uint8_t& b) {
+    r = p[0];
+    g = p[1];
+    b = p[2];
+  }
+  static int luma(const uint8_t* p) { return lumaOf(p[0], p[1], p[2]); }
+};
+
+template <> struct PixelReader<PixelLayout::RGBA>
+{
+  static constexpr int CHANNELS = 4;
+  static void rgb(const uint8_t* p, uint8_t& r, uint8_t& g, uint8_t& b) {
+    r = overBlack(p[0], p[3]);
+    g = overBlack(p[1], p[3]);
+    b = overBlack(p[2], p[3]);
+  }
+  static int luma(const uint8_t* p) { return lumaOf(overBlack(p[0], p[3]), overBlack(p[1], p[3]), overBlack(p[2], p[3])); }
+};
+
+template <> struct PixelReader<PixelLayout::BGR>
+{
+  static constexpr int CHANNELS = 3;
+  static void rgb(const uint8_t* p, uint8_t& r, uint8_t& g, uint8_t& b) {
+    r = p[2];
+    g = p[1];
+    b = p[0];
+  }
+  static int luma(const uint8_t* p) { return lumaOf(p[2], p[1], p[0]); }
+};
+
+template <PixelLayout L> using PixelLayoutTag = std::integral_constant<PixelLayout, L>;
+
+// Calls f(PixelLayoutTag<layout>()). The converters branch on the layout
+// here once per call, the loops inside f are specialized for it.
+template <typename F>
+decltype(auto) dispatchPixelLayout(PixelLayout layout, F&& f) {
+  switch (layout) {
+    case PixelLayout::Gray: return f(PixelLayoutTag<PixelLayout::Gray>());
+    case PixelLayout::GrayA: return f(PixelLayoutTag<PixelLayout::GrayA>());
+    case PixelLayout::RGBA: return f(PixelLayoutTag<PixelLayout::RGBA>());
+    case PixelLayout::BGR: return f(PixelLayoutTag<PixelLayout::BGR>());
+    default: return f(PixelLayoutTag<PixelLayout::RGB>());
+  }
+}
+
+// Glyphs of one row. RGB rows go through the SIMD row kernel, the others
+// through the table.
+template <PixelLayout L>
+inline void rowToGlyphs(const uint8_t* pixels, int width, char* out) {
+  if constexpr (L == PixelLayout::RGB) {
+    convertRowToAscii(pixels, width, out);
+  } else {
+    for (int x = 0; x < width; ++x, pixels += PixelReader<L>::CHANNELS) {
+      out[x] = GLYPH_TABLE[PixelReader<L>::luma(pixels)];
+    }
+  }
+}
+
+// Luma of one row, the values rowToGlyphs indexes the glyph table with
+template <PixelLayout L>
+inline void rowToLuma(const uint8_t* pixels, int width, uint8_t* out) {
+  if constexpr (L == PixelLayout::RGB) {
+    convertRowToGray(pixels, width, out);
+  } else {
+    for (int x = 0; x < width; ++x, pixels += PixelReader<L>::CHANNELS) {
+      out[x] = static_cast<uint8_t>(PixelReader<L>::luma(pixels));
+    }
+  }
+}
+
+// Throws unless the view has as many channels as the layout
+void checkPixelLayout(const RawImageView& view, PixelLayout layout);
+
+// Packed RGB copy of any layout, for code that only reads RGB
+RawImage convertToRgb(const RawImageView& view, PixelLayout layout);
+
+#endif // PIXEL_LAYOUT_HPP
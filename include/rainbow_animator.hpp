@@ -0,0 +1,67 @@
+#ifndef RAINBOW_ANIMATOR_HPP
+#define RAINBOW_ANIMATOR_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "ascii_image.hpp"
+#include "raw_image.hpp"
+#include "raw_image_view.hpp"
+#include "frame_renderer.hpp"
+#include "terminal_writer.hpp"
+
+// Plays the rainbow animation of a still image. The glyphs are computed once,
+// the colors come from the rainbow table, and since the animation repeats every
+// RAINBOW_PERIOD frames each frame of a period is rendered once and then
+// replayed from memory. Frames that no longer fit in the cache limit are
+// rendered every time.
+//
+// FullRepaint frames are the convertToRainbowAscii output for their offset.
+// Differential frames are what a DiffRenderer fed buildRainbowCells writes,
+// and assume the terminal shows everything this animator returned before.
+// The cache limit only counts the cached frames.
+class RainbowAnimator
+{
+public:
+  static const size_t DEFAULT_CACHE_LIMIT = size_t(64) << 20;
+
+private:
+  CellGrid m_cells; // Glyphs fixed, colors of m_phase
+  int m_phase = -1;
+  RenderMode m_mode;
+  DiffRenderer m_renderer;
+  RawImage m_scratch;
+  size_t m_cache_limit;
+  size_t m_cached_bytes = 0;
+  // Rendered frames by phase; in differential mode the transition from the previous phase
+  std::vector<RawImage> m_cache;
+  std::array<int, RAINBOW_PERIOD> m_slots;
+  std::array<RenderStats, RAINBOW_PERIOD> m_slot_stats;
+  int m_shown_phase = -1;        // What the terminal shows, -1 when unknown
+  bool m_renderer_stale = false; // Cached frames were returned since the last render
+  uint64_t m_hits = 0, m_misses = 0;
+
+  void setPhase(int phase);
+public:
+  // The image must stay 3-channel RGB, only its glyphs are kept
+  explicit RainbowAnimator(const RawImageView& img, RenderMode mode = RenderMode::Differential,
+                           size_t cache_limit = DEFAULT_CACHE_LIMIT);
+
+  // Output for frame `index` (scroll offset `index`), valid until the next call
+  AsciiSegment frame(size_t index, RenderStats* stats = nullptr);
+  // The terminal state is unknown, e.g. the last frame was not written
+  void invalidate();
+
+  int width() const { return m_cells.width; }
+  int height() const { return m_cells.height; }
+  size_t cachedFrames() const { return m_cache.size(); }
+  size_t cachedBytes() const { return m_cached_bytes; }
+  size_t cacheLimit() const { return m_cache_limit; }
+  // Glyphs, colors, scratch buffer and cache
+  size_t memoryUsage() const;
+  uint64_t cacheHits() const { return m_hits; }
+  uint64_t cacheMisses() const { return m_misses; }
+};
+
+#endif // RAINBOW_ANIMATOR_HPP
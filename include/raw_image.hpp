@@ -1,21 +1,33 @@
 #ifndef RAW_IMAGE_HPP
 #define RAW_IMAGE_HPP
 
+#include <atomic>
 #include <cstdint>
 #include <cstddef>
 #include <cstring>
 
+class BufferPool;
+
 class RawImage
 {
 private:
   int m_width, m_height, m_channels ;
   size_t m_size;
   uint8_t* m_data = nullptr;
-  static inline int s_live_objects = 0;
+  BufferPool* m_pool = nullptr; // Where m_data goes back to, nullptr for the heap
+  bool m_decoded = false;       // m_data is the image decoder's own buffer
+  static inline std::atomic<int> s_live_objects{0}; // RawImages are made and freed on several threads
+
+  void freeData();
 public:
   RawImage(int width, int height, int channels);
   RawImage(int width, int height, int channels, const uint8_t* data);
+  // Draws the buffer from the pool, falls back to the heap when the pool cannot serve it
+  RawImage(int width, int height, int channels, BufferPool& pool);
+  // Decodes the file and takes over the decoder's buffer, nothing is copied
   RawImage(const char* filename);
+  // Same, converted to `channels` (1 to 4) by the decoder, 0 keeps what the file stores
+  RawImage(const char* filename, int channels);
   ~RawImage();
   
   RawImage(const RawImage &other); // Copy constructor
@@ -28,6 +40,8 @@ public:
   int getChannels() const { return m_channels;}
   uint8_t* getData() { return m_data; }
   const uint8_t* getData() const { return m_data; }
+  bool isPooled() const { return m_pool != nullptr; }
+  bool isDecoderOwned() const { return m_decoded; }
   static int get_live_count() { return s_live_objects; }
 };
 
@@ -0,0 +1,40 @@
+#ifndef RAW_IMAGE_VIEW_HPP
+#define RAW_IMAGE_VIEW_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include "raw_image.hpp"
+
+// Non-owning view of pixel rows that someone else keeps alive: a RawImage,
+// a cv::Mat, an stb_image buffer or a pipeline slot. Rows may be padded,
+// `stride` is the distance between row starts in bytes.
+class RawImageView
+{
+private:
+  const uint8_t* m_data = nullptr;
+  int m_width = 0, m_height = 0, m_channels = 0;
+  size_t m_stride = 0;
+public:
+  RawImageView() = default;
+  // stride 0 means tightly packed rows
+  RawImageView(const uint8_t* data, int width, int height, int channels, size_t stride = 0)
+  : m_data(data), m_width(width), m_height(height), m_channels(channels),
+    m_stride(stride ? stride : static_cast<size_t>(width) * channels) {}
+  // Implicit, so every converter taking a view also takes a RawImage
+  RawImageView(const RawImage& image)
+  : RawImageView(image.getData(), image.getWidth(), image.getHeight(), image.getChannels()) {}
+
+  int getWidth() const { return m_width; }
+  int getHeight() const { return m_height; }
+  int getChannels() const { return m_channels; }
+  size_t getStride() const { return m_stride; }
+  const uint8_t* getData() const { return m_data; }
+  const uint8_t* getRow(int y) const { return m_data + static_cast<size_t>(y) * m_stride; }
+  bool isContiguous() const { return m_stride == static_cast<size_t>(m_width) * m_channels; }
+  // Rows [y_begin, y_end) of this view
+  RawImageView rows(int y_begin, int y_end) const {
+    return RawImageView(getRow(y_begin), m_width, y_end - y_begin, m_channels, m_stride);
+  }
+};
+
+#endif // RAW_IMAGE_VIEW_HPP
@@ -0,0 +1,93 @@
+#ifndef SHAPE_ASCII_HPP
+#define SHAPE_ASCII_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "raw_image.hpp"
+#include "raw_image_view.hpp"
+#include "ascii_kernels.hpp"
+
+// Glyphs picked by the shape of the pixels in a cell instead of their
+// brightness alone. Each cell covers SHAPE_CELL_WIDTH x SHAPE_CELL_HEIGHT
+// pixels, one bit each: set where the pixel is brighter than the cell mean.
+// The glyph whose bitmap, reduced to the same 4x8 grid, differs in the fewest
+// bits wins. Bit r * 4 + c is row r, column c.
+constexpr int SHAPE_CELL_WIDTH = 4;
+constexpr int SHAPE_CELL_HEIGHT = 8;
+// Cells with less contrast have no shape to speak of and take the brightness ramp
+constexpr int SHAPE_MIN_CONTRAST = 40;
+constexpr int GLYPH_BITMAP_WIDTH = 8;
+constexpr int GLYPH_BITMAP_HEIGHT = 16;
+
+struct ShapeGlyph
+{
+  char glyph;
+  std::array<uint8_t, GLYPH_BITMAP_HEIGHT> bitmap; // Bit 7 - x of row y is pixel (x, y)
+  uint32_t mask;                                   // The bitmap on the 4x8 grid, 2x2 pixels per bit
+};
+
+// The built-in glyph set, punctuation and letters with distinct outlines.
+// Defined as strokes and rasterized into 8x16 bitmaps on first use.
+const std::vector<ShapeGlyph>& shapeGlyphs();
+
+// Index into shapeGlyphs() of the glyph nearest to `pattern` by Hamming
+// distance, the lowest index on ties. The SIMD kernels compute the distances
+// to 4 or 8 glyphs at once with a pshufb popcount.
+int nearestShapeGlyph(uint32_t pattern);
+int nearestShapeGlyph(AsciiKernel kernel, uint32_t pattern);
+
+// nearestShapeGlyph behind a direct-mapped cache keyed by the pattern.
+// Frames repeat few patterns, so most cells are one table load. Not thread
+// safe, every thread keeps its own.
+class ShapeMatcher
+{
+public:
+  static const int CACHE_BITS = 12;
+
+private:
+  struct Entry
+  {
+    uint32_t pattern = 0;
+    int16_t glyph = -1; // -1 = empty
+  };
+  std::vector<Entry> m_cache;
+  AsciiKernel m_kernel;
+  size_t m_hits = 0, m_misses = 0;
+
+public:
+  explicit ShapeMatcher(AsciiKernel kernel = getAsciiKernel());
+  char glyphFor(uint32_t pattern);
+  size_t hits() const { return m_hits; }
+  size_t misses() const { return m_misses; }
+};
+
+// Pattern, mean luma and contrast of the cell starting at column x of up to
+// 8 luma rows (rows past the image bottom are nullptr). Pixels past the
+// right or bottom edge stay 0 and do not count towards the mean.
+struct ShapeCell
+{
+  uint32_t pattern = 0;
+  int mean = 0;
+  int contrast = 0;
+};
+ShapeCell packShapeCell(const uint8_t* const luma[SHAPE_CELL_HEIGHT], int x, int width);
+
+// The glyph of a packed cell: the brightness ramp for flat cells, the nearest shape otherwise
+char shapeCellGlyph(const ShapeCell& cell, ShapeMatcher& matcher);
+
+// ceil(width / 4) glyphs and '\n' per row of ceil(height / 8) rows, NUL
+size_t shapeAsciiBufferSize(int width, int height);
+// Worst case of the colored variant: an SGR per cell, a reset and NUL at the end
+size_t coloredShapeAsciiBufferSize(int width, int height);
+
+RawImage convertToShapeAscii(const RawImageView& img);
+// Each cell colored by the mean color of its set pixels, the ones the glyph
+// draws, or of all its pixels when it is flat.
+// Returns the bytes written, excluding the terminating NUL.
+size_t convertToColoredShapeAscii(const RawImageView& img, RawImage& target, int color_tolerance = 0);
+// Same text for RGB pixels at out, through the caller's matcher. Returns the end of the text, NUL written.
+char* writeColoredShapeText(const RawImageView& img, char* out, int color_tolerance, ShapeMatcher& matcher);
+
+#endif // SHAPE_ASCII_HPP
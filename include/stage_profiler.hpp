@@ -0,0 +1,157 @@
+#ifndef STAGE_PROFILER_HPP
+#define STAGE_PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using ProfileClock = std::chrono::steady_clock;
+
+// The stages every streaming loop is split into. With fused sampling the
+// resize and color conversion happen inside the cells stage and stay empty.
+enum ProfileStage
+{
+  PROFILE_CAPTURE,  // Reading a frame from the source
+  PROFILE_RESIZE,   // Downscaling to the output width
+  PROFILE_COLOR,    // BGR to RGB
+  PROFILE_CELLS,    // Glyphs and colors of the cell grid (ASCII conversion)
+  PROFILE_RENDER,   // Escape sequences for the terminal
+  PROFILE_OUTPUT,   // Writing to the terminal
+  PROFILE_STAGE_COUNT
+};
+
+const char* profileStageName(ProfileStage stage);
+
+// Time spent on one frame in each stage, in nanoseconds
+struct FrameTiming
+{
+  uint64_t stage_ns[PROFILE_STAGE_COUNT] = {};
+};
+
+// Fixed-size log-linear histogram of nanosecond durations. Values below 64 ns
+// are exact, larger ones land in one of 32 buckets per power of two, so
+// percentiles are within about 3%. Recording never allocates.
+class LatencyHistogram
+{
+public:
+  static const int SUB_BUCKET_BITS = 5;
+  static const int MAX_BIT = 42; // Values from 2^42 ns (73 minutes) up share the last bucket
+  static const size_t BUCKET_COUNT = (2u << SUB_BUCKET_BITS) + (MAX_BIT - SUB_BUCKET_BITS) * (1u << SUB_BUCKET_BITS);
+
+private:
+  uint64_t m_buckets[BUCKET_COUNT] = {};
+  uint64_t m_count = 0;
+  uint64_t m_sum = 0;
+  uint64_t m_min = UINT64_MAX;
+  uint64_t m_max = 0;
+
+public:
+  static size_t bucketFor(uint64_t ns);
+  // Middle of the range of values the bucket holds
+  static uint64_t bucketValue(size_t bucket);
+
+  void record(uint64_t ns);
+  void merge(const LatencyHistogram& other);
+  void clear() { *this = LatencyHistogram(); }
+
+  uint64_t count() const { return m_count; }
+  uint64_t min() const { return m_count ? m_min : 0; }
+  uint64_t max() const { return m_max; }
+  double mean() const { return m_count ? static_cast<double>(m_sum) / m_count : 0.0; }
+  // percentile in [0, 100], clamped to the recorded min and max
+  uint64_t percentile(double percentile) const;
+};
+
+struct TraceEvent
+{
+  ProfileStage stage;
+  uint32_t thread;
+  uint64_t frame;
+  int64_t start_ns; // Since the profiler was created
+  int64_t duration_ns;
+};
+
+// Per-stage latency histograms for the streaming loops, plus an optional
+// buffer of trace events for chrome://tracing / Perfetto.
+//
+// Each stage must only be recorded from one thread at a time (true for both
+// the sequential loop and the pipeline, where every stage owns a thread).
+// Trace events may come from any thread. Reports are written after the loop
+// has finished.
+class StageProfiler
+{
+private:
+  LatencyHistogram m_stages[PROFILE_STAGE_COUNT];
+  LatencyHistogram m_frames; // Whole frame, first stage start to output end
+  uint64_t m_budget_misses[PROFILE_STAGE_COUNT] = {};
+  uint64_t m_frames_over_budget = 0;
+  uint64_t m_budget_ns;
+  ProfileClock::time_point m_epoch;
+
+  std::vector<TraceEvent> m_trace; // Preallocated, events past the capacity are dropped
+  std::atomic<size_t> m_trace_size{0};
+
+public:
+  // frame_budget: frames slower than this are blamed on their slowest stage.
+  // trace_capacity: trace events to keep, 0 disables tracing.
+  explicit StageProfiler(std::chrono::nanoseconds frame_budget = std::chrono::microseconds(33333),
+                         size_t trace_capacity = 0);
+
+  void record(ProfileStage stage, ProfileClock::time_point start, ProfileClock::time_point end, uint64_t frame = 0);
+  // A frame reached the terminal. total_ns includes time spent waiting between stages.
+  void endFrame(const FrameTiming& timing, uint64_t total_ns);
+
+  const LatencyHistogram& stage(ProfileStage stage) const { return m_stages[stage]; }
+  const LatencyHistogram& frames() const { return m_frames; }
+  uint64_t budgetMisses(ProfileStage stage) const { return m_budget_misses[stage]; }
+  uint64_t framesOverBudget() const { return m_frames_over_budget; }
+  uint64_t frameBudgetNs() const { return m_budget_ns; }
+  size_t traceEvents() const;
+  size_t traceDropped() const;
+
+  void writeJson(std::ostream& out) const;
+  void writeCsv(std::ostream& out) const;
+  // Chrome trace_event JSON, one complete ("X") event per recorded stage
+  void writeChromeTrace(std::ostream& out) const;
+  // One line per stage: count, p50/p90/p99/max and budget misses
+  void writeSummary(std::ostream& out) const;
+  // PREFIX.json and PREFIX.csv, plus PREFIX.trace.json when tracing is on
+  void writeReports(const std::string& prefix) const;
+};
+
+// Times a scope into `stage`. A null profiler makes it a no-op, so the
+// loops pay nothing when profiling is off. The duration is also added to
+// `timing` when one is given.
+class ScopedStageTimer
+{
+private:
+  StageProfiler* m_profiler;
+  ProfileStage m_stage;
+  uint64_t m_frame;
+  FrameTiming* m_timing;
+  ProfileClock::time_point m_start;
+
+public:
+  ScopedStageTimer(StageProfiler* profiler, ProfileStage stage, uint64_t frame = 0, FrameTiming* timing = nullptr)
+  : m_profiler(profiler), m_stage(stage), m_frame(frame), m_timing(timing) {
+    if (m_profiler) m_start = ProfileClock::now();
+  }
+  ~ScopedStageTimer() {
+    if (!m_profiler) return;
+    ProfileClock::time_point end = ProfileClock::now();
+    m_profiler->record(m_stage, m_start, end, m_frame);
+    if (m_timing) {
+      m_timing->stage_ns[m_stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_start).count();
+    }
+  }
+  // Nothing is recorded, e.g. when the source turned out to be at its end
+  void cancel() { m_profiler = nullptr; }
+  ScopedStageTimer(const ScopedStageTimer&) = delete;
+  ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+};
+
+#endif // STAGE_PROFILER_HPP
@@ -0,0 +1,130 @@
+#ifndef STREAM_SERVER_HPP
+#define STREAM_SERVER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include "raw_image.hpp"
+#include "frame_renderer.hpp"
+#include "dense_ascii.hpp"
+
+// Stream addresses: "unix:PATH" or "tcp:PORT" on 127.0.0.1, port 0 picks a free one.
+// Both return a blocking descriptor and throw on failure.
+int listenOnStream(const std::string& address, std::string& bound_address);
+int connectToStream(const std::string& address);
+
+struct StreamServerConfig
+{
+  // Frames queued per client, including the one being sent. A client that
+  // falls this far behind loses its queued frames and gets a keyframe next.
+  size_t client_queue_depth = 4;
+  ColorMode color_mode = ColorMode::Truecolor;
+  GlyphMode glyph_mode = GlyphMode::Ascii;
+};
+
+struct StreamClientStats
+{
+  uint64_t id = 0;
+  bool connected = true;
+  uint64_t frames_sent = 0;
+  uint64_t keyframes_sent = 0;
+  uint64_t frames_dropped = 0; // Queued frames discarded because the client fell behind
+  uint64_t bytes_sent = 0;
+  size_t queued = 0;           // Frames waiting right now, the current lag in frames
+  double mean_lag_ms = 0;      // Publish until the last byte reached the socket
+  double max_lag_ms = 0;
+};
+
+struct StreamServerStats
+{
+  uint64_t frames_published = 0;
+  uint64_t keyframes_rendered = 0;
+  uint64_t bytes_rendered = 0;
+  std::vector<StreamClientStats> clients; // Connected clients first, then the ones that left
+};
+
+// Renders every frame once and fans the bytes out to any number of viewers.
+// Frames are shared between the client queues, never copied per client.
+// In sync clients get the differential frame, clients that just joined or
+// dropped frames get a keyframe: a screen clear and a full repaint, rendered
+// at most once per frame however many clients need it. Dense glyph modes are
+// full repaints anyway, their keyframe is the same frame after the clear.
+// Sockets are written from one I/O thread without blocking, so publish()
+// never waits for a viewer.
+class StreamServer
+{
+private:
+  struct QueuedFrame
+  {
+    std::shared_ptr<const RawImage> data;
+    size_t size = 0;
+    bool keyframe = false; // Sent after the screen clear
+    std::chrono::steady_clock::time_point published;
+  };
+  struct Client
+  {
+    int fd = -1;
+    std::deque<QueuedFrame> queue;
+    size_t offset = 0; // Bytes of the queue head already sent, clear included
+    bool needs_keyframe = true;
+    double total_lag_ms = 0;
+    StreamClientStats stats;
+  };
+
+  StreamServerConfig m_config;
+  std::string m_address;
+  std::string m_unix_path; // Unlinked on destruction
+  int m_listen_fd = -1;
+  int m_wake_pipe[2] = { -1, -1 };
+  DiffRenderer m_renderer;
+  DiffRenderer m_key_renderer; // Full repaint of every frame it renders
+  std::unique_ptr<DenseRenderer> m_dense_renderer;
+  // Frame buffers, reused once no client queue holds them anymore
+  std::vector<std::shared_ptr<RawImage>> m_buffers;
+
+  mutable std::mutex m_mutex;
+  std::vector<std::unique_ptr<Client>> m_clients;
+  std::vector<StreamClientStats> m_departed;
+  uint64_t m_next_id = 1;
+  StreamServerStats m_stats;
+  std::vector<pollfd> m_pollfds;
+  std::atomic<bool> m_stop{false};
+  std::thread m_thread;
+
+  std::shared_ptr<RawImage> acquireBuffer(size_t size);
+  void wake();
+  void ioLoop();
+  void acceptClients();
+  // Returns false when the client is gone
+  bool sendQueued(Client& client);
+  void disconnect(size_t index);
+public:
+  explicit StreamServer(const std::string& address, const StreamServerConfig& config = StreamServerConfig());
+  ~StreamServer();
+  StreamServer(const StreamServer&) = delete;
+  StreamServer& operator=(const StreamServer&) = delete;
+
+  // Renders `cells` and queues the bytes for every client. With dense glyph
+  // modes the colors are pixels, as for DenseRenderer.
+  void publish(const CellGrid& cells);
+
+  // The bound address, with the chosen port for "tcp:0"
+  const std::string& address() const { return m_address; }
+  size_t clientCount() const;
+  StreamServerStats stats() const;
+  void writeSummary(std::ostream& out) const;
+};
+
+// Copies a stream to out_fd until the server closes it, returns the bytes relayed
+uint64_t viewStream(const std::string& address, int out_fd);
+
+#endif // STREAM_SERVER_HPP
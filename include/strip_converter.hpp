@@ -0,0 +1,91 @@
+#ifndef STRIP_CONVERTER_HPP
+#define STRIP_CONVERTER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "ansi_emitter.hpp"
+#include "cell_sampler.hpp"
+#include "frame_source.hpp"
+#include "raw_image_view.hpp"
+
+// An uncompressed image file mapped read-only, rows in file order: binary
+// PPM (P6) or PGM (P5) with a maxval of at most 255, or headerless raw
+// pixels. Rows are read straight from the mapping, nothing is decoded or
+// copied, and release() hands the pages of rows already used back to the
+// kernel, so a front to back pass keeps only a window of the file resident.
+// Only a maxval below 255 costs a copy: each strip is scaled to 0..255
+// through a table into a buffer of the strip's size.
+class StripImageFile
+{
+private:
+  const uint8_t* m_map = nullptr;
+  size_t m_map_size = 0;
+  size_t m_data_offset = 0;  // Start of the first row
+  size_t m_released = 0;     // Mapping bytes already handed back, page aligned
+  int m_width = 0, m_height = 0, m_channels = 0;
+  PixelFormat m_format = PixelFormat::RGB24;
+  int m_maxval = 255;
+  uint8_t m_scale[256];                 // Sample to 0..255, used when m_maxval != 255
+  mutable std::vector<uint8_t> m_scaled; // Last strip returned by rows(), scaled
+
+  void map(const std::string& filename);
+  void parseNetpbmHeader(const std::string& filename);
+public:
+  // PPM or PGM, told apart by the magic
+  explicit StripImageFile(const std::string& filename);
+  // Raw rows of width x channels bytes, 1 (gray) or 3 channels
+  StripImageFile(const std::string& filename, int width, int height, int channels,
+                 PixelFormat format = PixelFormat::RGB24);
+  ~StripImageFile();
+  StripImageFile(const StripImageFile&) = delete;
+  StripImageFile& operator=(const StripImageFile&) = delete;
+
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  int channels() const { return m_channels; }
+  PixelFormat format() const { return m_format; }
+  size_t rowBytes() const { return static_cast<size_t>(m_width) * m_channels; }
+  // Rows [y_begin, y_end). Rows before the last release() may be read again, from disk.
+  // With a maxval below 255 the view is a scaled copy, valid until the next call.
+  RawImageView rows(int y_begin, int y_end) const;
+  // Size of the scaled copy, 0 when rows are read from the mapping
+  size_t scaledBytes() const { return m_scaled.capacity(); }
+  // Drops the resident pages that only hold rows before y_end
+  void release(int y_end);
+  // Starts another front to back pass, release() begins again at the first row
+  void rewind() { m_released = 0; }
+  // Bytes between the last release point and the end of row y_end, what a pass holds
+  size_t residentBytes(int y_end) const;
+};
+
+struct StripConvertConfig
+{
+  int columns = 100;             // Clamped to the image width
+  bool color = false;            // Plain ASCII, or colored in color_mode
+  ColorMode color_mode = ColorMode::Truecolor;
+  size_t strip_bytes = 16 << 20; // Source bytes mapped at a time, at least one row
+  float aspect_correction = DEFAULT_ASPECT_CORRECTION;
+};
+
+struct StripConvertStats
+{
+  int columns = 0, rows = 0;  // Of the ASCII output
+  uint64_t strips = 0;
+  uint64_t source_bytes = 0;
+  uint64_t output_bytes = 0;
+  // Largest working set at any point: the resident source window, the cell
+  // row, the text buffer and the sampler's tables. Depends on strip_bytes,
+  // the image width and the columns, never on the image height.
+  size_t peak_bytes = 0;
+};
+
+// Converts the image to ASCII one cell row at a time and writes the rows to
+// out_fd as they are done. Each cell row's source rows are summed in strips
+// of at most strip_bytes, then released, so images far larger than memory
+// convert in a bounded working set. The glyphs and colors match
+// CellSampler::sample over the whole image.
+StripConvertStats convertInStrips(StripImageFile& image, const StripConvertConfig& config, int out_fd);
+
+#endif // STRIP_CONVERTER_HPP
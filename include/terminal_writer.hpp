@@ -0,0 +1,83 @@
+#ifndef TERMINAL_WRITER_HPP
+#define TERMINAL_WRITER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// A contiguous piece of output, in output order
+struct AsciiSegment
+{
+  const char* data;
+  size_t size;
+};
+
+enum class WriteMode
+{
+  Blocking,    // Every frame is written completely, the caller waits for slow readers
+  NonBlocking  // A frame is skipped while the previous one is still draining
+};
+
+struct WriterStats
+{
+  uint64_t frames_written = 0;
+  uint64_t frames_skipped = 0;
+  uint64_t bytes_written = 0;
+  uint64_t partial_writes = 0; // writev calls that took only part of what was offered
+  uint64_t syscalls = 0;
+};
+
+// Writes known-length frames straight to a file descriptor with writev, so
+// a frame, its header and its status line go out in one syscall without
+// strlen or iostream buffering.
+//
+// In NonBlocking mode a tty or pipe is reopened through /proc/self/fd with
+// O_NONBLOCK, so the descriptor passed in, usually stdout shared with the
+// shell, keeps its flags even if the process is killed. Descriptors that
+// cannot be reopened only get written when poll() reports room. When the
+// terminal or pipe cannot take a whole frame, the rest is kept and drained
+// before anything else is written, frames offered meanwhile are skipped.
+// A frame is never cut, so escape sequences always arrive complete.
+class TerminalWriter
+{
+private:
+  int m_fd;
+  bool m_owns_fd;
+  WriteMode m_mode;
+  bool m_poll_gated = false; // NonBlocking on a descriptor that stays blocking
+  std::vector<char> m_pending; // Unwritten tail of the last frame
+  size_t m_pending_offset = 0;
+  WriterStats m_stats;
+
+  size_t writeSegments(const AsciiSegment* segments, size_t count, size_t total);
+  bool drainPending();
+  void waitWritable();
+public:
+  // `fd` stays open and keeps its flags, NonBlocking mode writes through its own descriptor
+  explicit TerminalWriter(int fd, WriteMode mode = WriteMode::Blocking);
+  // Creates or truncates the file, always blocking
+  explicit TerminalWriter(const std::string& filename);
+  ~TerminalWriter();
+  TerminalWriter(const TerminalWriter&) = delete;
+  TerminalWriter& operator=(const TerminalWriter&) = delete;
+
+  // True when the previous frame is fully written, so the next one would
+  // not be skipped. Lets callers avoid rendering a frame that would be dropped.
+  bool ready();
+  // Writes the segments as one frame. Returns false if the frame was skipped,
+  // in which case nothing of it reached the descriptor.
+  bool writeFrame(const AsciiSegment* segments, size_t count);
+  bool writeFrame(std::initializer_list<AsciiSegment> segments) { return writeFrame(segments.begin(), segments.size()); }
+  bool writeFrame(const char* data, size_t size) { return writeFrame({ AsciiSegment{ data, size } }); }
+  // Blocks until the pending tail is written
+  void flush();
+
+  int fd() const { return m_fd; } // The descriptor written to, private in NonBlocking mode
+  WriteMode mode() const { return m_mode; }
+  size_t pendingBytes() const { return m_pending.size() - m_pending_offset; }
+  const WriterStats& stats() const { return m_stats; }
+};
+
+#endif // TERMINAL_WRITER_HPP
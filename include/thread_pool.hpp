@@ -0,0 +1,41 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that live as long as the pool.
+// `threads` is the total concurrency of parallelFor including the calling
+// thread, so ThreadPool(1) runs everything on the caller.
+class ThreadPool
+{
+private:
+  std::vector<std::thread> m_workers;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_stopping = false;
+
+  void workerLoop();
+public:
+  explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator= (const ThreadPool&) = delete;
+
+  size_t threadCount() const { return m_workers.size() + 1; }
+  void submit(std::function<void()> task);
+  // Runs body(0) .. body(count - 1) on the workers and the caller, returns when all are done.
+  // The first exception thrown by body is rethrown here.
+  void parallelFor(size_t count, const std::function<void(size_t)>& body);
+};
+
+// Process-wide pool sized to the machine, created on first use
+ThreadPool& sharedThreadPool();
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,116 @@
+#ifndef YUV_IMAGE_HPP
+#define YUV_IMAGE_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include "raw_image.hpp"
+#include "ansi_emitter.hpp"
+#include "pixel_layout.hpp"
+
+// 8-bit YUV as cameras and decoders deliver it, chroma at half the width:
+// YUYV packs Y0 U Y1 V per pixel pair, NV12 is a Y plane and an interleaved
+// UV plane at half height, I420 a Y plane and separate U and V planes at half height.
+enum class YuvFormat { YUYV, NV12, I420 };
+
+const char* yuvFormatName(YuvFormat format);
+// Bytes of a tightly packed width x height frame, odd sizes round the chroma up
+size_t yuvFrameSize(YuvFormat format, int width, int height);
+
+// Non-owning view of a YUV frame. Sample x of row y is
+// y_plane[y * y_stride + x * lumaStep()], chroma sample k of chroma row
+// y >> chromaShift() is u_plane / v_plane[row * chroma_stride + k * chromaStep()].
+class YuvImageView
+{
+private:
+  YuvFormat m_format = YuvFormat::I420;
+  int m_width = 0, m_height = 0;
+  const uint8_t* m_y = nullptr;
+  const uint8_t* m_u = nullptr;
+  const uint8_t* m_v = nullptr;
+  size_t m_y_stride = 0, m_chroma_stride = 0;
+public:
+  YuvImageView() = default;
+  // A tightly packed frame of yuvFrameSize(format, width, height) bytes
+  YuvImageView(const uint8_t* data, int width, int height, YuvFormat format);
+  // Planes that live apart or have padded rows. For YUYV and NV12 `v` is ignored,
+  // V sits one byte after U.
+  YuvImageView(YuvFormat format, int width, int height, const uint8_t* y, size_t y_stride, const uint8_t* u,
+               const uint8_t* v, size_t chroma_stride);
+
+  YuvFormat getFormat() const { return m_format; }
+  int getWidth() const { return m_width; }
+  int getHeight() const { return m_height; }
+  int chromaWidth() const { return (m_width + 1) / 2; }
+  int chromaHeight() const { return (m_height + chromaShift()) >> chromaShift(); }
+  int lumaStep() const { return m_format == YuvFormat::YUYV ? 2 : 1; }
+  int chromaStep() const { return m_format == YuvFormat::YUYV ? 4 : (m_format == YuvFormat::NV12 ? 2 : 1); }
+  int chromaShift() const { return m_format == YuvFormat::YUYV ? 0 : 1; }
+  size_t lumaStride() const { return m_y_stride; }
+  size_t chromaStride() const { return m_chroma_stride; }
+  const uint8_t* lumaRow(int y) const { return m_y + static_cast<size_t>(y) * m_y_stride; }
+  const uint8_t* uRow(int chroma_y) const { return m_u + static_cast<size_t>(chroma_y) * m_chroma_stride; }
+  const uint8_t* vRow(int chroma_y) const { return m_v + static_cast<size_t>(chroma_y) * m_chroma_stride; }
+};
+
+inline uint8_t clampToByte(int v) {
+  return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// BT.601 limited range, the default of ffmpeg and most webcams.
+// The chroma terms only depend on U and V, so pixels sharing a chroma
+// sample compute them once.
+struct ChromaTerms
+{
+  int r, g, b;
+};
+
+inline ChromaTerms chromaTerms(int u, int v) {
+  int d = u - 128, e = v - 128;
+  return { 409 * e + 128, -100 * d - 208 * e + 128, 516 * d + 128 };
+}
+
+inline void yuvToRgb(int y, const ChromaTerms& chroma, uint8_t& r, uint8_t& g, uint8_t& b) {
+  int c = 298 * (y - 16);
+  r = clampToByte((c + chroma.r) >> 8);
+  g = clampToByte((c + chroma.g) >> 8);
+  b = clampToByte((c + chroma.b) >> 8);
+}
+
+inline void yuvToRgb(int y, int u, int v, uint8_t& r, uint8_t& g, uint8_t& b) {
+  yuvToRgb(y, chromaTerms(u, v), r, g, b);
+}
+
+// Luma on the 0..255 scale of lumaOf. Y is that luma in limited range, so for
+// gray pixels this is exactly lumaOf of the converted RGB, for colored ones
+// it differs by the rounding of the conversion.
+constexpr int lumaFromY(int y) {
+  int v = (298 * (y - 16) + 128) >> 8;
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+// Glyph for every Y value, the gray path indexes it with the Y plane directly
+constexpr std::array<char, 256> makeYuvGlyphTable() {
+  std::array<char, 256> table{};
+  for (int y = 0; y < 256; ++y) table[y] = GLYPH_TABLE[lumaFromY(y)];
+  return table;
+}
+inline constexpr std::array<char, 256> YUV_GLYPH_TABLE = makeYuvGlyphTable();
+
+// Gray ASCII straight from the Y samples, no chroma is read.
+// Same text layout as convertToAscii: width glyphs and '\n' per row, then NUL.
+RawImage convertToAscii(const YuvImageView& source_image);
+// Same into a caller buffer of at least (width + 1) * height + 1 bytes, returns the size without the NUL
+size_t convertToAscii(const YuvImageView& source_image, RawImage& target);
+
+// Colored ASCII with one glyph per pixel. The glyph comes from Y, the chroma
+// terms are computed once per chroma sample and shared by its pixels.
+// Target must hold at least coloredAsciiBufferSize(width, height, mode) bytes.
+size_t convertToColoredAscii(const YuvImageView& source_image, RawImage& target,
+                             ColorMode mode = ColorMode::Truecolor);
+
+// Packed RGB24 of the whole frame, width * height * 3 bytes at rgb,
+// for the code paths that resample full-resolution RGB
+void convertYuvToRgb(const YuvImageView& source_image, uint8_t* rgb);
+
+#endif // YUV_IMAGE_HPP
@@ -0,0 +1,154 @@
+#include "adaptive_controller.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+TerminalSize queryTerminalSize(int fd) {
+  TerminalSize size;
+  winsize ws;
+  if (::ioctl(fd, TIOCGWINSZ, &ws) == 0) {
+    size.columns = ws.ws_col;
+    size.rows = ws.ws_row;
+  }
+  return size;
+}
+
+
+// Set from the signal handler, which may only touch lock-free atomics
+static std::atomic<bool> g_terminal_resized{false};
+static std::atomic<bool> g_watcher_active{false};
+
+static void onWindowChange(int) {
+  g_terminal_resized.store(true);
+}
+
+TerminalResizeWatcher::TerminalResizeWatcher() {
+  if (g_watcher_active.exchange(true)) {
+    throw std::runtime_error("Only one TerminalResizeWatcher may exist at a time");
+  }
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = onWindowChange;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART; // Reads and writes of the loop carry on
+  g_terminal_resized.store(false);
+  ::sigaction(SIGWINCH, &action, &m_previous);
+}
+
+TerminalResizeWatcher::~TerminalResizeWatcher() {
+  ::sigaction(SIGWINCH, &m_previous, nullptr);
+  g_watcher_active.store(false);
+}
+
+bool TerminalResizeWatcher::resized() {
+  return g_terminal_resized.exchange(false);
+}
+
+
+AdaptiveController::AdaptiveController(const AdaptiveConfig& config)
+: m_config(config) {
+  if (m_config.target_fps <= 0) {
+    throw std::runtime_error("Target frame rate must be positive");
+  }
+  if (m_config.min_width < 1 || m_config.max_width < m_config.min_width) {
+    throw std::runtime_error("Adaptive width range is empty");
+  }
+  m_budget_ns = static_cast<uint64_t>(1e9 / m_config.target_fps);
+  m_settings.width = std::clamp(m_settings.width, m_config.min_width, m_config.max_width);
+  m_settings.color_mode = m_config.best_color_mode;
+}
+
+// Palette modes in order of quality, Truecolor > Xterm256 > Ansi16 (the enum order)
+static bool cheaperColorMode(ColorMode mode, ColorMode& cheaper) {
+  if (mode == ColorMode::Ansi16) return false;
+  cheaper = mode == ColorMode::Truecolor ? ColorMode::Xterm256 : ColorMode::Ansi16;
+  return true;
+}
+
+void AdaptiveController::degrade() {
+  int width = m_terminal.columns > 0 ? std::min(m_settings.width, m_terminal.columns) : m_settings.width;
+  int narrower = std::max(m_config.min_width,
+                          static_cast<int>(width * std::clamp(std::sqrt(1.0 / m_load), 0.5, 0.9)));
+  ColorMode cheaper;
+  bool bytes_bound = m_output_share > 0.5;
+  if (!bytes_bound && narrower < width) {
+    m_settings.width = narrower;
+  } else if (m_settings.color_tolerance < MAX_TOLERANCE) {
+    m_settings.color_tolerance += TOLERANCE_STEP;
+  } else if (cheaperColorMode(m_settings.color_mode, cheaper)) {
+    m_settings.color_mode = cheaper;
+  } else if (narrower < width) {
+    m_settings.width = narrower;
+  }
+}
+
+void AdaptiveController::improve() {
+  int max_width = m_config.max_width;
+  if (m_terminal.columns > 0) max_width = std::max(m_config.min_width, std::min(max_width, m_terminal.columns));
+  if (m_settings.width < max_width) {
+    m_settings.width = std::min(max_width, m_settings.width + std::max(1, m_settings.width / 10));
+  } else if (m_settings.color_mode != m_config.best_color_mode) {
+    m_settings.color_mode = m_settings.color_mode == ColorMode::Ansi16 ? ColorMode::Xterm256 : ColorMode::Truecolor;
+  } else if (m_settings.color_tolerance > 0) {
+    m_settings.color_tolerance -= TOLERANCE_STEP;
+  }
+}
+
+bool AdaptiveController::update(const FrameTiming& timing) {
+  // Capture is left out, a webcam blocks until its next frame whatever we render
+  uint64_t work_ns = 0;
+  for (int stage = PROFILE_CAPTURE + 1; stage < PROFILE_STAGE_COUNT; ++stage) work_ns += timing.stage_ns[stage];
+  if (work_ns == 0) return false;
+  uint64_t output_ns = timing.stage_ns[PROFILE_RENDER] + timing.stage_ns[PROFILE_OUTPUT];
+  double load = static_cast<double>(work_ns) / m_budget_ns;
+  double output_share = static_cast<double>(output_ns) / work_ns;
+
+  // Averaged over the run of slow or fast frames that decides the step
+  if (load > 1.0) {
+    m_fast_frames = 0;
+    m_slow_frames++;
+  } else if (load < m_config.upgrade_load) {
+    m_slow_frames = 0;
+    m_fast_frames++;
+  } else {
+    m_slow_frames = m_fast_frames = 0;
+  }
+  int run = std::max(m_slow_frames, m_fast_frames);
+  if (run <= 1) {
+    m_load = load;
+    m_output_share = output_share;
+  } else {
+    m_load += (load - m_load) / run;
+    m_output_share += (output_share - m_output_share) / run;
+  }
+
+  AdaptiveSettings before = m_settings;
+  if (m_slow_frames >= m_config.downgrade_frames) {
+    degrade();
+  } else if (m_fast_frames >= m_config.upgrade_frames) {
+    improve();
+  } else {
+    return false;
+  }
+  m_slow_frames = m_fast_frames = 0;
+  if (m_settings == before) return false;
+  m_adjustments++;
+  return true;
+}
+
+int AdaptiveController::outputWidth(int source_width, int source_height) const {
+  int width = m_settings.width;
+  if (m_terminal.columns > 0) width = std::min(width, m_terminal.columns);
+  if (m_terminal.rows > 1 && source_width > 0 && source_height > 0) {
+    // cellRowsFor() rounds down, rows + 1 is never reached below this width. Step down from there.
+    int rows = m_terminal.rows - 1;
+    int fit = static_cast<int>((rows + 1) * static_cast<float>(source_width) / (source_height * m_config.aspect_correction)) + 1;
+    width = std::min(width, fit);
+    while (width > 1 && cellRowsFor(source_width, source_height, width, m_config.aspect_correction) > rows) --width;
+  }
+  return std::max(width, 1);
+}
@@ -1,252 +1,404 @@
 #include "ascii_image.hpp"
+#include "adaptive_controller.hpp"
+#include "ascii_kernels.hpp"
+#include "buffer_pool.hpp"
+#include "cell_sampler.hpp"
+#include "color_palette.hpp"
+#include "pixel_layout.hpp"
+#include "rainbow_animator.hpp"
+#include "stage_profiler.hpp"
+#include "terminal_writer.hpp"
+#include <cstdio>
+#include <unistd.h>
 #include <stdexcept>
-#include <cstdio>   // For sprintf
+#include <algorithm>
 #include <string> // For std::string, std::to_string
 #include <chrono> // For std::chrono
 #include <thread> // For std::this_thread::sleep_for
 #include <iomanip> // For std::setprecision
+#include <memory>
 
 
-// Precompile tables to avoid calculations
-const char* ASCII_CHARS = " .`,:\"^`_-\'!Ii><~+*jftrxunvczXYUJCLQ0OZmwdbqkhao*#MW&8B%@$";
-const int ASCII_TABLE_SIZE = 256;
+// The ramp and its luma table are compile-time constants, see pixel_layout.hpp
+const char* ASCII_CHARS = ASCII_RAMP;
 
-struct AsciiTable
+// One period of the rainbow, red, green and blue are sines 2 radians apart
+struct RainbowTable
 {
-  char data[ASCII_TABLE_SIZE];
-  AsciiTable() {
-    int len = std::strlen(ASCII_CHARS) - 1;
-    for (int i = 0; i < ASCII_TABLE_SIZE; ++i) {
-      data[i] = ASCII_CHARS[ (i * len) / (ASCII_TABLE_SIZE -1)];
+  uint8_t data[RAINBOW_PERIOD][3];
+  RainbowTable() {
+    const double PI = 3.14159265358979323846;
+    for (int i = 0; i < RAINBOW_PERIOD; ++i) {
+      double phase = 2 * PI * i / RAINBOW_PERIOD;
+      for (int c = 0; c < 3; ++c) {
+        data[i][c] = static_cast<uint8_t>(std::sin(phase + 2 * c) * 127 + 128);
+      }
     }
   }
 };
-static const AsciiTable ASCII_LUT;
-
-static const size_t ASCII_CHARS_LEN = strlen(ASCII_CHARS);
+static const RainbowTable RAINBOW_LUT;
 
 
 
 int getGrayscaleValue(uint8_t r, uint8_t g, uint8_t b) {
-  return (299 * static_cast<int>(r) + 587 * static_cast<int>(g) + 114 * static_cast<int>(b)) / 1000;
+  return lumaOf(r, g, b);
 }
 
 char pixelToAscii(int grayValue) {
   if (grayValue < 0 ) grayValue = 0;
   if (grayValue > 255 ) grayValue = 255;
-  return ASCII_LUT.data[grayValue];
+  return GLYPH_TABLE[grayValue];
 }
 
-RawImage convertToAscii(const RawImage &source_image) {
+// One glyph per pixel, a '\n' after each row and a terminating NUL
+template <PixelLayout L>
+static void writeAscii(const RawImageView& source_image, char* target_data) {
   int width = source_image.getWidth();
   int height = source_image.getHeight();
-  int channels = 1; // For 1 grayscaled ascii code per pixel
-  int size = source_image.getSize();
-  const uint8_t* source_data = source_image.getData();
-  
-  RawImage target_image(width + height, height, 1); // 1 extra row for '\n'
-  uint8_t* target_data = target_image.getData();
-  
   for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      size_t pixelIndex = (y * width + x) * 3;  // RGB data assumes 3 channels
-      uint8_t r = source_data[pixelIndex];
-      uint8_t g = source_data[pixelIndex + 1];
-      uint8_t b = source_data[pixelIndex + 2];
-      
-      int grayValue = getGrayscaleValue(r, g, b);
-      target_data[pixelIndex / 3] = pixelToAscii(grayValue);
-    }
-    target_data[(y * width) + 1] = '\n'; // New line after each row
+    char* row = target_data + static_cast<size_t>(y) * (width + 1);
+    rowToGlyphs<L>(source_image.getRow(y), width, row);
+    row[width] = '\n'; // New line after each row
   }
+  target_data[static_cast<size_t>(width + 1) * height] = '\0';
+}
+
+static void writeAscii(const RawImageView& source_image, PixelLayout layout, char* target_data) {
+  checkPixelLayout(source_image, layout);
+  dispatchPixelLayout(layout, [&](auto tag) { writeAscii<decltype(tag)::value>(source_image, target_data); });
+}
+
+RawImage convertToAscii(const RawImageView& source_image) {
+  return convertToAscii(source_image, pixelLayoutFor(source_image.getChannels()));
+}
+
+RawImage convertToAscii(const RawImageView& source_image, PixelLayout layout) {
+  RawImage target_image((source_image.getWidth() + 1) * source_image.getHeight() + 1, 1, 1);
+  writeAscii(source_image, layout, reinterpret_cast<char*>(target_image.getData()));
   return target_image;
 }
 
+RawImage convertToAscii(const RawImageView& source_image, BufferPool& pool) {
+  RawImage target_image((source_image.getWidth() + 1) * source_image.getHeight() + 1, 1, 1, pool);
+  writeAscii(source_image, pixelLayoutFor(source_image.getChannels()), reinterpret_cast<char*>(target_image.getData()));
+  return target_image;
+}
+
+size_t convertToAscii(const RawImageView& source_image, RawImage& target) {
+  size_t size = static_cast<size_t>(source_image.getWidth() + 1) * source_image.getHeight();
+  if (target.getSize() < size + 1) {
+    throw std::runtime_error("Target buffer too small for ASCII output");
+  }
+  writeAscii(source_image, pixelLayoutFor(source_image.getChannels()), reinterpret_cast<char*>(target.getData()));
+  return size;
+}
+
 
 void getRainbowColor(int width, int height, int scroll_offset, 
                     uint8_t& red, uint8_t& green, uint8_t& blue) {
-  double freq = 0.1;
-  double i = (width + height) + scroll_offset;
-  red = static_cast<uint8_t>(std::sin(freq * i + 0) * 127 + 128);
-  green = static_cast<uint8_t>(std::sin(freq * i + 2) * 127 + 128);
-  blue = static_cast<uint8_t>(std::sin(freq * i + 4) * 127 + 128);
+  int i = (width + height + scroll_offset) % RAINBOW_PERIOD;
+  if (i < 0) i += RAINBOW_PERIOD;
+  red = RAINBOW_LUT.data[i][0];
+  green = RAINBOW_LUT.data[i][1];
+  blue = RAINBOW_LUT.data[i][2];
 }
 
-void convertToRainbowAscii(const RawImage& img, int scroll_offset, RawImage& target) {
+// Glyph from the pixel's luma, color from the rainbow
+template <PixelLayout L>
+static void writeRainbow(const RawImageView& img, int scroll_offset, TruecolorEmitter& emitter) {
+  using Reader = PixelReader<L>;
   int width = img.getWidth();
   int height = img.getHeight();
-  const uint8_t* data = img.getData();
-  
-  char* buffer = reinterpret_cast<char*>(target.getData());
-  char* p = buffer;
-
   for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      size_t pixelIndex = (y * width + x) * 3;  // RGB data assumes 3 channels
-      uint8_t r = data[pixelIndex];
-      uint8_t g = data[pixelIndex + 1];
-      uint8_t b = data[pixelIndex + 2];
-      
-      int grayValue = getGrayscaleValue(r, g, b);
-      char asciiChar = pixelToAscii(grayValue);
-
+    const uint8_t* data = img.getRow(y);
+    for (int x = 0; x < width; ++x, data += Reader::CHANNELS) {
+      uint8_t r, g, b;
       getRainbowColor(x, y, scroll_offset, r, g, b);
+      emitter.put(r, g, b, GLYPH_TABLE[Reader::luma(data)]);
+    }
+    emitter.putChar('\n');
+  }
+}
 
-      // Using sprintf is much faster than stringstream or std::string concatenation
-      p += sprintf(p, "\033[38;2;%d;%d;%dm%c", r, g, b, asciiChar);
-    }  
-    *p++ = '\n';
+size_t convertToRainbowAscii(const RawImageView& img, int scroll_offset, RawImage& target, int color_tolerance) {
+  if (target.getSize() < coloredAsciiBufferSize(img.getWidth(), img.getHeight())) {
+    throw std::runtime_error("Target buffer too small for colored ASCII output");
   }
+  TruecolorEmitter emitter(reinterpret_cast<char*>(target.getData()), color_tolerance);
+  dispatchPixelLayout(pixelLayoutFor(img.getChannels()), [&](auto tag) {
+    writeRainbow<decltype(tag)::value>(img, scroll_offset, emitter);
+  });
   // Reset color at end
-  sprintf(p, "\033[0m");
-
+  emitter.finish();
+  return emitter.size();
 }
 
-void convertToColoredAscii(const RawImage &source_image, RawImage& target) {
+// Color and glyph from one read of each pixel. Specialized on the input
+// layout and, through the emitter, on the output color mode.
+template <PixelLayout L, typename Emitter>
+static void writeColored(const RawImageView& source_image, Emitter& emitter) {
+  using Reader = PixelReader<L>;
   int width = source_image.getWidth();
   int height = source_image.getHeight();
-  const uint8_t* data = source_image.getData();
-  
-  char* buffer = reinterpret_cast<char*>(target.getData());
-  char* p = buffer;
-
   for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      size_t pixelIndex = (y * width + x) * 3;  // RGB data assumes 3 channels
-      uint8_t r = data[pixelIndex];
-      uint8_t g = data[pixelIndex + 1];
-      uint8_t b = data[pixelIndex + 2];
-      
-      int grayValue = getGrayscaleValue(r, g, b);
-      char asciiChar = pixelToAscii(grayValue);
-
-      p += sprintf(p, "\033[38;2;%d;%d;%dm%c", r, g, b, asciiChar);
+    const uint8_t* data = source_image.getRow(y);
+    for (int x = 0; x < width; ++x, data += Reader::CHANNELS) {
+      uint8_t r, g, b;
+      Reader::rgb(data, r, g, b);
+      emitter.put(r, g, b, GLYPH_TABLE[lumaOf(r, g, b)]);
     }
-  
-    *p++ = '\n';
+    emitter.putChar('\n');
   }
-  // Reset color at end
-  sprintf(p, "\033[0m");
 }
 
-void outputAsciiToFile(const RawImage &img, const char* output_filename) {
-  std::ofstream outputFile(output_filename, std::ios::trunc) ;
-  
-  if (!outputFile) {
-    throw std::runtime_error("Error opening file!");
+size_t convertToColoredAscii(const RawImageView& source_image, RawImage& target, int color_tolerance) {
+  return convertToColoredAscii(source_image, target, ColorMode::Truecolor, color_tolerance);
+}
+
+size_t convertToColoredAscii(const RawImageView& source_image, RawImage& target, ColorMode mode, int color_tolerance) {
+  return convertToColoredAscii(source_image, target, mode, color_tolerance, pixelLayoutFor(source_image.getChannels()));
+}
+
+size_t convertToColoredAscii(const RawImageView& source_image, RawImage& target, ColorMode mode, int color_tolerance,
+                             PixelLayout layout) {
+  checkPixelLayout(source_image, layout);
+  if (target.getSize() < coloredAsciiBufferSize(source_image.getWidth(), source_image.getHeight(), mode)) {
+    throw std::runtime_error("Target buffer too small for colored ASCII output");
   }
+  char* out = reinterpret_cast<char*>(target.getData());
+  if (mode == ColorMode::Truecolor) {
+    TruecolorEmitter emitter(out, color_tolerance);
+    dispatchPixelLayout(layout, [&](auto tag) { writeColored<decltype(tag)::value>(source_image, emitter); });
+    // Reset color at end
+    emitter.finish();
+    return emitter.size();
+  }
+  // The palette modes only write an SGR when the cube index changes
+  PaletteEmitter emitter(out, mode);
+  dispatchPixelLayout(layout, [&](auto tag) { writeColored<decltype(tag)::value>(source_image, emitter); });
+  emitter.finish();
+  return emitter.size();
+}
 
-  std::streambuf* originalCoutBuffer = std::cout.rdbuf();
+void outputAsciiToFile(const RawImage &img, const char* output_filename) {
+  // The text ends at the NUL or at the end of the buffer, whichever comes first
+  const char* text = reinterpret_cast<const char*>(img.getData());
+  outputAsciiToFile(text, strnlen(text, img.getSize()), output_filename);
+}
 
-  std::cout.rdbuf(outputFile.rdbuf());
+void outputAsciiToFile(const char* data, size_t size, const char* output_filename) {
+  TerminalWriter writer{std::string(output_filename)};
+  writer.writeFrame(data, size);
+}
 
-  std::cout << img.getData();
-  
-  std::cout.rdbuf(originalCoutBuffer);
+
+// "Frame Rate: ..." status line below each frame, \033[K clears what is left of the previous one
+static size_t formatStatusLine(char* out, size_t capacity, double fps, size_t frame_bytes, size_t changed_cells) {
+  int len = std::snprintf(out, capacity, "Frame Rate: %.1f | Bytes: %zu | Changed cells: %zu\033[K\n", fps, frame_bytes,
+                          changed_cells);
+  return std::min(static_cast<size_t>(len), capacity - 1);
 }
 
 
-void outputWebcameAsciiStream(size_t FRAMES_TO_PROCESS) {
-  
-  cv::VideoCapture cap(0);
-  if (!cap.isOpened()) {
-    throw std::runtime_error("Error: Could not open webcame.");
-  }
-  
-  cv::Mat frame, resized_frame;
+void outputAsciiStream(FrameSource& source, size_t FRAMES_TO_PROCESS, RenderMode mode, StageProfiler* profiler,
+                       AdaptiveController* controller) {
+  Frame frame;
+  CellSampler sampler;
 
   // Disable synchronization with C-style I/O for faster terminal output
   std::ios::sync_with_stdio(false);
   std::cin.tie(NULL);
 
-  // Estimate size: max 19 bytes per pixel (\033[38;2;255;255;255mC) + newline + footer + null
+  // Worst case: 19 bytes of SGR + 1 glyph per pixel, newline per row, reset + null
   int initial_width = 100; // Assuming this as max width
   int initial_height = 100 * 0.55; // Assuming this as max height with aspect ratio
-  size_t estimated_size = initial_height * (initial_width * 20 + 1) + 16;
-  RawImage buffer_image(estimated_size, 1, 1);
+  RawImage buffer_image(DiffRenderer::bufferSize(initial_width, initial_height), 1, 1);
+  // A full repaint every frame when differential rendering is off
+  const double repaint_threshold = mode == RenderMode::Differential ? 0.5 : -1.0;
+  DiffRenderer renderer(repaint_threshold);
+  CellGrid cells;
+
+  // The controller needs the stage times even when nothing is profiled
+  std::unique_ptr<StageProfiler> controller_profiler;
+  if (controller && !profiler) controller_profiler = std::make_unique<StageProfiler>();
+  StageProfiler* timing_profiler = profiler ? profiler : controller_profiler.get();
+  std::unique_ptr<TerminalResizeWatcher> resize_watcher;
+  if (controller) {
+    resize_watcher = std::make_unique<TerminalResizeWatcher>();
+    controller->setTerminalSize(queryTerminalSize(STDOUT_FILENO));
+    const AdaptiveSettings& settings = controller->settings();
+    renderer = DiffRenderer(repaint_threshold, settings.color_tolerance, settings.color_mode);
+  }
 
-  // calculating average frame rate
-  unsigned int current_fps = 0, avg_fps = 0; 
+  // Frame rate from the time between shown frames, terminal I/O included
+  double current_fps = 0.0;
+  size_t total_bytes = 0, total_changed_cells = 0;
+  size_t frames = 0, shown = 0;
+  char status[128];
+  WriterStats writer_stats;
+  auto first_shown = std::chrono::steady_clock::now(), last_shown = first_shown;
+
+  {
+  // A terminal that cannot keep up skips frames instead of stalling capture
+  TerminalWriter writer(STDOUT_FILENO, WriteMode::NonBlocking);
   
-  for (int i = 0; i < FRAMES_TO_PROCESS; i++){
-    auto start = std::chrono::high_resolution_clock::now();  
-
-    cap >> frame;
-    if (frame.empty()) {
-      throw std::runtime_error("Error: No frame captured from the webcam.");
+  for (; FRAMES_TO_PROCESS == 0 || frames < FRAMES_TO_PROCESS; frames++){
+    auto start = std::chrono::steady_clock::now();
+    FrameTiming timing;
+
+    {
+      ScopedStageTimer timer(timing_profiler, PROFILE_CAPTURE, frames, &timing);
+      if (!source.read(frame)) {
+        timer.cancel();
+        break; // End of stream
+      }
+    }
+    if (!writer.ready()) {
+      continue; // Still draining the last frame, skip this one without rendering it
     }
     
-    // Resize to fit terminal width (e.g., 100 chars)
-    // We multiply height by 0.55 to account for the rectangular shape of terminal characters
-    int new_width = 100;
-    int new_height = static_cast<int>(frame.rows * (static_cast<float>(new_width) / (frame.cols) * 0.55f));
-    cv::resize(frame, resized_frame, cv::Size(new_width, new_height));
-    
-    // OpenCV uses BGR by default, convert to RGB for RawImage
-    cv::cvtColor(resized_frame, resized_frame, cv::COLOR_BGR2RGB);
-    
-    // Create RawImage from the resized OpenCV matrix data
-    RawImage img(resized_frame.cols, resized_frame.rows, resized_frame.channels(), resized_frame.data);
-    
-    std::cout << "\033[H\033[2J";  // ANSI escape code to clear screen and move cursor home
-    convertToColoredAscii(img, buffer_image);
-    std::cout << buffer_image.getData() << std::flush;
+    if (resize_watcher && resize_watcher->resized()) {
+      controller->setTerminalSize(queryTerminalSize(STDOUT_FILENO));
+      renderer.invalidate(); // The terminal may have reflowed what was on screen
+    }
+    int columns = controller ? controller->outputWidth(frame.width, frame.height) : 100;
+
+    {
+      // Box-average the columns straight from the frame, the rows are scaled by 0.55
+      // to account for the rectangular shape of terminal characters
+      ScopedStageTimer timer(timing_profiler, PROFILE_CELLS, frames, &timing);
+      if (isYuvFormat(frame.format)) {
+        sampler.sample(frame.yuvView(), columns, cells);
+      } else {
+        sampler.sample(frame.view(), frame.format, columns, cells);
+      }
+    }
 
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double, std::milli> elapsed = end - start;
+    // Grows with the width and the color mode, the first frame and every change fit
+    size_t required = DiffRenderer::bufferSize(cells.width, cells.height, renderer.colorMode());
+    if (buffer_image.getSize() < required) {
+      buffer_image = RawImage(static_cast<int>(required), 1, 1);
+    }
 
-    current_fps = static_cast<int>(1000 / elapsed.count());
-    std::string fps_str = std::to_string(current_fps);
-    
-    std::cout << "Frame Rate: " <<  fps_str << std::endl;
-    avg_fps += current_fps;
+    RenderStats stats;
+    {
+      ScopedStageTimer timer(timing_profiler, PROFILE_RENDER, frames, &timing);
+      stats = renderer.render(cells, buffer_image);
+    }
+    size_t frame_bytes = stats.bytes_written, changed_cells = stats.changed_cells;
+
+    // Frame and status line in one writev
+    size_t status_bytes = formatStatusLine(status, sizeof(status), current_fps, frame_bytes, changed_cells);
+    bool written;
+    {
+      ScopedStageTimer timer(timing_profiler, PROFILE_OUTPUT, frames, &timing);
+      written = writer.writeFrame({ { reinterpret_cast<const char*>(buffer_image.getData()), frame_bytes },
+                                    { status, status_bytes } });
+    }
+    if (!written) {
+      renderer.invalidate(); // The screen never saw this frame
+      continue;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    if (profiler) {
+      profiler->endFrame(timing, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+    if (shown == 0) {
+      first_shown = end;
+    } else {
+      std::chrono::duration<double> interval = end - last_shown;
+      current_fps = interval.count() > 0 ? 1.0 / interval.count() : 0.0;
+    }
+    last_shown = end;
+    total_bytes += frame_bytes;
+    total_changed_cells += changed_cells;
+    shown++;
+    if (controller && controller->update(timing)) {
+      // A new renderer repaints the whole screen, old cells of a wider grid are cleared
+      const AdaptiveSettings& settings = controller->settings();
+      renderer = DiffRenderer(repaint_threshold, settings.color_tolerance, settings.color_mode);
+    }
+  }
+  writer.flush();
+  writer_stats = writer.stats();
   }
   
-  avg_fps /= FRAMES_TO_PROCESS;
+  if (shown == 0) {
+    return;
+  }
+  std::chrono::duration<double> elapsed = last_shown - first_shown;
+  double avg_fps = shown > 1 && elapsed.count() > 0 ? (shown - 1) / elapsed.count() : 0.0;
   
-  std::string avg_fps_str = std::to_string(avg_fps);
-  std::cout << "Avg. Frame Rate: " <<  avg_fps_str << std::endl;
+  std::cout << "Avg. Frame Rate: " << std::fixed << std::setprecision(1) << avg_fps
+            << " | Avg. Bytes: " << total_bytes / shown
+            << " | Avg. Changed cells: " << total_changed_cells / shown << " | Skipped frames: " << frames - shown
+            << " | Partial writes: " << writer_stats.partial_writes << std::endl;
+  if (controller) {
+    const AdaptiveSettings& settings = controller->settings();
+    std::cout << "Adaptive: " << settings.width << " columns | " << colorModeName(settings.color_mode)
+              << " colors | tolerance " << settings.color_tolerance << " | " << controller->adjustments()
+              << " adjustments" << std::endl;
+  }
+  if (profiler) {
+    profiler->writeSummary(std::cout);
+  }
+}
+
+
+void outputWebcameAsciiStream(size_t FRAMES_TO_PROCESS, RenderMode mode, StageProfiler* profiler,
+                              AdaptiveController* controller) {
+  VideoCaptureSource webcam(0);
+  outputAsciiStream(webcam, FRAMES_TO_PROCESS, mode, profiler, controller);
 }
 
 
-void outputRainbowAsciiAnimation(const RawImage& img, size_t FRAMES_TO_PROCESS) {
+void outputRainbowAsciiAnimation(const RawImageView& img, size_t FRAMES_TO_PROCESS, RenderMode mode) {
   // Disable synchronization with C-style I/O for faster terminal output
   std::ios::sync_with_stdio(false);
   std::cin.tie(NULL);
   
-  // Create the RawImage object once
-
-  // Estimate size: max 19 bytes per pixel (\033[38;2;255;255;255mC) + newline + footer + null
-  int width = img.getWidth();
-  int height = img.getHeight();
-  size_t estimated_size = height * (width * 20 + 1) + 16;
-
-  RawImage buffer_image(estimated_size, 1, 1);
-
-  // calculating average frame rate
-  unsigned int current_fps = 0, avg_fps = 0; 
+  // Glyphs once, then every frame of one rainbow period rendered once and replayed
+  RainbowAnimator animator(img, mode);
+
+  // Frame rate from the time between frames, terminal I/O included
+  double current_fps = 0.0;
+  size_t total_bytes = 0, total_changed_cells = 0;
+  char status[128];
+  // Nothing to capture here, every frame is shown
+  TerminalWriter writer(STDOUT_FILENO, WriteMode::Blocking);
+  auto first_frame = std::chrono::steady_clock::now(), last_frame = first_frame;
   
-  for (int i = 0; i < FRAMES_TO_PROCESS; i++){
-    auto start = std::chrono::high_resolution_clock::now();
-
-    std::cout << "\033[H\033[2J";  // ANSI escape code to clear screen and move cursor home
-    
-    convertToRainbowAscii(img, i, buffer_image);
-
-    std::cout << buffer_image.getData() << std::flush;
-
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double, std::milli> elapsed = end - start;
+  for (size_t i = 0; i < FRAMES_TO_PROCESS; i++){
+    RenderStats stats;
+    AsciiSegment frame = animator.frame(i, &stats);
+    AsciiSegment header{ "", 0 };
+    if (mode == RenderMode::FullRepaint) {
+      header = AsciiSegment{ "\033[H\033[2J", 7 };  // ANSI escape code to clear screen and move cursor home
+    }
 
-    current_fps = static_cast<int>(1000 / elapsed.count());
-    std::string fps_str = std::to_string(current_fps);
+    // Header, frame and status line in one writev
+    size_t status_bytes = formatStatusLine(status, sizeof(status), current_fps, stats.bytes_written, stats.changed_cells);
+    writer.writeFrame({ header, frame, { status, status_bytes } });
+    total_bytes += stats.bytes_written;
+    total_changed_cells += stats.changed_cells;
 
-    std::cout << "Frame Rate: " <<  fps_str << std::endl;
-    avg_fps += current_fps;
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> interval = now - last_frame;
+    current_fps = interval.count() > 0 ? 1.0 / interval.count() : 0.0;
+    last_frame = now;
   }
   
-  avg_fps /= FRAMES_TO_PROCESS;
+  if (FRAMES_TO_PROCESS == 0) {
+    return;
+  }
+  std::chrono::duration<double> elapsed = last_frame - first_frame;
+  double avg_fps = elapsed.count() > 0 ? FRAMES_TO_PROCESS / elapsed.count() : 0.0;
   
-  std::string avg_fps_str = std::to_string(avg_fps);
-  std::cout << "Avg. Frame Rate: " <<  avg_fps_str << std::endl;
-}
\ No newline at end of file
+  std::cout << "Avg. Frame Rate: " << std::fixed << std::setprecision(1) << avg_fps
+            << " | Avg. Bytes: " << total_bytes / FRAMES_TO_PROCESS
+            << " | Avg. Changed cells: " << total_changed_cells / FRAMES_TO_PROCESS << std::endl;
+  std::cout << "Cached frames: " << animator.cachedFrames() << "/" << RAINBOW_PERIOD << " ("
+            << animator.cachedBytes() / 1024 << " KiB, limit " << animator.cacheLimit() / 1024 << " KiB)"
+            << " | Memory: " << animator.memoryUsage() / 1024 << " KiB" << std::endl;
+}
@@ -0,0 +1,326 @@
+#include "ascii_kernels.hpp"
+#include "ascii_image.hpp"
+#include <stdexcept>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ASCII_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+// Tables shared by the SIMD kernels, built once from ASCII_CHARS.
+// glyph index = (gray * len) / 255 is the same formula AsciiTable uses.
+struct GlyphTables
+{
+  int len;
+  bool fits_shuffle; // Up to 64 glyphs fit in four 16-entry shuffle tables
+  alignas(16) uint8_t glyphs[64];
+  alignas(16) uint8_t deinterleave[3][3][16]; // [channel][16-byte chunk][lane]
+  GlyphTables() {
+    len = static_cast<int>(std::strlen(ASCII_CHARS)) - 1;
+    fits_shuffle = len >= 0 && len < 64;
+    for (int i = 0; i < 64; ++i) {
+      glyphs[i] = static_cast<uint8_t>(ASCII_CHARS[i < len ? i : len]);
+    }
+    // Byte 3*i + c of a 48-byte RGB block holds channel c of pixel i
+    for (int c = 0; c < 3; ++c) {
+      for (int chunk = 0; chunk < 3; ++chunk) {
+        for (int i = 0; i < 16; ++i) {
+          int src = 3 * i + c;
+          deinterleave[c][chunk][i] = (src / 16 == chunk) ? static_cast<uint8_t>(src % 16) : 0x80;
+        }
+      }
+    }
+  }
+};
+
+static const GlyphTables& glyphTables() {
+  static const GlyphTables tables;
+  return tables;
+}
+
+static void rowToAsciiScalar(const uint8_t* rgb, int width, char* out) {
+  for (int x = 0; x < width; ++x) {
+    const uint8_t* p = rgb + x * 3;
+    out[x] = pixelToAscii(getGrayscaleValue(p[0], p[1], p[2]));
+  }
+}
+
+static void rowToGrayScalar(const uint8_t* rgb, int width, uint8_t* out) {
+  for (int x = 0; x < width; ++x) {
+    const uint8_t* p = rgb + x * 3;
+    out[x] = static_cast<uint8_t>(getGrayscaleValue(p[0], p[1], p[2]));
+  }
+}
+
+#ifdef ASCII_KERNELS_X86
+
+// Luma is (299r + 587g + 114b) / 1000 done exactly in 16-bit lanes:
+// the 32-bit sum is shifted by 3 to fit, then divided by 125 with
+// mulhi(y, 33555) >> 6, which is exact for every sum up to 255000.
+// Glyph index is (gray * len) / 255 with mulhi(v, 0x8081) >> 7.
+
+__attribute__((target("ssse3")))
+static inline __m128i luma8Ssse3(__m128i r, __m128i g, __m128i b) {
+  const __m128i w_rg = _mm_set1_epi32((587 << 16) | 299);
+  const __m128i w_b = _mm_set1_epi32(114);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r, g), w_rg),
+                             _mm_madd_epi16(_mm_unpacklo_epi16(b, zero), w_b));
+  __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r, g), w_rg),
+                             _mm_madd_epi16(_mm_unpackhi_epi16(b, zero), w_b));
+  __m128i y = _mm_packs_epi32(_mm_srli_epi32(lo, 3), _mm_srli_epi32(hi, 3));
+  return _mm_srli_epi16(_mm_mulhi_epu16(y, _mm_set1_epi16(33555)), 6);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i glyphIndex8Ssse3(__m128i gray, int len) {
+  __m128i v = _mm_mullo_epi16(gray, _mm_set1_epi16(static_cast<short>(len)));
+  return _mm_srli_epi16(_mm_mulhi_epu16(v, _mm_set1_epi16(static_cast<short>(0x8081))), 7);
+}
+
+// Luma of the 16 pixels at p as two vectors of 8 16-bit lanes
+__attribute__((target("ssse3")))
+static inline void grayOf16Ssse3(const uint8_t* p, const __m128i shuf[3][3], __m128i& gray_lo, __m128i& gray_hi) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i c0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  __m128i c1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+  __m128i c2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+  __m128i ch[3];
+  for (int c = 0; c < 3; ++c) {
+    ch[c] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, shuf[c][0]), _mm_shuffle_epi8(c1, shuf[c][1])),
+                         _mm_shuffle_epi8(c2, shuf[c][2]));
+  }
+  gray_lo = luma8Ssse3(_mm_unpacklo_epi8(ch[0], zero), _mm_unpacklo_epi8(ch[1], zero), _mm_unpacklo_epi8(ch[2], zero));
+  gray_hi = luma8Ssse3(_mm_unpackhi_epi8(ch[0], zero), _mm_unpackhi_epi8(ch[1], zero), _mm_unpackhi_epi8(ch[2], zero));
+}
+
+__attribute__((target("ssse3")))
+static void loadDeinterleaveSsse3(__m128i shuf[3][3]) {
+  const GlyphTables& t = glyphTables();
+  for (int c = 0; c < 3; ++c) {
+    for (int chunk = 0; chunk < 3; ++chunk) {
+      shuf[c][chunk] = _mm_load_si128(reinterpret_cast<const __m128i*>(t.deinterleave[c][chunk]));
+    }
+  }
+}
+
+__attribute__((target("ssse3")))
+static void rowToAsciiSsse3(const uint8_t* rgb, int width, char* out) {
+  const GlyphTables& t = glyphTables();
+  if (!t.fits_shuffle) {
+    rowToAsciiScalar(rgb, width, out);
+    return;
+  }
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  __m128i shuf[3][3];
+  loadDeinterleaveSsse3(shuf);
+  __m128i glyphs[4];
+  for (int k = 0; k < 4; ++k) {
+    glyphs[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(t.glyphs + 16 * k));
+  }
+
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i gray_lo, gray_hi;
+    grayOf16Ssse3(rgb + x * 3, shuf, gray_lo, gray_hi);
+    __m128i idx = _mm_packus_epi16(glyphIndex8Ssse3(gray_lo, t.len), glyphIndex8Ssse3(gray_hi, t.len));
+
+    __m128i low = _mm_and_si128(idx, nibble);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(idx, 4), nibble);
+    __m128i result = zero;
+    for (int k = 0; k < 4; ++k) {
+      __m128i sel = _mm_cmpeq_epi8(high, _mm_set1_epi8(static_cast<char>(k)));
+      result = _mm_or_si128(result, _mm_and_si128(sel, _mm_shuffle_epi8(glyphs[k], low)));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), result);
+  }
+  rowToAsciiScalar(rgb + x * 3, width - x, out + x);
+}
+
+__attribute__((target("ssse3")))
+static void rowToGraySsse3(const uint8_t* rgb, int width, uint8_t* out) {
+  __m128i shuf[3][3];
+  loadDeinterleaveSsse3(shuf);
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i gray_lo, gray_hi;
+    grayOf16Ssse3(rgb + x * 3, shuf, gray_lo, gray_hi);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(gray_lo, gray_hi));
+  }
+  rowToGrayScalar(rgb + x * 3, width - x, out + x);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i luma16Avx2(__m256i r, __m256i g, __m256i b) {
+  const __m256i w_rg = _mm256_set1_epi32((587 << 16) | 299);
+  const __m256i w_b = _mm256_set1_epi32(114);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(r, g), w_rg),
+                                _mm256_madd_epi16(_mm256_unpacklo_epi16(b, zero), w_b));
+  __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(r, g), w_rg),
+                                _mm256_madd_epi16(_mm256_unpackhi_epi16(b, zero), w_b));
+  __m256i y = _mm256_packs_epi32(_mm256_srli_epi32(lo, 3), _mm256_srli_epi32(hi, 3));
+  return _mm256_srli_epi16(_mm256_mulhi_epu16(y, _mm256_set1_epi16(33555)), 6);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i glyphIndex16Avx2(__m256i gray, int len) {
+  __m256i v = _mm256_mullo_epi16(gray, _mm256_set1_epi16(static_cast<short>(len)));
+  return _mm256_srli_epi16(_mm256_mulhi_epu16(v, _mm256_set1_epi16(static_cast<short>(0x8081))), 7);
+}
+
+// Luma of the 32 pixels at p, the low 128-bit lane holds pixels 0..15 and the high lane 16..31
+__attribute__((target("avx2")))
+static inline void grayOf32Avx2(const uint8_t* p, const __m256i shuf[3][3], __m256i& gray_lo, __m256i& gray_hi) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i c0 = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48)), 1);
+  __m256i c1 = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16))),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 64)), 1);
+  __m256i c2 = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32))),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 80)), 1);
+  __m256i ch[3];
+  for (int c = 0; c < 3; ++c) {
+    ch[c] = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(c0, shuf[c][0]), _mm256_shuffle_epi8(c1, shuf[c][1])),
+                            _mm256_shuffle_epi8(c2, shuf[c][2]));
+  }
+  gray_lo = luma16Avx2(_mm256_unpacklo_epi8(ch[0], zero), _mm256_unpacklo_epi8(ch[1], zero),
+                       _mm256_unpacklo_epi8(ch[2], zero));
+  gray_hi = luma16Avx2(_mm256_unpackhi_epi8(ch[0], zero), _mm256_unpackhi_epi8(ch[1], zero),
+                       _mm256_unpackhi_epi8(ch[2], zero));
+}
+
+__attribute__((target("avx2")))
+static void loadDeinterleaveAvx2(__m256i shuf[3][3]) {
+  const GlyphTables& t = glyphTables();
+  for (int c = 0; c < 3; ++c) {
+    for (int chunk = 0; chunk < 3; ++chunk) {
+      shuf[c][chunk] = _mm256_broadcastsi128_si256(
+          _mm_load_si128(reinterpret_cast<const __m128i*>(t.deinterleave[c][chunk])));
+    }
+  }
+}
+
+__attribute__((target("avx2")))
+static void rowToAsciiAvx2(const uint8_t* rgb, int width, char* out) {
+  const GlyphTables& t = glyphTables();
+  if (!t.fits_shuffle) {
+    rowToAsciiScalar(rgb, width, out);
+    return;
+  }
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  __m256i shuf[3][3];
+  loadDeinterleaveAvx2(shuf);
+  __m256i glyphs[4];
+  for (int k = 0; k < 4; ++k) {
+    glyphs[k] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(t.glyphs + 16 * k)));
+  }
+
+  // Low 128-bit lane handles pixels 0..15, high lane pixels 16..31
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i gray_lo, gray_hi;
+    grayOf32Avx2(rgb + x * 3, shuf, gray_lo, gray_hi);
+    __m256i idx = _mm256_packus_epi16(glyphIndex16Avx2(gray_lo, t.len), glyphIndex16Avx2(gray_hi, t.len));
+
+    __m256i low = _mm256_and_si256(idx, nibble);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(idx, 4), nibble);
+    __m256i result = zero;
+    for (int k = 0; k < 4; ++k) {
+      __m256i sel = _mm256_cmpeq_epi8(high, _mm256_set1_epi8(static_cast<char>(k)));
+      result = _mm256_or_si256(result, _mm256_and_si256(sel, _mm256_shuffle_epi8(glyphs[k], low)));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), result);
+  }
+  rowToAsciiSsse3(rgb + x * 3, width - x, out + x);
+}
+
+__attribute__((target("avx2")))
+static void rowToGrayAvx2(const uint8_t* rgb, int width, uint8_t* out) {
+  __m256i shuf[3][3];
+  loadDeinterleaveAvx2(shuf);
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i gray_lo, gray_hi;
+    grayOf32Avx2(rgb + x * 3, shuf, gray_lo, gray_hi);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_packus_epi16(gray_lo, gray_hi));
+  }
+  rowToGraySsse3(rgb + x * 3, width - x, out + x);
+}
+
+#endif // ASCII_KERNELS_X86
+
+const char* asciiKernelName(AsciiKernel kernel) {
+  switch (kernel) {
+    case AsciiKernel::Scalar: return "scalar";
+    case AsciiKernel::SSSE3: return "ssse3";
+    case AsciiKernel::AVX2: return "avx2";
+  }
+  return "unknown";
+}
+
+bool isAsciiKernelSupported(AsciiKernel kernel) {
+  switch (kernel) {
+    case AsciiKernel::Scalar: return true;
+#ifdef ASCII_KERNELS_X86
+    case AsciiKernel::SSSE3: __builtin_cpu_init(); return __builtin_cpu_supports("ssse3");
+    case AsciiKernel::AVX2: __builtin_cpu_init(); return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("ssse3");
+#else
+    default: return false;
+#endif
+  }
+  return false;
+}
+
+AsciiKernel detectBestAsciiKernel() {
+  if (isAsciiKernelSupported(AsciiKernel::AVX2)) return AsciiKernel::AVX2;
+  if (isAsciiKernelSupported(AsciiKernel::SSSE3)) return AsciiKernel::SSSE3;
+  return AsciiKernel::Scalar;
+}
+
+static AsciiKernel s_active_kernel = detectBestAsciiKernel();
+
+AsciiKernel getAsciiKernel() {
+  return s_active_kernel;
+}
+
+void setAsciiKernel(AsciiKernel kernel) {
+  if (!isAsciiKernelSupported(kernel)) {
+    throw std::runtime_error(std::string("ASCII kernel not supported on this CPU: ") + asciiKernelName(kernel));
+  }
+  s_active_kernel = kernel;
+}
+
+void convertRowToAscii(AsciiKernel kernel, const uint8_t* rgb, int width, char* out) {
+  switch (kernel) {
+#ifdef ASCII_KERNELS_X86
+    case AsciiKernel::AVX2: rowToAsciiAvx2(rgb, width, out); return;
+    case AsciiKernel::SSSE3: rowToAsciiSsse3(rgb, width, out); return;
+#endif
+    default: rowToAsciiScalar(rgb, width, out); return;
+  }
+}
+
+void convertRowToAscii(const uint8_t* rgb, int width, char* out) {
+  convertRowToAscii(s_active_kernel, rgb, width, out);
+}
+
+void convertRowToGray(AsciiKernel kernel, const uint8_t* rgb, int width, uint8_t* out) {
+  switch (kernel) {
+#ifdef ASCII_KERNELS_X86
+    case AsciiKernel::AVX2: rowToGrayAvx2(rgb, width, out); return;
+    case AsciiKernel::SSSE3: rowToGraySsse3(rgb, width, out); return;
+#endif
+    default: rowToGrayScalar(rgb, width, out); return;
+  }
+}
+
+void convertRowToGray(const uint8_t* rgb, int width, uint8_t* out) {
+  convertRowToGray(s_active_kernel, rgb, width, out);
+}
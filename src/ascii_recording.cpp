@@ -0,0 +1,489 @@
+#include "ascii_recording.hpp"
+#include "color_palette.hpp"
+#include "terminal_writer.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Little-endian fields, independent of the host byte order
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+}
+static void put32(uint8_t* p, uint32_t v) {
+  for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+static void put64(uint8_t* p, uint64_t v) {
+  for (int i = 0; i < 8; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+static uint16_t get16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+static uint32_t get32(const uint8_t* p) {
+  uint32_t v = 0;
+  for (int i = 3; i >= 0; --i) v = (v << 8) | p[i];
+  return v;
+}
+static uint64_t get64(const uint8_t* p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+  return v;
+}
+
+// 7 bits per byte, high bit set on all but the last
+static void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<uint8_t>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(v));
+}
+static uint64_t getVarint(const uint8_t*& p, const uint8_t* end) {
+  uint64_t v = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t byte = *p++;
+    v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return v;
+  }
+  throw std::runtime_error("Corrupt recording: truncated run");
+}
+
+static void writeFrameHeader(uint8_t* p, RecordedFrameType type, uint32_t payload_size, uint64_t timestamp_us) {
+  p[0] = static_cast<uint8_t>(type);
+  p[1] = p[2] = p[3] = 0;
+  put32(p + 4, payload_size);
+  put64(p + 8, timestamp_us);
+}
+
+
+AsciiRecorder::AsciiRecorder(const std::string& filename, ColorMode color_mode, GlyphMode glyph_mode,
+                             uint32_t keyframe_interval)
+: m_file(filename, std::ios::binary | std::ios::trunc) {
+  if (!m_file.is_open()) {
+    throw std::runtime_error("Error opening " + filename + ": " + std::strerror(errno));
+  }
+  m_info.color_mode = color_mode;
+  m_info.glyph_mode = glyph_mode;
+  m_info.keyframe_interval = std::max<uint32_t>(keyframe_interval, 1);
+}
+
+AsciiRecorder::~AsciiRecorder() {
+  try {
+    close();
+  } catch (const std::exception&) {
+    // Nothing to report to from a destructor, the recording stays playable without its index
+  }
+}
+
+void AsciiRecorder::writeHeader() {
+  uint8_t header[RECORDING_HEADER_SIZE] = {};
+  std::memcpy(header, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+  put16(header + 8, RECORDING_VERSION);
+  header[10] = static_cast<uint8_t>(m_info.color_mode);
+  header[11] = static_cast<uint8_t>(m_info.glyph_mode);
+  put32(header + 12, static_cast<uint32_t>(m_info.width));
+  put32(header + 16, static_cast<uint32_t>(m_info.height));
+  put32(header + 20, m_info.keyframe_interval);
+  put32(header + 24, m_info.frame_count);
+  put32(header + 28, m_info.keyframe_count);
+  put64(header + 32, m_info.index_offset);
+  put64(header + 40, m_info.duration_us);
+  m_file.seekp(0);
+  m_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+void AsciiRecorder::fillColorPlane(const CellGrid& cells) {
+  size_t count = cells.cellCount();
+  if (m_info.color_mode == ColorMode::Truecolor) {
+    std::memcpy(m_plane.data(), cells.colors.data(), count * 3);
+    return;
+  }
+  const ColorCube& cube = colorCube(m_info.color_mode);
+  const uint8_t* rgb = cells.colors.data();
+  for (size_t i = 0; i < count; ++i, rgb += 3) {
+    m_plane[i] = cube.lookup(rgb[0], rgb[1], rgb[2]);
+  }
+}
+
+void AsciiRecorder::encodeKeyframe(const CellGrid& cells) {
+  m_payload.clear();
+  m_payload.insert(m_payload.end(), cells.glyphs.begin(), cells.glyphs.end());
+  m_payload.insert(m_payload.end(), m_plane.begin(), m_plane.end());
+}
+
+void AsciiRecorder::encodeDelta(const CellGrid& cells) {
+  const size_t count = cells.cellCount();
+  const size_t color_size = recordedColorSize(m_info.color_mode);
+  m_payload.clear();
+  size_t run_end = 0; // First cell after the previous run
+  size_t i = 0;
+  while (i < count) {
+    if (cells.glyphs[i] == m_glyphs[i] &&
+        std::memcmp(&m_plane[i * color_size], &m_colors[i * color_size], color_size) == 0) {
+      ++i;
+      continue;
+    }
+    size_t start = i;
+    while (i < count && (cells.glyphs[i] != m_glyphs[i] ||
+                         std::memcmp(&m_plane[i * color_size], &m_colors[i * color_size], color_size) != 0)) {
+      ++i;
+    }
+    putVarint(m_payload, start - run_end);
+    putVarint(m_payload, i - start);
+    m_payload.insert(m_payload.end(), cells.glyphs.begin() + start, cells.glyphs.begin() + i);
+    m_payload.insert(m_payload.end(), m_plane.begin() + start * color_size, m_plane.begin() + i * color_size);
+    run_end = i;
+  }
+}
+
+void AsciiRecorder::addFrame(const CellGrid& cells, std::chrono::steady_clock::time_point captured_at) {
+  if (!m_file.is_open()) {
+    throw std::runtime_error("Recording is closed");
+  }
+  const size_t count = cells.cellCount();
+  const size_t color_size = recordedColorSize(m_info.color_mode);
+  if (m_info.frame_count == 0) {
+    m_info.width = cells.width;
+    m_info.height = cells.height;
+    m_start = captured_at;
+    m_glyphs.resize(count);
+    m_colors.resize(count * color_size);
+    m_plane.resize(count * color_size);
+    m_payload.reserve(count * (1 + color_size));
+    writeHeader();
+    m_offset = m_bytes = RECORDING_HEADER_SIZE;
+  } else if (cells.width != m_info.width || cells.height != m_info.height) {
+    throw std::runtime_error("Recorded frames must keep the size of the first frame");
+  }
+
+  fillColorPlane(cells);
+  const size_t keyframe_size = count * (1 + color_size);
+  bool keyframe = m_info.frame_count % m_info.keyframe_interval == 0;
+  if (!keyframe) {
+    encodeDelta(cells);
+    keyframe = m_payload.size() >= keyframe_size;
+  }
+  if (keyframe) {
+    encodeKeyframe(cells);
+  }
+
+  uint64_t timestamp_us = static_cast<uint64_t>(std::max<int64_t>(
+    std::chrono::duration_cast<std::chrono::microseconds>(captured_at - m_start).count(), 0));
+  if (keyframe) {
+    m_index.push_back({ m_info.frame_count, m_offset, timestamp_us });
+  }
+  uint8_t frame_header[RECORDING_FRAME_HEADER_SIZE];
+  writeFrameHeader(frame_header, keyframe ? RecordedFrameType::Keyframe : RecordedFrameType::Delta,
+                   static_cast<uint32_t>(m_payload.size()), timestamp_us);
+  m_file.write(reinterpret_cast<const char*>(frame_header), sizeof(frame_header));
+  m_file.write(reinterpret_cast<const char*>(m_payload.data()), static_cast<std::streamsize>(m_payload.size()));
+  if (!m_file) {
+    throw std::runtime_error("Error writing recording");
+  }
+  m_offset += sizeof(frame_header) + m_payload.size();
+  m_bytes = m_offset;
+
+  std::memcpy(m_glyphs.data(), cells.glyphs.data(), count);
+  std::memcpy(m_colors.data(), m_plane.data(), m_plane.size());
+  m_info.frame_count++;
+  m_info.keyframe_count = static_cast<uint32_t>(m_index.size());
+  m_info.duration_us = std::max(m_info.duration_us, timestamp_us);
+}
+
+void AsciiRecorder::close() {
+  if (!m_file.is_open()) return;
+  if (m_info.frame_count == 0) {
+    m_offset = RECORDING_HEADER_SIZE;
+  }
+  m_info.index_offset = m_offset;
+  std::vector<uint8_t> index(m_index.size() * RECORDING_INDEX_ENTRY_SIZE, 0);
+  for (size_t i = 0; i < m_index.size(); ++i) {
+    uint8_t* p = index.data() + i * RECORDING_INDEX_ENTRY_SIZE;
+    put32(p, m_index[i].frame);
+    put64(p + 8, m_index[i].offset);
+    put64(p + 16, m_index[i].timestamp_us);
+  }
+  m_file.seekp(static_cast<std::streamoff>(m_offset));
+  m_file.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size()));
+  writeHeader();
+  m_bytes = m_offset + index.size();
+  bool ok = static_cast<bool>(m_file);
+  m_file.close();
+  if (!ok || !m_file) {
+    throw std::runtime_error("Error writing recording index");
+  }
+}
+
+
+AsciiPlayer::AsciiPlayer(const std::string& filename) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Error opening " + filename + ": " + std::strerror(errno));
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < RECORDING_HEADER_SIZE) {
+    ::close(fd);
+    throw std::runtime_error(filename + " is not a recording");
+  }
+  m_size = static_cast<size_t>(st.st_size);
+  void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Error mapping " + filename + ": " + std::strerror(errno));
+  }
+  m_data = static_cast<const uint8_t*>(data);
+  // Frames are read front to back, let the kernel read ahead
+  ::madvise(data, m_size, MADV_SEQUENTIAL);
+
+  try {
+    const uint8_t* h = m_data;
+    if (std::memcmp(h, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0) {
+      throw std::runtime_error(filename + " is not a recording");
+    }
+    if (get16(h + 8) != RECORDING_VERSION) {
+      throw std::runtime_error(filename + ": unsupported recording version " + std::to_string(get16(h + 8)));
+    }
+    if (h[10] > static_cast<uint8_t>(ColorMode::Ansi16) || h[11] > static_cast<uint8_t>(GlyphMode::Shape)) {
+      throw std::runtime_error("Corrupt recording: unknown color or glyph mode");
+    }
+    m_info.color_mode = static_cast<ColorMode>(h[10]);
+    m_info.glyph_mode = static_cast<GlyphMode>(h[11]);
+    uint32_t width = get32(h + 12), height = get32(h + 16);
+    if (width > 65535 || height > 65535) {
+      throw std::runtime_error("Corrupt recording: grid size");
+    }
+    m_info.width = static_cast<int>(width);
+    m_info.height = static_cast<int>(height);
+    m_info.keyframe_interval = get32(h + 20);
+    m_info.frame_count = get32(h + 24);
+    m_info.keyframe_count = get32(h + 28);
+    m_info.index_offset = get64(h + 32);
+    m_info.duration_us = get64(h + 40);
+
+    uint64_t index_size = static_cast<uint64_t>(m_info.keyframe_count) * RECORDING_INDEX_ENTRY_SIZE;
+    if (m_info.index_offset == 0) {
+      scanFrames(); // Never closed, e.g. the recorder was killed
+    } else if (m_info.index_offset < RECORDING_HEADER_SIZE || m_info.index_offset > m_size ||
+               index_size != m_size - m_info.index_offset) {
+      throw std::runtime_error("Corrupt recording: index");
+    } else {
+      m_index.resize(m_info.keyframe_count);
+      const uint8_t* p = m_data + m_info.index_offset;
+      for (RecordingKeyframe& entry : m_index) {
+        entry.frame = get32(p);
+        entry.offset = get64(p + 8);
+        entry.timestamp_us = get64(p + 16);
+        if (entry.offset + RECORDING_FRAME_HEADER_SIZE > m_info.index_offset) {
+          throw std::runtime_error("Corrupt recording: keyframe offset");
+        }
+        p += RECORDING_INDEX_ENTRY_SIZE;
+      }
+    }
+    if (m_info.frame_count > 0 && (m_index.empty() || m_index[0].frame != 0)) {
+      throw std::runtime_error("Corrupt recording: no leading keyframe");
+    }
+    if (m_info.frame_count > 0) {
+      // The first keyframe holds every cell, so the grid has to fit in the
+      // file before it is allocated, a corrupt header cannot ask for 4 G cells
+      uint64_t keyframe_size = static_cast<uint64_t>(width) * height * (1 + recordedColorSize(m_info.color_mode));
+      const uint8_t* first = m_data + m_index[0].offset;
+      if (get32(first + 4) != keyframe_size ||
+          m_index[0].offset + RECORDING_FRAME_HEADER_SIZE + keyframe_size > m_info.index_offset) {
+        throw std::runtime_error("Corrupt recording: grid size does not match the first keyframe");
+      }
+    }
+  } catch (...) {
+    ::munmap(const_cast<uint8_t*>(m_data), m_size);
+    throw;
+  }
+  if (m_info.frame_count > 0) {
+    m_cells.resize(m_info.width, m_info.height);
+  }
+  m_position = RECORDING_HEADER_SIZE;
+  if (m_info.color_mode != ColorMode::Truecolor) {
+    buildPalette();
+  }
+}
+
+AsciiPlayer::~AsciiPlayer() {
+  ::munmap(const_cast<uint8_t*>(m_data), m_size);
+}
+
+void AsciiPlayer::scanFrames() {
+  uint64_t position = RECORDING_HEADER_SIZE;
+  uint32_t frame = 0;
+  while (position + RECORDING_FRAME_HEADER_SIZE <= m_size) {
+    const uint8_t* p = m_data + position;
+    uint64_t end = position + RECORDING_FRAME_HEADER_SIZE + get32(p + 4);
+    if (end > m_size) break; // Cut off mid-frame
+    if (p[0] == static_cast<uint8_t>(RecordedFrameType::Keyframe)) {
+      m_index.push_back({ frame, position, get64(p + 8) });
+    } else if (p[0] != static_cast<uint8_t>(RecordedFrameType::Delta)) {
+      break;
+    }
+    m_info.duration_us = std::max(m_info.duration_us, get64(p + 8));
+    position = end;
+    ++frame;
+  }
+  m_info.frame_count = frame;
+  m_info.keyframe_count = static_cast<uint32_t>(m_index.size());
+  m_info.index_offset = position; // End of the playable frames
+}
+
+// Some palette colors sit in a cube cell that belongs to a neighbouring
+// entry (gray 88 is nearer to the cube's 95 at the cell center), so those
+// entries are decoded to the center of a cell that maps to them instead.
+// Either way the renderer turns the color back into the recorded index.
+void AsciiPlayer::buildPalette() {
+  const ColorCube& cube = colorCube(m_info.color_mode);
+  std::array<bool, 256> exact{};
+  for (int i = 0; i < 256; ++i) {
+    uint8_t* rgb = &m_palette[i * 3];
+    paletteColor(m_info.color_mode, static_cast<uint8_t>(i), rgb[0], rgb[1], rgb[2]);
+    exact[i] = cube.lookup(rgb[0], rgb[1], rgb[2]) == i;
+  }
+  const int STEP = 1 << (8 - ColorCube::BITS);
+  for (int r = STEP / 2; r < 256; r += STEP) {
+    for (int g = STEP / 2; g < 256; g += STEP) {
+      for (int b = STEP / 2; b < 256; b += STEP) {
+        uint8_t index = cube.lookup(static_cast<uint8_t>(r), static_cast<uint8_t>(g), static_cast<uint8_t>(b));
+        if (!exact[index]) {
+          m_palette[index * 3] = static_cast<uint8_t>(r);
+          m_palette[index * 3 + 1] = static_cast<uint8_t>(g);
+          m_palette[index * 3 + 2] = static_cast<uint8_t>(b);
+          exact[index] = true;
+        }
+      }
+    }
+  }
+}
+
+void AsciiPlayer::decodeColors(const uint8_t* plane, size_t first, size_t count) {
+  uint8_t* rgb = m_cells.colors.data() + first * 3;
+  if (m_info.color_mode == ColorMode::Truecolor) {
+    std::memcpy(rgb, plane, count * 3);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i, rgb += 3) {
+    std::memcpy(rgb, &m_palette[plane[i] * 3], 3);
+  }
+}
+
+bool AsciiPlayer::next() {
+  // index_offset is where the frames end, also for scanned recordings
+  if (m_next_frame >= m_info.frame_count ||
+      m_position + RECORDING_FRAME_HEADER_SIZE > m_info.index_offset) {
+    return false;
+  }
+  const uint8_t* header = m_data + m_position;
+  uint32_t payload_size = get32(header + 4);
+  const uint8_t* p = header + RECORDING_FRAME_HEADER_SIZE;
+  const uint8_t* end = p + payload_size;
+  if (m_position + RECORDING_FRAME_HEADER_SIZE + payload_size > m_info.index_offset) {
+    throw std::runtime_error("Corrupt recording: frame " + std::to_string(m_next_frame) + " overruns the file");
+  }
+
+  const size_t count = m_cells.cellCount();
+  const size_t color_size = recordedColorSize(m_info.color_mode);
+  if (header[0] == static_cast<uint8_t>(RecordedFrameType::Keyframe)) {
+    if (payload_size != count * (1 + color_size)) {
+      throw std::runtime_error("Corrupt recording: keyframe size");
+    }
+    std::memcpy(m_cells.glyphs.data(), p, count);
+    decodeColors(p + count, 0, count);
+    m_changed_cells = count;
+  } else if (header[0] == static_cast<uint8_t>(RecordedFrameType::Delta)) {
+    size_t cell = 0;
+    m_changed_cells = 0;
+    while (p < end) {
+      uint64_t skip = getVarint(p, end);
+      uint64_t length = getVarint(p, end);
+      if (skip > count - cell || length > count - cell - skip ||
+          length * (1 + color_size) > static_cast<uint64_t>(end - p)) {
+        throw std::runtime_error("Corrupt recording: run out of bounds in frame " + std::to_string(m_next_frame));
+      }
+      cell += skip;
+      std::memcpy(m_cells.glyphs.data() + cell, p, length);
+      decodeColors(p + length, cell, length);
+      p += length * (1 + color_size);
+      cell += length;
+      m_changed_cells += length;
+    }
+  } else {
+    throw std::runtime_error("Corrupt recording: unknown frame type");
+  }
+  m_timestamp_us = get64(header + 8);
+  m_position += RECORDING_FRAME_HEADER_SIZE + payload_size;
+  m_next_frame++;
+  return true;
+}
+
+void AsciiPlayer::seek(uint32_t frame) {
+  if (m_index.empty()) return;
+  // Last keyframe at or before the frame
+  auto it = std::upper_bound(m_index.begin(), m_index.end(), frame,
+                             [](uint32_t f, const RecordingKeyframe& k) { return f < k.frame; });
+  const RecordingKeyframe& keyframe = *(it - 1);
+  m_position = keyframe.offset;
+  m_next_frame = keyframe.frame;
+  while (m_next_frame < frame && next()) {
+  }
+}
+
+void AsciiPlayer::seekTime(uint64_t timestamp_us) {
+  if (m_index.empty()) return;
+  auto it = std::upper_bound(m_index.begin(), m_index.end(), timestamp_us,
+                             [](uint64_t t, const RecordingKeyframe& k) { return t < k.timestamp_us; });
+  if (it != m_index.begin()) --it;
+  m_position = it->offset;
+  m_next_frame = it->frame;
+  // Decode up to the first frame at or after the timestamp
+  while (m_next_frame < m_info.frame_count && m_position + RECORDING_FRAME_HEADER_SIZE <= m_info.index_offset &&
+         get64(m_data + m_position + 8) < timestamp_us && next()) {
+  }
+}
+
+
+void playRecording(const std::string& filename, double speed) {
+  AsciiPlayer player(filename);
+  const RecordingInfo& info = player.info();
+  DiffRenderer renderer(0.5, 0, info.color_mode);
+  std::unique_ptr<DenseRenderer> dense_renderer;
+  size_t buffer_size = DiffRenderer::bufferSize(info.width, info.height, info.color_mode);
+  if (info.glyph_mode != GlyphMode::Ascii) {
+    dense_renderer = std::make_unique<DenseRenderer>(info.glyph_mode);
+    buffer_size = DenseRenderer::bufferSize(info.glyph_mode, info.width, info.height);
+  }
+  RawImage text_buffer(static_cast<int>(buffer_size), 1, 1);
+
+  uint64_t bytes_written = 0;
+  auto start = std::chrono::steady_clock::now();
+  {
+    TerminalWriter writer(STDOUT_FILENO, WriteMode::Blocking);
+    while (player.next()) {
+      if (speed > 0) {
+        std::chrono::duration<double, std::micro> due(player.timestamp() / speed);
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(due));
+      }
+      RenderStats stats = dense_renderer ? dense_renderer->render(player.cells(), text_buffer)
+                                         : renderer.render(player.cells(), text_buffer);
+      writer.writeFrame(reinterpret_cast<const char*>(text_buffer.getData()), stats.bytes_written);
+      bytes_written += stats.bytes_written;
+    }
+    writer.flush();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "\033[0mPlayed " << info.frame_count << " frames (" << info.keyframe_count << " keyframes) of "
+            << info.width << "x" << info.height << " in " << elapsed.count() << " s | " << bytes_written
+            << " bytes of terminal output from a " << std::filesystem::file_size(filename) << " byte recording"
+            << std::endl;
+}
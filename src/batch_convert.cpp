@@ -0,0 +1,213 @@
+#include "batch_convert.hpp"
+#include "ascii_image.hpp"
+#include "cell_sampler.hpp"
+#include "frame_source.hpp"
+#include "raw_image.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+
+std::vector<std::string> listBatchDirectory(const std::string& directory) {
+  if (!std::filesystem::is_directory(directory)) {
+    throw std::runtime_error(directory + " is not a directory");
+  }
+  return ImageSequenceSource::listDirectory(directory);
+}
+
+std::vector<std::string> readBatchList(const std::string& list_file) {
+  std::ifstream list(list_file);
+  if (!list) {
+    throw std::runtime_error("Error opening " + list_file);
+  }
+  std::vector<std::string> files;
+  std::string line;
+  while (std::getline(list, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty() || line[0] == '#') continue;
+    files.push_back(line);
+  }
+  return files;
+}
+
+
+// Everything a worker reuses from one file to the next
+struct BatchWorker
+{
+  RawImage text{0, 0, 0};
+  CellGrid cells;
+  CellSampler sampler;
+
+  char* reserve(size_t size) {
+    if (text.getSize() < size) text = RawImage(static_cast<int>(size), 1, 1);
+    return reinterpret_cast<char*>(text.getData());
+  }
+};
+
+static uint64_t elapsedNs(std::chrono::steady_clock::time_point since) {
+  return static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count());
+}
+
+// Converts the image into the worker's text buffer, returns the text size
+static size_t convertImage(const RawImageView& view, const BatchConfig& config, BatchWorker& worker) {
+  if (config.columns > 0) {
+    worker.sampler.sample(view, PixelFormat::RGB24, config.columns, worker.cells);
+    const CellGrid& cells = worker.cells;
+    if (config.color) {
+      // The converter computes the same glyphs again from the cell colors
+      worker.reserve(coloredAsciiBufferSize(cells.width, cells.height, config.color_mode));
+      return convertToColoredAscii(RawImageView(cells.colors.data(), cells.width, cells.height, 3), worker.text,
+                                   config.color_mode);
+    }
+    char* out = worker.reserve(static_cast<size_t>(cells.width + 1) * cells.height + 1);
+    for (int row = 0; row < cells.height; ++row) {
+      std::memcpy(out, cells.glyphs.data() + static_cast<size_t>(row) * cells.width, cells.width);
+      out += cells.width;
+      *out++ = '\n';
+    }
+    *out = '\0';
+    return static_cast<size_t>(cells.width + 1) * cells.height;
+  }
+  if (config.color) {
+    worker.reserve(coloredAsciiBufferSize(view.getWidth(), view.getHeight(), config.color_mode));
+    return convertToColoredAscii(view, worker.text, config.color_mode);
+  }
+  worker.reserve(static_cast<size_t>(view.getWidth() + 1) * view.getHeight() + 1);
+  return convertToAscii(view, worker.text);
+}
+
+static void convertFile(const BatchConfig& config, BatchWorker& worker, BatchFileResult& result) {
+  std::error_code error;
+  result.input_bytes = std::filesystem::file_size(result.path, error);
+  if (error) result.input_bytes = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  RawImage image(result.path.c_str(), 3); // Always RGB, whatever the file stores
+  result.decode_ns = elapsedNs(start);
+  result.width = image.getWidth();
+  result.height = image.getHeight();
+
+  start = std::chrono::steady_clock::now();
+  size_t size = convertImage(image, config, worker);
+  result.convert_ns = elapsedNs(start);
+
+  if (!config.output_directory.empty()) {
+    start = std::chrono::steady_clock::now();
+    outputAsciiToFile(reinterpret_cast<const char*>(worker.text.getData()), size,
+                      (std::filesystem::path(config.output_directory) / result.output_name).string().c_str());
+    result.write_ns = elapsedNs(start);
+  }
+  result.output_bytes = size;
+  result.ok = true;
+}
+
+// Names every output after its input path relative to the inputs' common
+// directory. Two entries naming the same file would race on one output, the
+// later one is failed up front instead.
+static void assignOutputNames(std::vector<BatchFileResult>& files) {
+  std::vector<std::filesystem::path> paths;
+  for (const BatchFileResult& file : files) {
+    paths.push_back(std::filesystem::absolute(file.path).lexically_normal());
+  }
+  std::filesystem::path root;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    std::filesystem::path parent = paths[i].parent_path();
+    if (i == 0) {
+      root = parent;
+      continue;
+    }
+    std::filesystem::path common;
+    auto a = root.begin(), b = parent.begin();
+    for (; a != root.end() && b != parent.end() && *a == *b; ++a, ++b) common /= *a;
+    root = common;
+  }
+  std::map<std::string, size_t> seen;
+  for (size_t i = 0; i < files.size(); ++i) {
+    files[i].output_name = paths[i].lexically_relative(root).string() + ".txt";
+    auto [first, inserted] = seen.emplace(files[i].output_name, i);
+    if (!inserted) files[i].error = "Same file as " + files[first->second].path;
+  }
+}
+
+BatchStats convertBatch(const std::vector<std::string>& files, const BatchConfig& config, ThreadPool& pool) {
+  if (!config.output_directory.empty()) {
+    std::filesystem::create_directories(config.output_directory);
+  }
+  BatchStats stats;
+  stats.files.resize(files.size());
+  for (size_t i = 0; i < files.size(); ++i) stats.files[i].path = files[i];
+  assignOutputNames(stats.files);
+  if (!config.output_directory.empty()) {
+    for (const BatchFileResult& result : stats.files) {
+      std::filesystem::path parent = std::filesystem::path(result.output_name).parent_path();
+      if (!parent.empty()) std::filesystem::create_directories(std::filesystem::path(config.output_directory) / parent);
+    }
+  }
+  stats.workers = config.workers ? std::min(config.workers, pool.threadCount()) : pool.threadCount();
+  stats.workers = std::max<size_t>(1, std::min(stats.workers, files.size()));
+
+  std::vector<BatchWorker> workers(stats.workers);
+  std::atomic<size_t> next{0};
+  auto start = std::chrono::steady_clock::now();
+  pool.parallelFor(stats.workers, [&](size_t w) {
+    size_t i;
+    while ((i = next.fetch_add(1)) < files.size()) {
+      BatchFileResult& result = stats.files[i];
+      result.worker = w;
+      if (!result.error.empty()) continue;
+      try {
+        convertFile(config, workers[w], result);
+      } catch (const std::exception& e) {
+        result.ok = false;
+        result.error = e.what();
+      }
+    }
+  });
+  stats.wall_ns = elapsedNs(start);
+
+  for (const BatchFileResult& result : stats.files) {
+    if (!result.ok) {
+      stats.failed++;
+      continue;
+    }
+    stats.converted++;
+    stats.input_bytes += result.input_bytes;
+    stats.pixels += static_cast<uint64_t>(result.width) * result.height;
+    stats.output_bytes += result.output_bytes;
+  }
+  return stats;
+}
+
+void writeBatchReport(const BatchStats& stats, std::ostream& out, bool per_file) {
+  std::ios_base::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3);
+  out << "Converted " << stats.converted << " of " << stats.files.size() << " files in " << stats.wall_ns / 1e9
+      << " s on " << stats.workers << " workers: " << std::setprecision(1) << stats.imagesPerSecond()
+      << " images/s, " << stats.megabytesPerSecond() << " MB/s in, " << stats.pixels / 1e6 << " Mpixels, "
+      << stats.output_bytes / 1e6 << " MB out";
+  if (stats.failed) out << ", " << stats.failed << " failed";
+  out << "\n";
+  if (per_file) {
+    out << std::setprecision(2);
+    for (const BatchFileResult& result : stats.files) {
+      out << "  " << result.path;
+      if (!result.ok) {
+        out << "  FAILED: " << result.error << "\n";
+        continue;
+      }
+      out << "  " << result.width << "x" << result.height << "  decode " << result.decode_ns / 1e6 << " ms  convert "
+          << result.convert_ns / 1e6 << " ms  write " << result.write_ns / 1e6 << " ms  " << result.output_bytes
+          << " bytes  worker " << result.worker << "\n";
+    }
+  }
+  out.flags(flags);
+  out.precision(precision);
+}
@@ -0,0 +1,52 @@
+#include "buffer_pool.hpp"
+#include <cstdlib>
+
+
+BufferPool::BufferPool(size_t buffer_size, size_t buffer_count)
+: m_buffer_size(buffer_size), m_buffer_count(buffer_count),
+  m_storage(new uint8_t[buffer_size * buffer_count]), m_in_use(buffer_count, false) {
+  // Reserved up front, release() must not allocate either
+  m_free.reserve(buffer_count);
+  for (size_t i = buffer_count; i-- > 0;) {
+    m_free.push_back(m_storage.get() + i * buffer_size);
+  }
+}
+
+uint8_t* BufferPool::acquire(size_t size) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (size > m_buffer_size || m_free.empty()) {
+    m_misses++;
+    return nullptr;
+  }
+  uint8_t* buffer = m_free.back();
+  m_free.pop_back();
+  m_in_use[(buffer - m_storage.get()) / m_buffer_size] = true;
+  return buffer;
+}
+
+void BufferPool::release(uint8_t* buffer) noexcept {
+  // Reached from ~RawImage, which must not throw. Freeing a foreign buffer or
+  // handing one buffer out twice would corrupt memory, so stop here instead.
+  if (!owns(buffer)) std::abort();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  size_t index = (buffer - m_storage.get()) / m_buffer_size;
+  if (!m_in_use[index]) std::abort();
+  m_in_use[index] = false;
+  m_free.push_back(buffer);
+}
+
+bool BufferPool::owns(const uint8_t* buffer) const {
+  const uint8_t* begin = m_storage.get();
+  return buffer >= begin && buffer < begin + m_buffer_size * m_buffer_count &&
+         (buffer - begin) % m_buffer_size == 0;
+}
+
+size_t BufferPool::available() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_free.size();
+}
+
+size_t BufferPool::misses() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_misses;
+}
@@ -0,0 +1,254 @@
+#include "cell_sampler.hpp"
+#include "ascii_kernels.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+
+// 257 * 255 is the most a 16-bit sum can take
+static const int MAX_ROWS_PER_PASS = 257;
+
+int cellRowsFor(int source_width, int source_height, int columns, float aspect_correction) {
+  // Same formula as the resize in the streaming loops
+  int rows = static_cast<int>(source_height * (static_cast<float>(columns) / source_width * aspect_correction));
+  return std::max(1, std::min(rows, source_height));
+}
+
+void CellSampler::prepareColumns(int source_width, int columns, int channels) {
+  if (source_width == m_source_width && columns == m_columns && channels == m_channels) return;
+  m_source_width = source_width;
+  m_columns = columns;
+  m_channels = channels;
+  m_column_start.resize(columns + 1);
+  for (int c = 0; c <= columns; ++c) {
+    m_column_start[c] = cellStart(source_width, columns, c);
+  }
+  m_sums.resize(static_cast<size_t>(columns) * 3);
+  m_vertical.resize(static_cast<size_t>(source_width) * channels);
+}
+
+static void checkSource(const RawImageView& source, int columns) {
+  if (source.getChannels() != 3 && source.getChannels() != 1) {
+    throw std::runtime_error("Cell sampling needs 3 channel or gray pixels");
+  }
+  if (source.getWidth() <= 0 || source.getHeight() <= 0 || columns <= 0) {
+    throw std::runtime_error("Cell sampling needs a non-empty source and grid");
+  }
+}
+
+void CellSampler::sample(const RawImageView& source, PixelFormat format, int columns, CellGrid& cells,
+                         float aspect_correction) {
+  checkSource(source, columns);
+  int source_width = source.getWidth();
+  int source_height = source.getHeight();
+  columns = std::min(columns, source_width);
+  int rows = cellRowsFor(source_width, source_height, columns, aspect_correction);
+  cells.resize(columns, rows);
+  for (int row = 0; row < rows; ++row) {
+    int y_begin = cellStart(source_height, rows, row);
+    int y_end = cellStart(source_height, rows, row + 1);
+    beginRow(source_width, source.getChannels(), columns);
+    addRows(source.rows(y_begin, y_end));
+    finishRow(format, cells.colors.data() + static_cast<size_t>(row) * columns * 3,
+              cells.glyphs.data() + static_cast<size_t>(row) * columns);
+  }
+}
+
+void CellSampler::sampleRegion(const RawImageView& source, PixelFormat format, CellGrid& cells, int column_begin,
+                               int column_end, int row_begin, int row_end) {
+  checkSource(source, cells.width);
+  if (column_begin < 0 || column_end > cells.width || column_begin >= column_end || row_begin < 0 ||
+      row_end > cells.height || row_begin >= row_end || cells.width > source.getWidth()) {
+    throw std::runtime_error("Cell region is outside the grid");
+  }
+  int columns = cells.width;
+  int source_height = source.getHeight();
+  prepareColumns(source.getWidth(), columns, source.getChannels());
+  for (int row = row_begin; row < row_end; ++row) {
+    int y_begin = cellStart(source_height, cells.height, row);
+    int y_end = cellStart(source_height, cells.height, row + 1);
+    std::fill(m_sums.begin() + column_begin * 3, m_sums.begin() + column_end * 3, 0);
+    m_row_height = 0;
+    addColumns(source.rows(y_begin, y_end), column_begin, column_end);
+    finishColumns(format, cells.colors.data() + static_cast<size_t>(row) * columns * 3,
+                  cells.glyphs.data() + static_cast<size_t>(row) * columns, column_begin, column_end);
+  }
+}
+
+// Adds `rows` rows of `samples` samples, `step` bytes apart, into the 16-bit
+// vertical sums in chunks that cannot overflow, then each chunk's
+// [begin[c], end[c]) range into sums[c * 3]
+static void addPlane(const uint8_t* row, size_t stride, int rows, int samples, int step, const int* begin,
+                     const int* end, int columns, uint16_t* vertical, uint64_t* sums) {
+  for (int chunk = 0; chunk < rows; chunk += MAX_ROWS_PER_PASS) {
+    int chunk_end = std::min(rows, chunk + MAX_ROWS_PER_PASS);
+    std::memset(vertical, 0, static_cast<size_t>(samples) * sizeof(uint16_t));
+    for (int y = chunk; y < chunk_end; ++y, row += stride) {
+      if (step == 1) {
+        for (int i = 0; i < samples; ++i) vertical[i] += row[i];
+      } else {
+        for (int i = 0; i < samples; ++i) vertical[i] += row[i * step];
+      }
+    }
+    for (int c = 0; c < columns; ++c) {
+      uint64_t s = 0;
+      for (int i = begin[c]; i < end[c]; ++i) s += vertical[i];
+      sums[c * 3] += s;
+    }
+  }
+}
+
+void CellSampler::sample(const YuvImageView& source, int columns, CellGrid& cells, float aspect_correction) {
+  int source_width = source.getWidth();
+  int source_height = source.getHeight();
+  if (source_width <= 0 || source_height <= 0 || columns <= 0) {
+    throw std::runtime_error("Cell sampling needs a non-empty source and grid");
+  }
+  columns = std::min(columns, source_width);
+  int rows = cellRowsFor(source_width, source_height, columns, aspect_correction);
+  cells.resize(columns, rows);
+  prepareColumns(source_width, columns, 1);
+
+  // A cell takes every chroma sample that covers one of its pixels
+  int chroma_width = source.chromaWidth();
+  int shift = source.chromaShift();
+  m_chroma_begin.resize(columns);
+  m_chroma_end.resize(columns);
+  for (int c = 0; c < columns; ++c) {
+    m_chroma_begin[c] = m_column_start[c] / 2;
+    m_chroma_end[c] = (m_column_start[c + 1] + 1) / 2;
+  }
+  m_chroma_vertical.resize(chroma_width);
+
+  const int* column_start = m_column_start.data();
+  uint64_t* sums = m_sums.data();
+  for (int row = 0; row < rows; ++row) {
+    int y_begin = cellStart(source_height, rows, row);
+    int y_end = cellStart(source_height, rows, row + 1);
+    int chroma_begin = y_begin >> shift;
+    int chroma_end = ((y_end - 1) >> shift) + 1;
+    std::fill(m_sums.begin(), m_sums.end(), 0);
+    addPlane(source.lumaRow(y_begin), source.lumaStride(), y_end - y_begin, source_width,
+             source.lumaStep(), column_start, column_start + 1, columns, m_vertical.data(), sums);
+    size_t chroma_stride = source.chromaStride();
+    addPlane(source.uRow(chroma_begin), chroma_stride, chroma_end - chroma_begin, chroma_width, source.chromaStep(),
+             m_chroma_begin.data(), m_chroma_end.data(), columns, m_chroma_vertical.data(), sums + 1);
+    addPlane(source.vRow(chroma_begin), chroma_stride, chroma_end - chroma_begin, chroma_width, source.chromaStep(),
+             m_chroma_begin.data(), m_chroma_end.data(), columns, m_chroma_vertical.data(), sums + 2);
+
+    uint8_t* color = cells.colors.data() + static_cast<size_t>(row) * columns * 3;
+    char* glyph = cells.glyphs.data() + static_cast<size_t>(row) * columns;
+    for (int c = 0; c < columns; ++c, color += 3) {
+      uint64_t count = static_cast<uint64_t>(y_end - y_begin) * (column_start[c + 1] - column_start[c]);
+      uint64_t chroma_count = static_cast<uint64_t>(chroma_end - chroma_begin) * (m_chroma_end[c] - m_chroma_begin[c]);
+      int luma = static_cast<int>((sums[c * 3] + count / 2) / count);
+      int u = static_cast<int>((sums[c * 3 + 1] + chroma_count / 2) / chroma_count);
+      int v = static_cast<int>((sums[c * 3 + 2] + chroma_count / 2) / chroma_count);
+      yuvToRgb(luma, u, v, color[0], color[1], color[2]);
+      glyph[c] = YUV_GLYPH_TABLE[luma];
+    }
+  }
+}
+
+void CellSampler::beginRow(int source_width, int channels, int columns) {
+  checkSource(RawImageView(nullptr, source_width, 1, channels), columns);
+  if (columns > source_width) {
+    throw std::runtime_error("Cell row is wider than its source");
+  }
+  prepareColumns(source_width, columns, channels);
+  std::fill(m_sums.begin(), m_sums.end(), 0);
+  m_row_height = 0;
+}
+
+void CellSampler::addRows(const RawImageView& band) {
+  if (band.getWidth() != m_source_width || band.getChannels() != m_channels) {
+    throw std::runtime_error("Rows do not match the cell row being sampled");
+  }
+  addColumns(band, 0, m_columns);
+}
+
+void CellSampler::addColumns(const RawImageView& band, int column_begin, int column_end) {
+  int channels = m_channels;
+  const int* column_start = m_column_start.data();
+  size_t first_byte = static_cast<size_t>(column_start[column_begin]) * channels;
+  size_t row_bytes = static_cast<size_t>(column_start[column_end]) * channels - first_byte;
+  uint64_t* sums = m_sums.data();
+
+  // Vertical pass: add the band's source rows into 16-bit column sums. Each
+  // source byte is read once, in order, and the loop vectorizes. Chunks of at
+  // most MAX_ROWS_PER_PASS rows keep the sums from overflowing.
+  int height = band.getHeight();
+  for (int chunk = 0; chunk < height; chunk += MAX_ROWS_PER_PASS) {
+    int chunk_end = std::min(height, chunk + MAX_ROWS_PER_PASS);
+    // Indexed by source byte, only this region's bytes are touched
+    uint16_t* vertical = m_vertical.data();
+    std::memset(vertical + first_byte, 0, row_bytes * sizeof(uint16_t));
+    for (int y = chunk; y < chunk_end; ++y) {
+      const uint8_t* row_data = band.getRow(y) + first_byte;
+      uint16_t* sum = vertical + first_byte;
+      for (size_t i = 0; i < row_bytes; ++i) sum[i] += row_data[i];
+    }
+
+    // Horizontal pass over the much smaller column sums
+    const uint16_t* p = vertical + first_byte;
+    if (channels == 1) {
+      for (int c = column_begin; c < column_end; ++c) {
+        uint64_t s = 0;
+        const uint16_t* end = vertical + column_start[c + 1];
+        for (; p < end; ++p) s += *p;
+        sums[c * 3] += s;
+      }
+      continue;
+    }
+    for (int c = column_begin; c < column_end; ++c) {
+      uint64_t s0 = 0, s1 = 0, s2 = 0;
+      const uint16_t* end = vertical + column_start[c + 1] * 3;
+      for (; p < end; p += 3) {
+        s0 += p[0];
+        s1 += p[1];
+        s2 += p[2];
+      }
+      sums[c * 3] += s0;
+      sums[c * 3 + 1] += s1;
+      sums[c * 3 + 2] += s2;
+    }
+  }
+  m_row_height += height;
+}
+
+void CellSampler::finishRow(PixelFormat format, uint8_t* colors, char* glyphs) {
+  finishColumns(format, colors, glyphs, 0, m_columns);
+}
+
+void CellSampler::finishColumns(PixelFormat format, uint8_t* colors, char* glyphs, int column_begin,
+                                int column_end) {
+  if (m_row_height == 0) {
+    throw std::runtime_error("Cell row has no source rows");
+  }
+  // Channel order of the sums, so the colors come out as RGB
+  int r_index = format == PixelFormat::BGR24 ? 2 : 0;
+  int b_index = 2 - r_index;
+  const int* column_start = m_column_start.data();
+  const uint64_t* sums = m_sums.data();
+  uint8_t* color = colors + static_cast<size_t>(column_begin) * 3;
+  for (int c = column_begin; c < column_end; ++c, color += 3) {
+    uint64_t count = m_row_height * static_cast<uint64_t>(column_start[c + 1] - column_start[c]);
+    if (m_channels == 1) {
+      // Gray cells are gray colors, the glyph comes out of the same weights
+      color[0] = color[1] = color[2] = static_cast<uint8_t>((sums[c * 3] + count / 2) / count);
+      continue;
+    }
+    color[0] = static_cast<uint8_t>((sums[c * 3 + r_index] + count / 2) / count);
+    color[1] = static_cast<uint8_t>((sums[c * 3 + 1] + count / 2) / count);
+    color[2] = static_cast<uint8_t>((sums[c * 3 + b_index] + count / 2) / count);
+  }
+  // The colors are packed RGB, the row kernels read them directly
+  convertRowToAscii(colors + static_cast<size_t>(column_begin) * 3, column_end - column_begin, glyphs + column_begin);
+}
+
+size_t CellSampler::scratchBytes() const {
+  return m_column_start.capacity() * sizeof(int) + m_sums.capacity() * sizeof(uint64_t) +
+         m_vertical.capacity() * sizeof(uint16_t) +
+         (m_chroma_begin.capacity() + m_chroma_end.capacity()) * sizeof(int) +
+         m_chroma_vertical.capacity() * sizeof(uint16_t);
+}
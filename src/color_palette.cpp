@@ -0,0 +1,135 @@
+#include "color_palette.hpp"
+#include <stdexcept>
+#include <climits>
+#include <cstdlib>
+
+// xterm defaults for the 16 ANSI colors
+static const uint8_t ANSI16_COLORS[16][3] = {
+  { 0, 0, 0 },       { 205, 0, 0 },   { 0, 205, 0 },   { 205, 205, 0 },
+  { 0, 0, 238 },     { 205, 0, 205 }, { 0, 205, 205 }, { 229, 229, 229 },
+  { 127, 127, 127 }, { 255, 0, 0 },   { 0, 255, 0 },   { 255, 255, 0 },
+  { 92, 92, 255 },   { 255, 0, 255 }, { 0, 255, 255 }, { 255, 255, 255 },
+};
+
+// Channel levels of the 6x6x6 cube (16-231), the gray ramp (232-255) is 8 + 10 * i
+static const uint8_t CUBE_LEVELS[6] = { 0, 95, 135, 175, 215, 255 };
+static const int CUBE_START = 16;
+static const int GRAY_START = 232;
+
+// Weighted squared distance, green counts most and blue least, like the eye
+static int colorDistance(int r1, int g1, int b1, int r2, int g2, int b2) {
+  int dr = r1 - r2, dg = g1 - g2, db = b1 - b2;
+  return 3 * dr * dr + 4 * dg * dg + 2 * db * db;
+}
+
+static int nearestCubeLevel(int value) {
+  int best = 0;
+  for (int i = 1; i < 6; ++i) {
+    if (std::abs(value - CUBE_LEVELS[i]) < std::abs(value - CUBE_LEVELS[best])) best = i;
+  }
+  return best;
+}
+
+// The distance is a weighted sum over channels, so the nearest point of the
+// 6x6x6 cube is the nearest level on each channel. Only the 24 grays need a search.
+static uint8_t nearestXterm256(int r, int g, int b) {
+  int ri = nearestCubeLevel(r), gi = nearestCubeLevel(g), bi = nearestCubeLevel(b);
+  int best = CUBE_START + 36 * ri + 6 * gi + bi;
+  int best_distance = colorDistance(r, g, b, CUBE_LEVELS[ri], CUBE_LEVELS[gi], CUBE_LEVELS[bi]);
+  for (int i = 0; i < 24; ++i) {
+    int gray = 8 + 10 * i;
+    int distance = colorDistance(r, g, b, gray, gray, gray);
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = GRAY_START + i;
+    }
+  }
+  return static_cast<uint8_t>(best);
+}
+
+static uint8_t nearestAnsi16(int r, int g, int b) {
+  int best = 0, best_distance = INT_MAX;
+  for (int i = 0; i < 16; ++i) {
+    int distance = colorDistance(r, g, b, ANSI16_COLORS[i][0], ANSI16_COLORS[i][1], ANSI16_COLORS[i][2]);
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = i;
+    }
+  }
+  return static_cast<uint8_t>(best);
+}
+
+
+ColorCube::ColorCube(ColorMode mode) {
+  if (mode == ColorMode::Truecolor) {
+    throw std::runtime_error("Truecolor output has no palette");
+  }
+  // Each cell covers 8 values per channel, its center stands for all of them
+  const int STEP = 1 << (8 - BITS);
+  for (int r = 0; r < (1 << BITS); ++r) {
+    for (int g = 0; g < (1 << BITS); ++g) {
+      for (int b = 0; b < (1 << BITS); ++b) {
+        int cr = r * STEP + STEP / 2, cg = g * STEP + STEP / 2, cb = b * STEP + STEP / 2;
+        m_index[(static_cast<size_t>(r) << (2 * BITS)) | (g << BITS) | b] =
+          mode == ColorMode::Ansi16 ? nearestAnsi16(cr, cg, cb) : nearestXterm256(cr, cg, cb);
+      }
+    }
+  }
+}
+
+const ColorCube& colorCube(ColorMode mode) {
+  static const ColorCube xterm256(ColorMode::Xterm256);
+  static const ColorCube ansi16(ColorMode::Ansi16);
+  switch (mode) {
+    case ColorMode::Xterm256: return xterm256;
+    case ColorMode::Ansi16: return ansi16;
+    default: throw std::runtime_error("Truecolor output has no palette");
+  }
+}
+
+void paletteColor(ColorMode mode, uint8_t index, uint8_t& r, uint8_t& g, uint8_t& b) {
+  if (mode == ColorMode::Ansi16 || index < CUBE_START) {
+    const uint8_t* c = ANSI16_COLORS[index & 15];
+    r = c[0];
+    g = c[1];
+    b = c[2];
+  } else if (index < GRAY_START) {
+    int i = index - CUBE_START;
+    r = CUBE_LEVELS[i / 36];
+    g = CUBE_LEVELS[(i / 6) % 6];
+    b = CUBE_LEVELS[i % 6];
+  } else {
+    r = g = b = static_cast<uint8_t>(8 + 10 * (index - GRAY_START));
+  }
+}
+
+uint8_t nearestPaletteIndex(ColorMode mode, uint8_t r, uint8_t g, uint8_t b) {
+  int first = mode == ColorMode::Ansi16 ? 0 : CUBE_START;
+  int last = mode == ColorMode::Ansi16 ? 15 : 255;
+  int best = first, best_distance = INT_MAX;
+  for (int i = first; i <= last; ++i) {
+    uint8_t pr, pg, pb;
+    paletteColor(mode, static_cast<uint8_t>(i), pr, pg, pb);
+    int distance = colorDistance(r, g, b, pr, pg, pb);
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = i;
+    }
+  }
+  return static_cast<uint8_t>(best);
+}
+
+ColorMode parseColorMode(const std::string& name) {
+  if (name == "truecolor" || name == "24bit") return ColorMode::Truecolor;
+  if (name == "256") return ColorMode::Xterm256;
+  if (name == "16") return ColorMode::Ansi16;
+  throw std::runtime_error("Unknown color mode: " + name + " (truecolor, 256 or 16)");
+}
+
+const char* colorModeName(ColorMode mode) {
+  switch (mode) {
+    case ColorMode::Xterm256: return "256";
+    case ColorMode::Ansi16: return "16";
+    default: return "truecolor";
+  }
+}
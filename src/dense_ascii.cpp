@@ -0,0 +1,417 @@
+#include "dense_ascii.hpp"
+#include "ansi_emitter.hpp"
+#include "pixel_layout.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DENSE_ASCII_X86 1
+#include <immintrin.h>
+#endif
+
+// Upper half block U+2580
+static const char HALF_BLOCK[UNICODE_GLYPH_SIZE] = { '\xE2', '\x96', '\x80' };
+
+// Bit of the dot in column c (0-1) and row r (0-3), in Unicode dot order:
+// dots 1-3 and 4-6 run down the columns, 7 and 8 are the bottom row
+static const uint8_t BRAILLE_BITS[4][2] = { { 0x01, 0x08 }, { 0x02, 0x10 }, { 0x04, 0x20 }, { 0x40, 0x80 } };
+
+// Dots lit for 0..8 levels of brightness in flat cells, an ordered dither
+// that spreads each new dot away from the ones already lit
+struct BrailleDither
+{
+  uint8_t patterns[16] = {};
+  BrailleDither() {
+    static const int RANK[4][2] = { { 0, 4 }, { 6, 2 }, { 1, 5 }, { 7, 3 } };
+    for (int level = 0; level <= 8; ++level) {
+      for (int r = 0; r < 4; ++r) {
+        for (int c = 0; c < 2; ++c) {
+          if (RANK[r][c] < level) patterns[level] |= BRAILLE_BITS[r][c];
+        }
+      }
+    }
+  }
+};
+static const BrailleDither BRAILLE_DITHER;
+
+
+GlyphMode parseGlyphMode(const std::string& name) {
+  if (name == "ascii") return GlyphMode::Ascii;
+  if (name == "half" || name == "halfblock") return GlyphMode::HalfBlock;
+  if (name == "braille") return GlyphMode::Braille;
+  if (name == "shape") return GlyphMode::Shape;
+  throw std::runtime_error("Unknown glyph mode: " + name + " (ascii, half, braille or shape)");
+}
+
+const char* glyphModeName(GlyphMode mode) {
+  switch (mode) {
+    case GlyphMode::HalfBlock: return "half";
+    case GlyphMode::Braille: return "braille";
+    case GlyphMode::Shape: return "shape";
+    default: return "ascii";
+  }
+}
+
+
+size_t halfBlockBufferSize(int width, int height) {
+  size_t rows = static_cast<size_t>(height + 1) / 2;
+  return rows * (static_cast<size_t>(width) * (HALF_BLOCK_SGR_MAX_SIZE + UNICODE_GLYPH_SIZE) + COLOR_RESET_SIZE + 1) + 1;
+}
+
+static bool withinTolerance(const uint8_t* a, const uint8_t* b, int tolerance) {
+  return std::abs(a[0] - b[0]) <= tolerance && std::abs(a[1] - b[1]) <= tolerance && std::abs(a[2] - b[2]) <= tolerance;
+}
+
+// \033[38;2;r;g;b;48;2;r;g;bm, both colors in one sequence
+static char* writeHalfBlockSgr(char* p, const uint8_t* fg, const uint8_t* bg) {
+  p = writeTruecolorSgr(p, fg[0], fg[1], fg[2]);
+  p[-1] = ';';
+  std::memcpy(p, "48;2;", 5);
+  p += 5;
+  for (int c = 0; c < 3; ++c) {
+    std::memcpy(p, DECIMAL_TABLE.text[bg[c]], 4);
+    p += DECIMAL_TABLE.len[bg[c]];
+  }
+  p[-1] = 'm';
+  return p;
+}
+
+// Writes the half-block text and a NUL, returns the end of the text
+static char* writeHalfBlockText(const RawImageView& img, char* p, int color_tolerance) {
+  int width = img.getWidth();
+  int height = img.getHeight();
+  for (int y = 0; y < height; y += 2) {
+    const uint8_t* top = img.getRow(y);
+    // An odd last row repeats its top pixels
+    const uint8_t* bottom = img.getRow(std::min(y + 1, height - 1));
+    // Every row starts from the terminal defaults
+    bool has_fg = false, has_bg = false;
+    uint8_t fg[3] = {}, bg[3] = {};
+    for (int x = 0; x < width; ++x, top += 3, bottom += 3) {
+      if (withinTolerance(top, bottom, color_tolerance)) {
+        // Both halves look the same, a space on the background color is enough
+        if (!has_bg || !withinTolerance(bg, top, color_tolerance) || !withinTolerance(bg, bottom, color_tolerance)) {
+          p = writeTruecolorBackgroundSgr(p, top[0], top[1], top[2]);
+          std::memcpy(bg, top, 3);
+          has_bg = true;
+        }
+        *p++ = ' ';
+        continue;
+      }
+      bool fg_ok = has_fg && withinTolerance(fg, top, color_tolerance);
+      bool bg_ok = has_bg && withinTolerance(bg, bottom, color_tolerance);
+      if (!fg_ok && !bg_ok) {
+        p = writeHalfBlockSgr(p, top, bottom);
+      } else if (!fg_ok) {
+        p = writeTruecolorSgr(p, top[0], top[1], top[2]);
+      } else if (!bg_ok) {
+        p = writeTruecolorBackgroundSgr(p, bottom[0], bottom[1], bottom[2]);
+      }
+      if (!fg_ok) std::memcpy(fg, top, 3);
+      if (!bg_ok) std::memcpy(bg, bottom, 3);
+      has_fg = has_bg = true;
+      std::memcpy(p, HALF_BLOCK, UNICODE_GLYPH_SIZE);
+      p += UNICODE_GLYPH_SIZE;
+    }
+    std::memcpy(p, "\033[0m\n", COLOR_RESET_SIZE + 1);
+    p += COLOR_RESET_SIZE + 1;
+  }
+  *p = '\0';
+  return p;
+}
+
+size_t convertToHalfBlockAscii(const RawImageView& img, RawImage& target, int color_tolerance) {
+  if (img.getChannels() != 3) {
+    // The dense modes read two or eight pixels per cell, one RGB copy up front
+    // keeps their inner loops on a single layout
+    return convertToHalfBlockAscii(convertToRgb(img, pixelLayoutFor(img.getChannels())), target, color_tolerance);
+  }
+  if (target.getSize() < halfBlockBufferSize(img.getWidth(), img.getHeight())) {
+    throw std::runtime_error("Target buffer too small for half-block output");
+  }
+  char* begin = reinterpret_cast<char*>(target.getData());
+  return static_cast<size_t>(writeHalfBlockText(img, begin, color_tolerance) - begin);
+}
+
+
+size_t brailleBufferSize(int width, int height) {
+  size_t columns = static_cast<size_t>(width + 1) / 2;
+  size_t rows = static_cast<size_t>(height + 3) / 4;
+  return rows * (columns * UNICODE_GLYPH_SIZE + 1) + 1;
+}
+
+size_t coloredBrailleBufferSize(int width, int height) {
+  size_t columns = static_cast<size_t>(width + 1) / 2;
+  size_t rows = static_cast<size_t>(height + 3) / 4;
+  return rows * (columns * (TRUECOLOR_SGR_MAX_SIZE + UNICODE_GLYPH_SIZE) + 1) + COLOR_RESET_SIZE + 1;
+}
+
+// U+2800 + pattern as UTF-8
+static char* writeBraille(char* p, uint8_t pattern) {
+  p[0] = '\xE2';
+  p[1] = static_cast<char>(0xA0 | (pattern >> 6));
+  p[2] = static_cast<char>(0x80 | (pattern & 0x3F));
+  return p + UNICODE_GLYPH_SIZE;
+}
+
+// Reference packing, also used for the cells at the right and bottom edges
+// where some of the 8 pixels are missing
+static uint8_t packBrailleCell(const uint8_t* const gray[4], int x, int width, bool dither_flat) {
+  int sum = 0, count = 0, lo = 255, hi = 0;
+  uint8_t present = 0;
+  for (int r = 0; r < 4; ++r) {
+    if (!gray[r]) continue;
+    for (int c = 0; c < 2 && x + c < width; ++c) {
+      int v = gray[r][x + c];
+      sum += v;
+      count++;
+      lo = std::min(lo, v);
+      hi = std::max(hi, v);
+      present |= BRAILLE_BITS[r][c];
+    }
+  }
+  if (count == 0) return 0;
+  if (hi - lo < BRAILLE_MIN_CONTRAST) {
+    if (!dither_flat) return present;
+    return BRAILLE_DITHER.patterns[(sum * 9) / (count * 256)] & present;
+  }
+  int threshold = sum / count;
+  uint8_t pattern = 0;
+  for (int r = 0; r < 4; ++r) {
+    if (!gray[r]) continue;
+    for (int c = 0; c < 2 && x + c < width; ++c) {
+      if (gray[r][x + c] > threshold) pattern |= BRAILLE_BITS[r][c];
+    }
+  }
+  return pattern;
+}
+
+static void packBrailleCellsScalar(const uint8_t* const gray[4], int x, int width, uint8_t* patterns, bool dither_flat) {
+  for (; x < width; x += 2) {
+    patterns[x / 2] = packBrailleCell(gray, x, width, dither_flat);
+  }
+}
+
+#ifdef DENSE_ASCII_X86
+
+// 8 cells (16 pixels of each of the 4 rows) per step, in 16-bit lanes, one per cell:
+// pair sums with maddubs, the per-cell mean as threshold broadcast back to both
+// bytes of the lane, unsigned compares via the sign bit, and the dot bits of
+// each row summed into the lane. Flat cells take the dither pattern via pshufb.
+__attribute__((target("ssse3")))
+static void packBrailleCellsSsse3(const uint8_t* const gray[4], int width, uint8_t* patterns, bool dither_flat) {
+  const __m128i ones = _mm_set1_epi8(1);
+  const __m128i sign = _mm_set1_epi8(static_cast<char>(0x80));
+  const __m128i low_byte = _mm_set1_epi16(0x00FF);
+  const __m128i min_contrast = _mm_set1_epi16(BRAILLE_MIN_CONTRAST);
+  uint8_t flat_table[16];
+  for (int i = 0; i < 16; ++i) flat_table[i] = dither_flat ? BRAILLE_DITHER.patterns[i] : 0xFF;
+  const __m128i flat_patterns = _mm_loadu_si128(reinterpret_cast<const __m128i*>(flat_table));
+  __m128i row_bits[4];
+  for (int r = 0; r < 4; ++r) {
+    row_bits[r] = _mm_set1_epi16(static_cast<short>(BRAILLE_BITS[r][0] | (BRAILLE_BITS[r][1] << 8)));
+  }
+
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i v[4];
+    __m128i sum = _mm_setzero_si128();
+    __m128i lo = _mm_set1_epi8(static_cast<char>(0xFF));
+    __m128i hi = _mm_setzero_si128();
+    for (int r = 0; r < 4; ++r) {
+      v[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gray[r] + x));
+      sum = _mm_add_epi16(sum, _mm_maddubs_epi16(v[r], ones));
+      lo = _mm_min_epu8(lo, v[r]);
+      hi = _mm_max_epu8(hi, v[r]);
+    }
+    // Fold the odd byte of each lane onto the even one
+    lo = _mm_and_si128(_mm_min_epu8(lo, _mm_srli_epi16(lo, 8)), low_byte);
+    hi = _mm_and_si128(_mm_max_epu8(hi, _mm_srli_epi16(hi, 8)), low_byte);
+    __m128i flat = _mm_cmpgt_epi16(min_contrast, _mm_sub_epi16(hi, lo));
+
+    __m128i threshold = _mm_srli_epi16(sum, 3);
+    threshold = _mm_xor_si128(_mm_or_si128(threshold, _mm_slli_epi16(threshold, 8)), sign);
+    __m128i pattern = _mm_setzero_si128();
+    for (int r = 0; r < 4; ++r) {
+      __m128i on = _mm_cmpgt_epi8(_mm_xor_si128(v[r], sign), threshold);
+      pattern = _mm_add_epi16(pattern, _mm_maddubs_epi16(_mm_and_si128(on, row_bits[r]), ones));
+    }
+    // level = sum * 9 / 2048, 0..8
+    __m128i level = _mm_srli_epi16(_mm_mullo_epi16(sum, _mm_set1_epi16(9)), 11);
+    __m128i dithered = _mm_and_si128(_mm_shuffle_epi8(flat_patterns, level), low_byte);
+    pattern = _mm_or_si128(_mm_and_si128(flat, dithered), _mm_andnot_si128(flat, pattern));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(patterns + x / 2), _mm_packus_epi16(pattern, pattern));
+  }
+  packBrailleCellsScalar(gray, x, width, patterns, dither_flat);
+}
+
+#endif // DENSE_ASCII_X86
+
+static void packBrailleRow(AsciiKernel kernel, const uint8_t* const gray[4], int width, uint8_t* patterns,
+                           bool dither_flat) {
+#ifdef DENSE_ASCII_X86
+  // The SSSE3 packer serves the AVX2 setting too, one 128-bit step already covers 8 cells
+  bool all_rows = gray[0] && gray[1] && gray[2] && gray[3];
+  if (kernel != AsciiKernel::Scalar && all_rows) {
+    packBrailleCellsSsse3(gray, width, patterns, dither_flat);
+    return;
+  }
+#endif
+  packBrailleCellsScalar(gray, 0, width, patterns, dither_flat);
+}
+
+void packBrailleCells(AsciiKernel kernel, const uint8_t* const gray[4], int width, uint8_t* patterns) {
+  packBrailleRow(kernel, gray, width, patterns, true);
+}
+
+void packBrailleCells(const uint8_t* const gray[4], int width, uint8_t* patterns) {
+  packBrailleRow(getAsciiKernel(), gray, width, patterns, true);
+}
+
+// Luma of the (up to) 4 source rows of cell row `cell_y`, missing rows are nullptr
+static void grayRows(const RawImageView& img, int cell_y, std::vector<uint8_t>& buffer, const uint8_t* gray[4]) {
+  int width = img.getWidth();
+  for (int r = 0; r < 4; ++r) {
+    int y = cell_y * 4 + r;
+    if (y >= img.getHeight()) {
+      gray[r] = nullptr;
+      continue;
+    }
+    uint8_t* row = buffer.data() + static_cast<size_t>(r) * width;
+    convertRowToGray(img.getRow(y), width, row);
+    gray[r] = row;
+  }
+}
+
+RawImage convertToBrailleAscii(const RawImageView& img) {
+  if (img.getChannels() != 3) {
+    return convertToBrailleAscii(convertToRgb(img, pixelLayoutFor(img.getChannels())));
+  }
+  int width = img.getWidth();
+  int height = img.getHeight();
+  int columns = (width + 1) / 2;
+  RawImage target(static_cast<int>(brailleBufferSize(width, height)), 1, 1);
+  std::vector<uint8_t> buffer(static_cast<size_t>(width) * 4);
+  std::vector<uint8_t> patterns(columns);
+  char* p = reinterpret_cast<char*>(target.getData());
+
+  for (int cell_y = 0; cell_y * 4 < height; ++cell_y) {
+    const uint8_t* gray[4];
+    grayRows(img, cell_y, buffer, gray);
+    packBrailleCells(gray, width, patterns.data());
+    for (int c = 0; c < columns; ++c) p = writeBraille(p, patterns[c]);
+    *p++ = '\n';
+  }
+  *p = '\0';
+  return target;
+}
+
+// Writes the colored Braille text, the reset and a NUL, returns the end of the text
+static char* writeColoredBrailleText(const RawImageView& img, char* out, int color_tolerance) {
+  int width = img.getWidth();
+  int height = img.getHeight();
+  int columns = (width + 1) / 2;
+  std::vector<uint8_t> buffer(static_cast<size_t>(width) * 4);
+  std::vector<uint8_t> patterns(columns);
+  TruecolorEmitter emitter(out, color_tolerance);
+
+  for (int cell_y = 0; cell_y * 4 < height; ++cell_y) {
+    const uint8_t* gray[4];
+    grayRows(img, cell_y, buffer, gray);
+    packBrailleRow(getAsciiKernel(), gray, width, patterns.data(), false);
+
+    for (int c = 0; c < columns; ++c) {
+      uint8_t pattern = patterns[c];
+      char glyph[UNICODE_GLYPH_SIZE];
+      writeBraille(glyph, pattern);
+      if (pattern == 0) {
+        // Nothing lit, the color would not show
+        emitter.putText(glyph, UNICODE_GLYPH_SIZE);
+        continue;
+      }
+      // Mean color of the lit dots
+      int sum[3] = { 0, 0, 0 }, count = 0;
+      for (int r = 0; r < 4; ++r) {
+        if (!gray[r]) continue;
+        const uint8_t* row = img.getRow(cell_y * 4 + r);
+        for (int dx = 0; dx < 2; ++dx) {
+          if (!(pattern & BRAILLE_BITS[r][dx])) continue;
+          const uint8_t* px = row + (c * 2 + dx) * 3;
+          sum[0] += px[0];
+          sum[1] += px[1];
+          sum[2] += px[2];
+          count++;
+        }
+      }
+      emitter.setColor(static_cast<uint8_t>(sum[0] / count), static_cast<uint8_t>(sum[1] / count),
+                       static_cast<uint8_t>(sum[2] / count));
+      emitter.putText(glyph, UNICODE_GLYPH_SIZE);
+    }
+    emitter.putChar('\n');
+  }
+  emitter.finish();
+  return emitter.end();
+}
+
+size_t convertToColoredBraille(const RawImageView& img, RawImage& target, int color_tolerance) {
+  if (img.getChannels() != 3) {
+    return convertToColoredBraille(convertToRgb(img, pixelLayoutFor(img.getChannels())), target, color_tolerance);
+  }
+  if (target.getSize() < coloredBrailleBufferSize(img.getWidth(), img.getHeight())) {
+    throw std::runtime_error("Target buffer too small for colored Braille output");
+  }
+  char* begin = reinterpret_cast<char*>(target.getData());
+  return static_cast<size_t>(writeColoredBrailleText(img, begin, color_tolerance) - begin);
+}
+
+
+DenseRenderer::DenseRenderer(GlyphMode mode) : m_mode(mode) {
+  if (mode == GlyphMode::Ascii) {
+    throw std::runtime_error("DenseRenderer needs the half-block, Braille or shape glyph mode");
+  }
+}
+
+size_t DenseRenderer::bufferSize(GlyphMode mode, int width, int height) {
+  size_t text;
+  switch (mode) {
+    case GlyphMode::Braille: text = coloredBrailleBufferSize(width, height); break;
+    case GlyphMode::Shape: text = coloredShapeAsciiBufferSize(width, height); break;
+    default: text = halfBlockBufferSize(width, height); break;
+  }
+  return 7 + text; // \033[H\033[2J + frame
+}
+
+RenderStats DenseRenderer::render(const CellGrid& pixels, RawImage& target) {
+  int width = pixels.width;
+  int height = pixels.height;
+  if (target.getSize() < bufferSize(m_mode, width, height)) {
+    throw std::runtime_error("Target buffer too small for rendered frame");
+  }
+  RenderStats stats;
+  stats.total_cells = stats.changed_cells = static_cast<size_t>((width + glyphCellWidth(m_mode) - 1) / glyphCellWidth(m_mode)) *
+                                            ((height + glyphCellHeight(m_mode) - 1) / glyphCellHeight(m_mode));
+  stats.full_repaint = true;
+
+  char* begin = reinterpret_cast<char*>(target.getData());
+  char* p = begin;
+  // Only clear when the geometry changed, overwriting in place does not flicker
+  if (!m_valid || width != m_width || height != m_height) {
+    std::memcpy(p, "\033[H\033[2J", 7);
+    p += 7;
+  } else {
+    std::memcpy(p, "\033[H", 3);
+    p += 3;
+  }
+  RawImageView view(pixels.colors.data(), width, height, 3);
+  switch (m_mode) {
+    case GlyphMode::Braille: p = writeColoredBrailleText(view, p, 0); break;
+    case GlyphMode::Shape: p = writeColoredShapeText(view, p, 0, m_matcher); break;
+    default: p = writeHalfBlockText(view, p, 0); break;
+  }
+  stats.bytes_written = static_cast<size_t>(p - begin);
+  m_width = width;
+  m_height = height;
+  m_valid = true;
+  return stats;
+}
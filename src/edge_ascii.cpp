@@ -0,0 +1,294 @@
+#include "edge_ascii.hpp"
+#include "ascii_image.hpp"
+#include "color_palette.hpp"
+#include "pixel_layout.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EDGE_ASCII_X86 1
+#include <immintrin.h>
+#endif
+
+int parseEdgeThreshold(const std::string& text) {
+  size_t used = 0;
+  int threshold = 0;
+  try {
+    threshold = std::stoi(text, &used);
+  } catch (const std::exception&) {
+    used = 0;
+  }
+  if (used == 0 || used != text.size() || threshold < 1 || threshold > 2040) {
+    throw std::runtime_error("Bad edge threshold: " + text + " (1..2040)");
+  }
+  return threshold;
+}
+
+char edgeGlyph(int gx, int gy, int threshold) {
+  int ax = std::abs(gx);
+  int ay = std::abs(gy);
+  if (ax + ay <= threshold) return 0;
+  // tan(22.5) ~ 2 / 5
+  if (2 * ax > 5 * ay) return '|';
+  if (2 * ay > 5 * ax) return gy > 0 ? '_' : '-';
+  return (gx ^ gy) >= 0 ? '/' : '\\';
+}
+
+// Sobel at x, neighbors past the borders clamped
+static void sobelAt(const uint8_t* a, const uint8_t* r, const uint8_t* b, int x, int width, int& gx, int& gy) {
+  int l = x > 0 ? x - 1 : 0;
+  int h = x + 1 < width ? x + 1 : width - 1;
+  gx = (a[h] - a[l]) + 2 * (r[h] - r[l]) + (b[h] - b[l]);
+  gy = (b[l] + 2 * b[x] + b[h]) - (a[l] + 2 * a[x] + a[h]);
+}
+
+static void overlayEdgeGlyphsScalar(const uint8_t* above, const uint8_t* row, const uint8_t* below, int x, int end,
+                                    int width, int threshold, char* glyphs) {
+  for (; x < end; ++x) {
+    int gx, gy;
+    sobelAt(above, row, below, x, width, gx, gy);
+    char glyph = edgeGlyph(gx, gy, threshold);
+    if (glyph) glyphs[x] = glyph;
+  }
+}
+
+#ifdef EDGE_ASCII_X86
+
+// 8 pixels per step in 16-bit lanes. The glyph choice is the scalar one as
+// masks: strong, vertical, horizontal and the signs pick between constants.
+__attribute__((target("ssse3")))
+static int overlayEdgeGlyphsSsse3(const uint8_t* above, const uint8_t* row, const uint8_t* below, int width,
+                                  int threshold, char* glyphs) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i limit = _mm_set1_epi16(static_cast<short>(threshold));
+  const __m128i five = _mm_set1_epi16(5);
+  const __m128i minus_one = _mm_set1_epi16(-1);
+  auto load = [&](const uint8_t* p) { return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero); };
+  auto select = [](__m128i mask, __m128i yes, __m128i no) {
+    return _mm_or_si128(_mm_and_si128(mask, yes), _mm_andnot_si128(mask, no));
+  };
+
+  int x = 1;
+  for (; x + 8 < width; x += 8) {
+    __m128i al = load(above + x - 1), ac = load(above + x), ah = load(above + x + 1);
+    __m128i rl = load(row + x - 1), rh = load(row + x + 1);
+    __m128i bl = load(below + x - 1), bc = load(below + x), bh = load(below + x + 1);
+    __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(ah, al), _mm_sub_epi16(bh, bl)),
+                               _mm_slli_epi16(_mm_sub_epi16(rh, rl), 1));
+    __m128i gy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(bl, bh), _mm_slli_epi16(bc, 1)),
+                               _mm_add_epi16(_mm_add_epi16(al, ah), _mm_slli_epi16(ac, 1)));
+    __m128i ax = _mm_abs_epi16(gx);
+    __m128i ay = _mm_abs_epi16(gy);
+    __m128i strong = _mm_cmpgt_epi16(_mm_add_epi16(ax, ay), limit);
+    if (_mm_movemask_epi8(strong) == 0) continue;
+    __m128i vertical = _mm_cmpgt_epi16(_mm_slli_epi16(ax, 1), _mm_mullo_epi16(ay, five));
+    __m128i horizontal = _mm_cmpgt_epi16(_mm_slli_epi16(ay, 1), _mm_mullo_epi16(ax, five));
+    __m128i flat = select(_mm_cmpgt_epi16(gy, zero), _mm_set1_epi16('_'), _mm_set1_epi16('-'));
+    __m128i diagonal = select(_mm_cmpgt_epi16(_mm_xor_si128(gx, gy), minus_one), _mm_set1_epi16('/'),
+                              _mm_set1_epi16('\\'));
+    __m128i edge = select(vertical, _mm_set1_epi16('|'), select(horizontal, flat, diagonal));
+    __m128i result = select(strong, edge, load(reinterpret_cast<const uint8_t*>(glyphs) + x));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(glyphs + x), _mm_packus_epi16(result, result));
+  }
+  return x;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i loadWidened(const uint8_t* p) {
+  return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+// Same with 16 pixels per step
+__attribute__((target("avx2")))
+static int overlayEdgeGlyphsAvx2(const uint8_t* above, const uint8_t* row, const uint8_t* below, int width,
+                                 int threshold, char* glyphs) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i limit = _mm256_set1_epi16(static_cast<short>(threshold));
+  const __m256i five = _mm256_set1_epi16(5);
+  const __m256i minus_one = _mm256_set1_epi16(-1);
+
+  int x = 1;
+  for (; x + 16 < width; x += 16) {
+    __m256i al = loadWidened(above + x - 1), ac = loadWidened(above + x), ah = loadWidened(above + x + 1);
+    __m256i rl = loadWidened(row + x - 1), rh = loadWidened(row + x + 1);
+    __m256i bl = loadWidened(below + x - 1), bc = loadWidened(below + x), bh = loadWidened(below + x + 1);
+    __m256i gx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(ah, al), _mm256_sub_epi16(bh, bl)),
+                                  _mm256_slli_epi16(_mm256_sub_epi16(rh, rl), 1));
+    __m256i gy = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(bl, bh), _mm256_slli_epi16(bc, 1)),
+                                  _mm256_add_epi16(_mm256_add_epi16(al, ah), _mm256_slli_epi16(ac, 1)));
+    __m256i ax = _mm256_abs_epi16(gx);
+    __m256i ay = _mm256_abs_epi16(gy);
+    __m256i strong = _mm256_cmpgt_epi16(_mm256_add_epi16(ax, ay), limit);
+    if (_mm256_movemask_epi8(strong) == 0) continue;
+    __m256i vertical = _mm256_cmpgt_epi16(_mm256_slli_epi16(ax, 1), _mm256_mullo_epi16(ay, five));
+    __m256i horizontal = _mm256_cmpgt_epi16(_mm256_slli_epi16(ay, 1), _mm256_mullo_epi16(ax, five));
+    __m256i flat = _mm256_blendv_epi8(_mm256_set1_epi16('-'), _mm256_set1_epi16('_'), _mm256_cmpgt_epi16(gy, zero));
+    __m256i diagonal = _mm256_blendv_epi8(_mm256_set1_epi16('\\'), _mm256_set1_epi16('/'),
+                                          _mm256_cmpgt_epi16(_mm256_xor_si256(gx, gy), minus_one));
+    __m256i edge = _mm256_blendv_epi8(_mm256_blendv_epi8(diagonal, flat, horizontal), _mm256_set1_epi16('|'), vertical);
+    __m256i result = _mm256_blendv_epi8(loadWidened(reinterpret_cast<const uint8_t*>(glyphs) + x), edge, strong);
+    // packus works per 128-bit lane, gather the two low quadwords
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(result, result), 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(glyphs + x), _mm256_castsi256_si128(packed));
+  }
+  return x;
+}
+
+#endif // EDGE_ASCII_X86
+
+void overlayEdgeGlyphs(AsciiKernel kernel, const uint8_t* above, const uint8_t* row, const uint8_t* below, int width,
+                       int threshold, char* glyphs) {
+  if (width <= 0) return;
+  // The SIMD kernels compare in 16 bits, beyond 2040 nothing is an edge anyway
+  threshold = std::clamp(threshold, 0, 2040);
+  int x = 0;
+#ifdef EDGE_ASCII_X86
+  if (kernel != AsciiKernel::Scalar) {
+    // The first column clamps its left neighbor, the kernels start at 1 and
+    // stop before the last column
+    overlayEdgeGlyphsScalar(above, row, below, 0, 1, width, threshold, glyphs);
+    x = kernel == AsciiKernel::AVX2 ? overlayEdgeGlyphsAvx2(above, row, below, width, threshold, glyphs)
+                                    : overlayEdgeGlyphsSsse3(above, row, below, width, threshold, glyphs);
+  }
+#else
+  (void)kernel;
+#endif
+  overlayEdgeGlyphsScalar(above, row, below, x, width, width, threshold, glyphs);
+}
+
+void overlayEdgeGlyphs(const uint8_t* above, const uint8_t* row, const uint8_t* below, int width, int threshold,
+                       char* glyphs) {
+  overlayEdgeGlyphs(getAsciiKernel(), above, row, below, width, threshold, glyphs);
+}
+
+
+// Several bands per thread keeps the load balanced, each band also computes
+// the luma of the row above and below it, so bands are kept tall enough for
+// that to stay small
+static const size_t BANDS_PER_THREAD = 4;
+static const int MIN_ROWS_PER_BAND = 32;
+
+static size_t bandCount(int height, const ThreadPool& pool) {
+  size_t by_rows = static_cast<size_t>((height + MIN_ROWS_PER_BAND - 1) / MIN_ROWS_PER_BAND);
+  return std::max<size_t>(1, std::min(by_rows, pool.threadCount() * BANDS_PER_THREAD));
+}
+
+// Ramp glyphs of rows [y_begin, y_end) with the edges drawn over them.
+// Row y goes to glyphs + (y - y_begin) * stride.
+template <PixelLayout L>
+static void edgeGlyphBand(const RawImageView& source_image, int y_begin, int y_end, int threshold, char* glyphs,
+                          size_t stride) {
+  int width = source_image.getWidth();
+  int height = source_image.getHeight();
+  AsciiKernel kernel = getAsciiKernel();
+  // Rolling luma of rows y - 1, y and y + 1
+  thread_local std::vector<uint8_t> luma;
+  luma.resize(static_cast<size_t>(width) * 3);
+  uint8_t* rows[3] = { luma.data(), luma.data() + width, luma.data() + 2 * static_cast<size_t>(width) };
+  rowToLuma<L>(source_image.getRow(std::max(y_begin - 1, 0)), width, rows[0]);
+  rowToLuma<L>(source_image.getRow(y_begin), width, rows[1]);
+  for (int y = y_begin; y < y_end; ++y) {
+    rowToLuma<L>(source_image.getRow(std::min(y + 1, height - 1)), width, rows[2]);
+    char* out = glyphs + static_cast<size_t>(y - y_begin) * stride;
+    rowToGlyphs<L>(source_image.getRow(y), width, out);
+    overlayEdgeGlyphs(kernel, rows[0], rows[1], rows[2], width, threshold, out);
+    std::rotate(rows, rows + 1, rows + 3);
+  }
+}
+
+// Runs edgeGlyphBand over the image on the pool, row y at glyphs + y * stride
+static void edgeGlyphs(const RawImageView& source_image, int threshold, char* glyphs, size_t stride,
+                       ThreadPool& pool) {
+  int height = source_image.getHeight();
+  if (height == 0 || source_image.getWidth() == 0) return;
+  size_t bands = bandCount(height, pool);
+  dispatchPixelLayout(pixelLayoutFor(source_image.getChannels()), [&](auto tag) {
+    pool.parallelFor(bands, [&](size_t band) {
+      int y_begin = static_cast<int>(band * static_cast<size_t>(height) / bands);
+      int y_end = static_cast<int>((band + 1) * static_cast<size_t>(height) / bands);
+      edgeGlyphBand<decltype(tag)::value>(source_image, y_begin, y_end, threshold,
+                                          glyphs + static_cast<size_t>(y_begin) * stride, stride);
+    });
+  });
+}
+
+RawImage convertToEdgeAscii(const RawImageView& source_image, int threshold, ThreadPool& pool) {
+  int width = source_image.getWidth();
+  int height = source_image.getHeight();
+  RawImage target_image((width + 1) * height + 1, 1, 1);
+  char* target_data = reinterpret_cast<char*>(target_image.getData());
+  edgeGlyphs(source_image, threshold, target_data, static_cast<size_t>(width) + 1, pool);
+  for (int y = 0; y < height; ++y) {
+    target_data[static_cast<size_t>(y) * (width + 1) + width] = '\n';
+  }
+  target_data[static_cast<size_t>(width + 1) * height] = '\0';
+  return target_image;
+}
+
+template <PixelLayout L, typename Emitter>
+static void writeColoredGlyphs(const RawImageView& source_image, const char* glyphs, Emitter& emitter) {
+  using Reader = PixelReader<L>;
+  int width = source_image.getWidth();
+  int height = source_image.getHeight();
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* data = source_image.getRow(y);
+    for (int x = 0; x < width; ++x, data += Reader::CHANNELS) {
+      uint8_t r, g, b;
+      Reader::rgb(data, r, g, b);
+      emitter.put(r, g, b, *glyphs++);
+    }
+    emitter.putChar('\n');
+  }
+}
+
+size_t convertToColoredEdgeAscii(const RawImageView& source_image, RawImage& target, ColorMode mode, int threshold,
+                                 ThreadPool& pool) {
+  int width = source_image.getWidth();
+  int height = source_image.getHeight();
+  if (target.getSize() < coloredAsciiBufferSize(width, height, mode)) {
+    throw std::runtime_error("Target buffer too small for colored ASCII output");
+  }
+  thread_local std::vector<char> glyphs;
+  glyphs.resize(static_cast<size_t>(width) * height);
+  edgeGlyphs(source_image, threshold, glyphs.data(), width, pool);
+
+  char* out = reinterpret_cast<char*>(target.getData());
+  PixelLayout layout = pixelLayoutFor(source_image.getChannels());
+  if (mode == ColorMode::Truecolor) {
+    TruecolorEmitter emitter(out, 0);
+    dispatchPixelLayout(layout, [&](auto tag) {
+      writeColoredGlyphs<decltype(tag)::value>(source_image, glyphs.data(), emitter);
+    });
+    emitter.finish();
+    return emitter.size();
+  }
+  PaletteEmitter emitter(out, mode);
+  dispatchPixelLayout(layout, [&](auto tag) {
+    writeColoredGlyphs<decltype(tag)::value>(source_image, glyphs.data(), emitter);
+  });
+  emitter.finish();
+  return emitter.size();
+}
+
+void applyEdgeGlyphs(CellGrid& cells, int threshold) {
+  if (cells.width == 0 || cells.height == 0) return;
+  // A few thousand cells, not worth the pool. Called every frame, so the
+  // rolling luma of rows y - 1, y and y + 1 is kept from call to call.
+  int width = cells.width;
+  RawImageView colors(cells.colors.data(), width, cells.height, 3);
+  thread_local std::vector<uint8_t> luma;
+  luma.resize(static_cast<size_t>(width) * 3);
+  uint8_t* rows[3] = { luma.data(), luma.data() + width, luma.data() + 2 * static_cast<size_t>(width) };
+  convertRowToGray(colors.getRow(0), width, rows[1]);
+  std::memcpy(rows[0], rows[1], width);
+  AsciiKernel kernel = getAsciiKernel();
+  for (int y = 0; y < cells.height; ++y) {
+    convertRowToGray(colors.getRow(std::min(y + 1, cells.height - 1)), width, rows[2]);
+    overlayEdgeGlyphs(kernel, rows[0], rows[1], rows[2], width, threshold,
+                      cells.glyphs.data() + static_cast<size_t>(y) * width);
+    std::rotate(rows, rows + 1, rows + 3);
+  }
+}
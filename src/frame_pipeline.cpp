@@ -0,0 +1,408 @@
+#include "frame_pipeline.hpp"
+#include "edge_ascii.hpp"
+#include "incremental_convert.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+
+
+static void waitForWork() {
+  std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+// Pixels sampled per row, output_width cells times the pixels per cell
+static int sampleWidth(const PipelineConfig& config) {
+  return config.output_width * glyphCellWidth(config.glyph_mode);
+}
+
+// The aspect correction is for cell rows, dense glyph modes sample several pixel rows per cell
+static float sampleAspect(const PipelineConfig& config) {
+  return config.aspect_correction * glyphCellHeight(config.glyph_mode) / glyphCellWidth(config.glyph_mode);
+}
+
+static void allocateSlots(std::vector<FrameSlot>& slots, size_t capacity) {
+  for (FrameSlot& slot : slots) {
+    slot.pixels = RawImage(static_cast<int>(capacity), 1, 1);
+  }
+}
+
+FramePipeline::FramePipeline(const PipelineConfig& config, FrameSource& source, WriteFunction write)
+: m_config(config), m_source(source), m_write(std::move(write)),
+  m_captured(config.queue_depth), m_resized(config.queue_depth), m_converted(config.queue_depth) {
+  allocate();
+}
+
+FramePipeline::FramePipeline(const PipelineConfig& config, FrameSource& source, TerminalWriter& writer)
+: m_config(config), m_source(source), m_writer(&writer),
+  m_captured(config.queue_depth), m_resized(config.queue_depth), m_converted(config.queue_depth) {
+  allocate();
+}
+
+void FramePipeline::allocate() {
+  const PipelineConfig& config = m_config;
+  if (config.queue_depth == 0) {
+    throw std::runtime_error("Pipeline queue depth must be at least 1");
+  }
+  if (config.glyph_mode != GlyphMode::Ascii && config.color_mode != ColorMode::Truecolor) {
+    throw std::runtime_error("Half-block, Braille and shape output need truecolor");
+  }
+  if (config.glyph_mode != GlyphMode::Ascii && config.edge_threshold > 0) {
+    throw std::runtime_error("Edge glyphs need the ASCII glyph mode");
+  }
+  if (config.incremental_noise >= 0 && !config.fused_sampling) {
+    throw std::runtime_error("Incremental sampling needs fused sampling");
+  }
+  size_t capture_capacity = static_cast<size_t>(config.max_capture_width) * config.max_capture_height * 3;
+  allocateSlots(m_captured.slots(), capture_capacity);
+  m_scratch.pixels = RawImage(static_cast<int>(capture_capacity), 1, 1);
+
+  // Scaled down to the output width, the output stays below the input height
+  int max_output_height = config.max_capture_height;
+  if (!config.fused_sampling) {
+    allocateSlots(m_resized.slots(), static_cast<size_t>(sampleWidth(config)) * max_output_height * 3);
+  }
+  for (CellSlot& slot : m_converted.slots()) {
+    slot.cells.resize(sampleWidth(config), max_output_height);
+  }
+}
+
+void FramePipeline::captureLoop() {
+  uint64_t sequence = 0;
+  while (!m_stop.load() && (m_config.max_frames == 0 || sequence < m_config.max_frames)) {
+    FrameSlot* slot = m_captured.acquire();
+    FrameSlot& target = slot ? *slot : m_scratch;
+    target.timing = FrameTiming();
+    {
+      ScopedStageTimer timer(m_config.profiler, PROFILE_CAPTURE, sequence, &target.timing);
+      if (!m_source.read(target)) {
+        timer.cancel();
+        break;
+      }
+    }
+    target.sequence = sequence++;
+    target.captured_at = std::chrono::steady_clock::now();
+    m_processed[CAPTURE_STAGE]++;
+    if (slot) m_captured.publish(slot);
+  }
+  m_captured.close();
+}
+
+void FramePipeline::resizeLoop() {
+  std::vector<uint8_t> rgb; // YUV frames are converted here before the resize
+  while (true) {
+    FrameSlot* in = m_captured.takeLatest();
+    if (!in) {
+      if (m_captured.finished()) break;
+      waitForWork();
+      continue;
+    }
+    FrameSlot* out = m_resized.acquire();
+    if (out) {
+      // Resize to the output width, scale height by the terminal aspect correction
+      int new_width = sampleWidth(m_config);
+      int new_height = static_cast<int>(in->height * (static_cast<float>(new_width) / in->width * sampleAspect(m_config)));
+      new_height = std::max(1, new_height);
+      out->reshape(new_width, new_height, PixelFormat::RGB24);
+
+      out->timing = in->timing;
+      uint8_t* pixels = in->pixels.getData();
+      if (isYuvFormat(in->format)) {
+        ScopedStageTimer timer(m_config.profiler, PROFILE_COLOR, in->sequence, &out->timing);
+        rgb.resize(static_cast<size_t>(in->width) * in->height * 3);
+        convertYuvToRgb(in->yuvView(), rgb.data());
+        pixels = rgb.data();
+      }
+      cv::Mat frame(in->height, in->width, CV_8UC3, pixels);
+      cv::Mat resized_frame(new_height, new_width, CV_8UC3, out->pixels.getData());
+      {
+        ScopedStageTimer timer(m_config.profiler, PROFILE_RESIZE, in->sequence, &out->timing);
+        cv::resize(frame, resized_frame, cv::Size(new_width, new_height));
+      }
+      // OpenCV sources deliver BGR, the converters expect RGB
+      if (in->format == PixelFormat::BGR24) {
+        ScopedStageTimer timer(m_config.profiler, PROFILE_COLOR, in->sequence, &out->timing);
+        cv::cvtColor(resized_frame, resized_frame, cv::COLOR_BGR2RGB);
+      }
+      if (resized_frame.data != out->pixels.getData()) {
+        std::memcpy(out->pixels.getData(), resized_frame.data, out->byteSize());
+      }
+
+      out->sequence = in->sequence;
+      out->captured_at = in->captured_at;
+      m_resized.publish(out);
+      m_processed[RESIZE_STAGE]++;
+    }
+    m_captured.release(in);
+  }
+  m_resized.close();
+}
+
+void FramePipeline::convertLoop() {
+  FrameQueue<FrameSlot>& input = convertInput();
+  CellSampler sampler;
+  std::unique_ptr<IncrementalCellSampler> incremental;
+  if (m_config.incremental_noise >= 0) {
+    IncrementalSamplerConfig incremental_config;
+    incremental_config.noise_threshold = m_config.incremental_noise;
+    incremental = std::make_unique<IncrementalCellSampler>(incremental_config);
+  }
+  while (true) {
+    FrameSlot* in = input.takeLatest();
+    if (!in) {
+      if (input.finished()) break;
+      waitForWork();
+      continue;
+    }
+    CellSlot* out = m_converted.acquire();
+    if (out) {
+      out->timing = in->timing;
+      {
+        ScopedStageTimer timer(m_config.profiler, PROFILE_CELLS, in->sequence, &out->timing);
+        if (m_config.fused_sampling) {
+          if (isYuvFormat(in->format)) {
+            // YUV frames are sampled whole, tileChanged compares packed pixels
+            sampler.sample(in->yuvView(), sampleWidth(m_config), out->cells, sampleAspect(m_config));
+          } else if (incremental) {
+            incremental->sample(in->view(), in->format, sampleWidth(m_config), out->cells, sampleAspect(m_config));
+            m_tiles += incremental->lastStats().tiles;
+            m_dirty_tiles += incremental->lastStats().dirty_tiles;
+          } else {
+            sampler.sample(in->view(), in->format, sampleWidth(m_config), out->cells, sampleAspect(m_config));
+          }
+        } else {
+          buildColoredCells(in->view(), out->cells);
+        }
+        if (m_config.edge_threshold > 0) {
+          applyEdgeGlyphs(out->cells, m_config.edge_threshold);
+        }
+      }
+      out->sequence = in->sequence;
+      out->captured_at = in->captured_at;
+      m_converted.publish(out);
+      m_processed[CONVERT_STAGE]++;
+    }
+    input.release(in);
+  }
+  m_converted.close();
+}
+
+void FramePipeline::writeLoop() {
+  // A full repaint every frame when differential rendering is off
+  DiffRenderer renderer(m_config.render_mode == RenderMode::Differential ? 0.5 : -1.0, 0, m_config.color_mode);
+  // Half-block, Braille and shape frames are full repaints of the sampled pixels
+  std::unique_ptr<DenseRenderer> dense_renderer;
+  if (m_config.glyph_mode != GlyphMode::Ascii) {
+    dense_renderer = std::make_unique<DenseRenderer>(m_config.glyph_mode);
+  }
+  RawImage text_buffer(0, 0, 0);
+  auto last_write = std::chrono::steady_clock::now();
+
+  while (true) {
+    CellSlot* in = m_converted.takeLatest();
+    if (!in) {
+      if (m_converted.finished()) break;
+      waitForWork();
+      continue;
+    }
+    if (m_config.recorder) {
+      m_config.recorder->addFrame(in->cells, in->captured_at);
+    }
+    if (m_config.server) {
+      m_config.server->publish(in->cells);
+    }
+    if (!m_writer && !m_write) {
+      m_converted.release(in);
+      m_processed[WRITE_STAGE]++;
+      continue;
+    }
+    if (m_writer && !m_writer->ready()) {
+      // The terminal is still taking the last frame, rendering this one would be wasted
+      m_converted.release(in);
+      m_write_skipped++;
+      continue;
+    }
+    size_t required = dense_renderer
+                        ? DenseRenderer::bufferSize(m_config.glyph_mode, in->cells.width, in->cells.height)
+                        : DiffRenderer::bufferSize(in->cells.width, in->cells.height, m_config.color_mode);
+    if (text_buffer.getSize() < required) {
+      text_buffer = RawImage(static_cast<int>(required), 1, 1);
+    }
+    FrameTiming timing = in->timing;
+    uint64_t sequence = in->sequence;
+    RenderStats render_stats;
+    {
+      ScopedStageTimer timer(m_config.profiler, PROFILE_RENDER, sequence, &timing);
+      render_stats = dense_renderer ? dense_renderer->render(in->cells, text_buffer) : renderer.render(in->cells, text_buffer);
+    }
+    auto captured_at = in->captured_at;
+    m_converted.release(in);
+
+    auto now = std::chrono::steady_clock::now();
+    char status[160];
+    size_t status_bytes = 0;
+    if (m_config.show_status) {
+      std::chrono::duration<double, std::milli> interval = now - last_write;
+      std::chrono::duration<double, std::milli> latency = now - captured_at;
+      PipelineStats current = stats();
+      int len = std::snprintf(status, sizeof(status),
+                              "Frame Rate: %.1f | Latency: %.1f ms | Dropped: %llu/%llu/%llu\033[K\n",
+                              interval.count() > 0 ? 1000.0 / interval.count() : 0.0, latency.count(),
+                              static_cast<unsigned long long>(current.stages[RESIZE_STAGE].dropped),
+                              static_cast<unsigned long long>(current.stages[CONVERT_STAGE].dropped),
+                              static_cast<unsigned long long>(current.stages[WRITE_STAGE].dropped));
+      status_bytes = std::min(static_cast<size_t>(len), sizeof(status) - 1);
+    }
+
+    const char* frame = reinterpret_cast<const char*>(text_buffer.getData());
+    bool written = true;
+    {
+      ScopedStageTimer timer(m_config.profiler, PROFILE_OUTPUT, sequence, &timing);
+      if (m_writer) {
+        // Frame and status line in one writev
+        written = m_writer->writeFrame({ { frame, render_stats.bytes_written }, { status, status_bytes } });
+      } else {
+        m_write(frame, render_stats.bytes_written);
+        if (status_bytes > 0) m_write(status, status_bytes);
+      }
+    }
+    if (!written) {
+      renderer.invalidate(); // The screen never saw this frame
+      if (dense_renderer) dense_renderer->invalidate();
+      m_write_skipped++;
+      continue;
+    }
+    if (m_config.profiler) {
+      // Capture to screen, including the time spent queued between stages
+      auto done = std::chrono::steady_clock::now();
+      m_config.profiler->endFrame(timing, std::chrono::duration_cast<std::chrono::nanoseconds>(done - captured_at).count());
+    }
+    m_bytes_written += render_stats.bytes_written;
+    m_processed[WRITE_STAGE]++;
+    last_write = now;
+  }
+}
+
+template <class Queue>
+void FramePipeline::runStage(void (FramePipeline::*loop)(), Queue* output) {
+  try {
+    (this->*loop)();
+  } catch (...) {
+    {
+      std::lock_guard<std::mutex> lock(m_error_mutex);
+      if (!m_error) m_error = std::current_exception();
+    }
+    m_stop.store(true);
+    if (output) output->close();
+  }
+}
+
+void FramePipeline::run() {
+  std::thread capture_thread([this] { runStage(&FramePipeline::captureLoop, &m_captured); });
+  std::thread resize_thread;
+  if (!m_config.fused_sampling) {
+    resize_thread = std::thread([this] { runStage(&FramePipeline::resizeLoop, &m_resized); });
+  }
+  std::thread convert_thread([this] { runStage(&FramePipeline::convertLoop, &m_converted); });
+  runStage<FrameQueue<CellSlot>>(&FramePipeline::writeLoop, nullptr);
+  capture_thread.join();
+  if (resize_thread.joinable()) resize_thread.join();
+  convert_thread.join();
+  if (m_error) std::rethrow_exception(m_error);
+}
+
+PipelineStats FramePipeline::stats() const {
+  PipelineStats result;
+  static const char* names[PIPELINE_STAGE_COUNT] = { "capture", "resize", "convert", "write" };
+  for (int i = 0; i < PIPELINE_STAGE_COUNT; ++i) {
+    result.stages[i].name = names[i];
+    result.stages[i].processed = m_processed[i].load();
+  }
+  // Drops and occupancy belong to the queue feeding each stage, capture has none.
+  // With fused sampling the resize stage is skipped and stays at zero.
+  if (!m_config.fused_sampling) {
+    result.stages[RESIZE_STAGE].dropped = m_captured.dropped();
+    result.stages[RESIZE_STAGE].occupancy = m_captured.occupancy();
+    result.stages[RESIZE_STAGE].max_occupancy = m_captured.maxOccupancy();
+  }
+  const FrameQueue<FrameSlot>& convert_input = convertInput();
+  result.stages[CONVERT_STAGE].dropped = convert_input.dropped();
+  result.stages[CONVERT_STAGE].occupancy = convert_input.occupancy();
+  result.stages[CONVERT_STAGE].max_occupancy = convert_input.maxOccupancy();
+  result.stages[WRITE_STAGE].dropped = m_converted.dropped() + m_write_skipped.load();
+  result.stages[WRITE_STAGE].occupancy = m_converted.occupancy();
+  result.stages[WRITE_STAGE].max_occupancy = m_converted.maxOccupancy();
+  result.bytes_written = m_bytes_written.load();
+  result.tiles = m_tiles.load();
+  result.dirty_tiles = m_dirty_tiles.load();
+  return result;
+}
+
+
+// Share of tiles the incremental sampler had to box-average again
+static void writeIncrementalSummary(const PipelineStats& stats, const PipelineConfig& config) {
+  if (config.incremental_noise < 0) return;
+  std::ios_base::fmtflags flags = std::cout.flags();
+  std::cout << "incremental: " << std::fixed << std::setprecision(1) << stats.dirtyRatio() * 100
+            << "% of tiles resampled | noise " << config.incremental_noise << std::endl;
+  std::cout.flags(flags);
+}
+
+void outputAsciiPipeline(FrameSource& source, size_t FRAMES_TO_PROCESS, const PipelineConfig& config) {
+  std::ios::sync_with_stdio(false);
+  PipelineConfig pipeline_config = config;
+  pipeline_config.max_frames = FRAMES_TO_PROCESS;
+
+  PipelineStats stats;
+  {
+    // A terminal that cannot keep up skips frames instead of stalling the writer thread
+    TerminalWriter writer(STDOUT_FILENO, WriteMode::NonBlocking);
+    FramePipeline pipeline(pipeline_config, source, writer);
+    pipeline.run();
+    writer.flush();
+    stats = pipeline.stats();
+  }
+
+
+  for (const PipelineStageStats& stage : stats.stages) {
+    std::cout << stage.name << ": processed " << stage.processed << " | dropped " << stage.dropped
+              << " | max queued " << stage.max_occupancy << std::endl;
+  }
+  writeIncrementalSummary(stats, config);
+  if (config.profiler) {
+    config.profiler->writeSummary(std::cout);
+  }
+}
+
+void serveAsciiPipeline(FrameSource& source, size_t FRAMES_TO_PROCESS, const PipelineConfig& config) {
+  if (!config.server) {
+    throw std::runtime_error("Serving needs a StreamServer");
+  }
+  PipelineConfig pipeline_config = config;
+  pipeline_config.max_frames = FRAMES_TO_PROCESS;
+  pipeline_config.show_status = false;
+  FramePipeline pipeline(pipeline_config, source, WriteFunction());
+  std::cout << "Serving on " << config.server->address() << std::endl;
+  pipeline.run();
+
+  PipelineStats stats = pipeline.stats();
+  for (const PipelineStageStats& stage : stats.stages) {
+    std::cout << stage.name << ": processed " << stage.processed << " | dropped " << stage.dropped
+              << " | max queued " << stage.max_occupancy << std::endl;
+  }
+  writeIncrementalSummary(stats, config);
+  config.server->writeSummary(std::cout);
+  if (config.profiler) {
+    config.profiler->writeSummary(std::cout);
+  }
+}
+
+void outputWebcameAsciiPipeline(size_t FRAMES_TO_PROCESS, const PipelineConfig& config) {
+  VideoCaptureSource webcam(0);
+  outputAsciiPipeline(webcam, FRAMES_TO_PROCESS, config);
+}
@@ -0,0 +1,199 @@
+#include "frame_renderer.hpp"
+#include "ascii_image.hpp"
+#include "ascii_kernels.hpp"
+#include "ansi_emitter.hpp"
+#include "color_palette.hpp"
+#include "pixel_layout.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <type_traits>
+
+
+void CellGrid::resize(int w, int h) {
+  width = w;
+  height = h;
+  glyphs.resize(cellCount());
+  colors.resize(cellCount() * 3);
+}
+
+template <PixelLayout L>
+static void buildColoredCells(const RawImageView& source_image, CellGrid& cells) {
+  int width = source_image.getWidth();
+  int height = source_image.getHeight();
+  for (int y = 0; y < height; ++y) {
+    size_t row = static_cast<size_t>(y) * width;
+    const uint8_t* data = source_image.getRow(y);
+    rowToGlyphs<L>(data, width, cells.glyphs.data() + row);
+    uint8_t* color = cells.colors.data() + row * 3;
+    if constexpr (L == PixelLayout::RGB) {
+      std::memcpy(color, data, static_cast<size_t>(width) * 3);
+    } else {
+      for (int x = 0; x < width; ++x, data += PixelReader<L>::CHANNELS, color += 3) {
+        PixelReader<L>::rgb(data, color[0], color[1], color[2]);
+      }
+    }
+  }
+}
+
+void buildColoredCells(const RawImageView& source_image, CellGrid& cells) {
+  cells.resize(source_image.getWidth(), source_image.getHeight());
+  dispatchPixelLayout(pixelLayoutFor(source_image.getChannels()),
+                      [&](auto tag) { buildColoredCells<decltype(tag)::value>(source_image, cells); });
+}
+
+void buildColoredCells(const uint8_t* data, int width, int height, CellGrid& cells) {
+  buildColoredCells(RawImageView(data, width, height, 3), cells);
+}
+
+void buildRainbowCells(const RawImageView& source_image, int scroll_offset, CellGrid& cells) {
+  int width = source_image.getWidth();
+  int height = source_image.getHeight();
+  cells.resize(width, height);
+
+  PixelLayout layout = pixelLayoutFor(source_image.getChannels());
+  for (int y = 0; y < height; ++y) {
+    size_t row = static_cast<size_t>(y) * width;
+    dispatchPixelLayout(layout, [&](auto tag) {
+      rowToGlyphs<decltype(tag)::value>(source_image.getRow(y), width, cells.glyphs.data() + row);
+    });
+    uint8_t* color = cells.colors.data() + row * 3;
+    for (int x = 0; x < width; ++x, color += 3) {
+      getRainbowColor(x, y, scroll_offset, color[0], color[1], color[2]);
+    }
+  }
+}
+
+
+DiffRenderer::DiffRenderer(double full_repaint_threshold, int color_tolerance, ColorMode color_mode)
+: m_full_repaint_threshold(full_repaint_threshold), m_color_tolerance(color_tolerance), m_color_mode(color_mode) {
+  if (color_mode != ColorMode::Truecolor) {
+    colorCube(color_mode); // Build the cube now rather than during the first frame
+  }
+}
+
+size_t DiffRenderer::bufferSize(int width, int height, ColorMode color_mode) {
+  size_t full = 7 + coloredAsciiBufferSize(width, height, color_mode); // \033[H\033[2J + frame
+  // Every cell as its own run, plus the final move below the grid
+  size_t diff = static_cast<size_t>(width) * height * (CURSOR_POSITION_MAX_SIZE + colorSgrMaxSize(color_mode) + 1) +
+                CURSOR_POSITION_MAX_SIZE + COLOR_RESET_SIZE + 1;
+  return std::max(full, diff);
+}
+
+bool DiffRenderer::cellChanged(const CellGrid& cells, size_t index) const {
+  if (cells.glyphs[index] != m_screen.glyphs[index]) return true;
+  const uint8_t* a = cells.colors.data() + index * 3;
+  const uint8_t* b = m_screen.colors.data() + index * 3;
+  if (m_color_mode != ColorMode::Truecolor) {
+    const ColorCube& cube = colorCube(m_color_mode);
+    return cube.lookup(a[0], a[1], a[2]) != cube.lookup(b[0], b[1], b[2]);
+  }
+  return std::abs(a[0] - b[0]) > m_color_tolerance || std::abs(a[1] - b[1]) > m_color_tolerance ||
+         std::abs(a[2] - b[2]) > m_color_tolerance;
+}
+
+template <class Emitter>
+void DiffRenderer::recordEmittedColor(const Emitter& emitter, size_t index) {
+  // Within the tolerance the emitter keeps the previous color, the screen
+  // has to remember that color or cells drift up to twice the tolerance.
+  // The palette modes compare palette indices, the source color maps to
+  // the index that was written.
+  if constexpr (std::is_same_v<Emitter, TruecolorEmitter>) {
+    emitter.activeColor(m_screen.colors.data() + index * 3);
+  }
+}
+
+template <class Emitter>
+void DiffRenderer::emitFrame(Emitter& emitter, const CellGrid& cells, const RenderStats& stats, bool size_changed) {
+  int width = cells.width;
+  int height = cells.height;
+
+  if (stats.full_repaint) {
+    // Only clear when the geometry changed, overwriting in place does not flicker
+    if (size_changed) {
+      emitter.putText("\033[H\033[2J", 7);
+    } else {
+      emitter.putText("\033[H", 3);
+    }
+    m_screen = cells;
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        size_t i = static_cast<size_t>(y) * width + x;
+        const uint8_t* c = cells.colors.data() + i * 3;
+        emitter.put(c[0], c[1], c[2], cells.glyphs[i]);
+        recordEmittedColor(emitter, i);
+      }
+      emitter.putChar('\n');
+    }
+    m_valid = true;
+  } else {
+    for (int y = 0; y < height; ++y) {
+      const uint8_t* changed = m_changed.data() + static_cast<size_t>(y) * width;
+      int x = 0;
+      while (x < width) {
+        if (!changed[x]) {
+          ++x;
+          continue;
+        }
+        // Extend the run over short unchanged gaps, rewriting them is cheaper than a cursor move
+        int start = x;
+        int end = x + 1;
+        for (int next = end; next < width && next - end <= MAX_MERGED_GAP; ++next) {
+          if (changed[next]) end = next + 1;
+        }
+
+        emitter.putCursorPosition(y + 1, start + 1);
+        for (int cx = start; cx < end; ++cx) {
+          size_t i = static_cast<size_t>(y) * width + cx;
+          if (changed[cx]) {
+            m_screen.glyphs[i] = cells.glyphs[i];
+            std::memcpy(m_screen.colors.data() + i * 3, cells.colors.data() + i * 3, 3);
+          }
+          const uint8_t* c = m_screen.colors.data() + i * 3;
+          emitter.put(c[0], c[1], c[2], m_screen.glyphs[i]);
+          recordEmittedColor(emitter, i);
+        }
+        x = end;
+      }
+    }
+    emitter.putCursorPosition(height + 1, 1);
+  }
+
+  emitter.finish();
+}
+
+RenderStats DiffRenderer::render(const CellGrid& cells, RawImage& target) {
+  int width = cells.width;
+  int height = cells.height;
+  if (target.getSize() < bufferSize(width, height, m_color_mode)) {
+    throw std::runtime_error("Target buffer too small for rendered frame");
+  }
+
+  RenderStats stats;
+  stats.total_cells = cells.cellCount();
+  bool size_changed = !m_valid || m_screen.width != width || m_screen.height != height;
+
+  if (size_changed) {
+    stats.changed_cells = stats.total_cells;
+  } else {
+    m_changed.resize(stats.total_cells);
+    for (size_t i = 0; i < stats.total_cells; ++i) {
+      m_changed[i] = cellChanged(cells, i);
+      stats.changed_cells += m_changed[i];
+    }
+  }
+  stats.full_repaint = size_changed ||
+                       static_cast<double>(stats.changed_cells) > m_full_repaint_threshold * stats.total_cells;
+
+  char* out = reinterpret_cast<char*>(target.getData());
+  if (m_color_mode == ColorMode::Truecolor) {
+    TruecolorEmitter emitter(out, m_color_tolerance);
+    emitFrame(emitter, cells, stats, size_changed);
+    stats.bytes_written = emitter.size();
+  } else {
+    PaletteEmitter emitter(out, m_color_mode);
+    emitFrame(emitter, cells, stats, size_changed);
+    stats.bytes_written = emitter.size();
+  }
+  m_last_stats = stats;
+  return stats;
+}
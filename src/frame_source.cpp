@@ -0,0 +1,368 @@
+#include "frame_source.hpp"
+#include "stb_image.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+void Frame::reshape(int w, int h, PixelFormat pixel_format) {
+  width = w;
+  height = h;
+  format = pixel_format;
+  if (pixels.getSize() < byteSize()) {
+    pixels = RawImage(static_cast<int>(byteSize()), 1, 1);
+  }
+}
+
+// Reads exactly `size` bytes unless the stream ends first, returns the count read
+static size_t readFully(int fd, uint8_t* buffer, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = ::read(fd, buffer + done, size - done);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      throw std::runtime_error(std::string("Error reading frame stream: ") + std::strerror(errno));
+    }
+    if (n == 0) break;
+    done += static_cast<size_t>(n);
+  }
+  return done;
+}
+
+static int openForReading(const std::string& filename) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Error opening " + filename + ": " + std::strerror(errno));
+  }
+  return fd;
+}
+
+
+VideoCaptureSource::VideoCaptureSource(int device) : m_capture(device), m_name("webcam") {
+  if (!m_capture.isOpened()) {
+    throw std::runtime_error("Error: Could not open webcame.");
+  }
+}
+
+VideoCaptureSource::VideoCaptureSource(const std::string& filename) : m_capture(filename), m_name(filename) {
+  if (!m_capture.isOpened()) {
+    throw std::runtime_error("Error: Could not open video file " + filename);
+  }
+}
+
+bool VideoCaptureSource::read(Frame& frame) {
+  // Reading into a header over the frame buffer lets OpenCV reuse it while the size holds
+  cv::Mat mat;
+  if (frame.width > 0 && frame.format == PixelFormat::BGR24) {
+    mat = cv::Mat(frame.height, frame.width, CV_8UC3, frame.pixels.getData());
+  }
+  if (!m_capture.read(mat) || mat.empty()) {
+    return false;
+  }
+  if (mat.channels() != 3) {
+    throw std::runtime_error("Error: Expected 3 channel frames from " + m_name);
+  }
+  if (mat.data != frame.pixels.getData()) {
+    frame.reshape(mat.cols, mat.rows, PixelFormat::BGR24);
+    for (int y = 0; y < mat.rows; ++y) {
+      std::memcpy(frame.pixels.getData() + static_cast<size_t>(y) * mat.cols * 3, mat.ptr(y),
+                  static_cast<size_t>(mat.cols) * 3);
+    }
+  }
+  return true;
+}
+
+
+ImageSequenceSource::ImageSequenceSource(std::vector<std::string> files, bool loop)
+: m_files(std::move(files)), m_loop(loop) {}
+
+std::vector<std::string> ImageSequenceSource::listDirectory(const std::string& directory) {
+  std::vector<std::string> files;
+  for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+    if (entry.is_regular_file()) files.push_back(entry.path().string());
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+bool ImageSequenceSource::read(Frame& frame) {
+  while (m_next < m_files.size() || (m_loop && !m_files.empty())) {
+    if (m_next == m_files.size()) m_next = 0;
+    const std::string& filename = m_files[m_next++];
+    int width, height, channels;
+    // Ask stb for RGB whatever the file holds, skip files it cannot decode
+    uint8_t* data = stbi_load(filename.c_str(), &width, &height, &channels, 3);
+    if (!data) continue;
+    frame.reshape(width, height, PixelFormat::RGB24);
+    std::memcpy(frame.pixels.getData(), data, frame.byteSize());
+    stbi_image_free(data);
+    return true;
+  }
+  return false;
+}
+
+
+SyntheticSource::SyntheticSource(int width, int height, SyntheticPattern pattern, size_t frame_count)
+: m_width(width), m_height(height), m_pattern(pattern), m_frame_count(frame_count) {
+  if (width <= 0 || height <= 0) {
+    throw std::runtime_error("Synthetic source needs a positive size");
+  }
+}
+
+SyntheticPattern SyntheticSource::parsePattern(const std::string& name) {
+  if (name == "gradient") return SyntheticPattern::Gradient;
+  if (name == "checkerboard") return SyntheticPattern::Checkerboard;
+  if (name == "bars") return SyntheticPattern::ColorBars;
+  if (name == "noise") return SyntheticPattern::Noise;
+  throw std::runtime_error("Unknown synthetic pattern: " + name);
+}
+
+bool SyntheticSource::read(Frame& frame) {
+  if (m_frame_count && m_index >= m_frame_count) return false;
+  uint64_t t = m_index++;
+  frame.reshape(m_width, m_height, PixelFormat::RGB24);
+  uint8_t* p = frame.pixels.getData();
+
+  switch (m_pattern) {
+    case SyntheticPattern::Gradient:
+      for (int y = 0; y < m_height; ++y) {
+        for (int x = 0; x < m_width; ++x, p += 3) {
+          p[0] = static_cast<uint8_t>(x * 2 - t);
+          p[1] = static_cast<uint8_t>(y * 2 + t);
+          p[2] = static_cast<uint8_t>(x + y + t * 3);
+        }
+      }
+      break;
+    case SyntheticPattern::Checkerboard:
+      for (int y = 0; y < m_height; ++y) {
+        for (int x = 0; x < m_width; ++x, p += 3) {
+          uint8_t v = (((x + t) / 16 + y / 16) & 1) ? 235 : 16;
+          p[0] = p[1] = p[2] = v;
+        }
+      }
+      break;
+    case SyntheticPattern::ColorBars: {
+      static const uint8_t bars[8][3] = { { 235, 235, 235 }, { 235, 235, 16 }, { 16, 235, 235 }, { 16, 235, 16 },
+                                          { 235, 16, 235 }, { 235, 16, 16 }, { 16, 16, 235 }, { 16, 16, 16 } };
+      for (int y = 0; y < m_height; ++y) {
+        for (int x = 0; x < m_width; ++x, p += 3) {
+          const uint8_t* bar = bars[((x + t) * 8 / m_width) % 8];
+          p[0] = bar[0];
+          p[1] = bar[1];
+          p[2] = bar[2];
+        }
+      }
+      break;
+    }
+    case SyntheticPattern::Noise: {
+      // xorshift seeded by the frame index keeps every frame reproducible
+      uint64_t state = 0x9E3779B97F4A7C15ull ^ (t + 1) * 0xBF58476D1CE4E5B9ull;
+      for (size_t i = 0; i < frame.byteSize(); ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        p[i] = static_cast<uint8_t>(state >> 24);
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+
+RawStreamSource::RawStreamSource(int fd, int width, int height, PixelFormat format)
+: m_fd(fd), m_owns_fd(false), m_width(width), m_height(height), m_format(format) {
+  if (width <= 0 || height <= 0) {
+    throw std::runtime_error("Raw stream needs a positive frame size");
+  }
+}
+
+RawStreamSource::RawStreamSource(const std::string& filename, int width, int height, PixelFormat format)
+: RawStreamSource(openForReading(filename), width, height, format) {
+  m_owns_fd = true;
+}
+
+RawStreamSource::~RawStreamSource() {
+  if (m_owns_fd) ::close(m_fd);
+}
+
+bool RawStreamSource::read(Frame& frame) {
+  frame.reshape(m_width, m_height, m_format);
+  size_t got = readFully(m_fd, frame.pixels.getData(), frame.byteSize());
+  if (got < frame.byteSize()) {
+    // A pipe cut off mid-frame, e.g. by a killed producer, ends the stream like EOF
+    m_truncated_bytes = got;
+    return false;
+  }
+  return true;
+}
+
+
+Y4mSource::Y4mSource(int fd) : m_fd(fd), m_owns_fd(false) {
+  readHeader();
+}
+
+Y4mSource::Y4mSource(const std::string& filename) : m_fd(openForReading(filename)), m_owns_fd(true) {
+  try {
+    readHeader();
+  } catch (...) {
+    ::close(m_fd);
+    throw;
+  }
+}
+
+Y4mSource::~Y4mSource() {
+  if (m_owns_fd) ::close(m_fd);
+}
+
+// Reads one '\n' terminated header line byte by byte, so no frame data is consumed
+static bool readLine(int fd, std::string& line) {
+  line.clear();
+  uint8_t c;
+  while (readFully(fd, &c, 1) == 1) {
+    if (c == '\n') return true;
+    line.push_back(static_cast<char>(c));
+    if (line.size() > 1024) throw std::runtime_error("Y4M header line too long");
+  }
+  return !line.empty();
+}
+
+void Y4mSource::readHeader() {
+  std::string line;
+  if (!readLine(m_fd, line) || line.compare(0, 10, "YUV4MPEG2 ") != 0) {
+    throw std::runtime_error("Not a YUV4MPEG2 stream");
+  }
+  std::string colorspace = "420jpeg";
+  size_t pos = 10;
+  while (pos < line.size()) {
+    size_t end = line.find(' ', pos);
+    if (end == std::string::npos) end = line.size();
+    std::string token = line.substr(pos, end - pos);
+    if (!token.empty()) {
+      switch (token[0]) {
+        case 'W': m_width = std::stoi(token.substr(1)); break;
+        case 'H': m_height = std::stoi(token.substr(1)); break;
+        case 'C': colorspace = token.substr(1); break;
+        case 'F': {
+          size_t colon = token.find(':');
+          if (colon != std::string::npos) {
+            double den = std::stod(token.substr(colon + 1));
+            m_fps = den > 0 ? std::stod(token.substr(1, colon - 1)) / den : 0;
+          }
+          break;
+        }
+        default: break;
+      }
+    }
+    pos = end + 1;
+  }
+  if (m_width <= 0 || m_height <= 0) {
+    throw std::runtime_error("Y4M header without frame size");
+  }
+  if (colorspace == "mono") {
+    m_mono = true;
+  } else if (colorspace.compare(0, 3, "420") != 0) {
+    throw std::runtime_error("Unsupported Y4M colorspace: C" + colorspace);
+  }
+  size_t luma = static_cast<size_t>(m_width) * m_height;
+  size_t chroma = m_mono ? 0 : static_cast<size_t>((m_width + 1) / 2) * ((m_height + 1) / 2);
+  m_planes.resize(luma + 2 * chroma);
+}
+
+bool Y4mSource::read(Frame& frame) {
+  std::string line;
+  if (!readLine(m_fd, line)) return false;
+  if (line.compare(0, 5, "FRAME") != 0) {
+    throw std::runtime_error("Corrupt Y4M stream, expected FRAME");
+  }
+  if (readFully(m_fd, m_planes.data(), m_planes.size()) != m_planes.size()) {
+    return false; // Cut off mid-frame, ends the stream like the raw source
+  }
+
+  frame.reshape(m_width, m_height, PixelFormat::RGB24);
+  uint8_t* rgb = frame.pixels.getData();
+  const uint8_t* y_plane = m_planes.data();
+  const uint8_t* u_plane = y_plane + static_cast<size_t>(m_width) * m_height;
+  int chroma_width = (m_width + 1) / 2;
+  const uint8_t* v_plane = u_plane + static_cast<size_t>(chroma_width) * ((m_height + 1) / 2);
+
+  // BT.601 limited range, the yuv420p default of ffmpeg
+  for (int y = 0; y < m_height; ++y) {
+    const uint8_t* y_row = y_plane + static_cast<size_t>(y) * m_width;
+    const uint8_t* u_row = u_plane + static_cast<size_t>(y / 2) * chroma_width;
+    const uint8_t* v_row = v_plane + static_cast<size_t>(y / 2) * chroma_width;
+    for (int x = 0; x < m_width; ++x, rgb += 3) {
+      yuvToRgb(y_row[x], m_mono ? 128 : u_row[x / 2], m_mono ? 128 : v_row[x / 2], rgb[0], rgb[1], rgb[2]);
+    }
+  }
+  return true;
+}
+
+
+static bool parseSize(const std::string& text, int& width, int& height) {
+  return std::sscanf(text.c_str(), "%dx%d", &width, &height) == 2 && width > 0 && height > 0;
+}
+
+std::unique_ptr<FrameSource> openFrameSource(const std::string& spec) {
+  size_t colon = spec.find(':');
+  std::string kind = spec.substr(0, colon);
+  std::string rest = colon == std::string::npos ? "" : spec.substr(colon + 1);
+
+  if (kind == "webcam") {
+    return std::make_unique<VideoCaptureSource>(rest.empty() ? 0 : std::stoi(rest));
+  }
+  if (kind == "file") {
+    return std::make_unique<VideoCaptureSource>(rest);
+  }
+  if (kind == "images") {
+    return std::make_unique<ImageSequenceSource>(ImageSequenceSource::listDirectory(rest));
+  }
+  if (kind == "synthetic") {
+    // synthetic[:PATTERN[:WxH]]
+    std::string pattern = rest.substr(0, rest.find(':'));
+    int width = 640, height = 480;
+    size_t size_at = rest.find(':');
+    if (size_at != std::string::npos && !parseSize(rest.substr(size_at + 1), width, height)) {
+      throw std::runtime_error("Bad synthetic size in " + spec);
+    }
+    return std::make_unique<SyntheticSource>(width, height,
+                                             SyntheticSource::parsePattern(pattern.empty() ? "gradient" : pattern));
+  }
+  if (kind == "raw") {
+    // raw:WxH[:rgb|bgr|yuyv|nv12|i420][:PATH], stdin without a path
+    int width, height;
+    size_t next = rest.find(':');
+    if (!parseSize(rest.substr(0, next), width, height)) {
+      throw std::runtime_error("Raw source needs a WxH size: " + spec);
+    }
+    PixelFormat format = PixelFormat::RGB24;
+    std::string path;
+    if (next != std::string::npos) {
+      std::string tail = rest.substr(next + 1);
+      std::string layout = tail.substr(0, tail.find(':'));
+      static const std::pair<const char*, PixelFormat> LAYOUTS[] = {
+        { "rgb", PixelFormat::RGB24 }, { "bgr", PixelFormat::BGR24 }, { "yuyv", PixelFormat::YUYV },
+        { "nv12", PixelFormat::NV12 }, { "i420", PixelFormat::I420 },
+      };
+      for (const auto& [name, layout_format] : LAYOUTS) {
+        if (layout == name) {
+          format = layout_format;
+          tail = tail.size() > layout.size() ? tail.substr(layout.size() + 1) : "";
+          break;
+        }
+      }
+      path = tail;
+    }
+    if (path.empty()) return std::make_unique<RawStreamSource>(STDIN_FILENO, width, height, format);
+    return std::make_unique<RawStreamSource>(path, width, height, format);
+  }
+  if (kind == "y4m") {
+    if (rest.empty()) return std::make_unique<Y4mSource>(STDIN_FILENO);
+    return std::make_unique<Y4mSource>(rest);
+  }
+  throw std::runtime_error("Unknown frame source: " + spec);
+}
@@ -0,0 +1,346 @@
+#include "incremental_convert.hpp"
+#include "color_palette.hpp"
+#include "pixel_layout.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INCREMENTAL_CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+int parseNoiseThreshold(const std::string& text) {
+  size_t used = 0;
+  int threshold = -1;
+  try {
+    threshold = std::stoi(text, &used);
+  } catch (const std::exception&) {
+    used = 0;
+  }
+  if (used == 0 || used != text.size() || threshold < 0 || threshold > 255) {
+    throw std::runtime_error("Bad noise threshold: " + text + " (0..255)");
+  }
+  return threshold;
+}
+
+static bool rowChangedScalar(const uint8_t* a, const uint8_t* b, int x, int n, int threshold) {
+  for (; x < n; ++x) {
+    if (std::abs(a[x] - b[x]) > threshold) return true;
+  }
+  return false;
+}
+
+#ifdef INCREMENTAL_CONVERT_X86
+
+// |a - b| as the OR of both saturated differences, minus the threshold,
+// saturated again: any byte left non-zero is a change
+__attribute__((target("sse2")))
+static bool rowChangedSse2(const uint8_t* a, const uint8_t* b, int n, int threshold) {
+  const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold));
+  __m128i any = _mm_setzero_si128();
+  int x = 0;
+  for (; x + 16 <= n; x += 16) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+    __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+    any = _mm_or_si128(any, _mm_subs_epu8(diff, limit));
+  }
+  // The tail as one more vector overlapping the last one, short rows go scalar
+  if (x < n && n >= 16) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + n - 16));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + n - 16));
+    __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+    any = _mm_or_si128(any, _mm_subs_epu8(diff, limit));
+    x = n;
+  }
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xFFFF) return true;
+  return rowChangedScalar(a, b, x, n, threshold);
+}
+
+__attribute__((target("avx2")))
+static bool rowChangedAvx2(const uint8_t* a, const uint8_t* b, int n, int threshold) {
+  const __m256i limit = _mm256_set1_epi8(static_cast<char>(threshold));
+  __m256i any = _mm256_setzero_si256();
+  int x = 0;
+  for (; x + 32 <= n; x += 32) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + x));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + x));
+    __m256i diff = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+    any = _mm256_or_si256(any, _mm256_subs_epu8(diff, limit));
+  }
+  if (x < n && n >= 32) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + n - 32));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + n - 32));
+    __m256i diff = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+    any = _mm256_or_si256(any, _mm256_subs_epu8(diff, limit));
+    x = n;
+  }
+  if (!_mm256_testz_si256(any, any)) return true;
+  return rowChangedScalar(a, b, x, n, threshold);
+}
+
+#endif // INCREMENTAL_CONVERT_X86
+
+bool tileChanged(AsciiKernel kernel, const uint8_t* a, size_t a_stride, const uint8_t* b, size_t b_stride,
+                 int row_bytes, int rows, int threshold) {
+  bool (*row_changed)(const uint8_t*, const uint8_t*, int, int) = [](const uint8_t* a, const uint8_t* b, int n,
+                                                                     int threshold) {
+    return rowChangedScalar(a, b, 0, n, threshold);
+  };
+#ifdef INCREMENTAL_CONVERT_X86
+  // SSE2 serves the SSSE3 setting, nothing here needs more
+  if (kernel == AsciiKernel::AVX2) row_changed = rowChangedAvx2;
+  if (kernel == AsciiKernel::SSSE3) row_changed = rowChangedSse2;
+#else
+  (void)kernel;
+#endif
+  for (int y = 0; y < rows; ++y, a += a_stride, b += b_stride) {
+    if (row_changed(a, b, row_bytes, threshold)) return true;
+  }
+  return false;
+}
+
+bool tileChanged(const uint8_t* a, size_t a_stride, const uint8_t* b, size_t b_stride, int row_bytes, int rows,
+                 int threshold) {
+  return tileChanged(getAsciiKernel(), a, a_stride, b, b_stride, row_bytes, rows, threshold);
+}
+
+
+IncrementalConverter::IncrementalConverter(const IncrementalConfig& config) : m_config(config) {
+  if (config.tile_width < 1 || config.tile_height < 1) {
+    throw std::runtime_error("Tiles need at least one pixel");
+  }
+  if (config.noise_threshold < 0 || config.noise_threshold > 255) {
+    throw std::runtime_error("The noise threshold must be within 0..255");
+  }
+  if (config.color_mode != ColorMode::Truecolor) {
+    colorCube(config.color_mode); // Build the cube now rather than during the first frame
+  }
+}
+
+void IncrementalConverter::reset(int width, int height, int channels) {
+  m_width = width;
+  m_height = height;
+  m_channels = channels;
+  m_columns = (width + m_config.tile_width - 1) / m_config.tile_width;
+  m_rows = (height + m_config.tile_height - 1) / m_config.tile_height;
+  m_reference.resize(static_cast<size_t>(width) * height * channels);
+  m_dirty.assign(static_cast<size_t>(m_columns) * m_rows, 1);
+  m_segments.assign(static_cast<size_t>(m_columns) * height, Segment());
+  size_t cell = colorSgrMaxSize(m_config.color_mode) + 1;
+  m_segment_capacity = static_cast<size_t>(m_config.tile_width) * cell;
+  m_row_capacity = static_cast<size_t>(m_columns) * m_segment_capacity;
+  m_text.resize(m_row_capacity * height);
+  m_valid = true;
+}
+
+// Writes the segments of one tile from the frame and takes its pixels as the new reference
+template <typename Emitter, typename Reader>
+void IncrementalConverter::convertTile(const RawImageView& frame, int column, int row) {
+  int x0 = column * m_config.tile_width;
+  int count = std::min(m_config.tile_width, m_width - x0);
+  int y_end = std::min(m_height, (row + 1) * m_config.tile_height);
+  size_t row_bytes = static_cast<size_t>(count) * m_channels;
+  for (int y = row * m_config.tile_height; y < y_end; ++y) {
+    const uint8_t* pixels = frame.getRow(y) + static_cast<size_t>(x0) * m_channels;
+    char* out = m_text.data() + y * m_row_capacity + column * m_segment_capacity;
+    // A fresh emitter, so the segment opens with its own color
+    Emitter emitter = [&]() {
+      if constexpr (std::is_same_v<Emitter, TruecolorEmitter>) {
+        return TruecolorEmitter(out, 0);
+      } else {
+        return PaletteEmitter(out, m_config.color_mode);
+      }
+    }();
+    const uint8_t* p = pixels;
+    for (int x = 0; x < count; ++x, p += Reader::CHANNELS) {
+      uint8_t r, g, b;
+      Reader::rgb(p, r, g, b);
+      emitter.put(r, g, b, GLYPH_TABLE[lumaOf(r, g, b)]);
+    }
+
+    Segment& segment = m_segments[static_cast<size_t>(y) * m_columns + column];
+    segment.size = static_cast<uint32_t>(emitter.size());
+    segment.first_sgr = static_cast<uint8_t>(static_cast<const char*>(std::memchr(out, 'm', segment.size)) - out + 1);
+    size_t last = segment.size;
+    while (out[--last] != '\033') {}
+    segment.last_sgr = static_cast<uint32_t>(last);
+    segment.last_sgr_size = static_cast<uint8_t>(static_cast<const char*>(std::memchr(out + last, 'm', segment.size - last)) -
+                                                 (out + last) + 1);
+
+    std::memcpy(m_reference.data() + (static_cast<size_t>(y) * m_width + x0) * m_channels, pixels, row_bytes);
+  }
+}
+
+size_t IncrementalConverter::convert(const RawImageView& frame, RawImage& target) {
+  int width = frame.getWidth();
+  int height = frame.getHeight();
+  int channels = frame.getChannels();
+  PixelLayout layout = pixelLayoutFor(channels);
+  if (target.getSize() < coloredAsciiBufferSize(width, height, m_config.color_mode)) {
+    throw std::runtime_error("Target buffer too small for colored ASCII output");
+  }
+
+  IncrementalStats stats;
+  stats.full_convert = !m_valid || width != m_width || height != m_height || channels != m_channels;
+  if (stats.full_convert) {
+    reset(width, height, channels);
+  } else {
+    AsciiKernel kernel = getAsciiKernel();
+    size_t reference_stride = static_cast<size_t>(width) * channels;
+    for (int row = 0; row < m_rows; ++row) {
+      int y0 = row * m_config.tile_height;
+      int rows = std::min(m_config.tile_height, height - y0);
+      for (int column = 0; column < m_columns; ++column) {
+        int x0 = column * m_config.tile_width;
+        int row_bytes = std::min(m_config.tile_width, width - x0) * channels;
+        m_dirty[static_cast<size_t>(row) * m_columns + column] =
+          tileChanged(kernel, frame.getRow(y0) + static_cast<size_t>(x0) * channels, frame.getStride(),
+                      m_reference.data() + y0 * reference_stride + static_cast<size_t>(x0) * channels,
+                      reference_stride, row_bytes, rows, m_config.noise_threshold);
+      }
+    }
+  }
+
+  dispatchPixelLayout(layout, [&](auto tag) {
+    using Reader = PixelReader<decltype(tag)::value>;
+    for (int row = 0; row < m_rows; ++row) {
+      for (int column = 0; column < m_columns; ++column) {
+        if (!m_dirty[static_cast<size_t>(row) * m_columns + column]) continue;
+        if (m_config.color_mode == ColorMode::Truecolor) {
+          convertTile<TruecolorEmitter, Reader>(frame, column, row);
+        } else {
+          convertTile<PaletteEmitter, Reader>(frame, column, row);
+        }
+        stats.dirty_tiles++;
+      }
+    }
+  });
+  stats.tiles = m_dirty.size();
+
+  // Join the segments, a leading SGR that repeats the active color is left out
+  char* begin = reinterpret_cast<char*>(target.getData());
+  char* out = begin;
+  const char* active = nullptr;
+  size_t active_size = 0;
+  for (int y = 0; y < height; ++y) {
+    const char* text = m_text.data() + y * m_row_capacity;
+    const Segment* segment = m_segments.data() + static_cast<size_t>(y) * m_columns;
+    for (int column = 0; column < m_columns; ++column, ++segment, text += m_segment_capacity) {
+      size_t skip = active && active_size == segment->first_sgr && std::memcmp(active, text, active_size) == 0
+                      ? segment->first_sgr : 0;
+      std::memcpy(out, text + skip, segment->size - skip);
+      out += segment->size - skip;
+      active = text + segment->last_sgr;
+      active_size = segment->last_sgr_size;
+    }
+    *out++ = '\n';
+  }
+  std::memcpy(out, "\033[0m", COLOR_RESET_SIZE);
+  out += COLOR_RESET_SIZE;
+  *out = '\0';
+
+  stats.bytes_written = static_cast<size_t>(out - begin);
+  m_last_stats = stats;
+  m_totals.tiles += stats.tiles;
+  m_totals.dirty_tiles += stats.dirty_tiles;
+  m_totals.bytes_written += stats.bytes_written;
+  m_frames++;
+  return stats.bytes_written;
+}
+
+
+IncrementalCellSampler::IncrementalCellSampler(const IncrementalSamplerConfig& config) : m_config(config) {
+  if (config.tile_columns < 1 || config.tile_rows < 1) {
+    throw std::runtime_error("Tiles need at least one cell");
+  }
+  if (config.noise_threshold < 0 || config.noise_threshold > 255) {
+    throw std::runtime_error("The noise threshold must be within 0..255");
+  }
+}
+
+// Copies the source pixels [x0, x1) x [y0, y1) into the reference
+void IncrementalCellSampler::keepReference(const RawImageView& source, int x0, int x1, int y0, int y1) {
+  size_t stride = static_cast<size_t>(m_width) * m_channels;
+  size_t row_bytes = static_cast<size_t>(x1 - x0) * m_channels;
+  for (int y = y0; y < y1; ++y) {
+    std::memcpy(m_reference.data() + y * stride + static_cast<size_t>(x0) * m_channels,
+                source.getRow(y) + static_cast<size_t>(x0) * m_channels, row_bytes);
+  }
+}
+
+void IncrementalCellSampler::sample(const RawImageView& source, PixelFormat format, int columns, CellGrid& cells,
+                                    float aspect_correction) {
+  int width = source.getWidth();
+  int height = source.getHeight();
+  int channels = source.getChannels();
+  IncrementalStats stats;
+  stats.full_convert = !m_valid || width != m_width || height != m_height || channels != m_channels ||
+                       format != m_format || std::min(columns, width) != m_columns ||
+                       aspect_correction != m_aspect_correction;
+  if (stats.full_convert) {
+    m_sampler.sample(source, format, columns, m_cells, aspect_correction);
+    m_width = width;
+    m_height = height;
+    m_channels = channels;
+    m_format = format;
+    m_columns = std::min(columns, width);
+    m_aspect_correction = aspect_correction;
+    m_reference.resize(static_cast<size_t>(width) * height * channels);
+    keepReference(source, 0, width, 0, height);
+    m_valid = true;
+  }
+
+  int grid_rows = m_cells.height;
+  int tile_columns = (m_columns + m_config.tile_columns - 1) / m_config.tile_columns;
+  int tile_rows = (grid_rows + m_config.tile_rows - 1) / m_config.tile_rows;
+  stats.tiles = static_cast<size_t>(tile_columns) * tile_rows;
+  if (stats.full_convert) {
+    stats.dirty_tiles = stats.tiles;
+  } else {
+    AsciiKernel kernel = getAsciiKernel();
+    size_t reference_stride = static_cast<size_t>(width) * channels;
+    for (int tile_row = 0; tile_row < tile_rows; ++tile_row) {
+      int r0 = tile_row * m_config.tile_rows;
+      int r1 = std::min(grid_rows, r0 + m_config.tile_rows);
+      int y0 = cellStart(height, grid_rows, r0);
+      int y1 = cellStart(height, grid_rows, r1);
+      // Runs of dirty tiles are resampled in one pass over their rows
+      int run_begin = -1;
+      for (int tile = 0; tile <= tile_columns; ++tile) {
+        bool dirty = false;
+        if (tile < tile_columns) {
+          int c0 = tile * m_config.tile_columns;
+          int c1 = std::min(m_columns, c0 + m_config.tile_columns);
+          int x0 = cellStart(width, m_columns, c0);
+          int x1 = cellStart(width, m_columns, c1);
+          dirty = tileChanged(kernel, source.getRow(y0) + static_cast<size_t>(x0) * channels, source.getStride(),
+                              m_reference.data() + y0 * reference_stride + static_cast<size_t>(x0) * channels,
+                              reference_stride, (x1 - x0) * channels, y1 - y0, m_config.noise_threshold);
+        }
+        if (dirty) {
+          stats.dirty_tiles++;
+          if (run_begin < 0) run_begin = tile;
+          continue;
+        }
+        if (run_begin < 0) continue;
+        int c0 = run_begin * m_config.tile_columns;
+        int c1 = std::min(m_columns, tile * m_config.tile_columns);
+        m_sampler.sampleRegion(source, format, m_cells, c0, c1, r0, r1);
+        keepReference(source, cellStart(width, m_columns, c0), cellStart(width, m_columns, c1), y0, y1);
+        run_begin = -1;
+      }
+    }
+  }
+
+  cells.resize(m_cells.width, m_cells.height);
+  std::memcpy(cells.glyphs.data(), m_cells.glyphs.data(), m_cells.cellCount());
+  std::memcpy(cells.colors.data(), m_cells.colors.data(), m_cells.cellCount() * 3);
+
+  m_last_stats = stats;
+  m_totals.tiles += stats.tiles;
+  m_totals.dirty_tiles += stats.dirty_tiles;
+  m_frames++;
+}
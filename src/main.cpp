@@ -1,12 +1,263 @@
 #include "ascii_image.hpp"
+#include "ascii_recording.hpp"
+#include "batch_convert.hpp"
+#include "color_palette.hpp"
+#include "dense_ascii.hpp"
+#include "edge_ascii.hpp"
+#include "frame_pipeline.hpp"
+#include "frame_source.hpp"
+#include "incremental_convert.hpp"
+#include "mosaic_compositor.hpp"
+#include "stage_profiler.hpp"
+#include "stream_server.hpp"
+#include "strip_converter.hpp"
+#include <memory>
 #include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <string>
+#include <vector>
+#include <unistd.h>
 
-int main() {
+int main(int argc, char** argv) {
 
   size_t FRAMES_TO_PROCESS = 65535; // Will run for 36 minutes and 24.5 seconds
-  outputWebcameAsciiStream(FRAMES_TO_PROCESS);
+  std::string source_spec = "webcam";
+  std::string profile_prefix;
+  bool trace = false;
+  double budget_ms = 1000.0 / 30;
+  ColorMode color_mode = ColorMode::Truecolor;
+  GlyphMode glyph_mode = GlyphMode::Ascii;
+  int edge_threshold = 0;
+  int incremental_noise = -1;
+  std::string record_path;
+  std::string play_path;
+  double speed = 1.0;
+  std::string serve_address;
+  std::string view_address;
+  double adaptive_fps = 0;
+  std::string convert_path;
+  std::string raw_geometry;
+  bool colors_given = false;
+  int columns = 100;
+  bool columns_given = false;
+  std::string batch_directory;
+  std::string batch_list;
+  std::string output_directory;
+  size_t threads = 0;
+  std::vector<std::string> mosaic_specs;
+
+  // --source SPEC picks the frame source, see openFrameSource for the specs
+  // --frames N stops after N frames, 0 runs until the source ends
+  // --colors MODE truecolor (default), 256 or 16 colors
+  // --glyphs MODE ascii (default), half (1x2 pixels per cell), braille (2x4 pixels per cell)
+  //   or shape (4x8 pixels per cell, matched to the glyph outlines)
+  // --edges [T] draws | / - \ _ where the picture has an edge stronger than T (default 256, up to 2040)
+  // --incremental [NOISE] box-averages only the tiles of cells whose capture pixels moved by more than NOISE
+  //   (default 8) since they were last sampled, and prints the share resampled on exit
+  // --profile PREFIX times every stage and writes PREFIX.json and PREFIX.csv on exit
+  // --trace also writes PREFIX.trace.json for chrome://tracing
+  // --budget MS frame budget for the profile, frames over it are blamed on their slowest stage
+  // --record PATH also writes every frame to a binary recording
+  // --play PATH replays a recording instead of capturing, --speed X scales its timing (0 = as fast as possible)
+  // --serve ADDR renders each frame once for every viewer connected to unix:PATH or tcp:PORT
+  // --view ADDR shows the stream of a server
+  // --adaptive FPS fits width, colors and redraws to the terminal and the frame rate, single-threaded
+  // --convert PATH writes one PPM/PGM image as ASCII to stdout in bounded memory, --columns N wide,
+  //   colored only with --colors; --raw WxH[:gray|:bgr] reads headerless pixels instead
+  // --batch DIR or --batch-list FILE converts every image on all cores (--threads N), into --output DIR
+  //   as NAME.txt, one glyph per pixel unless --columns is given, colored only with --colors
+  // --mosaic SPEC, repeated, shows every source as a tile of one terminal, --columns N wide per tile,
+  //   for --frames N refreshes
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+      if (arg == "--source" && i + 1 < argc) {
+        source_spec = argv[++i];
+      } else if (arg == "--frames" && i + 1 < argc) {
+        FRAMES_TO_PROCESS = std::stoul(argv[++i]);
+      } else if (arg == "--colors" && i + 1 < argc) {
+        color_mode = parseColorMode(argv[++i]);
+        colors_given = true;
+      } else if (arg == "--glyphs" && i + 1 < argc) {
+        glyph_mode = parseGlyphMode(argv[++i]);
+      } else if (arg == "--edges") {
+        edge_threshold = EDGE_DEFAULT_THRESHOLD;
+        if (i + 1 < argc && argv[i + 1][0] != '-') edge_threshold = parseEdgeThreshold(argv[++i]);
+      } else if (arg == "--incremental") {
+        incremental_noise = IncrementalSamplerConfig().noise_threshold;
+        if (i + 1 < argc && argv[i + 1][0] != '-') incremental_noise = parseNoiseThreshold(argv[++i]);
+      } else if (arg == "--profile" && i + 1 < argc) {
+        profile_prefix = argv[++i];
+      } else if (arg == "--trace") {
+        trace = true;
+      } else if (arg == "--budget" && i + 1 < argc) {
+        budget_ms = std::stod(argv[++i]);
+      } else if (arg == "--record" && i + 1 < argc) {
+        record_path = argv[++i];
+      } else if (arg == "--play" && i + 1 < argc) {
+        play_path = argv[++i];
+      } else if (arg == "--speed" && i + 1 < argc) {
+        speed = std::stod(argv[++i]);
+      } else if (arg == "--serve" && i + 1 < argc) {
+        serve_address = argv[++i];
+      } else if (arg == "--view" && i + 1 < argc) {
+        view_address = argv[++i];
+      } else if (arg == "--adaptive" && i + 1 < argc) {
+        adaptive_fps = std::stod(argv[++i]);
+      } else if (arg == "--convert" && i + 1 < argc) {
+        convert_path = argv[++i];
+      } else if (arg == "--raw" && i + 1 < argc) {
+        raw_geometry = argv[++i];
+      } else if (arg == "--columns" && i + 1 < argc) {
+        columns = std::stoi(argv[++i]);
+        columns_given = true;
+      } else if (arg == "--batch" && i + 1 < argc) {
+        batch_directory = argv[++i];
+      } else if (arg == "--batch-list" && i + 1 < argc) {
+        batch_list = argv[++i];
+      } else if (arg == "--output" && i + 1 < argc) {
+        output_directory = argv[++i];
+      } else if (arg == "--threads" && i + 1 < argc) {
+        threads = std::stoul(argv[++i]);
+      } else if (arg == "--mosaic" && i + 1 < argc) {
+        mosaic_specs.push_back(argv[++i]);
+      } else {
+        std::cerr << "Usage: " << argv[0] << " [--source SPEC] [--frames N] [--colors truecolor|256|16]"
+                  << " [--glyphs ascii|half|braille|shape] [--edges [T]] [--incremental [NOISE]]"
+                  << " [--profile PREFIX [--trace] [--budget MS]] [--record PATH] [--serve ADDR]\n"
+                  << "       " << argv[0] << " [--source SPEC] [--frames N] [--colors MODE] --adaptive FPS\n"
+                  << "       " << argv[0] << " --play PATH [--speed X]\n"
+                  << "       " << argv[0] << " --view ADDR\n"
+                  << "       " << argv[0] << " --convert PATH [--raw WxH[:gray|:bgr]] [--columns N] [--colors MODE]\n"
+                  << "       " << argv[0] << " --batch DIR|--batch-list FILE [--output DIR] [--columns N] [--colors MODE]"
+                  << " [--threads N]\n"
+                  << "       " << argv[0] << " --mosaic SPEC [--mosaic SPEC ...] [--columns N] [--frames N] [--colors MODE]\n"
+                  << "  ADDR: unix:PATH or tcp:PORT (localhost)\n"
+                  << "  SPEC: webcam[:N], file:PATH, images:DIR, synthetic[:PATTERN[:WxH]],\n"
+                  << "        raw:WxH[:rgb|bgr|yuyv|nv12|i420][:PATH], y4m[:PATH]" << std::endl;
+        return 1;
+      }
+    }
+  } catch (const std::exception& e) {
+    // Unknown --colors or --glyphs values and malformed numbers
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  try {
+    if (!batch_directory.empty() || !batch_list.empty()) {
+      std::vector<std::string> files = batch_directory.empty() ? readBatchList(batch_list) : listBatchDirectory(batch_directory);
+      BatchConfig batch_config;
+      batch_config.output_directory = output_directory;
+      batch_config.columns = columns_given ? columns : 0;
+      batch_config.color = colors_given;
+      batch_config.color_mode = color_mode;
+      std::unique_ptr<ThreadPool> own_pool;
+      if (threads) own_pool = std::make_unique<ThreadPool>(threads);
+      BatchStats stats = convertBatch(files, batch_config, own_pool ? *own_pool : sharedThreadPool());
+      writeBatchReport(stats, std::cout);
+      return stats.failed ? 1 : 0;
+    }
+    if (!mosaic_specs.empty()) {
+      MosaicConfig mosaic_config;
+      if (columns_given) mosaic_config.tile_width = columns;
+      mosaic_config.color_mode = color_mode;
+      outputMosaic(mosaic_specs, FRAMES_TO_PROCESS, mosaic_config);
+      return 0;
+    }
+    if (!convert_path.empty()) {
+      std::unique_ptr<StripImageFile> image;
+      if (raw_geometry.empty()) {
+        image = std::make_unique<StripImageFile>(convert_path);
+      } else {
+        int width = 0, height = 0;
+        char suffix[8] = "";
+        if (std::sscanf(raw_geometry.c_str(), "%dx%d:%7s", &width, &height, suffix) < 2) {
+          throw std::runtime_error("Bad raw geometry: " + raw_geometry);
+        }
+        std::string layout = suffix;
+        if (!layout.empty() && layout != "gray" && layout != "bgr") {
+          throw std::runtime_error("Unknown raw layout: " + layout);
+        }
+        image = std::make_unique<StripImageFile>(convert_path, width, height, layout == "gray" ? 1 : 3,
+                                                 layout == "bgr" ? PixelFormat::BGR24 : PixelFormat::RGB24);
+      }
+      StripConvertConfig convert_config;
+      convert_config.columns = columns;
+      convert_config.color = colors_given;
+      convert_config.color_mode = color_mode;
+      StripConvertStats stats = convertInStrips(*image, convert_config, STDOUT_FILENO);
+      std::cerr << image->width() << "x" << image->height() << " -> " << stats.columns << "x" << stats.rows
+                << " in " << stats.strips << " strips, peak " << stats.peak_bytes / 1024 << " KiB for "
+                << stats.source_bytes / 1024 << " KiB of pixels" << std::endl;
+      return 0;
+    }
+    if (!play_path.empty()) {
+      playRecording(play_path, speed);
+      return 0;
+    }
+    if (!view_address.empty()) {
+      viewStream(view_address, STDOUT_FILENO);
+      std::cout << "\033[0m" << std::endl;
+      return 0;
+    }
+    std::unique_ptr<FrameSource> source = openFrameSource(source_spec);
+    std::unique_ptr<StageProfiler> profiler;
+    if (!profile_prefix.empty()) {
+      // Up to six events per frame, enough for the default 65535 frames
+      size_t trace_capacity = trace ? (size_t(1) << 20) : 0;
+      auto budget = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double, std::milli>(budget_ms));
+      profiler = std::make_unique<StageProfiler>(budget, trace_capacity);
+    }
+    std::unique_ptr<AsciiRecorder> recorder;
+    if (!record_path.empty()) {
+      recorder = std::make_unique<AsciiRecorder>(record_path, color_mode, glyph_mode);
+    }
+    PipelineConfig config;
+    config.profiler = profiler.get();
+    config.recorder = recorder.get();
+    config.color_mode = color_mode;
+    config.glyph_mode = glyph_mode;
+    config.edge_threshold = edge_threshold;
+    config.incremental_noise = incremental_noise;
+    if (adaptive_fps > 0) {
+      if (glyph_mode != GlyphMode::Ascii || recorder || !serve_address.empty()) {
+        throw std::runtime_error("--adaptive only supports ASCII glyphs on the local terminal");
+      }
+      if (edge_threshold) {
+        throw std::runtime_error("--edges does not work with --adaptive");
+      }
+      if (incremental_noise >= 0) {
+        throw std::runtime_error("--incremental does not work with --adaptive");
+      }
+      AdaptiveConfig adaptive_config;
+      adaptive_config.target_fps = adaptive_fps;
+      adaptive_config.best_color_mode = color_mode;
+      AdaptiveController controller(adaptive_config);
+      outputAsciiStream(*source, FRAMES_TO_PROCESS, RenderMode::Differential, profiler.get(), &controller);
+    } else if (!serve_address.empty()) {
+      StreamServerConfig server_config;
+      server_config.color_mode = color_mode;
+      server_config.glyph_mode = glyph_mode;
+      StreamServer server(serve_address, server_config);
+      config.server = &server;
+      serveAsciiPipeline(*source, FRAMES_TO_PROCESS, config);
+    } else {
+      outputAsciiPipeline(*source, FRAMES_TO_PROCESS, config);
+    }
+    if (profiler) {
+      profiler->writeReports(profile_prefix);
+    }
+    if (recorder) {
+      recorder->close();
+      std::cout << "Recorded " << recorder->info().frame_count << " frames (" << recorder->info().keyframe_count
+                << " keyframes), " << recorder->bytesWritten() << " bytes to " << record_path << std::endl;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,293 @@
+#include "mosaic_compositor.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+
+// Light gray label text, blank cells are spaces on black
+static const uint8_t LABEL_COLOR[3] = { 200, 200, 200 };
+
+MosaicCompositor::MosaicCompositor(const MosaicConfig& config, std::vector<FrameSource*> sources, WriteFunction write,
+                                   ThreadPool& pool)
+: m_config(config), m_pool(pool), m_write(std::move(write)), m_renderer(0.5, 0, config.color_mode) {
+  for (FrameSource* source : sources) {
+    m_tiles.push_back(std::make_unique<Tile>());
+    m_tiles.back()->source = source;
+  }
+  layout();
+}
+
+MosaicCompositor::MosaicCompositor(const MosaicConfig& config, std::vector<FrameSource*> sources, TerminalWriter& writer,
+                                   ThreadPool& pool)
+: MosaicCompositor(config, std::move(sources), WriteFunction(), pool) {
+  m_writer = &writer;
+}
+
+MosaicCompositor::~MosaicCompositor() {
+  waitIdle();
+}
+
+void MosaicCompositor::layout() {
+  if (m_tiles.empty()) {
+    throw std::runtime_error("A mosaic needs at least one source");
+  }
+  if (m_config.tile_width < 1 || m_config.tile_height < 0 || m_config.grid_columns < 0 || m_config.refresh_fps < 0) {
+    throw std::runtime_error("Bad mosaic geometry");
+  }
+  int count = static_cast<int>(m_tiles.size());
+  m_grid_columns = m_config.grid_columns ? std::min(m_config.grid_columns, count)
+                                         : static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+  int grid_rows = (count + m_grid_columns - 1) / m_grid_columns;
+  m_tile_height = m_config.tile_height ? m_config.tile_height
+                                       : cellRowsFor(640, 480, m_config.tile_width, m_config.aspect_correction);
+  m_label_rows = m_config.show_labels ? 1 : 0;
+
+  // One blank column between tiles, the labels separate the rows
+  m_mosaic.resize(m_grid_columns * (m_config.tile_width + 1) - 1, grid_rows * (m_tile_height + m_label_rows));
+  std::fill(m_mosaic.glyphs.begin(), m_mosaic.glyphs.end(), ' ');
+  std::fill(m_mosaic.colors.begin(), m_mosaic.colors.end(), 0);
+  for (int i = 0; i < count; ++i) {
+    Tile& tile = *m_tiles[i];
+    tile.name = std::to_string(i + 1) + " " + tile.source->name();
+  }
+}
+
+void MosaicCompositor::capture(Tile& tile) {
+  auto started = std::chrono::steady_clock::now();
+  try {
+    if (!tile.source->read(tile.frame)) {
+      tile.ended.store(true);
+    } else {
+      // The widest grid that fits the tile at the frame's aspect
+      int columns = std::min(m_config.tile_width, tile.frame.width);
+      while (columns > 1 && cellRowsFor(tile.frame.width, tile.frame.height, columns, m_config.aspect_correction) >
+                              m_tile_height) {
+        columns--;
+      }
+      if (isYuvFormat(tile.frame.format)) {
+        tile.sampler.sample(tile.frame.yuvView(), columns, tile.back, m_config.aspect_correction);
+      } else {
+        tile.sampler.sample(tile.frame.view(), tile.frame.format, columns, tile.back, m_config.aspect_correction);
+      }
+      std::lock_guard<std::mutex> lock(tile.mutex);
+      std::swap(tile.front, tile.back);
+      tile.fresh = true;
+      tile.front_started = started;
+      tile.frames++;
+    }
+  } catch (const std::exception& e) {
+    std::lock_guard<std::mutex> lock(tile.mutex);
+    tile.error = e.what();
+    tile.ended.store(true);
+  }
+  tile.busy.store(false);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (--m_in_flight == 0) m_idle.notify_all();
+}
+
+void MosaicCompositor::waitIdle() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle.wait(lock, [this] { return m_in_flight == 0; });
+}
+
+void MosaicCompositor::writeLabel(int tile_index, Tile& tile, std::chrono::steady_clock::time_point now) {
+  // Frame rate over the last second or so
+  std::chrono::duration<double> window = now - tile.window_start;
+  if (window.count() >= 1.0) {
+    uint64_t frames = tile.frames.load();
+    tile.window_fps = (frames - tile.window_frames) / window.count();
+    tile.window_frames = frames;
+    tile.window_start = now;
+  }
+  char label[128];
+  if (tile.ended.load()) {
+    std::snprintf(label, sizeof(label), "%s %s", tile.name.c_str(), tile.error.empty() ? "ended" : "failed");
+  } else {
+    std::snprintf(label, sizeof(label), "%s %.0ffps %.0fms", tile.name.c_str(), tile.window_fps, tile.last_latency_ms);
+  }
+  int x0 = (tile_index % m_grid_columns) * (m_config.tile_width + 1);
+  size_t row = static_cast<size_t>(tile_index / m_grid_columns) * (m_tile_height + m_label_rows) * m_mosaic.width;
+  size_t length = std::strlen(label);
+  for (int x = 0; x < m_config.tile_width; ++x) {
+    size_t i = row + x0 + x;
+    m_mosaic.glyphs[i] = static_cast<size_t>(x) < length ? label[x] : ' ';
+    std::memcpy(&m_mosaic.colors[i * 3], LABEL_COLOR, 3);
+  }
+}
+
+bool MosaicCompositor::compose(std::chrono::steady_clock::time_point now) {
+  bool active = false;
+  for (size_t t = 0; t < m_tiles.size(); ++t) {
+    Tile& tile = *m_tiles[t];
+    active = active || !tile.ended.load() || tile.busy.load();
+    int index = static_cast<int>(t);
+    int x0 = (index % m_grid_columns) * (m_config.tile_width + 1);
+    int y0 = (index / m_grid_columns) * (m_tile_height + m_label_rows) + m_label_rows;
+
+    std::lock_guard<std::mutex> lock(tile.mutex);
+    if (tile.fresh) {
+      double latency = std::chrono::duration<double, std::milli>(now - tile.front_started).count();
+      tile.latency_sum_ms += latency;
+      tile.latency_max_ms = std::max(tile.latency_max_ms, latency);
+      tile.last_latency_ms = latency;
+      tile.shown++;
+      tile.fresh = false;
+
+      // Centered, the rest of the tile blank
+      const CellGrid& cells = tile.front;
+      int dx = (m_config.tile_width - cells.width) / 2, dy = (m_tile_height - cells.height) / 2;
+      for (int y = 0; y < m_tile_height; ++y) {
+        size_t row = static_cast<size_t>(y0 + y) * m_mosaic.width + x0;
+        int sy = y - dy;
+        for (int x = 0; x < m_config.tile_width; ++x) {
+          int sx = x - dx;
+          bool inside = sy >= 0 && sy < cells.height && sx >= 0 && sx < cells.width;
+          size_t source = inside ? static_cast<size_t>(sy) * cells.width + sx : 0;
+          m_mosaic.glyphs[row + x] = inside ? cells.glyphs[source] : ' ';
+          uint8_t* color = &m_mosaic.colors[(row + x) * 3];
+          if (inside) {
+            std::memcpy(color, &cells.colors[source * 3], 3);
+          } else {
+            std::memset(color, 0, 3);
+          }
+        }
+      }
+    }
+    if (m_label_rows) writeLabel(index, tile, now);
+  }
+  return active;
+}
+
+void MosaicCompositor::refresh() {
+  if (m_writer && !m_writer->ready()) {
+    // The terminal is still taking the last refresh, rendering this one would be wasted
+    m_skipped++;
+    return;
+  }
+  size_t required = DiffRenderer::bufferSize(m_mosaic.width, m_mosaic.height, m_config.color_mode);
+  if (m_text.getSize() < required) {
+    m_text = RawImage(static_cast<int>(required), 1, 1);
+  }
+  RenderStats render_stats = m_renderer.render(m_mosaic, m_text);
+  const char* text = reinterpret_cast<const char*>(m_text.getData());
+  if (m_writer) {
+    if (!m_writer->writeFrame(text, render_stats.bytes_written)) {
+      m_renderer.invalidate(); // The screen never saw this refresh
+      m_skipped++;
+      return;
+    }
+  } else if (m_write) {
+    m_write(text, render_stats.bytes_written);
+  }
+  m_bytes_written += render_stats.bytes_written;
+}
+
+void MosaicCompositor::run() {
+  auto start = std::chrono::steady_clock::now();
+  for (std::unique_ptr<Tile>& tile : m_tiles) tile->window_start = start;
+  auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(m_config.refresh_fps > 0 ? 1.0 / m_config.refresh_fps : 0.0));
+  auto deadline = start;
+
+  while (!m_stop.load() && (m_config.max_refreshes == 0 || m_refreshes < m_config.max_refreshes)) {
+    for (std::unique_ptr<Tile>& tile_ptr : m_tiles) {
+      Tile* tile = tile_ptr.get();
+      if (tile->ended.load()) continue;
+      if (tile->busy.exchange(true)) {
+        tile->busy_refreshes++;
+        continue;
+      }
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_in_flight++;
+      }
+      m_pool.submit([this, tile] { capture(*tile); });
+    }
+
+    if (m_config.refresh_fps > 0) {
+      // Behind schedule the next refresh is due now, missed ones are not made up
+      deadline = std::max(deadline + interval, std::chrono::steady_clock::now());
+      std::this_thread::sleep_until(deadline);
+    } else {
+      waitIdle();
+    }
+    bool active = compose(std::chrono::steady_clock::now());
+    refresh();
+    m_refreshes++;
+    if (!active) break;
+  }
+  waitIdle();
+  m_wall_ns = static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+MosaicStats MosaicCompositor::stats() const {
+  MosaicStats result;
+  result.refreshes = m_refreshes;
+  result.skipped = m_skipped;
+  result.bytes_written = m_bytes_written;
+  result.wall_ns = m_wall_ns;
+  for (const std::unique_ptr<Tile>& tile : m_tiles) {
+    MosaicSourceStats source;
+    source.name = tile->name;
+    source.frames = tile->frames.load();
+    source.shown = tile->shown;
+    source.busy_refreshes = tile->busy_refreshes;
+    source.fps = m_wall_ns ? source.frames * 1e9 / m_wall_ns : 0;
+    source.mean_latency_ms = tile->shown ? tile->latency_sum_ms / tile->shown : 0;
+    source.max_latency_ms = tile->latency_max_ms;
+    source.ended = tile->ended.load();
+    {
+      std::lock_guard<std::mutex> lock(tile->mutex);
+      source.error = tile->error;
+    }
+    result.sources.push_back(source);
+  }
+  return result;
+}
+
+
+void writeMosaicReport(const MosaicStats& stats, std::ostream& out) {
+  char line[256];
+  std::snprintf(line, sizeof(line), "%zu sources, %llu refreshes (%.1f/s), %llu skipped, %llu bytes\n",
+                stats.sources.size(), static_cast<unsigned long long>(stats.refreshes), stats.refreshesPerSecond(),
+                static_cast<unsigned long long>(stats.skipped), static_cast<unsigned long long>(stats.bytes_written));
+  out << line;
+  for (const MosaicSourceStats& source : stats.sources) {
+    std::snprintf(line, sizeof(line),
+                  "%s: %llu frames (%.1f fps), %llu shown, latency %.1f ms mean %.1f ms max, %llu busy refreshes",
+                  source.name.c_str(), static_cast<unsigned long long>(source.frames), source.fps,
+                  static_cast<unsigned long long>(source.shown), source.mean_latency_ms, source.max_latency_ms,
+                  static_cast<unsigned long long>(source.busy_refreshes));
+    out << line;
+    if (!source.error.empty()) out << ", failed: " << source.error;
+    out << "\n";
+  }
+}
+
+void outputMosaic(const std::vector<std::string>& specs, size_t REFRESHES, const MosaicConfig& config) {
+  std::vector<std::unique_ptr<FrameSource>> sources;
+  std::vector<FrameSource*> pointers;
+  for (const std::string& spec : specs) {
+    sources.push_back(openFrameSource(spec));
+    pointers.push_back(sources.back().get());
+  }
+  MosaicConfig mosaic_config = config;
+  mosaic_config.max_refreshes = REFRESHES;
+
+  MosaicStats stats;
+  {
+    // A terminal that cannot keep up skips refreshes instead of stalling the sources
+    TerminalWriter writer(STDOUT_FILENO, WriteMode::NonBlocking);
+    MosaicCompositor compositor(mosaic_config, pointers, writer);
+    compositor.run();
+    writer.flush();
+    stats = compositor.stats();
+  }
+  std::cout << "\033[0m";
+  writeMosaicReport(stats, std::cout);
+}
@@ -0,0 +1,146 @@
+#include "parallel_convert.hpp"
+#include "ascii_image.hpp"
+#include "ascii_kernels.hpp"
+#include "ansi_emitter.hpp"
+#include "pixel_layout.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+// Several bands per thread keeps the load balanced when rows differ in cost
+static const size_t BANDS_PER_THREAD = 4;
+static const int MIN_ROWS_PER_BAND = 8;
+
+static size_t bandCount(int height, const ThreadPool& pool) {
+  size_t by_rows = static_cast<size_t>((height + MIN_ROWS_PER_BAND - 1) / MIN_ROWS_PER_BAND);
+  return std::max<size_t>(1, std::min(by_rows, pool.threadCount() * BANDS_PER_THREAD));
+}
+
+static int bandStart(size_t band, size_t bands, int height) {
+  return static_cast<int>(band * static_cast<size_t>(height) / bands);
+}
+
+RawImage convertToAsciiParallel(const RawImageView& source_image, ThreadPool& pool) {
+  int width = source_image.getWidth();
+  int height = source_image.getHeight();
+
+  // One glyph per pixel, a '\n' after each row and a terminating NUL
+  RawImage target_image((width + 1) * height + 1, 1, 1);
+  char* target_data = reinterpret_cast<char*>(target_image.getData());
+
+  size_t bands = bandCount(height, pool);
+  dispatchPixelLayout(pixelLayoutFor(source_image.getChannels()), [&](auto tag) {
+    pool.parallelFor(bands, [&](size_t band) {
+      int y_end = bandStart(band + 1, bands, height);
+      for (int y = bandStart(band, bands, height); y < y_end; ++y) {
+        char* row = target_data + static_cast<size_t>(y) * (width + 1);
+        rowToGlyphs<decltype(tag)::value>(source_image.getRow(y), width, row);
+        row[width] = '\n';
+      }
+    });
+  });
+  target_data[static_cast<size_t>(width + 1) * height] = '\0';
+  return target_image;
+}
+
+// Converts every band of rows of layout L into its worst-case region. ColorAt(x, y, pixel, r, g, b)
+// picks the cell color, the glyph always comes from the source pixel.
+template <PixelLayout L, typename ColorAt>
+static size_t convertColoredBands(const RawImageView& source_image, RawImage& target, std::vector<AsciiSegment>& segments,
+                                  ThreadPool& pool, int color_tolerance, ColorAt color_at) {
+  int width = source_image.getWidth();
+  int height = source_image.getHeight();
+
+  if (target.getSize() < coloredAsciiBufferSize(width, height)) {
+    throw std::runtime_error("Target buffer too small for colored ASCII output");
+  }
+  char* buffer = reinterpret_cast<char*>(target.getData());
+  size_t row_capacity = static_cast<size_t>(width) * (TRUECOLOR_SGR_MAX_SIZE + 1) + 1;
+
+  size_t bands = bandCount(height, pool);
+  segments.assign(bands + 1, AsciiSegment{ nullptr, 0 });
+  pool.parallelFor(bands, [&](size_t band) {
+    int y_begin = bandStart(band, bands, height);
+    int y_end = bandStart(band + 1, bands, height);
+    char* start = buffer + static_cast<size_t>(y_begin) * row_capacity;
+    TruecolorEmitter emitter(start, color_tolerance);
+
+    // Without tolerance the color in effect is exactly the previous cell's,
+    // continuing from it keeps the joined output identical to the sequential one
+    if (color_tolerance == 0 && y_begin > 0 && width > 0) {
+      uint8_t r, g, b;
+      color_at(width - 1, y_begin - 1, source_image.getRow(y_begin - 1) + (width - 1) * PixelReader<L>::CHANNELS, r, g, b);
+      emitter.assumeColor(r, g, b);
+    }
+
+    thread_local std::vector<char> glyphs;
+    glyphs.resize(width);
+    for (int y = y_begin; y < y_end; ++y) {
+      const uint8_t* row = source_image.getRow(y);
+      rowToGlyphs<L>(row, width, glyphs.data());
+      for (int x = 0; x < width; ++x) {
+        uint8_t r, g, b;
+        color_at(x, y, row + x * PixelReader<L>::CHANNELS, r, g, b);
+        emitter.put(r, g, b, glyphs[x]);
+      }
+      emitter.putChar('\n');
+    }
+    segments[band] = AsciiSegment{ start, emitter.size() };
+  });
+
+  // Color reset after the last band's region
+  char* reset = buffer + static_cast<size_t>(height) * row_capacity;
+  std::memcpy(reset, "\033[0m", COLOR_RESET_SIZE);
+  segments[bands] = AsciiSegment{ reset, COLOR_RESET_SIZE };
+
+  size_t total = 0;
+  for (const AsciiSegment& segment : segments) total += segment.size;
+  return total;
+}
+
+size_t convertToColoredAsciiBands(const RawImageView& source_image, RawImage& target,
+                                  std::vector<AsciiSegment>& segments, ThreadPool& pool, int color_tolerance) {
+  return dispatchPixelLayout(pixelLayoutFor(source_image.getChannels()), [&](auto tag) {
+    constexpr PixelLayout L = decltype(tag)::value;
+    return convertColoredBands<L>(source_image, target, segments, pool, color_tolerance,
+                                  [](int, int, const uint8_t* pixel, uint8_t& r, uint8_t& g, uint8_t& b) {
+                                    PixelReader<L>::rgb(pixel, r, g, b);
+                                  });
+  });
+}
+
+size_t convertToRainbowAsciiBands(const RawImageView& img, int scroll_offset, RawImage& target,
+                                  std::vector<AsciiSegment>& segments, ThreadPool& pool, int color_tolerance) {
+  return dispatchPixelLayout(pixelLayoutFor(img.getChannels()), [&](auto tag) {
+    return convertColoredBands<decltype(tag)::value>(
+      img, target, segments, pool, color_tolerance,
+      [scroll_offset](int x, int y, const uint8_t*, uint8_t& r, uint8_t& g, uint8_t& b) {
+        getRainbowColor(x, y, scroll_offset, r, g, b);
+      });
+  });
+}
+
+size_t joinAsciiSegments(RawImage& target, const std::vector<AsciiSegment>& segments) {
+  char* begin = reinterpret_cast<char*>(target.getData());
+  char* p = begin;
+  for (const AsciiSegment& segment : segments) {
+    // Segments are in buffer order, so the write position never passes a segment start
+    if (segment.data != p) std::memmove(p, segment.data, segment.size);
+    p += segment.size;
+  }
+  *p = '\0';
+  return static_cast<size_t>(p - begin);
+}
+
+size_t convertToColoredAsciiParallel(const RawImageView& source_image, RawImage& target, ThreadPool& pool,
+                                     int color_tolerance) {
+  std::vector<AsciiSegment> segments;
+  convertToColoredAsciiBands(source_image, target, segments, pool, color_tolerance);
+  return joinAsciiSegments(target, segments);
+}
+
+size_t convertToRainbowAsciiParallel(const RawImageView& img, int scroll_offset, RawImage& target, ThreadPool& pool,
+                                     int color_tolerance) {
+  std::vector<AsciiSegment> segments;
+  convertToRainbowAsciiBands(img, scroll_offset, target, segments, pool, color_tolerance);
+  return joinAsciiSegments(target, segments);
+}
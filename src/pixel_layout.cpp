@@ -0,0 +1,50 @@
+#include "pixel_layout.hpp"
+#include <stdexcept>
+#include <string>
+
+PixelLayout pixelLayoutFor(int channels) {
+  switch (channels) {
+    case 1: return PixelLayout::Gray;
+    case 2: return PixelLayout::GrayA;
+    case 3: return PixelLayout::RGB;
+    case 4: return PixelLayout::RGBA;
+  }
+  throw std::runtime_error("No pixel layout has " + std::to_string(channels) + " channels");
+}
+
+const char* pixelLayoutName(PixelLayout layout) {
+  switch (layout) {
+    case PixelLayout::Gray: return "gray";
+    case PixelLayout::GrayA: return "gray+alpha";
+    case PixelLayout::RGB: return "rgb";
+    case PixelLayout::RGBA: return "rgba";
+    case PixelLayout::BGR: return "bgr";
+  }
+  return "unknown";
+}
+
+void checkPixelLayout(const RawImageView& view, PixelLayout layout) {
+  if (view.getChannels() != pixelLayoutChannels(layout)) {
+    throw std::runtime_error(std::string("A ") + pixelLayoutName(layout) + " image needs " +
+                             std::to_string(pixelLayoutChannels(layout)) + " channels, this one has " +
+                             std::to_string(view.getChannels()));
+  }
+}
+
+RawImage convertToRgb(const RawImageView& view, PixelLayout layout) {
+  checkPixelLayout(view, layout);
+  int width = view.getWidth();
+  int height = view.getHeight();
+  RawImage rgb(width, height, 3);
+  dispatchPixelLayout(layout, [&](auto tag) {
+    using Reader = PixelReader<decltype(tag)::value>;
+    uint8_t* out = rgb.getData();
+    for (int y = 0; y < height; ++y) {
+      const uint8_t* p = view.getRow(y);
+      for (int x = 0; x < width; ++x, p += Reader::CHANNELS, out += 3) {
+        Reader::rgb(p, out[0], out[1], out[2]);
+      }
+    }
+  });
+  return rgb;
+}
@@ -0,0 +1,99 @@
+#include "rainbow_animator.hpp"
+#include "ascii_kernels.hpp"
+#include "ansi_emitter.hpp"
+#include "pixel_layout.hpp"
+#include <stdexcept>
+
+
+RainbowAnimator::RainbowAnimator(const RawImageView& img, RenderMode mode, size_t cache_limit)
+: m_mode(mode),
+  m_renderer(mode == RenderMode::Differential ? 0.5 : -1.0),
+  m_scratch(static_cast<int>(DiffRenderer::bufferSize(img.getWidth(), img.getHeight())), 1, 1),
+  m_cache_limit(cache_limit) {
+  int width = img.getWidth();
+  int height = img.getHeight();
+  m_cells.resize(width, height);
+  dispatchPixelLayout(pixelLayoutFor(img.getChannels()), [&](auto tag) {
+    for (int y = 0; y < height; ++y) {
+      rowToGlyphs<decltype(tag)::value>(img.getRow(y), width, m_cells.glyphs.data() + static_cast<size_t>(y) * width);
+    }
+  });
+  m_slots.fill(-1);
+  m_cache.reserve(RAINBOW_PERIOD);
+}
+
+void RainbowAnimator::setPhase(int phase) {
+  if (phase == m_phase) return;
+  uint8_t* color = m_cells.colors.data();
+  for (int y = 0; y < m_cells.height; ++y) {
+    for (int x = 0; x < m_cells.width; ++x, color += 3) {
+      getRainbowColor(x, y, phase, color[0], color[1], color[2]);
+    }
+  }
+  m_phase = phase;
+}
+
+AsciiSegment RainbowAnimator::frame(size_t index, RenderStats* stats) {
+  int phase = static_cast<int>(index % RAINBOW_PERIOD);
+  // A differential frame can only be replayed on top of the phase it was rendered from
+  bool cacheable = m_mode == RenderMode::FullRepaint ||
+                   (m_shown_phase >= 0 && (m_shown_phase + 1) % RAINBOW_PERIOD == phase);
+
+  if (cacheable && m_slots[phase] >= 0) {
+    const RawImage& cached = m_cache[m_slots[phase]];
+    m_hits++;
+    m_renderer_stale = true;
+    m_shown_phase = phase;
+    if (stats) *stats = m_slot_stats[phase];
+    return AsciiSegment{ reinterpret_cast<const char*>(cached.getData()), cached.getSize() - 1 };
+  }
+
+  m_misses++;
+  RenderStats frame_stats;
+  if (m_mode == RenderMode::FullRepaint) {
+    setPhase(phase);
+    TruecolorEmitter emitter(reinterpret_cast<char*>(m_scratch.getData()));
+    const uint8_t* color = m_cells.colors.data();
+    for (int y = 0; y < m_cells.height; ++y) {
+      const char* glyphs = m_cells.glyphs.data() + static_cast<size_t>(y) * m_cells.width;
+      for (int x = 0; x < m_cells.width; ++x, color += 3) {
+        emitter.put(color[0], color[1], color[2], glyphs[x]);
+      }
+      emitter.putChar('\n');
+    }
+    emitter.finish();
+    frame_stats.bytes_written = emitter.size();
+    frame_stats.changed_cells = frame_stats.total_cells = m_cells.cellCount();
+    frame_stats.full_repaint = true;
+  } else {
+    if (m_renderer_stale && m_shown_phase >= 0) {
+      // Cached frames moved the terminal on without the renderer
+      setPhase(m_shown_phase);
+      m_renderer.assumeScreen(m_cells);
+    }
+    setPhase(phase);
+    frame_stats = m_renderer.render(m_cells, m_scratch);
+  }
+  m_renderer_stale = false;
+  m_shown_phase = phase;
+  if (stats) *stats = frame_stats;
+
+  size_t bytes = frame_stats.bytes_written + 1; // NUL included
+  if (cacheable && m_cached_bytes + bytes <= m_cache_limit) {
+    m_slots[phase] = static_cast<int>(m_cache.size());
+    m_slot_stats[phase] = frame_stats;
+    m_cache.emplace_back(static_cast<int>(bytes), 1, 1, m_scratch.getData());
+    m_cached_bytes += bytes;
+  }
+  return AsciiSegment{ reinterpret_cast<const char*>(m_scratch.getData()), frame_stats.bytes_written };
+}
+
+void RainbowAnimator::invalidate() {
+  m_shown_phase = -1;
+  m_renderer_stale = false;
+  m_renderer.invalidate();
+}
+
+size_t RainbowAnimator::memoryUsage() const {
+  return m_cells.glyphs.size() + m_cells.colors.size() + m_scratch.getSize() + m_cached_bytes;
+}
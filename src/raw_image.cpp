@@ -1,4 +1,5 @@
 #include "raw_image.hpp"
+#include "buffer_pool.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include <stdexcept>
@@ -6,36 +7,60 @@
 
 RawImage::RawImage(int width, int height, int channels) 
 : m_width(width), m_height(height), m_channels(channels) {
-  m_size = static_cast<size_t>(m_width * m_height * m_channels);
+  m_size = static_cast<size_t>(m_width) * m_height * m_channels;
   m_data = new uint8_t[m_size];
   s_live_objects++;
 }
 
 RawImage::RawImage(int width, int height, int channels, const uint8_t* data)
 : m_width(width), m_height(height), m_channels(channels) {
-  m_size = static_cast<size_t>(m_width * m_height * m_channels);
+  m_size = static_cast<size_t>(m_width) * m_height * m_channels;
   m_data = new uint8_t[m_size];
   std::memcpy(m_data, data, m_size);
   s_live_objects++;
 }
 
-RawImage::RawImage(const char* filename) {
-    uint8_t* temp_data = stbi_load(filename, &m_width, &m_height, &m_channels, 0);
-    if (!temp_data) {
-        throw std::runtime_error("Failed to load image");
-    }
+RawImage::RawImage(int width, int height, int channels, BufferPool& pool)
+: m_width(width), m_height(height), m_channels(channels) {
+  m_size = static_cast<size_t>(m_width) * m_height * m_channels;
+  m_data = pool.acquire(m_size);
+  if (m_data) {
+    m_pool = &pool;
+  } else {
+    m_data = new uint8_t[m_size];
+  }
+  s_live_objects++;
+}
 
-    try {
-        m_size = static_cast<size_t>(m_width * m_height * m_channels);
-        m_data = new uint8_t[m_size];
-        std::memcpy(m_data, temp_data, m_size);
-        s_live_objects++;
-    } catch (...) {
-        stbi_image_free(temp_data); // Ensure temp_data is freed on exception
-        throw; // Re-throw the exception
-    }
-    stbi_image_free(temp_data); // Free the original image
-} 
+void RawImage::freeData() {
+  if (m_pool) {
+    m_pool->release(m_data);
+  } else if (m_decoded) {
+    stbi_image_free(m_data);
+  } else {
+    delete[] m_data;
+  }
+  m_pool = nullptr;
+  m_decoded = false;
+}
+
+RawImage::RawImage(const char* filename) : RawImage(filename, 0) {}
+
+RawImage::RawImage(const char* filename, int channels) {
+  if (channels < 0 || channels > 4) {
+    throw std::runtime_error("Images decode to 1 to 4 channels");
+  }
+  // Keep the decoder's buffer instead of copying it, the peak stays at one image
+  int stored_channels = 0;
+  m_data = stbi_load(filename, &m_width, &m_height, &stored_channels, channels);
+  if (!m_data) {
+    throw std::runtime_error("Failed to load image");
+  }
+  m_channels = channels ? channels : stored_channels;
+  m_decoded = true;
+  m_size = static_cast<size_t>(m_width) * m_height * m_channels;
+  s_live_objects++;
+}
   
 RawImage::RawImage(const RawImage &other) 
 : m_width(other.m_width), m_height(other.m_height), m_channels(other.m_channels), m_size(other.m_size) {
@@ -52,6 +77,8 @@ RawImage& RawImage::operator= (const RawImage &other)
   std::swap(m_channels, temp.m_channels);
   std::swap(m_size, temp.m_size);
   std::swap(m_data, temp.m_data);
+  std::swap(m_pool, temp.m_pool);
+  std::swap(m_decoded, temp.m_decoded);
   // No change to s_live_objects here as resources are swapped, not newly allocated/deleted in this object.
   // The temp object's destructor will handle the decrement for the old resources.
   return *this;
@@ -60,7 +87,7 @@ RawImage& RawImage::operator= (const RawImage &other)
 RawImage::~RawImage()
 {
   if(m_data) {
-    delete[] m_data;
+    freeData();
     s_live_objects--;
   }
 }
@@ -68,8 +95,10 @@ RawImage::~RawImage()
 
 RawImage::RawImage(RawImage &&other) noexcept 
 : m_width(other.m_width), m_height(other.m_height), m_channels(other.m_channels), 
-m_size(other.m_size), m_data(other.m_data) { // Corrected: m_data(other.m_data)
+m_size(other.m_size), m_data(other.m_data), m_pool(other.m_pool), m_decoded(other.m_decoded) { // Corrected: m_data(other.m_data)
   other.m_data = nullptr; // Transfering the ownership
+  other.m_pool = nullptr;
+  other.m_decoded = false;
   other.m_width = 0;
   other.m_height = 0;
   other.m_channels = 0;
@@ -81,13 +110,19 @@ RawImage& RawImage::operator= (RawImage &&other) noexcept {
   
   if (this != &other) {
   
-    delete[] m_data;    // Delete current resources
-    s_live_objects--;
+    if (m_data) {
+      freeData();    // Delete current resources
+      s_live_objects--;
+    }
   
     // Transfer ownership from 'other'
   
     m_data = other.m_data;    
   
+    m_pool = other.m_pool;    
+  
+    m_decoded = other.m_decoded;    
+  
     m_size = other.m_size;    
   
     m_width = other.m_width;    
@@ -102,6 +137,10 @@ RawImage& RawImage::operator= (RawImage &&other) noexcept {
   
     other.m_data = nullptr; 
   
+    other.m_pool = nullptr; 
+  
+    other.m_decoded = false; 
+  
     other.m_size = 0;
   
     other.m_width = 0;
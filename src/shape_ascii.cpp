@@ -0,0 +1,384 @@
+#include "shape_ascii.hpp"
+#include "ansi_emitter.hpp"
+#include "pixel_layout.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHAPE_ASCII_X86 1
+#include <immintrin.h>
+#endif
+
+struct StrokePoint
+{
+  float x, y;
+};
+
+// Polylines in bitmap coordinates, x 0..8 right and y 0..16 down. The cap
+// height runs from 2 to 14, lowercase starts at 6, a single point is a dot.
+struct StrokeGlyph
+{
+  char glyph;
+  std::vector<std::vector<StrokePoint>> strokes;
+};
+
+// Points of an ellipse around (cx, cy), closed
+static std::vector<StrokePoint> ellipse(float cx, float cy, float rx, float ry) {
+  std::vector<StrokePoint> points;
+  for (int i = 0; i <= 16; ++i) {
+    float a = static_cast<float>(i) * 3.14159265f / 8;
+    points.push_back({ cx + rx * std::cos(a), cy + ry * std::sin(a) });
+  }
+  return points;
+}
+
+static const std::vector<StrokeGlyph>& strokeGlyphs() {
+  static const std::vector<StrokeGlyph> glyphs = {
+    { ' ', {} },
+    { '.', { { { 4, 13 } } } },
+    { ',', { { { 4.5f, 12.5f }, { 3, 15.5f } } } },
+    { '\'', { { { 4, 1.5f }, { 4, 5 } } } },
+    { '"', { { { 1.5f, 1.5f }, { 1.5f, 5 } }, { { 6.5f, 1.5f }, { 6.5f, 5 } } } },
+    { '`', { { { 2.5f, 1.5f }, { 5, 4.5f } } } },
+    { ':', { { { 4, 7 } }, { { 4, 13 } } } },
+    { ';', { { { 4, 7 } }, { { 4.5f, 11.5f }, { 3, 15 } } } },
+    { '!', { { { 4, 1.5f }, { 4, 10 } }, { { 4, 13 } } } },
+    { '-', { { { 1, 9 }, { 7, 9 } } } },
+    { '_', { { { 0, 15 }, { 8, 15 } } } },
+    { '=', { { { 1, 5 }, { 7, 5 } }, { { 1, 11 }, { 7, 11 } } } },
+    { '~', { { { 0.5f, 8.5f }, { 2.5f, 6.5f }, { 5.5f, 9.5f }, { 7.5f, 7.5f } } } },
+    { '^', { { { 0.5f, 6.5f }, { 4, 1.5f }, { 7.5f, 6.5f } } } },
+    { '|', { { { 4, 0 }, { 4, 16 } } } },
+    { '/', { { { 7.5f, 0.5f }, { 0.5f, 15.5f } } } },
+    { '\\', { { { 0.5f, 0.5f }, { 7.5f, 15.5f } } } },
+    { '(', { { { 6, 0.5f }, { 3, 4.5f }, { 3, 11.5f }, { 6, 15.5f } } } },
+    { ')', { { { 2, 0.5f }, { 5, 4.5f }, { 5, 11.5f }, { 2, 15.5f } } } },
+    { '[', { { { 6, 1 }, { 2.5f, 1 }, { 2.5f, 15 }, { 6, 15 } } } },
+    { ']', { { { 2, 1 }, { 5.5f, 1 }, { 5.5f, 15 }, { 2, 15 } } } },
+    { '<', { { { 7, 3.5f }, { 1, 8.5f }, { 7, 13.5f } } } },
+    { '>', { { { 1, 3.5f }, { 7, 8.5f }, { 1, 13.5f } } } },
+    { '+', { { { 4, 4 }, { 4, 13 } }, { { 1, 8.5f }, { 7, 8.5f } } } },
+    { 'x', { { { 1, 6 }, { 7, 14 } }, { { 7, 6 }, { 1, 14 } } } },
+    { '*', { { { 4, 3.5f }, { 4, 12.5f } }, { { 1, 5 }, { 7, 11 } }, { { 7, 5 }, { 1, 11 } } } },
+    { '#', { { { 2.5f, 2 }, { 2.5f, 14 } }, { { 5.5f, 2 }, { 5.5f, 14 } }, { { 0.5f, 5.5f }, { 7.5f, 5.5f } },
+             { { 0.5f, 10.5f }, { 7.5f, 10.5f } } } },
+    { 'o', { ellipse(4, 10, 2.5f, 3.5f) } },
+    { 'O', { ellipse(4, 8, 3, 6) } },
+    { 'T', { { { 0.5f, 2 }, { 7.5f, 2 } }, { { 4, 2 }, { 4, 14.5f } } } },
+    { 'L', { { { 1.5f, 1.5f }, { 1.5f, 14 }, { 7, 14 } } } },
+    { 'J', { { { 6, 1.5f }, { 6, 12 }, { 4.5f, 14 }, { 1.5f, 13 } } } },
+    { '7', { { { 1, 2 }, { 7, 2 }, { 3, 14.5f } } } },
+    { 'v', { { { 1, 6 }, { 4, 14 }, { 7, 6 } } } },
+    { 'V', { { { 0.5f, 1.5f }, { 4, 14.5f }, { 7.5f, 1.5f } } } },
+    { 'Y', { { { 0.5f, 1.5f }, { 4, 8 }, { 7.5f, 1.5f } }, { { 4, 8 }, { 4, 14.5f } } } },
+    { 'A', { { { 0.5f, 14.5f }, { 4, 1.5f }, { 7.5f, 14.5f } }, { { 2, 10 }, { 6, 10 } } } },
+    { 'H', { { { 1.5f, 1.5f }, { 1.5f, 14.5f } }, { { 6.5f, 1.5f }, { 6.5f, 14.5f } }, { { 1.5f, 8 }, { 6.5f, 8 } } } },
+    { 'M', { { { 1, 14.5f }, { 1, 1.5f }, { 4, 8 }, { 7, 1.5f }, { 7, 14.5f } } } },
+    { 'W', { { { 0.5f, 1.5f }, { 2, 14.5f }, { 4, 8 }, { 6, 14.5f }, { 7.5f, 1.5f } } } },
+  };
+  return glyphs;
+}
+
+// Pixel centers closer than this to a stroke are inked, 1 to 2 pixels wide
+static const float STROKE_RADIUS = 1.0f;
+
+static float segmentDistance(float px, float py, const StrokePoint& a, const StrokePoint& b) {
+  float dx = b.x - a.x, dy = b.y - a.y;
+  float length = dx * dx + dy * dy;
+  float t = length > 0 ? std::clamp(((px - a.x) * dx + (py - a.y) * dy) / length, 0.0f, 1.0f) : 0.0f;
+  float ex = a.x + t * dx - px, ey = a.y + t * dy - py;
+  return std::sqrt(ex * ex + ey * ey);
+}
+
+static ShapeGlyph rasterize(const StrokeGlyph& source) {
+  ShapeGlyph glyph{ source.glyph, {}, 0 };
+  for (int y = 0; y < GLYPH_BITMAP_HEIGHT; ++y) {
+    for (int x = 0; x < GLYPH_BITMAP_WIDTH; ++x) {
+      bool inked = false;
+      for (const std::vector<StrokePoint>& stroke : source.strokes) {
+        for (size_t i = 0; i < stroke.size() && !inked; ++i) {
+          const StrokePoint& next = stroke[std::min(i + 1, stroke.size() - 1)];
+          inked = segmentDistance(x + 0.5f, y + 0.5f, stroke[i], next) < STROKE_RADIUS;
+        }
+      }
+      if (inked) glyph.bitmap[y] |= static_cast<uint8_t>(0x80 >> x);
+    }
+  }
+  // A cell bit is set when at least 2 of its 2x2 pixels are
+  const int block_width = GLYPH_BITMAP_WIDTH / SHAPE_CELL_WIDTH, block_height = GLYPH_BITMAP_HEIGHT / SHAPE_CELL_HEIGHT;
+  for (int r = 0; r < SHAPE_CELL_HEIGHT; ++r) {
+    for (int c = 0; c < SHAPE_CELL_WIDTH; ++c) {
+      int count = 0;
+      for (int y = r * block_height; y < (r + 1) * block_height; ++y) {
+        for (int x = c * block_width; x < (c + 1) * block_width; ++x) count += (glyph.bitmap[y] >> (7 - x)) & 1;
+      }
+      if (count * 2 >= block_width * block_height) glyph.mask |= 1u << (r * SHAPE_CELL_WIDTH + c);
+    }
+  }
+  return glyph;
+}
+
+// The glyph masks padded with copies of the first to a multiple of 8, for the SIMD kernels
+struct GlyphMasks
+{
+  std::vector<uint32_t> masks;
+  int count;
+};
+
+static const GlyphMasks& glyphMasks() {
+  static const GlyphMasks masks = [] {
+    GlyphMasks m;
+    const std::vector<ShapeGlyph>& glyphs = shapeGlyphs();
+    m.count = static_cast<int>(glyphs.size());
+    for (const ShapeGlyph& glyph : glyphs) m.masks.push_back(glyph.mask);
+    while (m.masks.size() % 8) m.masks.push_back(glyphs[0].mask);
+    return m;
+  }();
+  return masks;
+}
+
+// Distance in the upper bits and index in the low byte: the smallest key is
+// the nearest glyph, the lowest index among equals
+static int nearestScalar(uint32_t pattern) {
+  const GlyphMasks& m = glyphMasks();
+  uint32_t best = UINT32_MAX;
+  for (int i = 0; i < m.count; ++i) {
+    uint32_t distance = static_cast<uint32_t>(__builtin_popcount(m.masks[i] ^ pattern));
+    best = std::min(best, distance << 8 | static_cast<uint32_t>(i));
+  }
+  return static_cast<int>(best & 0xFF);
+}
+
+#ifdef SHAPE_ASCII_X86
+
+// Keys of at most 32 << 8 | 63 fit a signed 16-bit lane, so pminsw (SSE2)
+// finds the smallest; the upper halves of the 32-bit lanes stay 0
+__attribute__((target("ssse3")))
+static inline int horizontalMin(__m128i v) {
+  v = _mm_min_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_min_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+// Bits set in each 32-bit lane: nibble counts from a pshufb table, summed to
+// 16 bits with maddubs and to 32 bits with madd, keyed like nearestScalar.
+// The padding copies of glyph 0 never win, their index is higher.
+__attribute__((target("ssse3")))
+static int nearestSsse3(uint32_t pattern) {
+  const GlyphMasks& m = glyphMasks();
+  const __m128i nibbles = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m128i low = _mm_set1_epi8(0x0F);
+  const __m128i ones8 = _mm_set1_epi8(1);
+  const __m128i ones16 = _mm_set1_epi16(1);
+  const __m128i p = _mm_set1_epi32(static_cast<int>(pattern));
+  __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+  const __m128i step = _mm_set1_epi32(4);
+  __m128i best = _mm_set1_epi32(0x7FFF);
+  for (int i = 0; i < m.count; i += 4) {
+    __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(m.masks.data() + i)), p);
+    __m128i bytes = _mm_add_epi8(_mm_shuffle_epi8(nibbles, _mm_and_si128(x, low)),
+                                 _mm_shuffle_epi8(nibbles, _mm_and_si128(_mm_srli_epi16(x, 4), low)));
+    __m128i distance = _mm_madd_epi16(_mm_maddubs_epi16(bytes, ones8), ones16);
+    best = _mm_min_epi16(best, _mm_or_si128(_mm_slli_epi32(distance, 8), index));
+    index = _mm_add_epi32(index, step);
+  }
+  return horizontalMin(best) & 0xFF;
+}
+
+__attribute__((target("avx2")))
+static int nearestAvx2(uint32_t pattern) {
+  const GlyphMasks& m = glyphMasks();
+  const __m256i nibbles = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0F);
+  const __m256i ones8 = _mm256_set1_epi8(1);
+  const __m256i ones16 = _mm256_set1_epi16(1);
+  const __m256i p = _mm256_set1_epi32(static_cast<int>(pattern));
+  __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256i step = _mm256_set1_epi32(8);
+  __m256i best = _mm256_set1_epi32(0x7FFF);
+  for (int i = 0; i < m.count; i += 8) {
+    __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(m.masks.data() + i)), p);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(nibbles, _mm256_and_si256(x, low)),
+                                    _mm256_shuffle_epi8(nibbles, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+    __m256i distance = _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, ones8), ones16);
+    best = _mm256_min_epi16(best, _mm256_or_si256(_mm256_slli_epi32(distance, 8), index));
+    index = _mm256_add_epi32(index, step);
+  }
+  return horizontalMin(_mm_min_epi16(_mm256_castsi256_si128(best), _mm256_extracti128_si256(best, 1))) & 0xFF;
+}
+
+#endif // SHAPE_ASCII_X86
+
+const std::vector<ShapeGlyph>& shapeGlyphs() {
+  static const std::vector<ShapeGlyph> glyphs = [] {
+    std::vector<ShapeGlyph> rasterized;
+    for (const StrokeGlyph& glyph : strokeGlyphs()) rasterized.push_back(rasterize(glyph));
+    return rasterized;
+  }();
+  return glyphs;
+}
+
+int nearestShapeGlyph(AsciiKernel kernel, uint32_t pattern) {
+#ifdef SHAPE_ASCII_X86
+  switch (kernel) {
+    case AsciiKernel::AVX2: return nearestAvx2(pattern);
+    case AsciiKernel::SSSE3: return nearestSsse3(pattern);
+    default: return nearestScalar(pattern);
+  }
+#else
+  (void)kernel;
+  return nearestScalar(pattern);
+#endif
+}
+
+int nearestShapeGlyph(uint32_t pattern) {
+  return nearestShapeGlyph(getAsciiKernel(), pattern);
+}
+
+
+ShapeMatcher::ShapeMatcher(AsciiKernel kernel) : m_cache(size_t(1) << CACHE_BITS), m_kernel(kernel) {
+  shapeGlyphs(); // Rasterize now rather than during the first frame
+}
+
+char ShapeMatcher::glyphFor(uint32_t pattern) {
+  Entry& entry = m_cache[(pattern * 2654435761u) >> (32 - CACHE_BITS)];
+  if (entry.glyph < 0 || entry.pattern != pattern) {
+    entry.pattern = pattern;
+    entry.glyph = static_cast<int16_t>(nearestShapeGlyph(m_kernel, pattern));
+    m_misses++;
+  } else {
+    m_hits++;
+  }
+  return shapeGlyphs()[entry.glyph].glyph;
+}
+
+
+ShapeCell packShapeCell(const uint8_t* const luma[SHAPE_CELL_HEIGHT], int x, int width) {
+  ShapeCell cell;
+  int sum = 0, count = 0, lo = 255, hi = 0;
+  int columns = std::min(SHAPE_CELL_WIDTH, width - x);
+  for (int r = 0; r < SHAPE_CELL_HEIGHT; ++r) {
+    if (!luma[r]) continue;
+    for (int c = 0; c < columns; ++c) {
+      int v = luma[r][x + c];
+      sum += v;
+      lo = std::min(lo, v);
+      hi = std::max(hi, v);
+      count++;
+    }
+  }
+  if (count == 0) return cell;
+  cell.mean = sum / count;
+  cell.contrast = hi - lo;
+  for (int r = 0; r < SHAPE_CELL_HEIGHT; ++r) {
+    if (!luma[r]) continue;
+    for (int c = 0; c < columns; ++c) {
+      // No branch, in noisy cells it would be mispredicted half the time
+      cell.pattern |= static_cast<uint32_t>(luma[r][x + c] > cell.mean) << (r * SHAPE_CELL_WIDTH + c);
+    }
+  }
+  return cell;
+}
+
+char shapeCellGlyph(const ShapeCell& cell, ShapeMatcher& matcher) {
+  if (cell.contrast < SHAPE_MIN_CONTRAST) return GLYPH_TABLE[cell.mean];
+  return matcher.glyphFor(cell.pattern);
+}
+
+
+size_t shapeAsciiBufferSize(int width, int height) {
+  size_t columns = static_cast<size_t>(width + SHAPE_CELL_WIDTH - 1) / SHAPE_CELL_WIDTH;
+  size_t rows = static_cast<size_t>(height + SHAPE_CELL_HEIGHT - 1) / SHAPE_CELL_HEIGHT;
+  return rows * (columns + 1) + 1;
+}
+
+size_t coloredShapeAsciiBufferSize(int width, int height) {
+  size_t columns = static_cast<size_t>(width + SHAPE_CELL_WIDTH - 1) / SHAPE_CELL_WIDTH;
+  size_t rows = static_cast<size_t>(height + SHAPE_CELL_HEIGHT - 1) / SHAPE_CELL_HEIGHT;
+  return rows * (columns * (TRUECOLOR_SGR_MAX_SIZE + 1) + 1) + COLOR_RESET_SIZE + 1;
+}
+
+// Luma of the (up to) 8 RGB rows of cell row `cell_y`, missing rows are nullptr
+static void lumaRows(const RawImageView& img, int cell_y, std::vector<uint8_t>& buffer,
+                     const uint8_t* luma[SHAPE_CELL_HEIGHT]) {
+  int width = img.getWidth();
+  for (int r = 0; r < SHAPE_CELL_HEIGHT; ++r) {
+    int y = cell_y * SHAPE_CELL_HEIGHT + r;
+    if (y >= img.getHeight()) {
+      luma[r] = nullptr;
+      continue;
+    }
+    uint8_t* row = buffer.data() + static_cast<size_t>(r) * width;
+    convertRowToGray(img.getRow(y), width, row);
+    luma[r] = row;
+  }
+}
+
+RawImage convertToShapeAscii(const RawImageView& img) {
+  if (img.getChannels() != 3) {
+    return convertToShapeAscii(convertToRgb(img, pixelLayoutFor(img.getChannels())));
+  }
+  int width = img.getWidth();
+  int height = img.getHeight();
+  thread_local ShapeMatcher matcher;
+  RawImage target(static_cast<int>(shapeAsciiBufferSize(width, height)), 1, 1);
+  std::vector<uint8_t> buffer(static_cast<size_t>(width) * SHAPE_CELL_HEIGHT);
+  char* p = reinterpret_cast<char*>(target.getData());
+
+  for (int cell_y = 0; cell_y * SHAPE_CELL_HEIGHT < height; ++cell_y) {
+    const uint8_t* luma[SHAPE_CELL_HEIGHT];
+    lumaRows(img, cell_y, buffer, luma);
+    for (int x = 0; x < width; x += SHAPE_CELL_WIDTH) *p++ = shapeCellGlyph(packShapeCell(luma, x, width), matcher);
+    *p++ = '\n';
+  }
+  *p = '\0';
+  return target;
+}
+
+char* writeColoredShapeText(const RawImageView& img, char* out, int color_tolerance, ShapeMatcher& matcher) {
+  int width = img.getWidth();
+  int height = img.getHeight();
+  std::vector<uint8_t> buffer(static_cast<size_t>(width) * SHAPE_CELL_HEIGHT);
+  TruecolorEmitter emitter(out, color_tolerance);
+
+  for (int cell_y = 0; cell_y * SHAPE_CELL_HEIGHT < height; ++cell_y) {
+    const uint8_t* luma[SHAPE_CELL_HEIGHT];
+    lumaRows(img, cell_y, buffer, luma);
+    for (int x = 0; x < width; x += SHAPE_CELL_WIDTH) {
+      ShapeCell cell = packShapeCell(luma, x, width);
+      char glyph = shapeCellGlyph(cell, matcher);
+      // Mean color of the pixels the glyph draws, of all of them in flat cells
+      int flat = cell.contrast < SHAPE_MIN_CONTRAST;
+      int sum[3] = { 0, 0, 0 }, count = 0;
+      for (int r = 0; r < SHAPE_CELL_HEIGHT && luma[r]; ++r) {
+        const uint8_t* px = img.getRow(cell_y * SHAPE_CELL_HEIGHT + r) + static_cast<size_t>(x) * 3;
+        for (int c = 0; c < SHAPE_CELL_WIDTH && x + c < width; ++c, px += 3) {
+          int drawn = flat | static_cast<int>((cell.pattern >> (r * SHAPE_CELL_WIDTH + c)) & 1);
+          sum[0] += px[0] * drawn;
+          sum[1] += px[1] * drawn;
+          sum[2] += px[2] * drawn;
+          count += drawn;
+        }
+      }
+      emitter.put(static_cast<uint8_t>(sum[0] / count), static_cast<uint8_t>(sum[1] / count),
+                  static_cast<uint8_t>(sum[2] / count), glyph);
+    }
+    emitter.putChar('\n');
+  }
+  emitter.finish();
+  return emitter.end();
+}
+
+size_t convertToColoredShapeAscii(const RawImageView& img, RawImage& target, int color_tolerance) {
+  if (img.getChannels() != 3) {
+    return convertToColoredShapeAscii(convertToRgb(img, pixelLayoutFor(img.getChannels())), target, color_tolerance);
+  }
+  if (target.getSize() < coloredShapeAsciiBufferSize(img.getWidth(), img.getHeight())) {
+    throw std::runtime_error("Target buffer too small for colored shape output");
+  }
+  thread_local ShapeMatcher matcher;
+  char* begin = reinterpret_cast<char*>(target.getData());
+  return static_cast<size_t>(writeColoredShapeText(img, begin, color_tolerance, matcher) - begin);
+}
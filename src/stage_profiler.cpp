@@ -0,0 +1,194 @@
+#include "stage_profiler.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+static const char* STAGE_NAMES[PROFILE_STAGE_COUNT] = { "capture", "resize", "color", "cells", "render", "output" };
+
+const char* profileStageName(ProfileStage stage) {
+  return STAGE_NAMES[stage];
+}
+
+// Small ids for the trace viewer, in the order threads first record
+static uint32_t traceThreadId() {
+  static std::atomic<uint32_t> next_id{1};
+  thread_local uint32_t id = next_id++;
+  return id;
+}
+
+static double toMicros(uint64_t ns) {
+  return ns / 1000.0;
+}
+
+
+size_t LatencyHistogram::bucketFor(uint64_t ns) {
+  const uint64_t LINEAR = 2u << SUB_BUCKET_BITS;
+  if (ns < LINEAR) return static_cast<size_t>(ns);
+  int msb = 63 - __builtin_clzll(ns);
+  if (msb > MAX_BIT) return BUCKET_COUNT - 1;
+  uint64_t top = ns >> (msb - SUB_BUCKET_BITS); // [32, 64)
+  return static_cast<size_t>(LINEAR + (msb - SUB_BUCKET_BITS - 1) * (1u << SUB_BUCKET_BITS) +
+                             (top - (1u << SUB_BUCKET_BITS)));
+}
+
+uint64_t LatencyHistogram::bucketValue(size_t bucket) {
+  const size_t LINEAR = 2u << SUB_BUCKET_BITS;
+  if (bucket < LINEAR) return bucket;
+  size_t octave = (bucket - LINEAR) >> SUB_BUCKET_BITS;
+  uint64_t top = (1u << SUB_BUCKET_BITS) + ((bucket - LINEAR) & ((1u << SUB_BUCKET_BITS) - 1));
+  int shift = static_cast<int>(octave) + 1;
+  return (top << shift) + (uint64_t(1) << shift) / 2;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+  m_buckets[bucketFor(ns)]++;
+  m_count++;
+  m_sum += ns;
+  m_min = std::min(m_min, ns);
+  m_max = std::max(m_max, ns);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+  for (size_t i = 0; i < BUCKET_COUNT; ++i) m_buckets[i] += other.m_buckets[i];
+  m_count += other.m_count;
+  m_sum += other.m_sum;
+  m_min = std::min(m_min, other.m_min);
+  m_max = std::max(m_max, other.m_max);
+}
+
+uint64_t LatencyHistogram::percentile(double percentile) const {
+  if (m_count == 0) return 0;
+  percentile = std::min(100.0, std::max(0.0, percentile));
+  uint64_t rank = static_cast<uint64_t>(std::ceil(percentile / 100.0 * m_count));
+  // The extremes are known exactly
+  if (rank <= 1) return m_min;
+  if (rank >= m_count) return m_max;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+    seen += m_buckets[i];
+    if (seen >= rank) return std::min(m_max, std::max(m_min, bucketValue(i)));
+  }
+  return m_max;
+}
+
+
+StageProfiler::StageProfiler(std::chrono::nanoseconds frame_budget, size_t trace_capacity)
+: m_budget_ns(static_cast<uint64_t>(frame_budget.count())), m_epoch(ProfileClock::now()), m_trace(trace_capacity) {
+}
+
+void StageProfiler::record(ProfileStage stage, ProfileClock::time_point start, ProfileClock::time_point end,
+                           uint64_t frame) {
+  int64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  m_stages[stage].record(static_cast<uint64_t>(std::max<int64_t>(duration, 0)));
+  if (m_trace.empty()) return;
+
+  size_t slot = m_trace_size.fetch_add(1, std::memory_order_relaxed);
+  if (slot >= m_trace.size()) return; // Full, counted as dropped
+  m_trace[slot] = TraceEvent{ stage, traceThreadId(), frame,
+                              std::chrono::duration_cast<std::chrono::nanoseconds>(start - m_epoch).count(),
+                              duration };
+}
+
+void StageProfiler::endFrame(const FrameTiming& timing, uint64_t total_ns) {
+  m_frames.record(total_ns);
+  if (total_ns <= m_budget_ns) return;
+  m_frames_over_budget++;
+  int slowest = 0;
+  for (int i = 1; i < PROFILE_STAGE_COUNT; ++i) {
+    if (timing.stage_ns[i] > timing.stage_ns[slowest]) slowest = i;
+  }
+  m_budget_misses[slowest]++;
+}
+
+size_t StageProfiler::traceEvents() const {
+  return std::min(m_trace_size.load(), m_trace.size());
+}
+
+size_t StageProfiler::traceDropped() const {
+  return m_trace_size.load() - traceEvents();
+}
+
+static void writeHistogramJson(std::ostream& out, const LatencyHistogram& h) {
+  out << "\"count\": " << h.count() << ", \"mean_us\": " << toMicros(static_cast<uint64_t>(h.mean()))
+      << ", \"p50_us\": " << toMicros(h.percentile(50)) << ", \"p90_us\": " << toMicros(h.percentile(90))
+      << ", \"p99_us\": " << toMicros(h.percentile(99)) << ", \"max_us\": " << toMicros(h.max());
+}
+
+void StageProfiler::writeJson(std::ostream& out) const {
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+  out << "{\n  \"frame_budget_us\": " << toMicros(m_budget_ns) << ",\n  \"stages\": [\n";
+  for (int i = 0; i < PROFILE_STAGE_COUNT; ++i) {
+    out << "    { \"name\": \"" << STAGE_NAMES[i] << "\", ";
+    writeHistogramJson(out, m_stages[i]);
+    out << ", \"budget_misses\": " << m_budget_misses[i] << " }" << (i + 1 < PROFILE_STAGE_COUNT ? ",\n" : "\n");
+  }
+  out << "  ],\n  \"frame\": { ";
+  writeHistogramJson(out, m_frames);
+  out << ", \"over_budget\": " << m_frames_over_budget << " }\n}\n";
+  out.flags(flags);
+}
+
+void StageProfiler::writeCsv(std::ostream& out) const {
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+  out << "stage,count,mean_us,p50_us,p90_us,p99_us,max_us,budget_misses\n";
+  auto row = [&out](const char* name, const LatencyHistogram& h, uint64_t misses) {
+    out << name << ',' << h.count() << ',' << toMicros(static_cast<uint64_t>(h.mean())) << ','
+        << toMicros(h.percentile(50)) << ',' << toMicros(h.percentile(90)) << ',' << toMicros(h.percentile(99))
+        << ',' << toMicros(h.max()) << ',' << misses << '\n';
+  };
+  for (int i = 0; i < PROFILE_STAGE_COUNT; ++i) row(STAGE_NAMES[i], m_stages[i], m_budget_misses[i]);
+  row("frame", m_frames, m_frames_over_budget);
+  out.flags(flags);
+}
+
+void StageProfiler::writeChromeTrace(std::ostream& out) const {
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  size_t count = traceEvents();
+  for (size_t i = 0; i < count; ++i) {
+    const TraceEvent& e = m_trace[i];
+    out << "{\"name\": \"" << STAGE_NAMES[e.stage] << "\", \"cat\": \"stage\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+        << e.thread << ", \"ts\": " << e.start_ns / 1000.0 << ", \"dur\": " << e.duration_ns / 1000.0
+        << ", \"args\": {\"frame\": " << e.frame << "}}" << (i + 1 < count ? ",\n" : "\n");
+  }
+  out << "]}\n";
+  out.flags(flags);
+}
+
+void StageProfiler::writeSummary(std::ostream& out) const {
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(2);
+  auto line = [&out](const char* name, const LatencyHistogram& h, uint64_t misses) {
+    out << std::left << std::setw(8) << name << std::right << " n=" << h.count() << " | p50 "
+        << h.percentile(50) / 1e6 << " ms | p90 " << h.percentile(90) / 1e6 << " ms | p99 "
+        << h.percentile(99) / 1e6 << " ms | max " << h.max() / 1e6 << " ms | over budget " << misses << '\n';
+  };
+  for (int i = 0; i < PROFILE_STAGE_COUNT; ++i) {
+    if (m_stages[i].count() > 0) line(STAGE_NAMES[i], m_stages[i], m_budget_misses[i]);
+  }
+  line("frame", m_frames, m_frames_over_budget);
+  out.flags(flags);
+}
+
+void StageProfiler::writeReports(const std::string& prefix) const {
+  auto open = [](const std::string& filename) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+      throw std::runtime_error("Error opening file " + filename);
+    }
+    return file;
+  };
+  std::ofstream json = open(prefix + ".json");
+  writeJson(json);
+  std::ofstream csv = open(prefix + ".csv");
+  writeCsv(csv);
+  if (!m_trace.empty()) {
+    std::ofstream trace = open(prefix + ".trace.json");
+    writeChromeTrace(trace);
+  }
+}
@@ -0,0 +1,381 @@
+#include "stream_server.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Sent before a keyframe, a joining viewer's screen holds anything
+static const char CLEAR_SCREEN[] = "\033[H\033[2J";
+static const size_t CLEAR_SCREEN_SIZE = sizeof(CLEAR_SCREEN) - 1;
+
+static std::runtime_error socketError(const std::string& what, const std::string& address) {
+  return std::runtime_error("Error " + what + " " + address + ": " + std::strerror(errno));
+}
+
+// Splits "unix:PATH" / "tcp:PORT" and fills the socket address
+static int socketAddress(const std::string& address, sockaddr_storage& storage, socklen_t& length) {
+  std::memset(&storage, 0, sizeof(storage));
+  if (address.rfind("unix:", 0) == 0) {
+    std::string path = address.substr(5);
+    sockaddr_un* un = reinterpret_cast<sockaddr_un*>(&storage);
+    if (path.empty() || path.size() >= sizeof(un->sun_path)) {
+      throw std::runtime_error("Invalid Unix socket path: " + path);
+    }
+    un->sun_family = AF_UNIX;
+    std::memcpy(un->sun_path, path.c_str(), path.size() + 1);
+    length = sizeof(sockaddr_un);
+    return AF_UNIX;
+  }
+  if (address.rfind("tcp:", 0) == 0) {
+    std::string port = address.substr(4);
+    size_t end = 0;
+    unsigned long value = 0;
+    try {
+      value = std::stoul(port, &end);
+    } catch (const std::exception&) {
+      end = 0;
+    }
+    if (port.empty() || end != port.size() || value > 65535) {
+      throw std::runtime_error("Invalid TCP port: " + port);
+    }
+    sockaddr_in* in = reinterpret_cast<sockaddr_in*>(&storage);
+    in->sin_family = AF_INET;
+    in->sin_port = htons(static_cast<uint16_t>(value));
+    in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    length = sizeof(sockaddr_in);
+    return AF_INET;
+  }
+  throw std::runtime_error("Unknown stream address: " + address + " (unix:PATH or tcp:PORT)");
+}
+
+int listenOnStream(const std::string& address, std::string& bound_address) {
+  sockaddr_storage storage;
+  socklen_t length;
+  int family = socketAddress(address, storage, length);
+  int fd = ::socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) throw socketError("creating socket for", address);
+  if (family == AF_UNIX) {
+    ::unlink(reinterpret_cast<sockaddr_un*>(&storage)->sun_path); // Left behind by a server that crashed
+  } else {
+    int reuse = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  }
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&storage), length) != 0 || ::listen(fd, 16) != 0) {
+    std::runtime_error error = socketError("listening on", address);
+    ::close(fd);
+    throw error;
+  }
+  bound_address = address;
+  if (family == AF_INET) {
+    sockaddr_in bound;
+    socklen_t bound_length = sizeof(bound);
+    ::getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &bound_length);
+    bound_address = "tcp:" + std::to_string(ntohs(bound.sin_port));
+  }
+  return fd;
+}
+
+int connectToStream(const std::string& address) {
+  sockaddr_storage storage;
+  socklen_t length;
+  int family = socketAddress(address, storage, length);
+  int fd = ::socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) throw socketError("creating socket for", address);
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&storage), length) != 0) {
+    std::runtime_error error = socketError("connecting to", address);
+    ::close(fd);
+    throw error;
+  }
+  return fd;
+}
+
+
+StreamServer::StreamServer(const std::string& address, const StreamServerConfig& config)
+: m_config(config), m_renderer(0.5, 0, config.color_mode), m_key_renderer(-1.0, 0, config.color_mode) {
+  if (m_config.client_queue_depth == 0) {
+    throw std::runtime_error("Client queue depth must be at least 1");
+  }
+  if (m_config.glyph_mode != GlyphMode::Ascii) {
+    if (m_config.color_mode != ColorMode::Truecolor) {
+      throw std::runtime_error("Half-block, Braille and shape output need truecolor");
+    }
+    m_dense_renderer = std::make_unique<DenseRenderer>(m_config.glyph_mode);
+  }
+  m_listen_fd = listenOnStream(address, m_address);
+  if (address.rfind("unix:", 0) == 0) m_unix_path = address.substr(5);
+  if (::pipe2(m_wake_pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+    ::close(m_listen_fd);
+    throw std::runtime_error(std::string("Error creating pipe: ") + std::strerror(errno));
+  }
+  ::fcntl(m_listen_fd, F_SETFL, ::fcntl(m_listen_fd, F_GETFL) | O_NONBLOCK);
+  m_thread = std::thread(&StreamServer::ioLoop, this);
+}
+
+StreamServer::~StreamServer() {
+  m_stop.store(true);
+  wake();
+  m_thread.join();
+  for (auto& client : m_clients) ::close(client->fd);
+  ::close(m_listen_fd);
+  ::close(m_wake_pipe[0]);
+  ::close(m_wake_pipe[1]);
+  if (!m_unix_path.empty()) ::unlink(m_unix_path.c_str());
+}
+
+void StreamServer::wake() {
+  char byte = 1;
+  // A full pipe already has a wakeup pending
+  ssize_t ignored = ::write(m_wake_pipe[1], &byte, 1);
+  (void)ignored;
+}
+
+std::shared_ptr<RawImage> StreamServer::acquireBuffer(size_t size) {
+  // use_count() == 1 means no queue holds the buffer anymore, and only
+  // publish() adds references
+  for (std::shared_ptr<RawImage>& buffer : m_buffers) {
+    if (buffer.use_count() == 1) {
+      if (buffer->getSize() < size) *buffer = RawImage(static_cast<int>(size), 1, 1);
+      return buffer;
+    }
+  }
+  m_buffers.push_back(std::make_shared<RawImage>(static_cast<int>(size), 1, 1));
+  return m_buffers.back();
+}
+
+void StreamServer::publish(const CellGrid& cells) {
+  auto now = std::chrono::steady_clock::now();
+  size_t size = m_dense_renderer ? DenseRenderer::bufferSize(m_config.glyph_mode, cells.width, cells.height)
+                                 : DiffRenderer::bufferSize(cells.width, cells.height, m_config.color_mode);
+  bool keyframe_needed = false;
+  std::shared_ptr<RawImage> buffer, key_buffer;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& client : m_clients) {
+      if (client->queue.size() >= m_config.client_queue_depth) {
+        // Too far behind: keep only a partly sent head, the stream must stay intact
+        size_t keep = client->offset > 0 ? 1 : 0;
+        client->stats.frames_dropped += client->queue.size() - keep;
+        client->queue.resize(keep);
+        client->needs_keyframe = true;
+      }
+      keyframe_needed = keyframe_needed || client->needs_keyframe;
+    }
+    // Under the lock, queues only release buffers while holding it
+    buffer = acquireBuffer(size);
+    if (keyframe_needed && !m_dense_renderer) key_buffer = acquireBuffer(size);
+  }
+
+  QueuedFrame frame, keyframe;
+  frame.published = keyframe.published = now;
+  frame.data = buffer;
+  if (m_dense_renderer) {
+    frame.size = m_dense_renderer->render(cells, *buffer).bytes_written;
+    keyframe = frame;
+    keyframe.keyframe = true;
+  } else {
+    frame.size = m_renderer.render(cells, *buffer).bytes_written;
+    if (key_buffer) {
+      keyframe.size = m_key_renderer.render(cells, *key_buffer).bytes_written;
+      keyframe.data = key_buffer;
+      keyframe.keyframe = true;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.frames_published++;
+    m_stats.bytes_rendered += frame.size;
+    if (key_buffer) {
+      m_stats.keyframes_rendered++;
+      m_stats.bytes_rendered += keyframe.size;
+    }
+    for (auto& client : m_clients) {
+      if (!client->needs_keyframe) {
+        client->queue.push_back(frame);
+      } else if (keyframe.data) {
+        client->queue.push_back(keyframe);
+        client->needs_keyframe = false;
+      }
+      // Clients that joined after the check above wait for the next frame
+    }
+  }
+  wake();
+}
+
+void StreamServer::acceptClients() {
+  while (true) {
+    int fd = ::accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return; // EAGAIN, or a connection that went away before accept
+    auto client = std::make_unique<Client>();
+    client->fd = fd;
+    client->stats.id = m_next_id++;
+    m_clients.push_back(std::move(client));
+  }
+}
+
+bool StreamServer::sendQueued(Client& client) {
+  while (!client.queue.empty()) {
+    // Up to 8 frames per sendmsg, the head starts at the offset
+    iovec iov[16];
+    int count = 0;
+    size_t skip = client.offset;
+    for (size_t i = 0; i < client.queue.size() && count + 2 <= 16; ++i) {
+      const QueuedFrame& frame = client.queue[i];
+      const char* parts[2] = { frame.keyframe ? CLEAR_SCREEN : nullptr,
+                               reinterpret_cast<const char*>(frame.data->getData()) };
+      size_t sizes[2] = { frame.keyframe ? CLEAR_SCREEN_SIZE : 0, frame.size };
+      for (int p = 0; p < 2; ++p) {
+        if (skip >= sizes[p]) {
+          skip -= sizes[p];
+          continue;
+        }
+        iov[count].iov_base = const_cast<char*>(parts[p] + skip);
+        iov[count].iov_len = sizes[p] - skip;
+        ++count;
+        skip = 0;
+      }
+    }
+    msghdr message{};
+    message.msg_iov = iov;
+    message.msg_iovlen = static_cast<size_t>(count);
+    ssize_t n = ::sendmsg(client.fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    client.stats.bytes_sent += static_cast<uint64_t>(n);
+    client.offset += static_cast<size_t>(n);
+    auto now = std::chrono::steady_clock::now();
+    while (!client.queue.empty()) {
+      const QueuedFrame& head = client.queue.front();
+      size_t total = head.size + (head.keyframe ? CLEAR_SCREEN_SIZE : 0);
+      if (client.offset < total) break;
+      client.offset -= total;
+      double lag = std::chrono::duration<double, std::milli>(now - head.published).count();
+      client.stats.frames_sent++;
+      if (head.keyframe) client.stats.keyframes_sent++;
+      client.total_lag_ms += lag;
+      client.stats.max_lag_ms = std::max(client.stats.max_lag_ms, lag);
+      client.queue.pop_front();
+    }
+  }
+  return true;
+}
+
+void StreamServer::disconnect(size_t index) {
+  Client& client = *m_clients[index];
+  ::close(client.fd);
+  client.stats.connected = false;
+  client.stats.queued = 0;
+  client.stats.mean_lag_ms = client.stats.frames_sent ? client.total_lag_ms / client.stats.frames_sent : 0;
+  m_departed.push_back(client.stats);
+  m_clients.erase(m_clients.begin() + static_cast<std::ptrdiff_t>(index));
+}
+
+void StreamServer::ioLoop() {
+  while (!m_stop.load()) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_pollfds.clear();
+      m_pollfds.push_back({ m_wake_pipe[0], POLLIN, 0 });
+      m_pollfds.push_back({ m_listen_fd, POLLIN, 0 });
+      for (auto& client : m_clients) {
+        short events = POLLIN;
+        if (!client->queue.empty()) events |= POLLOUT;
+        m_pollfds.push_back({ client->fd, events, 0 });
+      }
+    }
+    if (::poll(m_pollfds.data(), m_pollfds.size(), 100) < 0 && errno != EINTR) {
+      break;
+    }
+    char drain[64];
+    while (::read(m_wake_pipe[0], drain, sizeof(drain)) > 0) {
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Clients accepted below are not in m_pollfds yet, only the first ones are checked
+    size_t polled = m_pollfds.size() - 2;
+    for (size_t i = std::min(polled, m_clients.size()); i-- > 0;) {
+      Client& client = *m_clients[i];
+      bool alive = !(m_pollfds[i + 2].revents & (POLLERR | POLLHUP | POLLNVAL));
+      if (alive && (m_pollfds[i + 2].revents & POLLIN)) {
+        // Viewers have nothing to say, a read of 0 means they left
+        char discard[256];
+        ssize_t n = ::recv(client.fd, discard, sizeof(discard), MSG_DONTWAIT);
+        alive = n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+      }
+      if (!alive) disconnect(i);
+    }
+    if (m_pollfds[1].revents & POLLIN) {
+      acceptClients();
+    }
+    for (size_t i = m_clients.size(); i-- > 0;) {
+      if (!sendQueued(*m_clients[i])) disconnect(i);
+    }
+  }
+}
+
+size_t StreamServer::clientCount() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_clients.size();
+}
+
+StreamServerStats StreamServer::stats() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  StreamServerStats result = m_stats;
+  for (const auto& client : m_clients) {
+    StreamClientStats stats = client->stats;
+    stats.queued = client->queue.size();
+    stats.mean_lag_ms = stats.frames_sent ? client->total_lag_ms / stats.frames_sent : 0;
+    result.clients.push_back(stats);
+  }
+  result.clients.insert(result.clients.end(), m_departed.begin(), m_departed.end());
+  return result;
+}
+
+void StreamServer::writeSummary(std::ostream& out) const {
+  StreamServerStats current = stats();
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(2);
+  out << "published " << current.frames_published << " frames (" << current.keyframes_rendered
+      << " extra keyframes), rendered " << current.bytes_rendered << " bytes\n";
+  for (const StreamClientStats& client : current.clients) {
+    out << "client " << client.id << (client.connected ? "" : " (left)") << ": sent " << client.frames_sent
+        << " | keyframes " << client.keyframes_sent << " | dropped " << client.frames_dropped << " | queued "
+        << client.queued << " | lag mean " << client.mean_lag_ms << " ms max " << client.max_lag_ms << " ms | "
+        << client.bytes_sent << " bytes\n";
+  }
+  out.flags(flags);
+}
+
+
+uint64_t viewStream(const std::string& address, int out_fd) {
+  int fd = connectToStream(address);
+  char buffer[64 * 1024];
+  uint64_t relayed = 0;
+  while (true) {
+    ssize_t n = ::read(fd, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    for (ssize_t done = 0; done < n;) {
+      ssize_t written = ::write(out_fd, buffer + done, static_cast<size_t>(n - done));
+      if (written < 0) {
+        if (errno == EINTR) continue;
+        ::close(fd);
+        throw std::runtime_error(std::string("Error writing stream: ") + std::strerror(errno));
+      }
+      done += written;
+    }
+    relayed += static_cast<uint64_t>(n);
+  }
+  ::close(fd);
+  return relayed;
+}
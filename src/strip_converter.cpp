@@ -0,0 +1,207 @@
+#include "strip_converter.hpp"
+#include "color_palette.hpp"
+#include "raw_image.hpp"
+#include "terminal_writer.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t pageSize() {
+  static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+void StripImageFile::map(const std::string& filename) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Error opening " + filename + ": " + std::strerror(errno));
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    ::close(fd);
+    throw std::runtime_error(filename + " is not a regular, non-empty file");
+  }
+  m_map_size = static_cast<size_t>(st.st_size);
+  void* data = ::mmap(nullptr, m_map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Error mapping " + filename + ": " + std::strerror(errno));
+  }
+  m_map = static_cast<const uint8_t*>(data);
+  // Rows are read front to back, let the kernel read ahead
+  ::madvise(data, m_map_size, MADV_SEQUENTIAL);
+}
+
+// Netpbm header fields are decimal numbers separated by whitespace and # comments
+static bool readHeaderNumber(const uint8_t* data, size_t size, size_t& pos, int& value) {
+  while (pos < size) {
+    if (data[pos] == '#') {
+      while (pos < size && data[pos] != '\n') ++pos;
+    } else if (std::isspace(data[pos])) {
+      ++pos;
+    } else {
+      break;
+    }
+  }
+  int64_t number = 0;
+  size_t start = pos;
+  while (pos < size && data[pos] >= '0' && data[pos] <= '9' && number <= 1 << 30) {
+    number = number * 10 + (data[pos++] - '0');
+  }
+  if (pos == start || number > 1 << 30) return false;
+  value = static_cast<int>(number);
+  return true;
+}
+
+void StripImageFile::parseNetpbmHeader(const std::string& filename) {
+  if (m_map_size < 2 || m_map[0] != 'P' || (m_map[1] != '5' && m_map[1] != '6')) {
+    throw std::runtime_error(filename + " is not a binary PPM or PGM image");
+  }
+  m_channels = m_map[1] == '6' ? 3 : 1;
+  size_t pos = 2;
+  int maxval = 0;
+  if (!readHeaderNumber(m_map, m_map_size, pos, m_width) || !readHeaderNumber(m_map, m_map_size, pos, m_height) ||
+      !readHeaderNumber(m_map, m_map_size, pos, maxval) || pos >= m_map_size || !std::isspace(m_map[pos])) {
+    throw std::runtime_error(filename + ": malformed PPM/PGM header");
+  }
+  if (maxval <= 0 || maxval > 255) {
+    throw std::runtime_error(filename + ": only 8-bit PPM/PGM images are supported");
+  }
+  m_maxval = maxval;
+  for (int v = 0; v < 256; ++v) {
+    m_scale[v] = static_cast<uint8_t>(std::min(255, (v * 255 + maxval / 2) / maxval)); // Above maxval is white
+  }
+  // A single whitespace byte separates the header from the pixels
+  m_data_offset = pos + 1;
+}
+
+StripImageFile::StripImageFile(const std::string& filename) {
+  map(filename);
+  try {
+    parseNetpbmHeader(filename);
+    if (m_width <= 0 || m_height <= 0 || (m_map_size - m_data_offset) / rowBytes() < static_cast<size_t>(m_height)) {
+      throw std::runtime_error(filename + " is truncated");
+    }
+  } catch (...) {
+    ::munmap(const_cast<uint8_t*>(m_map), m_map_size);
+    throw;
+  }
+}
+
+StripImageFile::StripImageFile(const std::string& filename, int width, int height, int channels, PixelFormat format)
+: m_width(width), m_height(height), m_channels(channels), m_format(format) {
+  if (width <= 0 || height <= 0 || (channels != 1 && channels != 3)) {
+    throw std::runtime_error("Raw images need a positive size and 1 or 3 channels");
+  }
+  map(filename);
+  if (m_map_size / rowBytes() < static_cast<size_t>(m_height)) {
+    ::munmap(const_cast<uint8_t*>(m_map), m_map_size);
+    throw std::runtime_error(filename + " is smaller than " + std::to_string(width) + "x" + std::to_string(height));
+  }
+}
+
+StripImageFile::~StripImageFile() {
+  ::munmap(const_cast<uint8_t*>(m_map), m_map_size);
+}
+
+RawImageView StripImageFile::rows(int y_begin, int y_end) const {
+  const uint8_t* begin = m_map + m_data_offset + static_cast<size_t>(y_begin) * rowBytes();
+  if (m_maxval != 255) {
+    size_t size = static_cast<size_t>(y_end - y_begin) * rowBytes();
+    m_scaled.resize(size);
+    for (size_t i = 0; i < size; ++i) m_scaled[i] = m_scale[begin[i]];
+    begin = m_scaled.data();
+  }
+  return RawImageView(begin, m_width, y_end - y_begin, m_channels);
+}
+
+void StripImageFile::release(int y_end) {
+  // Only whole pages before the first byte still needed, the page holding it stays
+  size_t end = (m_data_offset + static_cast<size_t>(y_end) * rowBytes()) / pageSize() * pageSize();
+  if (end <= m_released) return;
+  // Pages of a private read-only mapping are dropped, touching them again rereads the file
+  ::madvise(const_cast<uint8_t*>(m_map) + m_released, end - m_released, MADV_DONTNEED);
+  m_released = end;
+}
+
+size_t StripImageFile::residentBytes(int y_end) const {
+  size_t end = m_data_offset + static_cast<size_t>(y_end) * rowBytes();
+  size_t page = pageSize();
+  return std::min(m_map_size, (end + page - 1) / page * page) - m_released;
+}
+
+
+// Emits one cell row and its newline, the color reset after the last row. Returns the row's size.
+template <typename Emitter>
+static size_t emitCellRow(Emitter& emitter, const uint8_t* colors, const char* glyphs, int columns, bool last) {
+  for (int c = 0; c < columns; ++c, colors += 3) {
+    emitter.put(colors[0], colors[1], colors[2], glyphs[c]);
+  }
+  emitter.putChar('\n');
+  if (last) emitter.finish();
+  return emitter.size();
+}
+
+StripConvertStats convertInStrips(StripImageFile& image, const StripConvertConfig& config, int out_fd) {
+  if (config.columns <= 0) {
+    throw std::runtime_error("Strip conversion needs a positive column count");
+  }
+  StripConvertStats stats;
+  int width = image.width(), height = image.height();
+  int columns = std::min(config.columns, width);
+  int rows = cellRowsFor(width, height, columns, config.aspect_correction);
+  size_t row_bytes = image.rowBytes();
+  int strip_rows = static_cast<int>(std::clamp<size_t>(config.strip_bytes / row_bytes, 1, height));
+  stats.columns = columns;
+  stats.rows = rows;
+
+  image.rewind();
+  CellSampler sampler;
+  std::vector<uint8_t> colors(static_cast<size_t>(columns) * 3);
+  std::vector<char> glyphs(columns);
+  size_t text_size = config.color ? coloredAsciiBufferSize(columns, 1, config.color_mode) : static_cast<size_t>(columns) + 1;
+  RawImage text(static_cast<int>(text_size), 1, 1);
+  char* out = reinterpret_cast<char*>(text.getData());
+  TerminalWriter writer(out_fd);
+  size_t fixed_bytes = colors.size() + glyphs.size() + text.getSize();
+
+  for (int row = 0; row < rows; ++row) {
+    int y_begin = static_cast<int>(static_cast<int64_t>(row) * height / rows);
+    int y_end = static_cast<int>(static_cast<int64_t>(row + 1) * height / rows);
+    sampler.beginRow(width, image.channels(), columns);
+    for (int y = y_begin; y < y_end; y += strip_rows) {
+      int strip_end = std::min(y_end, y + strip_rows);
+      sampler.addRows(image.rows(y, strip_end));
+      stats.strips++;
+      stats.peak_bytes = std::max(stats.peak_bytes, image.residentBytes(strip_end) + image.scaledBytes() + fixed_bytes +
+                                                      sampler.scratchBytes());
+      image.release(strip_end);
+    }
+    sampler.finishRow(image.format(), colors.data(), glyphs.data());
+
+    bool last = row + 1 == rows;
+    size_t size;
+    if (!config.color) {
+      std::memcpy(out, glyphs.data(), columns);
+      out[columns] = '\n';
+      size = static_cast<size_t>(columns) + 1;
+    } else if (config.color_mode == ColorMode::Truecolor) {
+      TruecolorEmitter emitter(out);
+      size = emitCellRow(emitter, colors.data(), glyphs.data(), columns, last);
+    } else {
+      PaletteEmitter emitter(out, config.color_mode);
+      size = emitCellRow(emitter, colors.data(), glyphs.data(), columns, last);
+    }
+    writer.writeFrame(out, size);
+    stats.output_bytes += size;
+  }
+  stats.source_bytes = static_cast<uint64_t>(row_bytes) * height;
+  return stats;
+}
@@ -0,0 +1,152 @@
+#include "terminal_writer.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Linux takes at most IOV_MAX (1024) segments per writev
+static const size_t MAX_SEGMENTS_PER_CALL = 1024;
+
+
+TerminalWriter::TerminalWriter(int fd, WriteMode mode) : m_fd(fd), m_owns_fd(false), m_mode(mode) {
+  struct stat info;
+  if (mode == WriteMode::Blocking || (fstat(fd, &info) == 0 && S_ISREG(info.st_mode))) {
+    return; // Files take every write without blocking on a reader
+  }
+  // O_NONBLOCK belongs to the open file description, which stdout shares with
+  // the shell and std::cout. A private description of the same tty or pipe
+  // can be non-blocking without anyone else seeing it.
+  std::string path = "/proc/self/fd/" + std::to_string(fd);
+  int private_fd = ::open(path.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+  if (private_fd >= 0) {
+    m_fd = private_fd;
+    m_owns_fd = true;
+  } else {
+    m_poll_gated = true; // E.g. a socket, which cannot be reopened
+  }
+}
+
+TerminalWriter::TerminalWriter(const std::string& filename)
+: m_fd(::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)), m_owns_fd(true), m_mode(WriteMode::Blocking) {
+  if (m_fd < 0) {
+    throw std::runtime_error("Error opening file " + filename + ": " + std::strerror(errno));
+  }
+}
+
+TerminalWriter::~TerminalWriter() {
+  // Whatever is pending belongs to a frame that was reported as written
+  try {
+    flush();
+  } catch (...) {
+  }
+  if (m_owns_fd) ::close(m_fd);
+}
+
+void TerminalWriter::waitWritable() {
+  pollfd pfd{ m_fd, POLLOUT, 0 };
+  while (poll(&pfd, 1, -1) < 0 && errno == EINTR) {
+  }
+}
+
+// Writes as much as the descriptor takes without blocking in NonBlocking mode,
+// everything in Blocking mode. Returns the number of bytes written.
+size_t TerminalWriter::writeSegments(const AsciiSegment* segments, size_t count, size_t total) {
+  iovec iov[MAX_SEGMENTS_PER_CALL];
+  size_t done = 0;
+  size_t first = 0, skip = 0; // Current segment and bytes of it already written
+
+  while (done < total) {
+    size_t n = 0;
+    for (size_t i = first; i < count && n < MAX_SEGMENTS_PER_CALL; ++i) {
+      size_t offset = i == first ? skip : 0;
+      if (segments[i].size == offset) continue;
+      iov[n].iov_base = const_cast<char*>(segments[i].data + offset);
+      iov[n].iov_len = segments[i].size - offset;
+      n++;
+    }
+    size_t offered = 0;
+    for (size_t i = 0; i < n; ++i) offered += iov[i].iov_len;
+    if (m_poll_gated) {
+      // Only write when the descriptor has room, the write itself may still block
+      pollfd pfd{ m_fd, POLLOUT, 0 };
+      if (poll(&pfd, 1, 0) == 0) break;
+    }
+
+    ssize_t written = ::writev(m_fd, iov, static_cast<int>(n));
+    m_stats.syscalls++;
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (m_mode == WriteMode::NonBlocking) break;
+        waitWritable(); // A blocking writer on a descriptor someone else made non-blocking
+        continue;
+      }
+      throw std::runtime_error(std::string("Error writing frame: ") + std::strerror(errno));
+    }
+    if (static_cast<size_t>(written) < offered) m_stats.partial_writes++;
+    done += static_cast<size_t>(written);
+    m_stats.bytes_written += static_cast<size_t>(written);
+
+    // Advance over the written bytes
+    size_t left = static_cast<size_t>(written);
+    while (first < count && left >= segments[first].size - skip) {
+      left -= segments[first].size - skip;
+      skip = 0;
+      first++;
+    }
+    skip += left;
+  }
+  return done;
+}
+
+bool TerminalWriter::drainPending() {
+  if (m_pending_offset == m_pending.size()) return true;
+  AsciiSegment rest{ m_pending.data() + m_pending_offset, m_pending.size() - m_pending_offset };
+  m_pending_offset += writeSegments(&rest, 1, rest.size);
+  if (m_pending_offset < m_pending.size()) return false;
+  m_pending.clear();
+  m_pending_offset = 0;
+  return true;
+}
+
+bool TerminalWriter::ready() {
+  return drainPending();
+}
+
+bool TerminalWriter::writeFrame(const AsciiSegment* segments, size_t count) {
+  if (!drainPending()) {
+    m_stats.frames_skipped++;
+    return false;
+  }
+  size_t total = 0;
+  for (size_t i = 0; i < count; ++i) total += segments[i].size;
+
+  size_t done = writeSegments(segments, count, total);
+  if (done == 0 && total > 0) {
+    // Nothing of this frame went out, dropping it leaves the screen consistent
+    m_stats.frames_skipped++;
+    return false;
+  }
+  if (done < total) {
+    // Keep the tail so the frame finishes before the next one starts
+    size_t skip = done;
+    for (size_t i = 0; i < count; ++i) {
+      size_t offset = std::min(skip, segments[i].size);
+      skip -= offset;
+      m_pending.insert(m_pending.end(), segments[i].data + offset, segments[i].data + segments[i].size);
+    }
+  }
+  m_stats.frames_written++;
+  return true;
+}
+
+void TerminalWriter::flush() {
+  while (!drainPending()) {
+    waitWritable();
+  }
+}
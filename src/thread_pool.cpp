@@ -0,0 +1,101 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+
+ThreadPool::ThreadPool(size_t threads) {
+  size_t workers = threads > 1 ? threads - 1 : 0;
+  for (size_t i = 0; i < workers; ++i) {
+    m_workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_cv.notify_all();
+  for (std::thread& worker : m_workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+      if (m_tasks.empty()) return; // Stopping and drained
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    task();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  if (m_workers.empty()) {
+    task();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back(std::move(task));
+  }
+  m_cv.notify_one();
+}
+
+// Shared between the caller and helper tasks. Helpers that start after every
+// index was claimed only touch this state, never the caller's body.
+struct ParallelForState
+{
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> finished{0};
+  size_t count = 0;
+  const std::function<void(size_t)>* body = nullptr;
+  std::mutex mutex;
+  std::condition_variable done;
+  std::exception_ptr error;
+
+  void run() {
+    size_t i;
+    while ((i = next.fetch_add(1)) < count) {
+      try {
+        (*body)(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) error = std::current_exception();
+      }
+      if (finished.fetch_add(1) + 1 == count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.notify_all();
+      }
+    }
+  }
+};
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body) {
+  if (count == 0) return;
+  auto state = std::make_shared<ParallelForState>();
+  state->count = count;
+  state->body = &body;
+
+  size_t helpers = std::min(m_workers.size(), count - 1);
+  for (size_t i = 0; i < helpers; ++i) {
+    submit([state] { state->run(); });
+  }
+  state->run();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->done.wait(lock, [&state] { return state->finished.load() == state->count; });
+  if (state->error) std::rethrow_exception(state->error);
+}
+
+ThreadPool& sharedThreadPool() {
+  static ThreadPool pool;
+  return pool;
+}
@@ -0,0 +1,161 @@
+#include "yuv_image.hpp"
+#include "color_palette.hpp"
+#include <stdexcept>
+#include <type_traits>
+
+const char* yuvFormatName(YuvFormat format) {
+  switch (format) {
+    case YuvFormat::YUYV: return "yuyv";
+    case YuvFormat::NV12: return "nv12";
+    case YuvFormat::I420: return "i420";
+  }
+  return "unknown";
+}
+
+size_t yuvFrameSize(YuvFormat format, int width, int height) {
+  size_t luma = static_cast<size_t>(width) * height;
+  size_t chroma_width = static_cast<size_t>(width + 1) / 2;
+  switch (format) {
+    case YuvFormat::YUYV: return chroma_width * 4 * height;
+    case YuvFormat::NV12:
+    case YuvFormat::I420: return luma + chroma_width * 2 * ((height + 1) / 2);
+  }
+  return 0;
+}
+
+YuvImageView::YuvImageView(const uint8_t* data, int width, int height, YuvFormat format)
+: m_format(format), m_width(width), m_height(height), m_y(data) {
+  size_t chroma_width = static_cast<size_t>(width + 1) / 2;
+  switch (format) {
+    case YuvFormat::YUYV:
+      m_y_stride = m_chroma_stride = chroma_width * 4;
+      m_u = data + 1;
+      m_v = data + 3;
+      break;
+    case YuvFormat::NV12:
+      m_y_stride = width;
+      m_chroma_stride = chroma_width * 2;
+      m_u = data + static_cast<size_t>(width) * height;
+      m_v = m_u + 1;
+      break;
+    case YuvFormat::I420:
+      m_y_stride = width;
+      m_chroma_stride = chroma_width;
+      m_u = data + static_cast<size_t>(width) * height;
+      m_v = m_u + chroma_width * ((height + 1) / 2);
+      break;
+  }
+}
+
+YuvImageView::YuvImageView(YuvFormat format, int width, int height, const uint8_t* y, size_t y_stride,
+                           const uint8_t* u, const uint8_t* v, size_t chroma_stride)
+: m_format(format), m_width(width), m_height(height), m_y(y), m_u(u), m_v(format == YuvFormat::I420 ? v : u + 1),
+  m_y_stride(y_stride), m_chroma_stride(chroma_stride) {}
+
+// Calls f with the format as a compile-time constant, like dispatchPixelLayout
+template <typename F>
+static decltype(auto) dispatchYuvFormat(YuvFormat format, F&& f) {
+  switch (format) {
+    case YuvFormat::YUYV: return f(std::integral_constant<YuvFormat, YuvFormat::YUYV>());
+    case YuvFormat::NV12: return f(std::integral_constant<YuvFormat, YuvFormat::NV12>());
+    default: return f(std::integral_constant<YuvFormat, YuvFormat::I420>());
+  }
+}
+
+template <YuvFormat F>
+static void writeAscii(const YuvImageView& source_image, char* target_data) {
+  constexpr int LUMA_STEP = F == YuvFormat::YUYV ? 2 : 1;
+  int width = source_image.getWidth();
+  int height = source_image.getHeight();
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* luma = source_image.lumaRow(y);
+    char* row = target_data + static_cast<size_t>(y) * (width + 1);
+    for (int x = 0; x < width; ++x) row[x] = YUV_GLYPH_TABLE[luma[x * LUMA_STEP]];
+    row[width] = '\n';
+  }
+  target_data[static_cast<size_t>(width + 1) * height] = '\0';
+}
+
+static void writeAscii(const YuvImageView& source_image, char* target_data) {
+  dispatchYuvFormat(source_image.getFormat(), [&](auto format) {
+    writeAscii<decltype(format)::value>(source_image, target_data);
+  });
+}
+
+RawImage convertToAscii(const YuvImageView& source_image) {
+  RawImage target_image((source_image.getWidth() + 1) * source_image.getHeight() + 1, 1, 1);
+  writeAscii(source_image, reinterpret_cast<char*>(target_image.getData()));
+  return target_image;
+}
+
+size_t convertToAscii(const YuvImageView& source_image, RawImage& target) {
+  size_t size = static_cast<size_t>(source_image.getWidth() + 1) * source_image.getHeight();
+  if (target.getSize() < size + 1) {
+    throw std::runtime_error("Target buffer too small for ASCII output");
+  }
+  writeAscii(source_image, reinterpret_cast<char*>(target.getData()));
+  return size;
+}
+
+// Visits every pixel of a row pair by pair, with the chroma terms of the pair
+template <YuvFormat F, typename Visit>
+static void forEachPixel(const YuvImageView& source_image, int y, Visit&& visit) {
+  constexpr int LUMA_STEP = F == YuvFormat::YUYV ? 2 : 1;
+  constexpr int CHROMA_STEP = F == YuvFormat::YUYV ? 4 : (F == YuvFormat::NV12 ? 2 : 1);
+  constexpr int CHROMA_SHIFT = F == YuvFormat::YUYV ? 0 : 1;
+  int width = source_image.getWidth();
+  const uint8_t* luma = source_image.lumaRow(y);
+  const uint8_t* u = source_image.uRow(y >> CHROMA_SHIFT);
+  const uint8_t* v = source_image.vRow(y >> CHROMA_SHIFT);
+  int x = 0;
+  for (; x + 1 < width; x += 2, u += CHROMA_STEP, v += CHROMA_STEP) {
+    ChromaTerms chroma = chromaTerms(*u, *v);
+    visit(luma[x * LUMA_STEP], chroma);
+    visit(luma[(x + 1) * LUMA_STEP], chroma);
+  }
+  if (x < width) visit(luma[x * LUMA_STEP], chromaTerms(*u, *v));
+}
+
+template <YuvFormat F, typename Emitter>
+static void writeColored(const YuvImageView& source_image, Emitter& emitter) {
+  for (int y = 0; y < source_image.getHeight(); ++y) {
+    forEachPixel<F>(source_image, y, [&](int luma, const ChromaTerms& chroma) {
+      uint8_t r, g, b;
+      yuvToRgb(luma, chroma, r, g, b);
+      emitter.put(r, g, b, YUV_GLYPH_TABLE[luma]);
+    });
+    emitter.putChar('\n');
+  }
+}
+
+size_t convertToColoredAscii(const YuvImageView& source_image, RawImage& target, ColorMode mode) {
+  if (target.getSize() < coloredAsciiBufferSize(source_image.getWidth(), source_image.getHeight(), mode)) {
+    throw std::runtime_error("Target buffer too small for colored ASCII output");
+  }
+  char* out = reinterpret_cast<char*>(target.getData());
+  if (mode == ColorMode::Truecolor) {
+    TruecolorEmitter emitter(out);
+    dispatchYuvFormat(source_image.getFormat(), [&](auto format) {
+      writeColored<decltype(format)::value>(source_image, emitter);
+    });
+    emitter.finish();
+    return emitter.size();
+  }
+  PaletteEmitter emitter(out, mode);
+  dispatchYuvFormat(source_image.getFormat(), [&](auto format) {
+    writeColored<decltype(format)::value>(source_image, emitter);
+  });
+  emitter.finish();
+  return emitter.size();
+}
+
+void convertYuvToRgb(const YuvImageView& source_image, uint8_t* rgb) {
+  dispatchYuvFormat(source_image.getFormat(), [&](auto format) {
+    for (int y = 0; y < source_image.getHeight(); ++y) {
+      forEachPixel<decltype(format)::value>(source_image, y, [&](int luma, const ChromaTerms& chroma) {
+        yuvToRgb(luma, chroma, rgb[0], rgb[1], rgb[2]);
+        rgb += 3;
+      });
+    }
+  });
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include "adaptive_controller.hpp"
+#include "ascii_image.hpp"
+#include "cell_sampler.hpp"
+
+class AdaptiveControllerTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+// Stage times of one frame: the cell conversion, and rendering plus output
+static FrameTiming frameTiming(double cells_ms, double output_ms) {
+  FrameTiming timing;
+  timing.stage_ns[PROFILE_CAPTURE] = 30000000; // Waiting for the camera never counts
+  timing.stage_ns[PROFILE_CELLS] = static_cast<uint64_t>(cells_ms * 1e6);
+  timing.stage_ns[PROFILE_OUTPUT] = static_cast<uint64_t>(output_ms * 1e6);
+  return timing;
+}
+
+// Feeds the same frame until the settings change, returns how many it took
+static int framesUntilChange(AdaptiveController& controller, const FrameTiming& timing, int limit = 1000) {
+  for (int i = 1; i <= limit; ++i) {
+    if (controller.update(timing)) return i;
+  }
+  return -1;
+}
+
+TEST_F(AdaptiveControllerTests, SlowCellsShrinkTheWidth) {
+  AdaptiveController controller; // 30 fps, 33.3 ms
+  ASSERT_EQ(controller.settings().width, 100);
+
+  // 4 slow frames are not enough, a fast one restarts the count
+  for (int i = 0; i < 4; ++i) EXPECT_FALSE(controller.update(frameTiming(60, 5)));
+  EXPECT_FALSE(controller.update(frameTiming(10, 5)));
+  EXPECT_EQ(framesUntilChange(controller, frameTiming(60, 5)), 5);
+
+  // Twice the budget: the cell count has to halve, the width shrinks by about 1 / sqrt(2)
+  EXPECT_EQ(controller.settings().width, 71);
+  EXPECT_EQ(controller.settings().color_mode, ColorMode::Truecolor);
+  EXPECT_EQ(controller.settings().color_tolerance, 0);
+
+  // Never below the minimum, the color levers follow once the width is used up
+  while (controller.settings().width > AdaptiveConfig().min_width) {
+    ASSERT_GT(framesUntilChange(controller, frameTiming(200, 5)), 0);
+  }
+  EXPECT_EQ(controller.settings().width, AdaptiveConfig().min_width);
+  ASSERT_GT(framesUntilChange(controller, frameTiming(200, 5)), 0);
+  EXPECT_EQ(controller.settings().color_tolerance, AdaptiveController::TOLERANCE_STEP);
+}
+
+TEST_F(AdaptiveControllerTests, SlowOutputCutsBytesBeforeWidth) {
+  AdaptiveController controller;
+  const FrameTiming slow_output = frameTiming(5, 50);
+  for (int tolerance = AdaptiveController::TOLERANCE_STEP; tolerance <= AdaptiveController::MAX_TOLERANCE;
+       tolerance += AdaptiveController::TOLERANCE_STEP) {
+    ASSERT_EQ(framesUntilChange(controller, slow_output), 5);
+    EXPECT_EQ(controller.settings().color_tolerance, tolerance);
+  }
+  ASSERT_GT(framesUntilChange(controller, slow_output), 0);
+  EXPECT_EQ(controller.settings().color_mode, ColorMode::Xterm256);
+  ASSERT_GT(framesUntilChange(controller, slow_output), 0);
+  EXPECT_EQ(controller.settings().color_mode, ColorMode::Ansi16);
+  EXPECT_EQ(controller.settings().width, 100);
+  ASSERT_GT(framesUntilChange(controller, slow_output), 0);
+  EXPECT_LT(controller.settings().width, 100);
+  EXPECT_EQ(controller.adjustments(), 6u);
+}
+
+TEST_F(AdaptiveControllerTests, QualityReturnsSlowlyWhenThereIsHeadroom) {
+  AdaptiveConfig config;
+  config.max_width = 110;
+  AdaptiveController controller(config);
+  for (int i = 0; i < 4; ++i) ASSERT_GT(framesUntilChange(controller, frameTiming(5, 50)), 0);
+  AdaptiveSettings degraded = controller.settings();
+  ASSERT_EQ(degraded.color_mode, ColorMode::Xterm256);
+
+  // Frames between 60% and 100% of the budget hold the settings
+  EXPECT_EQ(framesUntilChange(controller, frameTiming(10, 15), 500), -1);
+  EXPECT_EQ(controller.settings(), degraded);
+
+  // Width first, then colors, then the tolerance, each after 60 fast frames
+  const FrameTiming fast = frameTiming(5, 5);
+  EXPECT_EQ(framesUntilChange(controller, fast), 60);
+  EXPECT_EQ(controller.settings().width, 110);
+  EXPECT_EQ(framesUntilChange(controller, fast), 60);
+  EXPECT_EQ(controller.settings().color_mode, ColorMode::Truecolor);
+  for (int i = 0; i < 3; ++i) EXPECT_EQ(framesUntilChange(controller, fast), 60);
+  EXPECT_EQ(controller.settings().color_tolerance, 0);
+  EXPECT_EQ(framesUntilChange(controller, fast), -1); // Nothing left to improve
+
+  // The palette mode the user asked for is the best it goes back to
+  AdaptiveConfig palette;
+  palette.best_color_mode = ColorMode::Ansi16;
+  EXPECT_EQ(AdaptiveController(palette).settings().color_mode, ColorMode::Ansi16);
+  AdaptiveConfig empty;
+  empty.min_width = 300;
+  EXPECT_THROW(AdaptiveController bad(empty), std::runtime_error);
+}
+
+TEST_F(AdaptiveControllerTests, WidthFitsTheTerminal) {
+  AdaptiveController controller;
+  EXPECT_EQ(controller.outputWidth(640, 480), 100); // Unknown size, no limit
+
+  controller.setTerminalSize({ 80, 0 });
+  EXPECT_EQ(controller.outputWidth(640, 480), 80);
+
+  // 24 rows leave 23 for the grid, the widest grid that still fits
+  controller.setTerminalSize({ 200, 24 });
+  int width = controller.outputWidth(640, 480);
+  EXPECT_LE(cellRowsFor(640, 480, width), 23);
+  EXPECT_GT(cellRowsFor(640, 480, width + 1), 23);
+  EXPECT_EQ(width, 58);
+
+  // Growing back never passes the terminal width
+  controller.setTerminalSize({ 104, 0 });
+  for (int i = 0; i < 10; ++i) framesUntilChange(controller, frameTiming(1, 1));
+  EXPECT_EQ(controller.settings().width, 104);
+}
+
+TEST_F(AdaptiveControllerTests, ResizeWatcherSeesSigwinch) {
+  {
+    TerminalResizeWatcher watcher;
+    EXPECT_FALSE(watcher.resized());
+    std::raise(SIGWINCH);
+    std::raise(SIGWINCH);
+    EXPECT_TRUE(watcher.resized());
+    EXPECT_FALSE(watcher.resized());
+    EXPECT_THROW(TerminalResizeWatcher second, std::runtime_error);
+  }
+  TerminalResizeWatcher again; // The first one released the handler
+
+  // Not a terminal
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  TerminalSize size = queryTerminalSize(fds[0]);
+  EXPECT_EQ(size.columns, 0);
+  EXPECT_EQ(size.rows, 0);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST_F(AdaptiveControllerTests, StreamFollowsTheController) {
+  // Every frame is slow for a 100000 fps target, the stream has to shrink without corrupting output
+  AdaptiveConfig config;
+  config.target_fps = 100000;
+  config.downgrade_frames = 2;
+  AdaptiveController controller(config);
+  SyntheticSource source(320, 240, SyntheticPattern::Noise, 40);
+  outputAsciiStream(source, 40, RenderMode::Differential, nullptr, &controller);
+  EXPECT_GT(controller.adjustments(), 0u);
+  EXPECT_TRUE(controller.settings().width < 100 || controller.settings().color_tolerance > 0);
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "ascii_image.hpp"
+#include "ansi_emitter.hpp"
+
+// Helper macro to stringify preprocessor definitions
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+
+class AnsiEmitterTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+struct Cell
+{
+  int r, g, b;
+  char glyph;
+};
+
+// Replays the SGR stream of a colored frame into one cell per glyph
+static std::vector<Cell> parseColoredFrame(const char* text, size_t len) {
+  std::vector<Cell> cells;
+  int r = -1, g = -1, b = -1;
+  size_t i = 0;
+  while (i < len) {
+    if (text[i] == '\033') {
+      if (std::strncmp(text + i, "\033[0m", 4) == 0) {
+        i += 4;
+        continue;
+      }
+      int consumed = 0;
+      EXPECT_EQ(std::sscanf(text + i, "\033[38;2;%d;%d;%dm%n", &r, &g, &b, &consumed), 3);
+      i += consumed;
+    } else {
+      if (text[i] != '\n') cells.push_back({ r, g, b, text[i] });
+      ++i;
+    }
+  }
+  return cells;
+}
+
+TEST_F(AnsiEmitterTests, SgrMatchesSprintfForEveryValue) {
+  char expected[32], actual[32];
+  for (int v = 0; v < 256; ++v) {
+    int n = std::snprintf(expected, sizeof(expected), "\033[38;2;%d;%d;%dm", v, 255 - v, (v * 7) % 256);
+    char* end = writeTruecolorSgr(actual, static_cast<uint8_t>(v), static_cast<uint8_t>(255 - v),
+                                  static_cast<uint8_t>((v * 7) % 256));
+    ASSERT_EQ(end - actual, n);
+    EXPECT_EQ(std::string(expected, n), std::string(actual, n));
+    EXPECT_LE(static_cast<size_t>(n), TRUECOLOR_SGR_MAX_SIZE);
+  }
+}
+
+TEST_F(AnsiEmitterTests, RepeatedColorIsEmittedOnce) {
+  char buffer[64];
+  TruecolorEmitter emitter(buffer);
+  emitter.put(10, 20, 30, 'a');
+  emitter.put(10, 20, 30, 'b');
+  emitter.put(10, 20, 30, 'c');
+  emitter.finish();
+  EXPECT_EQ(std::string(buffer), "\033[38;2;10;20;30mabc\033[0m");
+  EXPECT_EQ(emitter.size(), std::strlen(buffer));
+}
+
+TEST_F(AnsiEmitterTests, ToleranceComparesAgainstLastEmittedColor) {
+  char buffer[128];
+  TruecolorEmitter emitter(buffer, 2);
+  emitter.put(100, 100, 100, 'a');
+  emitter.put(102, 99, 100, 'b'); // Within tolerance
+  emitter.put(103, 100, 100, 'c'); // 3 away from the emitted color
+  emitter.finish();
+  EXPECT_EQ(std::string(buffer), "\033[38;2;100;100;100mab\033[38;2;103;100;100mc\033[0m");
+}
+
+TEST_F(AnsiEmitterTests, ColoredAsciiRendersEveryPixelColor) {
+  RawImage raw_img(TOSTRING(IMAGE_FILE_PATH));
+  int width = raw_img.getWidth();
+  int height = raw_img.getHeight();
+  RawImage colored_img(coloredAsciiBufferSize(width, height), 1, 1);
+
+  size_t written = convertToColoredAscii(raw_img, colored_img);
+  const char* text = reinterpret_cast<const char*>(colored_img.getData());
+  EXPECT_EQ(written, std::strlen(text));
+  EXPECT_LT(written, colored_img.getSize());
+
+  std::vector<Cell> cells = parseColoredFrame(text, written);
+  ASSERT_EQ(cells.size(), static_cast<size_t>(width * height));
+  const uint8_t* data = raw_img.getData();
+  for (int i = 0; i < width * height; ++i) {
+    const uint8_t* p = data + i * 3;
+    ASSERT_EQ(cells[i].r, p[0]);
+    ASSERT_EQ(cells[i].g, p[1]);
+    ASSERT_EQ(cells[i].b, p[2]);
+    ASSERT_EQ(cells[i].glyph, pixelToAscii(getGrayscaleValue(p[0], p[1], p[2])));
+  }
+}
+
+TEST_F(AnsiEmitterTests, ToleranceShrinksOutputWithinBound) {
+  RawImage raw_img(TOSTRING(IMAGE_FILE_PATH));
+  int width = raw_img.getWidth();
+  int height = raw_img.getHeight();
+  RawImage exact_img(coloredAsciiBufferSize(width, height), 1, 1);
+  RawImage lossy_img(coloredAsciiBufferSize(width, height), 1, 1);
+
+  const int tolerance = 8;
+  size_t exact_size = convertToColoredAscii(raw_img, exact_img);
+  size_t lossy_size = convertToColoredAscii(raw_img, lossy_img, tolerance);
+  EXPECT_LT(lossy_size, exact_size);
+  std::cout << "Colored frame bytes: exact " << exact_size << ", tolerance " << tolerance << " " << lossy_size
+            << std::endl;
+
+  std::vector<Cell> cells = parseColoredFrame(reinterpret_cast<const char*>(lossy_img.getData()), lossy_size);
+  ASSERT_EQ(cells.size(), static_cast<size_t>(width * height));
+  const uint8_t* data = raw_img.getData();
+  for (int i = 0; i < width * height; ++i) {
+    const uint8_t* p = data + i * 3;
+    ASSERT_LE(std::abs(cells[i].r - p[0]), tolerance);
+    ASSERT_LE(std::abs(cells[i].g - p[1]), tolerance);
+    ASSERT_LE(std::abs(cells[i].b - p[2]), tolerance);
+  }
+}
+
+TEST_F(AnsiEmitterTests, UndersizedTargetThrows) {
+  RawImage raw_img(4, 4, 3);
+  RawImage small_img(coloredAsciiBufferSize(4, 4) - 1, 1, 1);
+  EXPECT_THROW(convertToColoredAscii(raw_img, small_img), std::runtime_error);
+  EXPECT_THROW(convertToRainbowAscii(raw_img, 0, small_img), std::runtime_error);
+}
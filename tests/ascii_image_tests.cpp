@@ -24,6 +24,22 @@ TEST_F(AsciiImageTests, pixelToAsciiTest) {
   EXPECT_EQ(pixelToAscii(getGrayscaleValue(255, 255, 255)), '$');
 }
 
+TEST_F(AsciiImageTests, ConvertToAsciiPlacesNewlines) {
+  RawImage raw_img(TOSTRING(IMAGE_FILE_PATH));
+  RawImage gray_img = convertToAscii(raw_img);
+  int width = raw_img.getWidth();
+  int height = raw_img.getHeight();
+  ASSERT_EQ(gray_img.getSize(), static_cast<size_t>((width + 1) * height + 1));
+
+  const uint8_t* data = gray_img.getData();
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* row = data + y * (width + 1);
+    EXPECT_EQ(row[width], '\n') << "row " << y;
+    EXPECT_EQ(std::memchr(row, '\n', width), nullptr) << "row " << y;
+  }
+  EXPECT_EQ(data[(width + 1) * height], '\0');
+}
+
 TEST_F(AsciiImageTests, OuputGrayAsciiToFile) {
   try {
     RawImage raw_img(TOSTRING(IMAGE_FILE_PATH));
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include "ascii_image.hpp"
+#include "ascii_kernels.hpp"
+
+// Helper macro to stringify preprocessor definitions
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+
+class AsciiKernelsTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+    previous_kernel = getAsciiKernel();
+  }
+  void TearDown() override {
+    setAsciiKernel(previous_kernel);
+  }
+  AsciiKernel previous_kernel = AsciiKernel::Scalar;
+};
+
+static const AsciiKernel ALL_KERNELS[] = { AsciiKernel::Scalar, AsciiKernel::SSSE3, AsciiKernel::AVX2 };
+
+TEST_F(AsciiKernelsTests, ScalarMatchesReferenceFunctions) {
+  std::vector<uint8_t> rgb(256 * 3);
+  for (int i = 0; i < 256; ++i) {
+    rgb[i * 3] = static_cast<uint8_t>(i);
+    rgb[i * 3 + 1] = static_cast<uint8_t>(255 - i);
+    rgb[i * 3 + 2] = static_cast<uint8_t>(i * 7);
+  }
+  std::vector<char> out(256);
+  convertRowToAscii(AsciiKernel::Scalar, rgb.data(), 256, out.data());
+  for (int i = 0; i < 256; ++i) {
+    EXPECT_EQ(out[i], pixelToAscii(getGrayscaleValue(rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2])));
+  }
+}
+
+TEST_F(AsciiKernelsTests, SimdMatchesScalarOnRandomRows) {
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> byte(0, 255);
+  // Widths cover empty rows, pure tails and several full vector blocks
+  for (int width : {0, 1, 15, 16, 17, 31, 32, 33, 47, 64, 100, 257}) {
+    std::vector<uint8_t> rgb(static_cast<size_t>(width) * 3);
+    for (auto& v : rgb) v = static_cast<uint8_t>(byte(rng));
+    std::vector<char> expected(width + 1, '#'), actual(width + 1, '#');
+    convertRowToAscii(AsciiKernel::Scalar, rgb.data(), width, expected.data());
+    for (AsciiKernel kernel : ALL_KERNELS) {
+      if (!isAsciiKernelSupported(kernel)) continue;
+      std::fill(actual.begin(), actual.end(), '#');
+      convertRowToAscii(kernel, rgb.data(), width, actual.data());
+      EXPECT_EQ(expected, actual) << asciiKernelName(kernel) << " width " << width;
+    }
+  }
+}
+
+TEST_F(AsciiKernelsTests, GrayRowsMatchGetGrayscaleValue) {
+  std::mt19937 rng(99);
+  std::uniform_int_distribution<int> byte(0, 255);
+  for (int width : {0, 1, 15, 16, 17, 31, 32, 33, 64, 100, 257}) {
+    std::vector<uint8_t> rgb(static_cast<size_t>(width) * 3);
+    for (auto& v : rgb) v = static_cast<uint8_t>(byte(rng));
+    for (AsciiKernel kernel : ALL_KERNELS) {
+      if (!isAsciiKernelSupported(kernel)) continue;
+      std::vector<uint8_t> gray(width + 1, 0xAA);
+      convertRowToGray(kernel, rgb.data(), width, gray.data());
+      for (int x = 0; x < width; ++x) {
+        ASSERT_EQ(gray[x], getGrayscaleValue(rgb[x * 3], rgb[x * 3 + 1], rgb[x * 3 + 2]))
+          << asciiKernelName(kernel) << " width " << width << " x " << x;
+      }
+      EXPECT_EQ(gray[width], 0xAA) << asciiKernelName(kernel); // Nothing written past the row
+    }
+  }
+}
+
+TEST_F(AsciiKernelsTests, SimdMatchesScalarOnEveryGrayLevel) {
+  // Every exact multiple of 1000 in the luma sum is a rounding edge
+  std::vector<uint8_t> rgb;
+  for (int r = 0; r < 256; r += 3) {
+    for (int g = 0; g < 256; g += 5) {
+      for (int b = 0; b < 256; b += 17) {
+        rgb.push_back(static_cast<uint8_t>(r));
+        rgb.push_back(static_cast<uint8_t>(g));
+        rgb.push_back(static_cast<uint8_t>(b));
+      }
+    }
+  }
+  int width = static_cast<int>(rgb.size() / 3);
+  std::vector<char> expected(width), actual(width);
+  convertRowToAscii(AsciiKernel::Scalar, rgb.data(), width, expected.data());
+  for (AsciiKernel kernel : ALL_KERNELS) {
+    if (!isAsciiKernelSupported(kernel)) continue;
+    convertRowToAscii(kernel, rgb.data(), width, actual.data());
+    EXPECT_EQ(expected, actual) << asciiKernelName(kernel);
+  }
+}
+
+TEST_F(AsciiKernelsTests, ConvertToAsciiIsIdenticalForEveryKernel) {
+  RawImage raw_img(TOSTRING(IMAGE_FILE_PATH));
+  if (raw_img.getChannels() != 3) {
+    GTEST_SKIP() << "Test image is not RGB";
+  }
+  setAsciiKernel(AsciiKernel::Scalar);
+  RawImage expected = convertToAscii(raw_img);
+  for (AsciiKernel kernel : ALL_KERNELS) {
+    if (!isAsciiKernelSupported(kernel)) continue;
+    setAsciiKernel(kernel);
+    RawImage actual = convertToAscii(raw_img);
+    ASSERT_EQ(expected.getSize(), actual.getSize());
+    EXPECT_EQ(0, std::memcmp(expected.getData(), actual.getData(), expected.getSize())) << asciiKernelName(kernel);
+  }
+}
+
+TEST_F(AsciiKernelsTests, UnsupportedKernelThrows) {
+  for (AsciiKernel kernel : ALL_KERNELS) {
+    if (isAsciiKernelSupported(kernel)) {
+      EXPECT_NO_THROW(setAsciiKernel(kernel));
+    } else {
+      EXPECT_THROW(setAsciiKernel(kernel), std::runtime_error);
+    }
+  }
+}
@@ -0,0 +1,204 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "ascii_recording.hpp"
+#include "color_palette.hpp"
+#include "frame_source.hpp"
+
+class AsciiRecordingTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+static std::string recordingPath(const char* name) {
+  return (std::filesystem::temp_directory_path() / (std::string(name) + "_" + std::to_string(getpid()) + ".rec")).string();
+}
+
+// A noisy still with a small block moving across it, like a webcam on a desk
+static std::vector<CellGrid> makeSession(int width, int height, int frames) {
+  SyntheticSource source(width, height, SyntheticPattern::Noise, 1);
+  Frame frame;
+  source.read(frame);
+  CellGrid still;
+  buildColoredCells(frame.view(), still);
+  std::vector<CellGrid> session;
+  for (int i = 0; i < frames; ++i) {
+    CellGrid cells = still;
+    for (int y = height / 3; y < height / 3 + 3; ++y) {
+      for (int x = i % (width - 6); x < i % (width - 6) + 6; ++x) {
+        size_t cell = static_cast<size_t>(y) * width + x;
+        cells.glyphs[cell] = '#';
+        cells.colors[cell * 3] = static_cast<uint8_t>(40 * i);
+      }
+    }
+    session.push_back(std::move(cells));
+  }
+  return session;
+}
+
+static std::chrono::steady_clock::time_point frameTime(int i) {
+  return std::chrono::steady_clock::time_point() + std::chrono::milliseconds(33 * i + 1000);
+}
+
+static void record(const std::string& path, const std::vector<CellGrid>& session,
+                   ColorMode mode = ColorMode::Truecolor, uint32_t keyframe_interval = 10) {
+  AsciiRecorder recorder(path, mode, GlyphMode::Ascii, keyframe_interval);
+  for (size_t i = 0; i < session.size(); ++i) recorder.addFrame(session[i], frameTime(static_cast<int>(i)));
+}
+
+TEST_F(AsciiRecordingTests, FramesRoundTripExactly) {
+  std::string path = recordingPath("round_trip");
+  std::vector<CellGrid> session = makeSession(40, 20, 30);
+  record(path, session);
+
+  AsciiPlayer player(path);
+  EXPECT_EQ(player.info().width, 40);
+  EXPECT_EQ(player.info().height, 20);
+  EXPECT_EQ(player.info().frame_count, 30u);
+  EXPECT_EQ(player.info().keyframe_count, 3u); // Every 10th frame, the deltas are all smaller
+  EXPECT_EQ(player.info().duration_us, 29u * 33000);
+  for (int i = 0; i < 30; ++i) {
+    ASSERT_TRUE(player.next());
+    EXPECT_EQ(player.timestamp(), static_cast<uint64_t>(i) * 33000);
+    ASSERT_EQ(player.cells().glyphs, session[i].glyphs) << "frame " << i;
+    ASSERT_EQ(player.cells().colors, session[i].colors) << "frame " << i;
+    if (i % 10 != 0) {
+      EXPECT_LE(player.changedCells(), 2u * 18) << "frame " << i;
+    }
+  }
+  EXPECT_FALSE(player.next());
+  std::filesystem::remove(path);
+}
+
+TEST_F(AsciiRecordingTests, PaletteRecordingsKeepTheIndices) {
+  std::vector<CellGrid> session = makeSession(40, 20, 12);
+  for (ColorMode mode : { ColorMode::Xterm256, ColorMode::Ansi16 }) {
+    std::string path = recordingPath("palette");
+    record(path, session, mode);
+    const ColorCube& cube = colorCube(mode);
+
+    AsciiPlayer player(path);
+    EXPECT_EQ(player.info().color_mode, mode);
+    for (const CellGrid& expected : session) {
+      ASSERT_TRUE(player.next());
+      ASSERT_EQ(player.cells().glyphs, expected.glyphs);
+      for (size_t c = 0; c < expected.cellCount(); ++c) {
+        const uint8_t* a = player.cells().colors.data() + c * 3;
+        const uint8_t* b = expected.colors.data() + c * 3;
+        // Decoded to the palette color, which the renderer maps back to the same index
+        ASSERT_EQ(cube.lookup(a[0], a[1], a[2]), cube.lookup(b[0], b[1], b[2])) << colorModeName(mode) << " " << c;
+      }
+    }
+    std::filesystem::remove(path);
+  }
+}
+
+TEST_F(AsciiRecordingTests, SeekMatchesSequentialPlayback) {
+  std::string path = recordingPath("seek");
+  std::vector<CellGrid> session = makeSession(40, 20, 45);
+  record(path, session, ColorMode::Truecolor, 16);
+
+  AsciiPlayer player(path);
+  ASSERT_EQ(player.keyframes().size(), 3u);
+  EXPECT_EQ(player.keyframes()[1].frame, 16u);
+  for (uint32_t frame : { 37u, 0u, 16u, 15u, 44u }) {
+    player.seek(frame);
+    ASSERT_TRUE(player.next());
+    EXPECT_EQ(player.timestamp(), frame * 33000u);
+    EXPECT_EQ(player.cells().glyphs, session[frame].glyphs) << frame;
+    EXPECT_EQ(player.cells().colors, session[frame].colors) << frame;
+  }
+  EXPECT_FALSE(player.next());
+
+  player.seekTime(20 * 33000 - 1);
+  ASSERT_TRUE(player.next());
+  EXPECT_EQ(player.timestamp(), 20u * 33000);
+  EXPECT_EQ(player.cells().colors, session[20].colors);
+  std::filesystem::remove(path);
+}
+
+TEST_F(AsciiRecordingTests, UnclosedRecordingIsPlayable) {
+  std::string path = recordingPath("unclosed");
+  std::vector<CellGrid> session = makeSession(40, 20, 25);
+  record(path, session);
+
+  // What a killed recorder leaves behind: no index, the last frame cut short
+  std::uintmax_t index_offset;
+  {
+    AsciiPlayer player(path);
+    index_offset = player.info().index_offset;
+  }
+  std::filesystem::resize_file(path, index_offset - 5);
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    const char zeros[8] = {};
+    file.seekp(32);
+    file.write(zeros, sizeof(zeros));
+  }
+
+  AsciiPlayer player(path);
+  EXPECT_EQ(player.info().frame_count, 24u);
+  EXPECT_EQ(player.info().keyframe_count, 3u);
+  player.seek(23);
+  ASSERT_TRUE(player.next());
+  EXPECT_EQ(player.cells().colors, session[23].colors);
+  EXPECT_FALSE(player.next());
+  std::filesystem::remove(path);
+
+  {
+    std::ofstream garbage(path, std::ios::binary);
+    garbage << std::string(100, 'x');
+  }
+  EXPECT_THROW(AsciiPlayer bad(path), std::runtime_error);
+  std::filesystem::remove(path);
+  EXPECT_THROW(AsciiPlayer missing(path), std::runtime_error);
+}
+
+TEST_F(AsciiRecordingTests, GridSizeMustFitTheFile) {
+  std::string path = recordingPath("grid");
+  record(path, makeSession(40, 20, 5));
+  // A header claiming a 65535 x 65535 grid is rejected before the grid is allocated
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    const char huge[8] = { '\xff', '\xff', 0, 0, '\xff', '\xff', 0, 0 };
+    file.seekp(12);
+    file.write(huge, sizeof(huge));
+  }
+  EXPECT_THROW(AsciiPlayer player(path), std::runtime_error);
+  // So is one that is slightly off
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    const char off[8] = { 41, 0, 0, 0, 20, 0, 0, 0 };
+    file.seekp(12);
+    file.write(off, sizeof(off));
+  }
+  EXPECT_THROW(AsciiPlayer player(path), std::runtime_error);
+  std::filesystem::remove(path);
+}
+
+TEST_F(AsciiRecordingTests, SmallerThanTheEscapeStream) {
+  std::string path = recordingPath("size");
+  const int width = 100, height = 40, frames = 120;
+  std::vector<CellGrid> session = makeSession(width, height, frames);
+  record(path, session, ColorMode::Truecolor, AsciiRecorder::DEFAULT_KEYFRAME_INTERVAL);
+
+  DiffRenderer renderer;
+  RawImage buffer(static_cast<int>(DiffRenderer::bufferSize(width, height)), 1, 1);
+  size_t escape_bytes = 0;
+  for (const CellGrid& cells : session) escape_bytes += renderer.render(cells, buffer).bytes_written;
+
+  size_t recording_bytes = std::filesystem::file_size(path);
+  EXPECT_LT(recording_bytes * 3, escape_bytes) << recording_bytes << " vs " << escape_bytes;
+
+  AsciiRecorder closed(path);
+  closed.close();
+  EXPECT_THROW(closed.addFrame(session[0], frameTime(0)), std::runtime_error);
+  std::filesystem::remove(path);
+}
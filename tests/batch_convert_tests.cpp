@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "batch_convert.hpp"
+#include "ascii_image.hpp"
+#include "cell_sampler.hpp"
+
+// Helper macro to stringify preprocessor definitions
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+
+class BatchConvertTests : public ::testing::Test {
+protected:
+  std::filesystem::path m_directory;
+
+  void SetUp() override {
+    m_directory = std::filesystem::temp_directory_path() / ("batch_convert_" + std::to_string(getpid()));
+    std::filesystem::create_directories(m_directory / "in");
+  }
+  void TearDown() override {
+    std::filesystem::remove_all(m_directory);
+  }
+
+  // A noise image of the given size as a binary PPM, which stb_image decodes
+  std::string writePpm(const std::string& name, int width, int height) {
+    SyntheticSource source(width, height, SyntheticPattern::Noise, 1);
+    Frame frame;
+    source.read(frame);
+    std::string path = (m_directory / "in" / name).string();
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(frame.pixels.getData()), static_cast<std::streamsize>(frame.byteSize()));
+    return path;
+  }
+};
+
+static std::string readFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static std::string text(const RawImage& buffer, size_t size) {
+  return std::string(reinterpret_cast<const char*>(buffer.getData()), size);
+}
+
+TEST_F(BatchConvertTests, MatchesSequentialConversion) {
+  std::vector<std::string> files;
+  for (int i = 0; i < 12; ++i) files.push_back(writePpm("noise" + std::to_string(i) + ".ppm", 40 + 17 * i, 30 + 5 * i));
+  std::filesystem::copy_file(TOSTRING(IMAGE_FILE_PATH), m_directory / "in" / "light.png");
+  files.push_back((m_directory / "in" / "light.png").string());
+
+  ThreadPool pool(3);
+  BatchConfig config;
+  config.output_directory = (m_directory / "out").string();
+  BatchStats stats = convertBatch(listBatchDirectory((m_directory / "in").string()), config, pool);
+  ASSERT_EQ(stats.files.size(), files.size());
+  EXPECT_EQ(stats.converted, files.size());
+  EXPECT_EQ(stats.failed, 0u);
+  EXPECT_EQ(stats.workers, 3u);
+
+  uint64_t output_bytes = 0;
+  for (const BatchFileResult& result : stats.files) {
+    ASSERT_TRUE(result.ok) << result.path << ": " << result.error;
+    RawImage image(result.path.c_str(), 3);
+    EXPECT_EQ(result.width, image.getWidth());
+    RawImage expected = convertToAscii(image);
+    std::string name = std::filesystem::path(result.path).filename().string() + ".txt";
+    EXPECT_EQ(readFile((m_directory / "out" / name).string()), reinterpret_cast<const char*>(expected.getData()));
+    EXPECT_EQ(result.input_bytes, std::filesystem::file_size(result.path));
+    EXPECT_LT(result.worker, 3u);
+    output_bytes += result.output_bytes;
+  }
+  EXPECT_EQ(stats.output_bytes, output_bytes);
+  EXPECT_GT(stats.imagesPerSecond(), 0);
+  EXPECT_GT(stats.megabytesPerSecond(), 0);
+}
+
+TEST_F(BatchConvertTests, ColumnsAndColors) {
+  std::string path = writePpm("wide.ppm", 640, 480);
+  RawImage image(path.c_str(), 3);
+  CellGrid cells;
+  CellSampler sampler;
+  sampler.sample(image, PixelFormat::RGB24, 80, cells);
+  RawImageView cell_view(cells.colors.data(), cells.width, cells.height, 3);
+
+  ThreadPool pool(2);
+  BatchConfig config;
+  config.output_directory = (m_directory / "out").string();
+  config.columns = 80;
+  convertBatch({ path }, config, pool);
+  EXPECT_EQ(readFile((m_directory / "out" / "wide.ppm.txt").string()),
+            reinterpret_cast<const char*>(convertToAscii(cell_view).getData()));
+
+  config.color = true;
+  config.color_mode = ColorMode::Xterm256;
+  BatchStats stats = convertBatch({ path }, config, pool);
+  RawImage expected(static_cast<int>(coloredAsciiBufferSize(cells.width, cells.height, ColorMode::Xterm256)), 1, 1);
+  size_t size = convertToColoredAscii(cell_view, expected, ColorMode::Xterm256);
+  EXPECT_EQ(readFile((m_directory / "out" / "wide.ppm.txt").string()), text(expected, size));
+  EXPECT_EQ(stats.files[0].output_bytes, size);
+  EXPECT_EQ(stats.workers, 1u); // Never more workers than files
+}
+
+TEST_F(BatchConvertTests, SameNameInTwoDirectories) {
+  std::filesystem::create_directories(m_directory / "in" / "a");
+  std::filesystem::create_directories(m_directory / "in" / "b");
+  std::string first = writePpm("a/img.ppm", 16, 8);
+  std::string second = writePpm("b/img.ppm", 24, 8);
+
+  ThreadPool pool(2);
+  BatchConfig config;
+  config.output_directory = (m_directory / "out").string();
+  BatchStats stats = convertBatch({ first, second, first }, config, pool);
+  EXPECT_EQ(stats.converted, 2u);
+  EXPECT_EQ(stats.files[0].output_name, (std::filesystem::path("a") / "img.ppm.txt").string());
+  EXPECT_EQ(stats.files[1].output_name, (std::filesystem::path("b") / "img.ppm.txt").string());
+  EXPECT_FALSE(stats.files[2].ok); // Listed twice
+  EXPECT_NE(stats.files[2].error.find(first), std::string::npos);
+  EXPECT_EQ(readFile((m_directory / "out" / "a" / "img.ppm.txt").string()),
+            reinterpret_cast<const char*>(convertToAscii(RawImage(first.c_str(), 3)).getData()));
+  EXPECT_EQ(readFile((m_directory / "out" / "b" / "img.ppm.txt").string()),
+            reinterpret_cast<const char*>(convertToAscii(RawImage(second.c_str(), 3)).getData()));
+}
+
+TEST_F(BatchConvertTests, BadFilesAreReportedNotFatal) {
+  std::string good = writePpm("good.ppm", 32, 32);
+  std::string bad = (m_directory / "in" / "notes.txt").string();
+  std::ofstream(bad) << "not an image";
+  std::string list = (m_directory / "list.txt").string();
+  std::ofstream(list) << "# archive\n" << bad << "\n\n" << good << "\r\n" << (m_directory / "missing.png").string() << "\n";
+
+  std::vector<std::string> files = readBatchList(list);
+  ASSERT_EQ(files.size(), 3u);
+  EXPECT_EQ(files[1], good);
+
+  ThreadPool pool(2);
+  BatchConfig config; // No output directory, converted and timed only
+  BatchStats stats = convertBatch(files, config, pool);
+  EXPECT_EQ(stats.converted, 1u);
+  EXPECT_EQ(stats.failed, 2u);
+  EXPECT_FALSE(stats.files[0].ok);
+  EXPECT_FALSE(stats.files[0].error.empty());
+  EXPECT_TRUE(stats.files[1].ok);
+  EXPECT_EQ(stats.files[1].output_bytes, 33u * 32u);
+  EXPECT_EQ(stats.files[1].write_ns, 0u);
+  EXPECT_EQ(stats.pixels, 32u * 32u);
+
+  std::ostringstream report;
+  writeBatchReport(stats, report);
+  EXPECT_NE(report.str().find("Converted 1 of 3 files"), std::string::npos);
+  EXPECT_NE(report.str().find("2 failed"), std::string::npos);
+  EXPECT_NE(report.str().find(good + "  32x32"), std::string::npos);
+  EXPECT_NE(report.str().find("FAILED"), std::string::npos);
+
+  EXPECT_THROW(readBatchList((m_directory / "none.txt").string()), std::runtime_error);
+  EXPECT_THROW(listBatchDirectory(good), std::runtime_error);
+}
@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdlib>
+#include <fcntl.h>
+#include <new>
+#include <thread>
+#include <vector>
+#include "ascii_image.hpp"
+#include "buffer_pool.hpp"
+#include "edge_ascii.hpp"
+#include "frame_pipeline.hpp"
+#include "frame_renderer.hpp"
+#include "frame_source.hpp"
+#include "raw_image_view.hpp"
+
+// Counts every heap allocation made by this test executable
+static std::atomic<size_t> g_allocations{0};
+
+void* operator new(size_t size) {
+  g_allocations++;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+  g_allocations++;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+class BufferPoolTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+// Copies `image` into rows padded to `stride` bytes, like a cv::Mat ROI
+static std::vector<uint8_t> padRows(const RawImage& image, size_t stride) {
+  std::vector<uint8_t> padded(stride * image.getHeight(), 0xAB);
+  size_t row_bytes = static_cast<size_t>(image.getWidth()) * 3;
+  for (int y = 0; y < image.getHeight(); ++y) {
+    std::memcpy(padded.data() + y * stride, image.getData() + y * row_bytes, row_bytes);
+  }
+  return padded;
+}
+
+TEST_F(BufferPoolTests, AcquireAndReleaseDoNotAllocate) {
+  BufferPool pool(1024, 4);
+  std::vector<uint8_t*> buffers;
+  buffers.reserve(4);
+  size_t before = g_allocations.load();
+  for (int round = 0; round < 100; ++round) {
+    for (int i = 0; i < 4; ++i) buffers.push_back(pool.acquire(1000));
+    EXPECT_EQ(pool.acquire(1), nullptr);
+    for (uint8_t* buffer : buffers) pool.release(buffer);
+    buffers.clear();
+  }
+  EXPECT_EQ(g_allocations.load(), before);
+  EXPECT_EQ(pool.available(), 4u);
+}
+
+TEST_F(BufferPoolTests, ForeignAndRepeatedReleasesAbort) {
+  BufferPool pool(64, 2);
+  uint8_t stack_buffer[64];
+  EXPECT_DEATH(pool.release(stack_buffer), "");
+  BufferPool other(64, 2);
+  uint8_t* buffer = other.acquire(64);
+  EXPECT_DEATH(pool.release(buffer), "");
+  other.release(buffer);
+  EXPECT_DEATH(other.release(buffer), "");
+  EXPECT_EQ(other.available(), 2u);
+}
+
+TEST_F(BufferPoolTests, PoolIsSharedAcrossThreads) {
+  BufferPool pool(256, 8);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&pool] {
+      for (int i = 0; i < 2000; ++i) {
+        RawImage img(8, 8, 3, pool);
+        img.getData()[0] = static_cast<uint8_t>(i);
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  EXPECT_EQ(pool.available(), 8u);
+}
+
+TEST_F(BufferPoolTests, StridedViewConvertsLikePackedImage) {
+  SyntheticSource source(37, 11, SyntheticPattern::Noise, 1);
+  Frame frame;
+  ASSERT_TRUE(source.read(frame));
+  RawImage packed(37, 11, 3, frame.pixels.getData());
+  std::vector<uint8_t> padded = padRows(packed, 37 * 3 + 13);
+  RawImageView strided(padded.data(), 37, 11, 3, 37 * 3 + 13);
+
+  RawImage a = convertToAscii(packed);
+  RawImage b = convertToAscii(strided);
+  EXPECT_STREQ(reinterpret_cast<const char*>(a.getData()), reinterpret_cast<const char*>(b.getData()));
+
+  size_t size = coloredAsciiBufferSize(37, 11);
+  RawImage colored_a(static_cast<int>(size), 1, 1), colored_b(static_cast<int>(size), 1, 1);
+  size_t bytes_a = convertToColoredAscii(packed, colored_a);
+  size_t bytes_b = convertToColoredAscii(strided, colored_b);
+  ASSERT_EQ(bytes_a, bytes_b);
+  EXPECT_EQ(std::memcmp(colored_a.getData(), colored_b.getData(), bytes_a), 0);
+
+  CellGrid cells_a, cells_b;
+  buildColoredCells(packed, cells_a);
+  buildColoredCells(strided, cells_b);
+  EXPECT_EQ(cells_a.glyphs, cells_b.glyphs);
+  EXPECT_EQ(cells_a.colors, cells_b.colors);
+}
+
+TEST_F(BufferPoolTests, SteadyStateStreamingDoesNotAllocate) {
+  // The sequential loop's per-frame work: read, view, cells, render
+  SyntheticSource source(100, 55);
+  Frame frame;
+  CellGrid cells;
+  DiffRenderer renderer;
+  RawImage text(static_cast<int>(DiffRenderer::bufferSize(100, 55)), 1, 1);
+  RawImage full_repaint(static_cast<int>(coloredAsciiBufferSize(100, 55)), 1, 1);
+
+  auto streamFrame = [&] {
+    ASSERT_TRUE(source.read(frame));
+    RawImageView img = frame.view();
+    buildColoredCells(img, cells);
+    renderer.render(cells, text);
+    convertToColoredAscii(img, full_repaint);
+  };
+  for (int i = 0; i < 3; ++i) streamFrame(); // Buffers reach their final size
+
+  size_t before = g_allocations.load();
+  for (int i = 0; i < 100; ++i) streamFrame();
+  EXPECT_EQ(g_allocations.load() - before, 0u);
+}
+
+// Synthetic frames that note the allocation count once the pipeline warmed
+// up and again `measured` frames later, then end the stream
+class MeteredSource : public SyntheticSource
+{
+private:
+  size_t m_warmup, m_measured, m_frames = 0;
+public:
+  size_t before = 0, after = 0;
+  MeteredSource(int width, int height, size_t warmup, size_t measured)
+  : SyntheticSource(width, height), m_warmup(warmup), m_measured(measured) {}
+  bool read(Frame& frame) override {
+    if (m_frames == m_warmup) before = g_allocations.load();
+    if (m_frames == m_warmup + m_measured) {
+      after = g_allocations.load();
+      return false;
+    }
+    m_frames++;
+    return SyntheticSource::read(frame);
+  }
+};
+
+TEST_F(BufferPoolTests, SteadyStatePipelineDoesNotAllocate) {
+  PipelineConfig config;
+  config.max_capture_width = 640;
+  config.max_capture_height = 480;
+  config.edge_threshold = EDGE_DEFAULT_THRESHOLD;
+
+  // Capture, CellSampler, edges, DiffRenderer and the status line on all
+  // stage threads, written through a callback
+  MeteredSource source(640, 480, 20, 200);
+  size_t frames = 0;
+  FramePipeline pipeline(config, source, [&frames](const char*, size_t) { ++frames; });
+  pipeline.run();
+  EXPECT_GT(frames, 0u);
+  EXPECT_EQ(source.after - source.before, 0u);
+
+  // Same through a TerminalWriter
+  int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  ASSERT_GE(null_fd, 0);
+  {
+    MeteredSource written(640, 480, 20, 200);
+    TerminalWriter writer(null_fd, WriteMode::NonBlocking);
+    FramePipeline terminal_pipeline(config, written, writer);
+    terminal_pipeline.run();
+    EXPECT_GT(terminal_pipeline.stats().stages[WRITE_STAGE].processed, 0u);
+    EXPECT_EQ(written.after - written.before, 0u);
+  }
+  close(null_fd);
+}
+
+TEST_F(BufferPoolTests, PooledConversionDoesNotAllocate) {
+  SyntheticSource source(64, 32);
+  Frame frame;
+  ASSERT_TRUE(source.read(frame));
+  BufferPool pool(65 * 32 + 1, 2);
+
+  size_t heap_before = g_allocations.load();
+  RawImage heap = convertToAscii(frame.view());
+  EXPECT_GT(g_allocations.load() - heap_before, 0u);
+
+  size_t before = g_allocations.load();
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_TRUE(source.read(frame));
+    RawImage ascii = convertToAscii(frame.view(), pool);
+    ASSERT_TRUE(ascii.isPooled());
+  }
+  EXPECT_EQ(g_allocations.load() - before, 0u);
+  EXPECT_EQ(pool.misses(), 0u);
+}
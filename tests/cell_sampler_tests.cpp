@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <vector>
+#include "cell_sampler.hpp"
+#include "ascii_kernels.hpp"
+
+class CellSamplerTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+// Straightforward per-cell box average, the reference for the fused sweep
+static void referenceCells(const Frame& frame, int columns, float aspect, CellGrid& cells) {
+  int rows = cellRowsFor(frame.width, frame.height, columns, aspect);
+  cells.resize(columns, rows);
+  const uint8_t* data = frame.pixels.getData();
+  for (int row = 0; row < rows; ++row) {
+    int y0 = row * frame.height / rows, y1 = (row + 1) * frame.height / rows;
+    for (int c = 0; c < columns; ++c) {
+      int x0 = c * frame.width / columns, x1 = (c + 1) * frame.width / columns;
+      uint32_t sum[3] = { 0, 0, 0 };
+      for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+          for (int k = 0; k < 3; ++k) sum[k] += data[(static_cast<size_t>(y) * frame.width + x) * 3 + k];
+        }
+      }
+      uint32_t count = static_cast<uint32_t>((y1 - y0) * (x1 - x0));
+      uint8_t* color = cells.colors.data() + (static_cast<size_t>(row) * columns + c) * 3;
+      for (int k = 0; k < 3; ++k) {
+        int channel = frame.format == PixelFormat::BGR24 ? 2 - k : k;
+        color[k] = static_cast<uint8_t>((sum[channel] + count / 2) / count);
+      }
+    }
+    convertRowToAscii(AsciiKernel::Scalar, cells.colors.data() + static_cast<size_t>(row) * columns * 3, columns,
+                      cells.glyphs.data() + static_cast<size_t>(row) * columns);
+  }
+}
+
+TEST_F(CellSamplerTests, RowsFollowAspectCorrection) {
+  EXPECT_EQ(cellRowsFor(1920, 1080, 100), 30);
+  EXPECT_EQ(cellRowsFor(640, 480, 100), 41);
+  EXPECT_EQ(cellRowsFor(100, 100, 100), 55);
+  EXPECT_EQ(cellRowsFor(1000, 1, 100), 1);
+}
+
+TEST_F(CellSamplerTests, MatchesReferenceBoxAverage) {
+  // Sizes that do not divide evenly into the grid
+  for (PixelFormat format : { PixelFormat::RGB24, PixelFormat::BGR24 }) {
+    for (int columns : { 7, 100, 301 }) {
+      SyntheticSource source(1283, 719, SyntheticPattern::Noise, 1);
+      Frame frame;
+      ASSERT_TRUE(source.read(frame));
+      frame.format = format;
+
+      CellGrid expected, actual;
+      referenceCells(frame, columns, DEFAULT_ASPECT_CORRECTION, expected);
+      CellSampler sampler;
+      sampler.sample(frame.view(), frame.format, columns, actual);
+      ASSERT_EQ(actual.width, expected.width);
+      ASSERT_EQ(actual.height, expected.height);
+      EXPECT_EQ(actual.colors, expected.colors) << columns << " columns";
+      EXPECT_EQ(actual.glyphs, expected.glyphs) << columns << " columns";
+    }
+  }
+}
+
+TEST_F(CellSamplerTests, BgrIsSwappedToRgb) {
+  Frame frame;
+  frame.reshape(40, 40, PixelFormat::BGR24);
+  for (size_t i = 0; i < frame.byteSize(); i += 3) {
+    frame.pixels.getData()[i] = 10;      // B
+    frame.pixels.getData()[i + 1] = 20;  // G
+    frame.pixels.getData()[i + 2] = 200; // R
+  }
+  CellGrid cells;
+  CellSampler sampler;
+  sampler.sample(frame.view(), frame.format, 8, cells);
+  for (size_t i = 0; i < cells.cellCount(); ++i) {
+    EXPECT_EQ(cells.colors[i * 3], 200);
+    EXPECT_EQ(cells.colors[i * 3 + 1], 20);
+    EXPECT_EQ(cells.colors[i * 3 + 2], 10);
+  }
+}
+
+TEST_F(CellSamplerTests, GrayAndIncrementalRows) {
+  SyntheticSource source(211, 97, SyntheticPattern::Noise, 1);
+  Frame frame;
+  ASSERT_TRUE(source.read(frame));
+  std::vector<uint8_t> gray(211 * 97), expanded(211 * 97 * 3);
+  for (size_t i = 0; i < gray.size(); ++i) {
+    gray[i] = frame.pixels.getData()[i * 3 + 1];
+    expanded[i * 3] = expanded[i * 3 + 1] = expanded[i * 3 + 2] = gray[i];
+  }
+  CellSampler sampler;
+  CellGrid from_gray, from_rgb;
+  sampler.sample(RawImageView(gray.data(), 211, 97, 1), PixelFormat::RGB24, 50, from_gray);
+  sampler.sample(RawImageView(expanded.data(), 211, 97, 3), PixelFormat::RGB24, 50, from_rgb);
+  EXPECT_EQ(from_gray.colors, from_rgb.colors);
+  EXPECT_EQ(from_gray.glyphs, from_rgb.glyphs);
+
+  // All 97 rows as one cell row, fed in uneven bands
+  uint8_t colors[50 * 3];
+  char glyphs[50];
+  sampler.beginRow(211, 3, 50);
+  for (int y = 0; y < 97; y += 13) sampler.addRows(frame.view().rows(y, std::min(97, y + 13)));
+  sampler.finishRow(frame.format, colors, glyphs);
+  CellGrid whole;
+  sampler.sample(frame.view(), frame.format, 50, whole, 1.5f * 211 / (50 * 97)); // Exactly one row
+  ASSERT_EQ(whole.height, 1);
+  EXPECT_EQ(std::vector<uint8_t>(colors, colors + 150), whole.colors);
+  EXPECT_EQ(std::string(glyphs, 50), std::string(whole.glyphs.data(), 50));
+
+  EXPECT_THROW(sampler.addRows(RawImageView(gray.data(), 211, 97, 1)), std::runtime_error);
+  sampler.beginRow(211, 1, 50);
+  EXPECT_THROW(sampler.finishRow(PixelFormat::RGB24, colors, glyphs), std::runtime_error);
+  EXPECT_THROW(sampler.beginRow(211, 4, 50), std::runtime_error);
+}
+
+TEST_F(CellSamplerTests, HandlesStridedViewsAndNarrowSources) {
+  // A 30 pixel wide window of a wider buffer
+  SyntheticSource source(64, 20, SyntheticPattern::Gradient, 1);
+  Frame frame;
+  ASSERT_TRUE(source.read(frame));
+  RawImageView window(frame.pixels.getData() + 5 * 3, 30, 20, 3, 64 * 3);
+
+  CellGrid cells;
+  CellSampler sampler;
+  sampler.sample(window, PixelFormat::RGB24, 100, cells);
+  EXPECT_EQ(cells.width, 30); // Clamped to the source width
+  // One pixel per column, so the first column is exactly source pixel 5 of the first rows
+  EXPECT_EQ(cells.colors[0], frame.pixels.getData()[15]);
+
+  EXPECT_THROW(sampler.sample(RawImageView(frame.pixels.getData(), 0, 0, 3), PixelFormat::RGB24, 10, cells),
+               std::runtime_error);
+}
+
+TEST_F(CellSamplerTests, RegionOnlyTouchesItsCells) {
+  SyntheticSource source(203, 97, SyntheticPattern::ColorBars);
+  Frame first, second;
+  ASSERT_TRUE(source.read(first));
+  ASSERT_TRUE(source.read(second));
+  for (PixelFormat format : { PixelFormat::RGB24, PixelFormat::BGR24 }) {
+    CellGrid cells, before, after;
+    CellSampler sampler;
+    sampler.sample(first.view(), format, 41, before);
+    sampler.sample(second.view(), format, 41, after);
+    cells = before;
+    ASSERT_GE(cells.height, 8);
+    sampler.sampleRegion(second.view(), format, cells, 7, 23, 3, 7);
+    int moved = 0;
+    for (int row = 0; row < cells.height; ++row) {
+      for (int column = 0; column < cells.width; ++column) {
+        bool inside = column >= 7 && column < 23 && row >= 3 && row < 7;
+        const CellGrid& expected = inside ? after : before;
+        size_t i = static_cast<size_t>(row) * cells.width + column;
+        ASSERT_EQ(cells.glyphs[i], expected.glyphs[i]) << row << "," << column;
+        ASSERT_EQ(cells.colors[i * 3], expected.colors[i * 3]);
+        ASSERT_EQ(cells.colors[i * 3 + 2], expected.colors[i * 3 + 2]);
+        moved += inside && std::memcmp(&before.colors[i * 3], &after.colors[i * 3], 3) != 0;
+      }
+    }
+    EXPECT_GT(moved, 0); // The bars moved under the region
+  }
+  CellGrid cells;
+  CellSampler sampler;
+  sampler.sample(first.view(), PixelFormat::RGB24, 41, cells);
+  EXPECT_THROW(sampler.sampleRegion(first.view(), PixelFormat::RGB24, cells, 30, 42, 0, 1), std::runtime_error);
+  EXPECT_THROW(sampler.sampleRegion(first.view(), PixelFormat::RGB24, cells, 5, 5, 0, 1), std::runtime_error);
+}
+
+TEST_F(CellSamplerTests, VeryWideCellsDoNotOverflow) {
+  // One cell over 70000 x 300 white pixels: a 257 row chunk of it sums past 2^32
+  const int width = 70000, height = 300;
+  std::vector<uint8_t> white(static_cast<size_t>(width) * height * 3, 255);
+  CellGrid cells;
+  CellSampler sampler;
+  sampler.sample(RawImageView(white.data(), width, height, 3), PixelFormat::RGB24, 1, cells);
+  ASSERT_EQ(cells.width, 1);
+  EXPECT_EQ(cells.colors[0], 255);
+  EXPECT_EQ(cells.colors[2], 255);
+  sampler.sample(RawImageView(white.data(), width, height, 1), PixelFormat::RGB24, 1, cells);
+  EXPECT_EQ(cells.colors[0], 255);
+}
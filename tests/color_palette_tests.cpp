@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "ascii_image.hpp"
+#include "color_palette.hpp"
+#include "frame_renderer.hpp"
+
+class ColorPaletteTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+static const ColorMode PALETTE_MODES[] = { ColorMode::Xterm256, ColorMode::Ansi16 };
+
+// Replays cursor moves, clears and palette SGRs into a grid of palette indices
+struct PaletteTerminal
+{
+  int width, height;
+  int row = 0, col = 0, index = -1;
+  std::vector<char> glyphs;
+  std::vector<int> indices;
+
+  PaletteTerminal(int w, int h) : width(w), height(h), glyphs(w * h, ' '), indices(w * h, -1) {}
+
+  void apply(const char* text, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+      if (text[i] == '\033') {
+        int consumed = 0, a = 0, c = 0;
+        if (std::strncmp(text + i, "\033[2J", 4) == 0) {
+          std::fill(glyphs.begin(), glyphs.end(), ' ');
+          i += 4;
+        } else if (std::strncmp(text + i, "\033[H", 3) == 0) {
+          row = col = 0;
+          i += 3;
+        } else if (std::strncmp(text + i, "\033[0m", 4) == 0) {
+          index = -1;
+          i += 4;
+        } else if (std::sscanf(text + i, "\033[38;5;%dm%n", &a, &consumed) == 1 && consumed) {
+          index = a;
+          i += consumed;
+        } else if (std::sscanf(text + i, "\033[%d;%dH%n", &a, &c, &consumed) == 2 && consumed) {
+          row = a - 1;
+          col = c - 1;
+          i += consumed;
+        } else if (std::sscanf(text + i, "\033[%dm%n", &a, &consumed) == 1 && consumed) {
+          ASSERT_TRUE((a >= 30 && a <= 37) || (a >= 90 && a <= 97)) << a;
+          index = a >= 90 ? a - 90 + 8 : a - 30;
+          i += consumed;
+        } else {
+          ADD_FAILURE() << "Unexpected escape at " << i;
+          return;
+        }
+      } else if (text[i] == '\n') {
+        ++row;
+        col = 0;
+        ++i;
+      } else {
+        if (row < height && col < width) {
+          glyphs[static_cast<size_t>(row) * width + col] = text[i];
+          indices[static_cast<size_t>(row) * width + col] = index;
+        }
+        ++col;
+        ++i;
+      }
+    }
+  }
+};
+
+TEST_F(ColorPaletteTests, CubeMatchesExhaustiveSearch) {
+  for (ColorMode mode : PALETTE_MODES) {
+    const ColorCube& cube = colorCube(mode);
+    for (int r = 4; r < 256; r += 8) {
+      for (int g = 4; g < 256; g += 8) {
+        for (int b = 4; b < 256; b += 8) {
+          ASSERT_EQ(cube.lookup(r, g, b), nearestPaletteIndex(mode, r, g, b))
+            << colorModeName(mode) << " " << r << "," << g << "," << b;
+        }
+      }
+    }
+  }
+  const ColorCube& xterm = colorCube(ColorMode::Xterm256);
+  EXPECT_EQ(xterm.lookup(0, 0, 0), 16);
+  EXPECT_EQ(xterm.lookup(255, 0, 0), 196);
+  EXPECT_EQ(xterm.lookup(255, 255, 255), 231);
+  EXPECT_EQ(xterm.lookup(118, 118, 118), 243);
+  const ColorCube& ansi = colorCube(ColorMode::Ansi16);
+  EXPECT_EQ(ansi.lookup(205, 0, 0), 1);
+  EXPECT_EQ(ansi.lookup(255, 0, 0), 9);
+  EXPECT_EQ(ansi.lookup(10, 10, 10), 0);
+  EXPECT_THROW(colorCube(ColorMode::Truecolor), std::runtime_error);
+}
+
+TEST_F(ColorPaletteTests, SgrMatchesSprintf) {
+  char expected[32], actual[32];
+  for (int i = 0; i < 256; ++i) {
+    int n = std::snprintf(expected, sizeof(expected), "\033[38;5;%dm", i);
+    char* end = writeXterm256Sgr(actual, static_cast<uint8_t>(i));
+    ASSERT_EQ(end - actual, n);
+    EXPECT_EQ(std::string(expected, n), std::string(actual, n));
+    EXPECT_LE(static_cast<size_t>(n), XTERM256_SGR_MAX_SIZE);
+  }
+  for (int i = 0; i < 16; ++i) {
+    int n = std::snprintf(expected, sizeof(expected), "\033[%dm", i < 8 ? 30 + i : 90 + i - 8);
+    char* end = writeAnsi16Sgr(actual, static_cast<uint8_t>(i));
+    ASSERT_EQ(end - actual, n);
+    EXPECT_EQ(std::string(expected, n), std::string(actual, n));
+  }
+  EXPECT_EQ(parseColorMode("256"), ColorMode::Xterm256);
+  EXPECT_EQ(parseColorMode("16"), ColorMode::Ansi16);
+  EXPECT_EQ(parseColorMode("truecolor"), ColorMode::Truecolor);
+  EXPECT_THROW(parseColorMode("8"), std::runtime_error);
+}
+
+TEST_F(ColorPaletteTests, WorstCaseSizeIsExact) {
+  // Every cell alternates between two colors whose SGRs have the maximum length
+  const int width = 9, height = 4;
+  const uint8_t colors[3][2][3] = {
+    { { 255, 255, 255 }, { 254, 255, 255 } }, // Truecolor: 3 digits on every channel
+    { { 255, 0, 0 }, { 255, 255, 255 } },     // 196 and 231
+    { { 255, 0, 0 }, { 0, 0, 0 } },           // Every ANSI-16 SGR has the same length
+  };
+  const ColorMode modes[3] = { ColorMode::Truecolor, ColorMode::Xterm256, ColorMode::Ansi16 };
+  for (int m = 0; m < 3; ++m) {
+    RawImage img(width, height, 3);
+    for (int i = 0; i < width * height; ++i) std::memcpy(img.getData() + i * 3, colors[m][i % 2], 3);
+
+    size_t size = coloredAsciiBufferSize(width, height, modes[m]);
+    RawImage target(static_cast<int>(size), 1, 1);
+    size_t written = convertToColoredAscii(img, target, modes[m]);
+    EXPECT_EQ(written + 1, size) << colorModeName(modes[m]);
+    EXPECT_EQ(written, std::strlen(reinterpret_cast<const char*>(target.getData())));
+
+    RawImage small(static_cast<int>(size - 1), 1, 1);
+    EXPECT_THROW(convertToColoredAscii(img, small, modes[m]), std::runtime_error);
+  }
+}
+
+TEST_F(ColorPaletteTests, PaletteOutputShowsNearestColorsWithFewerBytes) {
+  SyntheticSource source(120, 60, SyntheticPattern::Noise, 3);
+  Frame frame;
+  ASSERT_TRUE(source.read(frame));
+  RawImageView img = frame.view();
+
+  RawImage truecolor(static_cast<int>(coloredAsciiBufferSize(120, 60)), 1, 1);
+  size_t truecolor_bytes = convertToColoredAscii(img, truecolor);
+  RawImage gray = convertToAscii(img);
+
+  for (ColorMode mode : PALETTE_MODES) {
+    RawImage target(static_cast<int>(coloredAsciiBufferSize(120, 60, mode)), 1, 1);
+    size_t bytes = convertToColoredAscii(img, target, mode);
+    // Well under the truecolor output even when every cell changes color
+    EXPECT_LT(bytes, truecolor_bytes * 2 / 3) << colorModeName(mode);
+
+    PaletteTerminal terminal(120, 60);
+    terminal.apply(reinterpret_cast<const char*>(target.getData()), bytes);
+    const ColorCube& cube = colorCube(mode);
+    const char* glyphs = reinterpret_cast<const char*>(gray.getData());
+    for (int y = 0; y < 60; ++y) {
+      const uint8_t* p = img.getRow(y);
+      for (int x = 0; x < 120; ++x, p += 3) {
+        size_t cell = static_cast<size_t>(y) * 120 + x;
+        ASSERT_EQ(terminal.indices[cell], cube.lookup(p[0], p[1], p[2])) << cell;
+        ASSERT_EQ(terminal.glyphs[cell], glyphs[y * 121 + x]) << cell;
+      }
+    }
+  }
+}
+
+TEST_F(ColorPaletteTests, DiffRendererTracksPaletteIndices) {
+  for (ColorMode mode : PALETTE_MODES) {
+    SyntheticSource source(40, 20, SyntheticPattern::Gradient, 5);
+    Frame frame;
+    DiffRenderer renderer(0.5, 0, mode);
+    PaletteTerminal terminal(40, 20);
+    RawImage buffer(static_cast<int>(DiffRenderer::bufferSize(40, 20, mode)), 1, 1);
+    CellGrid cells;
+    const ColorCube& cube = colorCube(mode);
+
+    for (int i = 0; i < 5; ++i) {
+      ASSERT_TRUE(source.read(frame));
+      buildColoredCells(frame.view(), cells);
+      RenderStats stats = renderer.render(cells, buffer);
+      terminal.apply(reinterpret_cast<const char*>(buffer.getData()), stats.bytes_written);
+      for (size_t c = 0; c < cells.cellCount(); ++c) {
+        const uint8_t* rgb = cells.colors.data() + c * 3;
+        ASSERT_EQ(terminal.glyphs[c], cells.glyphs[c]) << colorModeName(mode) << " frame " << i;
+        ASSERT_EQ(terminal.indices[c], cube.lookup(rgb[0], rgb[1], rgb[2])) << colorModeName(mode) << " frame " << i;
+      }
+    }
+
+    // Moving a color inside its cube cell does not change what the terminal shows
+    for (uint8_t& c : cells.colors) c = static_cast<uint8_t>((c & ~7) | (~c & 7));
+    EXPECT_EQ(renderer.render(cells, buffer).changed_cells, 0u) << colorModeName(mode);
+  }
+}
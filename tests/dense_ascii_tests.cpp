@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "ascii_image.hpp"
+#include "cell_sampler.hpp"
+#include "dense_ascii.hpp"
+#include "frame_pipeline.hpp"
+
+// Helper macro to stringify preprocessor definitions
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+
+class DenseAsciiTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+static const AsciiKernel ALL_KERNELS[] = { AsciiKernel::Scalar, AsciiKernel::SSSE3, AsciiKernel::AVX2 };
+
+// Code points of a UTF-8 text with escape sequences removed, '\n' kept
+static std::vector<uint32_t> decodeGlyphs(const char* text, size_t len) {
+  std::vector<uint32_t> glyphs;
+  size_t i = 0;
+  while (i < len) {
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    if (c == 0x1B) {
+      while (i < len && !std::isalpha(static_cast<unsigned char>(text[i]))) ++i;
+      ++i;
+    } else if (c < 0x80) {
+      glyphs.push_back(c);
+      ++i;
+    } else {
+      EXPECT_EQ(c & 0xF0, 0xE0) << "Only 3-byte sequences expected at " << i;
+      EXPECT_LE(i + 3, len);
+      glyphs.push_back(((c & 0x0F) << 12) | ((text[i + 1] & 0x3F) << 6) | (text[i + 2] & 0x3F));
+      i += 3;
+    }
+  }
+  return glyphs;
+}
+
+TEST_F(DenseAsciiTests, BraillePackingMatchesScalar) {
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> byte(0, 255), flat(100, 120);
+  for (int width : { 1, 2, 15, 16, 17, 31, 32, 33, 100, 257 }) {
+    std::vector<uint8_t> rows[4];
+    for (int r = 0; r < 4; ++r) {
+      rows[r].resize(width);
+      // Half of the cells flat, so both the threshold and the dither path run
+      for (int x = 0; x < width; ++x) rows[r][x] = static_cast<uint8_t>((x / 8) % 2 ? flat(rng) : byte(rng));
+    }
+    for (int present = 1; present <= 4; ++present) {
+      const uint8_t* gray[4] = {};
+      for (int r = 0; r < present; ++r) gray[r] = rows[r].data();
+      std::vector<uint8_t> expected((width + 1) / 2), actual((width + 1) / 2 + 1, 0xAA);
+      packBrailleCells(AsciiKernel::Scalar, gray, width, expected.data());
+      for (AsciiKernel kernel : ALL_KERNELS) {
+        if (!isAsciiKernelSupported(kernel)) continue;
+        packBrailleCells(kernel, gray, width, actual.data());
+        ASSERT_EQ(std::vector<uint8_t>(actual.begin(), actual.end() - 1), expected)
+          << asciiKernelName(kernel) << " width " << width << " rows " << present;
+        EXPECT_EQ(actual.back(), 0xAA);
+      }
+    }
+  }
+
+  // Left column bright, right column dark: dots 1, 2, 3 and 7
+  uint8_t edge[2] = { 250, 10 };
+  const uint8_t* gray[4] = { edge, edge, edge, edge };
+  uint8_t pattern = 0;
+  packBrailleCells(gray, 2, &pattern);
+  EXPECT_EQ(pattern, 0x47);
+  // Flat mid gray lights half of the dots, black none and white all
+  for (auto [value, dots] : { std::pair<uint8_t, int>{ 128, 4 }, { 0, 0 }, { 255, 8 } }) {
+    uint8_t level[2] = { value, value };
+    const uint8_t* flat_gray[4] = { level, level, level, level };
+    packBrailleCells(flat_gray, 2, &pattern);
+    EXPECT_EQ(__builtin_popcount(pattern), dots) << int(value);
+  }
+}
+
+TEST_F(DenseAsciiTests, HalfBlockWorstCaseIsExact) {
+  // Both colors of every cell change and have 3 digits per channel
+  for (int height : { 4, 5 }) {
+    const int width = 7;
+    RawImage img(width, height, 3);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        uint8_t* p = img.getData() + (y * width + x) * 3;
+        uint8_t base = (y % 2 ? 200 : 100) + (x % 2);
+        p[0] = p[1] = p[2] = base;
+      }
+    }
+    size_t size = halfBlockBufferSize(width, height);
+    RawImage target(static_cast<int>(size), 1, 1);
+    size_t written = convertToHalfBlockAscii(img, target);
+    // The odd last row doubles its pixels and becomes spaces, only even heights reach the bound
+    if (height % 2 == 0) {
+      EXPECT_EQ(written + 1, size);
+    } else {
+      EXPECT_LT(written + 1, size);
+    }
+    const char* text = reinterpret_cast<const char*>(target.getData());
+    EXPECT_EQ(written, std::strlen(text));
+
+    std::vector<uint32_t> glyphs = decodeGlyphs(text, written);
+    EXPECT_EQ(std::count(glyphs.begin(), glyphs.end(), 0x2580u), static_cast<long>(width * (height / 2)));
+    EXPECT_EQ(std::count(glyphs.begin(), glyphs.end(), '\n'), (height + 1) / 2);
+
+    RawImage small(static_cast<int>(size - 1), 1, 1);
+    EXPECT_THROW(convertToHalfBlockAscii(img, small), std::runtime_error);
+  }
+}
+
+TEST_F(DenseAsciiTests, HalfBlockSkipsRepeatedColors) {
+  // A flat image is one background SGR and a space per cell on every row
+  RawImage flat(20, 6, 3);
+  std::memset(flat.getData(), 90, flat.getSize());
+  RawImage target(static_cast<int>(halfBlockBufferSize(20, 6)), 1, 1);
+  size_t written = convertToHalfBlockAscii(flat, target);
+  std::string expected;
+  for (int row = 0; row < 3; ++row) expected += "\033[48;2;90;90;90m" + std::string(20, ' ') + "\033[0m\n";
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(target.getData()), written), expected);
+}
+
+TEST_F(DenseAsciiTests, BrailleOutputIsSizedExactly) {
+  SyntheticSource source(37, 23, SyntheticPattern::Noise);
+  Frame frame;
+  ASSERT_TRUE(source.read(frame));
+
+  RawImage mono = convertToBrailleAscii(frame.view());
+  const char* text = reinterpret_cast<const char*>(mono.getData());
+  EXPECT_EQ(std::strlen(text) + 1, brailleBufferSize(37, 23));
+  std::vector<uint32_t> glyphs = decodeGlyphs(text, std::strlen(text));
+  ASSERT_EQ(glyphs.size(), static_cast<size_t>(6 * (19 + 1)));
+  for (size_t i = 0; i < glyphs.size(); ++i) {
+    if (i % 20 == 19) {
+      EXPECT_EQ(glyphs[i], '\n');
+    } else {
+      EXPECT_GE(glyphs[i], 0x2800u);
+      EXPECT_LE(glyphs[i], 0x28FFu);
+    }
+  }
+
+  RawImage colored(static_cast<int>(coloredBrailleBufferSize(37, 23)), 1, 1);
+  size_t written = convertToColoredBraille(frame.view(), colored);
+  EXPECT_LT(written, colored.getSize());
+  std::vector<uint32_t> colored_glyphs = decodeGlyphs(reinterpret_cast<const char*>(colored.getData()), written);
+  EXPECT_EQ(colored_glyphs.size(), glyphs.size());
+  RawImage small(static_cast<int>(coloredBrailleBufferSize(37, 23) - 1), 1, 1);
+  EXPECT_THROW(convertToColoredBraille(frame.view(), small), std::runtime_error);
+}
+
+TEST_F(DenseAsciiTests, MoreDetailWithoutProportionallyMoreBytes) {
+  RawImage img(TOSTRING(IMAGE_FILE_PATH));
+  CellSampler sampler;
+  const int columns = 25;
+  CellGrid ascii, half, braille;
+  sampler.sample(img, PixelFormat::RGB24, columns, ascii);
+  sampler.sample(img, PixelFormat::RGB24, columns, half, DEFAULT_ASPECT_CORRECTION * 2);
+  sampler.sample(img, PixelFormat::RGB24, columns * 2, braille, DEFAULT_ASPECT_CORRECTION * 2);
+
+  RawImage ascii_out(static_cast<int>(coloredAsciiBufferSize(ascii.width, ascii.height)), 1, 1);
+  size_t ascii_bytes = convertToColoredAscii(RawImageView(ascii.colors.data(), ascii.width, ascii.height, 3), ascii_out);
+  RawImage half_out(static_cast<int>(halfBlockBufferSize(half.width, half.height)), 1, 1);
+  size_t half_bytes = convertToHalfBlockAscii(RawImageView(half.colors.data(), half.width, half.height, 3), half_out);
+  RawImage braille_out(static_cast<int>(coloredBrailleBufferSize(braille.width, braille.height)), 1, 1);
+  size_t braille_bytes =
+    convertToColoredBraille(RawImageView(braille.colors.data(), braille.width, braille.height, 3), braille_out);
+
+  // Same terminal size up to rounding, 2x and 8x the pixels
+  EXPECT_NEAR((half.height + 1) / 2, ascii.height, 1);
+  EXPECT_NEAR((braille.height + 3) / 4, ascii.height, 1);
+  EXPECT_EQ((braille.width + 1) / 2, ascii.width);
+  EXPECT_LT(half_bytes, ascii_bytes * 2);
+  EXPECT_LT(braille_bytes, ascii_bytes * 2);
+  std::cout << "Bytes for " << columns << " columns: ascii " << ascii_bytes << ", half-block " << half_bytes
+            << " (2x pixels), braille " << braille_bytes << " (8x pixels)" << std::endl;
+}
+
+TEST_F(DenseAsciiTests, PipelineRendersDenseGlyphs) {
+  for (GlyphMode mode : { GlyphMode::HalfBlock, GlyphMode::Braille }) {
+    PipelineConfig config;
+    config.max_capture_width = 160;
+    config.max_capture_height = 120;
+    config.output_width = 40;
+    config.max_frames = 5;
+    config.queue_depth = 5;
+    config.show_status = false;
+    config.glyph_mode = mode;
+
+    // Noise, vertical bars would make every half-block cell a space
+    SyntheticSource source(160, 120, SyntheticPattern::Noise);
+    std::string output;
+    FramePipeline pipeline(config, source, [&output](const char* data, size_t size) { output.append(data, size); });
+    pipeline.run();
+    ASSERT_GT(pipeline.stats().stages[WRITE_STAGE].processed, 0u) << glyphModeName(mode);
+
+    std::vector<uint32_t> glyphs = decodeGlyphs(output.data(), output.size());
+    size_t row_length = std::find(glyphs.begin(), glyphs.end(), uint32_t('\n')) - glyphs.begin();
+    EXPECT_EQ(row_length, 40u) << glyphModeName(mode); // output_width terminal cells
+    bool dense = std::any_of(glyphs.begin(), glyphs.end(), [](uint32_t g) { return g == 0x2580 || (g > 0x2800 && g <= 0x28FF); });
+    EXPECT_TRUE(dense) << glyphModeName(mode);
+
+    config.color_mode = ColorMode::Xterm256;
+    EXPECT_THROW(FramePipeline(config, source, [](const char*, size_t) {}), std::runtime_error);
+  }
+}
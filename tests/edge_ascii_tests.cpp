@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "edge_ascii.hpp"
+#include "ascii_image.hpp"
+
+
+class EdgeAsciiTests : public ::testing::Test {
+  protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+// A bright rectangle on a dark background, as gray and as RGB
+static std::vector<uint8_t> rectangle(int width, int height, int channels) {
+  std::vector<uint8_t> data(static_cast<size_t>(width) * height * channels, 20);
+  for (int y = height / 4; y < height * 3 / 4; ++y) {
+    for (int x = width / 4; x < width * 3 / 4; ++x) {
+      for (int c = 0; c < channels; ++c) data[(static_cast<size_t>(y) * width + x) * channels + c] = 220;
+    }
+  }
+  return data;
+}
+
+static std::string asciiText(const RawImage& image) {
+  return reinterpret_cast<const char*>(image.getData());
+}
+
+// Colored output without its SGR sequences
+static std::string glyphsOf(const RawImage& buffer, size_t size) {
+  std::string text;
+  const char* p = reinterpret_cast<const char*>(buffer.getData());
+  for (size_t i = 0; i < size; ++i) {
+    if (p[i] == '\033') {
+      while (i < size && p[i] != 'm') ++i;
+      continue;
+    }
+    text += p[i];
+  }
+  return text;
+}
+
+TEST_F(EdgeAsciiTests, GlyphFollowsTheGradient) {
+  EXPECT_EQ(edgeGlyph(400, 0, 256), '|');
+  EXPECT_EQ(edgeGlyph(-400, 30, 256), '|');
+  EXPECT_EQ(edgeGlyph(0, 400, 256), '_');   // Brighter below
+  EXPECT_EQ(edgeGlyph(20, -400, 256), '-'); // Brighter above
+  EXPECT_EQ(edgeGlyph(300, 300, 256), '/');
+  EXPECT_EQ(edgeGlyph(-300, -300, 256), '/');
+  EXPECT_EQ(edgeGlyph(300, -300, 256), '\\');
+  EXPECT_EQ(edgeGlyph(100, 100, 256), 0);
+  EXPECT_EQ(edgeGlyph(128, 128, 256), 0); // Not above the threshold
+}
+
+TEST_F(EdgeAsciiTests, ParseThreshold) {
+  EXPECT_EQ(parseEdgeThreshold("1"), 1);
+  EXPECT_EQ(parseEdgeThreshold("2040"), 2040);
+  EXPECT_THROW(parseEdgeThreshold("0"), std::runtime_error);
+  EXPECT_THROW(parseEdgeThreshold("2041"), std::runtime_error);
+  EXPECT_THROW(parseEdgeThreshold("65636"), std::runtime_error);
+  EXPECT_THROW(parseEdgeThreshold("100x"), std::runtime_error);
+  EXPECT_THROW(parseEdgeThreshold("edge"), std::runtime_error);
+}
+
+TEST_F(EdgeAsciiTests, KernelsMatchScalar) {
+  uint32_t seed = 5;
+  auto next = [&seed]() {
+    seed = seed * 1664525u + 1013904223u;
+    return static_cast<uint8_t>(seed >> 24);
+  };
+  for (AsciiKernel kernel : { AsciiKernel::SSSE3, AsciiKernel::AVX2 }) {
+    if (!isAsciiKernelSupported(kernel)) continue;
+    for (int width : { 1, 2, 3, 9, 16, 17, 18, 33, 100, 257 }) {
+      std::vector<uint8_t> luma(static_cast<size_t>(width) * 3);
+      for (uint8_t& value : luma) value = next() > 128 ? next() : 100; // Flat runs between edges
+      std::vector<char> ramp(width);
+      for (char& glyph : ramp) glyph = static_cast<char>('A' + next() % 26);
+      for (int threshold : { -5, 0, 100, 256, 1000, 65536 + 100 }) {
+        std::vector<char> expected = ramp, actual = ramp;
+        overlayEdgeGlyphs(AsciiKernel::Scalar, luma.data(), luma.data() + width, luma.data() + 2 * width, width,
+                          threshold, expected.data());
+        overlayEdgeGlyphs(kernel, luma.data(), luma.data() + width, luma.data() + 2 * width, width, threshold,
+                          actual.data());
+        EXPECT_EQ(std::string(actual.begin(), actual.end()), std::string(expected.begin(), expected.end()))
+          << asciiKernelName(kernel) << " width " << width << " threshold " << threshold;
+      }
+    }
+  }
+}
+
+TEST_F(EdgeAsciiTests, OutlinesARectangle) {
+  const int width = 40, height = 24;
+  std::vector<uint8_t> rgb = rectangle(width, height, 3);
+  RawImageView view(rgb.data(), width, height, 3);
+  ThreadPool pool(3);
+  std::string ramp = asciiText(convertToAscii(view));
+  std::string edges = asciiText(convertToEdgeAscii(view, EDGE_DEFAULT_THRESHOLD, pool));
+  ASSERT_EQ(edges.size(), ramp.size());
+
+  auto at = [&](const std::string& text, int x, int y) { return text[static_cast<size_t>(y) * (width + 1) + x]; };
+  EXPECT_EQ(at(edges, width / 4, height / 2), '|');
+  EXPECT_EQ(at(edges, width * 3 / 4, height / 2), '|');
+  EXPECT_EQ(at(edges, width / 2, height / 4), '_');
+  EXPECT_EQ(at(edges, width / 2, height * 3 / 4), '-');
+  EXPECT_EQ(at(edges, width / 4 - 1, height / 4 - 1), '/');
+  EXPECT_EQ(at(edges, width * 3 / 4, height / 4 - 1), '\\');
+  // Flat areas keep the brightness ramp
+  EXPECT_EQ(at(edges, 2, 2), at(ramp, 2, 2));
+  EXPECT_EQ(at(edges, width / 2, height / 2), at(ramp, width / 2, height / 2));
+  for (int y = 0; y < height; ++y) EXPECT_EQ(at(edges, width, y), '\n');
+
+  // No edge is that strong
+  EXPECT_EQ(asciiText(convertToEdgeAscii(view, 2040, pool)), ramp);
+  // Band borders do not show
+  ThreadPool single(1);
+  EXPECT_EQ(asciiText(convertToEdgeAscii(view, EDGE_DEFAULT_THRESHOLD, single)), edges);
+  // Gray input gives the same edges
+  std::vector<uint8_t> gray = rectangle(width, height, 1);
+  EXPECT_EQ(asciiText(convertToEdgeAscii(RawImageView(gray.data(), width, height, 1), EDGE_DEFAULT_THRESHOLD, pool)),
+            edges);
+}
+
+TEST_F(EdgeAsciiTests, ColoredKeepsTheColors) {
+  const int width = 33, height = 40;
+  std::vector<uint8_t> rgb = rectangle(width, height, 3);
+  for (size_t i = 0; i < rgb.size(); i += 3) rgb[i] = static_cast<uint8_t>(i); // Some color to keep
+  RawImageView view(rgb.data(), width, height, 3);
+  ThreadPool pool(2);
+
+  for (ColorMode mode : { ColorMode::Truecolor, ColorMode::Xterm256 }) {
+    RawImage expected(static_cast<int>(coloredAsciiBufferSize(width, height, mode)), 1, 1);
+    RawImage actual(static_cast<int>(coloredAsciiBufferSize(width, height, mode)), 1, 1);
+    size_t expected_size = convertToColoredAscii(view, expected, mode);
+    EXPECT_EQ(convertToColoredEdgeAscii(view, actual, mode, 2040, pool), expected_size);
+    EXPECT_EQ(std::memcmp(actual.getData(), expected.getData(), expected_size), 0);
+
+    size_t size = convertToColoredEdgeAscii(view, actual, mode, EDGE_DEFAULT_THRESHOLD, pool);
+    EXPECT_EQ(glyphsOf(actual, size), asciiText(convertToEdgeAscii(view, EDGE_DEFAULT_THRESHOLD, pool)));
+  }
+  RawImage small(16, 1, 1);
+  EXPECT_THROW(convertToColoredEdgeAscii(view, small), std::runtime_error);
+}
+
+TEST_F(EdgeAsciiTests, CellGridEdges) {
+  const int width = 24, height = 12;
+  std::vector<uint8_t> rgb = rectangle(width, height, 3);
+  RawImageView view(rgb.data(), width, height, 3);
+  CellGrid cells;
+  buildColoredCells(view, cells);
+  applyEdgeGlyphs(cells);
+  std::string text;
+  for (int y = 0; y < height; ++y) {
+    text.append(cells.glyphs.data() + static_cast<size_t>(y) * width, width);
+    text += '\n';
+  }
+  EXPECT_EQ(text, asciiText(convertToEdgeAscii(view)));
+
+  CellGrid empty;
+  applyEdgeGlyphs(empty);
+  EXPECT_TRUE(empty.glyphs.empty());
+}
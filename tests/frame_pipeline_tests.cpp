@@ -0,0 +1,273 @@
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "frame_pipeline.hpp"
+#include "edge_ascii.hpp"
+
+class FramePipelineTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+static uint64_t totalDropped(const PipelineStats& stats) {
+  uint64_t dropped = 0;
+  for (const PipelineStageStats& stage : stats.stages) dropped += stage.dropped;
+  return dropped;
+}
+
+TEST_F(FramePipelineTests, SpscRingKeepsOrderAcrossThreads) {
+  SpscRing<int> ring(8);
+  const int count = 20000;
+  std::thread producer([&ring] {
+    for (int i = 0; i < count; ++i) {
+      while (!ring.push(i)) std::this_thread::yield();
+    }
+  });
+  int expected = 0, value = 0;
+  while (expected < count) {
+    if (ring.pop(value)) {
+      ASSERT_EQ(value, expected);
+      ++expected;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  EXPECT_EQ(ring.size(), 0u);
+}
+
+TEST_F(FramePipelineTests, QueueHandsOutLatestFrame) {
+  FrameQueue<int> queue(3);
+  for (int i = 0; i < 3; ++i) {
+    int* slot = queue.acquire();
+    ASSERT_NE(slot, nullptr);
+    *slot = i;
+    queue.publish(slot);
+  }
+  EXPECT_EQ(queue.occupancy(), 3u);
+
+  int* latest = queue.takeLatest();
+  ASSERT_NE(latest, nullptr);
+  EXPECT_EQ(*latest, 2);
+  EXPECT_EQ(queue.dropped(), 2u); // Two superseded
+  EXPECT_EQ(queue.maxOccupancy(), 3u);
+  queue.release(latest);
+  EXPECT_EQ(queue.takeLatest(), nullptr);
+
+  queue.close();
+  EXPECT_TRUE(queue.finished());
+}
+
+TEST_F(FramePipelineTests, StalledConsumerGetsTheNewestFrame) {
+  for (size_t depth : { 1, 2, 3 }) {
+    FrameQueue<int> queue(depth);
+    // The consumer holds a frame and stalls while 50 more are captured
+    int* held = queue.acquire();
+    *held = -1;
+    queue.publish(held);
+    held = queue.takeLatest();
+    for (int sequence = 0; sequence < 50; ++sequence) {
+      int* slot = queue.acquire();
+      ASSERT_NE(slot, nullptr) << "depth " << depth; // Overwriting never runs out of slots
+      *slot = sequence;
+      queue.publish(slot);
+    }
+    EXPECT_EQ(queue.occupancy(), depth);
+    queue.release(held);
+
+    int* latest = queue.takeLatest();
+    ASSERT_NE(latest, nullptr);
+    EXPECT_EQ(*latest, 49) << "depth " << depth;
+    EXPECT_EQ(queue.dropped(), 49u); // Every frame but the newest
+    queue.release(latest);
+    EXPECT_EQ(queue.takeLatest(), nullptr);
+  }
+}
+
+TEST_F(FramePipelineTests, SyntheticSourceRunsHeadless) {
+  PipelineConfig config;
+  config.max_capture_width = 320;
+  config.max_capture_height = 240;
+  config.output_width = 80;
+  config.max_frames = 60;
+  config.show_status = false;
+
+  size_t frames = 0, bytes = 0;
+  SyntheticSource source(320, 240);
+  FramePipeline pipeline(config, source, [&](const char*, size_t size) {
+    ++frames;
+    bytes += size;
+  });
+  pipeline.run();
+
+  PipelineStats stats = pipeline.stats();
+  EXPECT_EQ(stats.stages[CAPTURE_STAGE].processed, 60u);
+  EXPECT_EQ(stats.stages[WRITE_STAGE].processed, frames);
+  EXPECT_EQ(stats.bytes_written, bytes);
+  EXPECT_GT(frames, 0u);
+  // Every captured frame was either written or dropped by exactly one stage
+  EXPECT_EQ(stats.stages[CAPTURE_STAGE].processed, stats.stages[WRITE_STAGE].processed + totalDropped(stats));
+  for (const PipelineStageStats& stage : stats.stages) {
+    EXPECT_EQ(stage.occupancy, 0u) << stage.name;
+    EXPECT_LE(stage.max_occupancy, config.queue_depth) << stage.name;
+  }
+}
+
+TEST_F(FramePipelineTests, ResizeStageRunsWithoutFusedSampling) {
+  PipelineConfig config;
+  config.max_capture_width = 320;
+  config.max_capture_height = 240;
+  config.output_width = 80;
+  config.max_frames = 30;
+  config.show_status = false;
+  config.fused_sampling = false;
+
+  SyntheticSource source(320, 240);
+  FramePipeline pipeline(config, source, [](const char*, size_t) {});
+  pipeline.run();
+
+  PipelineStats stats = pipeline.stats();
+  EXPECT_GT(stats.stages[RESIZE_STAGE].processed, 0u);
+  EXPECT_EQ(stats.stages[CAPTURE_STAGE].processed, stats.stages[WRITE_STAGE].processed + totalDropped(stats));
+}
+
+// Frame 0 of the synthetic pattern, again and again
+class StillSource : public FrameSource
+{
+private:
+  int m_width, m_height;
+public:
+  StillSource(int width, int height) : m_width(width), m_height(height) {}
+  bool read(Frame& frame) override { return SyntheticSource(m_width, m_height).read(frame); }
+  std::string name() const override { return "still"; }
+};
+
+TEST_F(FramePipelineTests, IncrementalSamplingSkipsStillTiles) {
+  PipelineConfig config;
+  config.max_capture_width = 320;
+  config.max_capture_height = 240;
+  config.output_width = 80;
+  config.max_frames = 20;
+  config.show_status = false;
+  config.edge_threshold = EDGE_DEFAULT_THRESHOLD; // Edges work on the sampled grid as before
+
+  // A still picture: every cell is sampled once, later frames only compare
+  std::vector<std::string> full, incremental;
+  StillSource still(320, 240);
+  FramePipeline full_pipeline(config, still, [&](const char* data, size_t size) { full.emplace_back(data, size); });
+  full_pipeline.run();
+  config.incremental_noise = 8;
+  FramePipeline pipeline(config, still, [&](const char* data, size_t size) { incremental.emplace_back(data, size); });
+  pipeline.run();
+
+  PipelineStats stats = pipeline.stats();
+  uint64_t sampled = stats.stages[CONVERT_STAGE].processed;
+  ASSERT_GT(sampled, 1u);
+  EXPECT_EQ(stats.tiles % sampled, 0u);
+  EXPECT_EQ(stats.dirty_tiles, stats.tiles / sampled); // The first frame only
+  EXPECT_EQ(full_pipeline.stats().tiles, 0u);
+  // Same cells, so the DiffRenderer sends the same first frame and no changed cell after it
+  ASSERT_GT(incremental.size(), 1u);
+  EXPECT_EQ(incremental[0], full[0]);
+  for (size_t i = 1; i < incremental.size(); ++i) {
+    EXPECT_EQ(incremental[i], incremental[1]);
+    EXPECT_LT(incremental[i].size(), 64u);
+  }
+
+  config.incremental_noise = 8;
+  config.fused_sampling = false;
+  EXPECT_THROW(FramePipeline(config, still, [](const char*, size_t) {}), std::runtime_error);
+}
+
+TEST_F(FramePipelineTests, SlowWriterDoesNotHoldBackCapture) {
+  PipelineConfig config;
+  config.max_capture_width = 160;
+  config.max_capture_height = 120;
+  config.output_width = 40;
+  config.max_frames = 200;
+  config.queue_depth = 1;
+  config.show_status = false;
+
+  auto start = std::chrono::steady_clock::now();
+  SyntheticSource source(160, 120);
+  FramePipeline pipeline(config, source, [](const char*, size_t) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  });
+  pipeline.run();
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+  PipelineStats stats = pipeline.stats();
+  EXPECT_EQ(stats.stages[CAPTURE_STAGE].processed, 200u);
+  EXPECT_LT(stats.stages[WRITE_STAGE].processed, 200u);
+  EXPECT_GT(totalDropped(stats), 0u);
+  // 200 blocking writes would take 4 seconds
+  EXPECT_LT(elapsed.count(), 200 * 20.0);
+  std::cout << "Slow writer: captured " << stats.stages[CAPTURE_STAGE].processed << ", written "
+            << stats.stages[WRITE_STAGE].processed << ", dropped " << totalDropped(stats) << " in "
+            << elapsed.count() << " ms" << std::endl;
+}
+
+TEST_F(FramePipelineTests, StopEndsEndlessSource) {
+  PipelineConfig config;
+  config.max_capture_width = 64;
+  config.max_capture_height = 48;
+  config.output_width = 32;
+  config.show_status = false;
+
+  SyntheticSource source(64, 48);
+  FramePipeline pipeline(config, source, [](const char*, size_t) {});
+  std::thread stopper([&pipeline] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    pipeline.stop();
+  });
+  pipeline.run();
+  stopper.join();
+  EXPECT_GT(pipeline.stats().stages[CAPTURE_STAGE].processed, 0u);
+}
+
+// Synthetic frames until `frames` were read, then a read error
+class FailingSource : public SyntheticSource
+{
+private:
+  size_t m_frames;
+public:
+  FailingSource(int width, int height, size_t frames) : SyntheticSource(width, height), m_frames(frames) {}
+  bool read(Frame& frame) override {
+    if (m_frames == 0) throw std::runtime_error("source failed");
+    m_frames--;
+    return SyntheticSource::read(frame);
+  }
+};
+
+TEST_F(FramePipelineTests, StageErrorsReachTheCaller) {
+  PipelineConfig config;
+  config.max_capture_width = 64;
+  config.max_capture_height = 48;
+  config.output_width = 32;
+  config.show_status = false;
+
+  // A capture error ends the run, frames already captured are still written
+  FailingSource failing(64, 48, 5);
+  size_t frames = 0;
+  FramePipeline capture_fails(config, failing, [&frames](const char*, size_t) { ++frames; });
+  EXPECT_THROW({
+    try {
+      capture_fails.run();
+    } catch (const std::runtime_error& e) {
+      EXPECT_STREQ(e.what(), "source failed");
+      throw;
+    }
+  }, std::runtime_error);
+  EXPECT_EQ(capture_fails.stats().stages[CAPTURE_STAGE].processed, 5u);
+  EXPECT_GT(frames, 0u);
+
+  // A write error on the calling thread stops capture and joins the other stages
+  SyntheticSource endless(64, 48);
+  FramePipeline write_fails(config, endless, [](const char*, size_t) { throw std::runtime_error("write failed"); });
+  EXPECT_THROW(write_fails.run(), std::runtime_error);
+  EXPECT_EQ(write_fails.stats().stages[WRITE_STAGE].processed, 0u);
+}
@@ -0,0 +1,214 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <vector>
+#include "ascii_image.hpp"
+#include "frame_renderer.hpp"
+
+// Helper macro to stringify preprocessor definitions
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+
+// Minimal terminal model: applies cursor moves, clears, SGR colors and glyphs
+struct FakeTerminal
+{
+  int width, height;
+  int row = 0, col = 0;
+  int r = -1, g = -1, b = -1;
+  std::vector<char> glyphs;
+  std::vector<int> colors;
+
+  FakeTerminal(int w, int h) : width(w), height(h), glyphs(w * h, ' '), colors(w * h * 3, -1) {}
+
+  void apply(const char* text, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+      if (text[i] == '\033') {
+        int consumed = 0, a = 0, c = 0, d = 0;
+        if (std::strncmp(text + i, "\033[2J", 4) == 0) {
+          std::fill(glyphs.begin(), glyphs.end(), ' ');
+          i += 4;
+        } else if (std::strncmp(text + i, "\033[H", 3) == 0) {
+          row = col = 0;
+          i += 3;
+        } else if (std::strncmp(text + i, "\033[0m", 4) == 0) {
+          r = g = b = -1;
+          i += 4;
+        } else if (std::sscanf(text + i, "\033[38;2;%d;%d;%dm%n", &a, &c, &d, &consumed) == 3 && consumed) {
+          r = a;
+          g = c;
+          b = d;
+          i += consumed;
+        } else if (std::sscanf(text + i, "\033[%d;%dH%n", &a, &c, &consumed) == 2 && consumed) {
+          row = a - 1;
+          col = c - 1;
+          i += consumed;
+        } else {
+          ADD_FAILURE() << "Unexpected escape at " << i;
+          return;
+        }
+      } else if (text[i] == '\n') {
+        ++row;
+        col = 0;
+        ++i;
+      } else {
+        if (row < height && col < width) {
+          size_t cell = static_cast<size_t>(row) * width + col;
+          glyphs[cell] = text[i];
+          colors[cell * 3] = r;
+          colors[cell * 3 + 1] = g;
+          colors[cell * 3 + 2] = b;
+        }
+        ++col;
+        ++i;
+      }
+    }
+  }
+
+  void expectShows(const CellGrid& cells) const {
+    for (size_t i = 0; i < cells.cellCount(); ++i) {
+      ASSERT_EQ(glyphs[i], cells.glyphs[i]) << "cell " << i;
+      ASSERT_EQ(colors[i * 3], cells.colors[i * 3]) << "cell " << i;
+      ASSERT_EQ(colors[i * 3 + 1], cells.colors[i * 3 + 1]) << "cell " << i;
+      ASSERT_EQ(colors[i * 3 + 2], cells.colors[i * 3 + 2]) << "cell " << i;
+    }
+  }
+};
+
+class FrameRendererTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+
+  RenderStats renderTo(DiffRenderer& renderer, const CellGrid& cells, FakeTerminal& terminal) {
+    RawImage buffer(DiffRenderer::bufferSize(cells.width, cells.height), 1, 1);
+    RenderStats stats = renderer.render(cells, buffer);
+    const char* text = reinterpret_cast<const char*>(buffer.getData());
+    EXPECT_EQ(stats.bytes_written, std::strlen(text));
+    terminal.apply(text, stats.bytes_written);
+    return stats;
+  }
+};
+
+TEST_F(FrameRendererTests, FirstFrameIsFullRepaint) {
+  RawImage raw_img(TOSTRING(IMAGE_FILE_PATH));
+  CellGrid cells;
+  buildColoredCells(raw_img, cells);
+
+  DiffRenderer renderer;
+  FakeTerminal terminal(cells.width, cells.height);
+  RenderStats stats = renderTo(renderer, cells, terminal);
+  EXPECT_TRUE(stats.full_repaint);
+  EXPECT_EQ(stats.changed_cells, cells.cellCount());
+  terminal.expectShows(cells);
+}
+
+TEST_F(FrameRendererTests, UnchangedFrameWritesAlmostNothing) {
+  RawImage raw_img(TOSTRING(IMAGE_FILE_PATH));
+  CellGrid cells;
+  buildColoredCells(raw_img, cells);
+
+  DiffRenderer renderer;
+  FakeTerminal terminal(cells.width, cells.height);
+  RenderStats first = renderTo(renderer, cells, terminal);
+  RenderStats second = renderTo(renderer, cells, terminal);
+  EXPECT_FALSE(second.full_repaint);
+  EXPECT_EQ(second.changed_cells, 0u);
+  EXPECT_LT(second.bytes_written, 32u);
+  EXPECT_GT(first.bytes_written, second.bytes_written);
+  terminal.expectShows(cells);
+}
+
+TEST_F(FrameRendererTests, OnlyChangedCellsAreRedrawn) {
+  RawImage raw_img(TOSTRING(IMAGE_FILE_PATH));
+  CellGrid cells;
+  buildColoredCells(raw_img, cells);
+
+  DiffRenderer renderer;
+  FakeTerminal terminal(cells.width, cells.height);
+  renderTo(renderer, cells, terminal);
+
+  // Two nearby cells merge into one run, a distant one gets its own cursor move
+  size_t changed[] = { 5, 7, static_cast<size_t>(cells.width) * 10 + 50 };
+  for (size_t i : changed) {
+    cells.glyphs[i] = '#';
+    cells.colors[i * 3] = 1;
+  }
+  RenderStats stats = renderTo(renderer, cells, terminal);
+  EXPECT_FALSE(stats.full_repaint);
+  EXPECT_EQ(stats.changed_cells, 3u);
+  EXPECT_LT(stats.bytes_written, 200u);
+  terminal.expectShows(cells);
+}
+
+TEST_F(FrameRendererTests, ThresholdTriggersFullRepaint) {
+  RawImage raw_img(TOSTRING(IMAGE_FILE_PATH));
+  CellGrid cells;
+  buildRainbowCells(raw_img, 0, cells);
+
+  DiffRenderer renderer(0.25);
+  FakeTerminal terminal(cells.width, cells.height);
+  renderTo(renderer, cells, terminal);
+
+  buildRainbowCells(raw_img, 1, cells); // Shifts the color of every cell
+  RenderStats stats = renderTo(renderer, cells, terminal);
+  EXPECT_TRUE(stats.full_repaint);
+  EXPECT_GT(stats.changed_cells, cells.cellCount() / 4);
+  terminal.expectShows(cells);
+}
+
+TEST_F(FrameRendererTests, AnimationStaysInSyncWithTerminal) {
+  RawImage raw_img(TOSTRING(IMAGE_FILE_PATH));
+  CellGrid cells;
+  DiffRenderer renderer(1.0); // Never falls back, every frame goes through the diff path
+  buildRainbowCells(raw_img, 0, cells);
+  FakeTerminal terminal(cells.width, cells.height);
+
+  size_t full_bytes = 0, diff_bytes = 0;
+  for (int i = 0; i < 20; ++i) {
+    buildRainbowCells(raw_img, i, cells);
+    RenderStats stats = renderTo(renderer, cells, terminal);
+    terminal.expectShows(cells);
+    (stats.full_repaint ? full_bytes : diff_bytes) += stats.bytes_written;
+  }
+  std::cout << "Rainbow frames, bytes written: full " << full_bytes << ", differential " << diff_bytes << std::endl;
+}
+
+TEST_F(FrameRendererTests, SizeChangeClearsScreen) {
+  CellGrid small_cells, large_cells;
+  RawImage small_img(4, 3, 3), large_img(6, 5, 3);
+  std::memset(small_img.getData(), 10, small_img.getSize());
+  std::memset(large_img.getData(), 200, large_img.getSize());
+  buildColoredCells(small_img, small_cells);
+  buildColoredCells(large_img, large_cells);
+
+  DiffRenderer renderer;
+  FakeTerminal terminal(6, 5);
+  renderTo(renderer, small_cells, terminal);
+  RenderStats stats = renderTo(renderer, large_cells, terminal);
+  EXPECT_TRUE(stats.full_repaint);
+  terminal.expectShows(large_cells);
+}
+
+TEST_F(FrameRendererTests, ToleranceDoesNotAccumulate) {
+  const int tolerance = 8;
+  RawImage image(8, 2, 3);
+  std::memset(image.getData(), 100, image.getSize());
+  CellGrid cells;
+  buildColoredCells(image, cells);
+
+  DiffRenderer renderer(1.0, tolerance);
+  FakeTerminal terminal(cells.width, cells.height);
+  // Odd cells start inside the tolerance of the even cells, so they are drawn
+  // in the even cells' color, then move away in steps inside the tolerance
+  for (int step = 0; step < 10; ++step) {
+    for (size_t i = 0; i < cells.colors.size(); ++i) {
+      cells.colors[i] = static_cast<uint8_t>(100 + (i / 3 % 2) * (step + 1) * 6);
+    }
+    renderTo(renderer, cells, terminal);
+    for (size_t i = 0; i < cells.colors.size(); ++i) {
+      ASSERT_LE(std::abs(terminal.colors[i] - cells.colors[i]), tolerance) << "step " << step << " channel " << i;
+    }
+  }
+}
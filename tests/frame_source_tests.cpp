@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "frame_source.hpp"
+#include "frame_pipeline.hpp"
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+
+class FrameSourceTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+// Writes `data` into a pipe on a helper thread, returns the read end
+static int pipeFrom(const std::string& data, std::thread& writer) {
+  int fds[2];
+  if (pipe(fds) != 0) throw std::runtime_error("pipe failed");
+  writer = std::thread([data, fd = fds[1]] {
+    size_t done = 0;
+    while (done < data.size()) {
+      ssize_t n = write(fd, data.data() + done, data.size() - done);
+      if (n <= 0) break;
+      done += static_cast<size_t>(n);
+    }
+    close(fd);
+  });
+  return fds[0];
+}
+
+TEST_F(FrameSourceTests, SyntheticFramesAreReproducible) {
+  for (SyntheticPattern pattern : { SyntheticPattern::Gradient, SyntheticPattern::Checkerboard,
+                                    SyntheticPattern::ColorBars, SyntheticPattern::Noise }) {
+    SyntheticSource a(64, 48, pattern, 3), b(64, 48, pattern, 3);
+    Frame fa, fb;
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_TRUE(a.read(fa));
+      ASSERT_TRUE(b.read(fb));
+      EXPECT_EQ(fa.width, 64);
+      EXPECT_EQ(fa.height, 48);
+      EXPECT_EQ(fa.format, PixelFormat::RGB24);
+      EXPECT_EQ(std::memcmp(fa.pixels.getData(), fb.pixels.getData(), fa.byteSize()), 0);
+    }
+    EXPECT_FALSE(a.read(fa)); // frame_count reached
+  }
+}
+
+TEST_F(FrameSourceTests, FrameBufferIsReused) {
+  SyntheticSource source(32, 32);
+  Frame frame;
+  ASSERT_TRUE(source.read(frame));
+  const uint8_t* buffer = frame.pixels.getData();
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(source.read(frame));
+    EXPECT_EQ(frame.pixels.getData(), buffer);
+  }
+}
+
+TEST_F(FrameSourceTests, RawStreamReadsWholeFrames) {
+  const int width = 5, height = 3;
+  std::string data;
+  for (int f = 0; f < 2; ++f) {
+    for (int i = 0; i < width * height * 3; ++i) data.push_back(static_cast<char>(f * 100 + i));
+  }
+  std::thread writer;
+  int fd = pipeFrom(data, writer);
+  RawStreamSource source(fd, width, height, PixelFormat::BGR24);
+  Frame frame;
+  for (int f = 0; f < 2; ++f) {
+    ASSERT_TRUE(source.read(frame));
+    EXPECT_EQ(frame.format, PixelFormat::BGR24);
+    EXPECT_EQ(frame.pixels.getData()[0], f * 100);
+    EXPECT_EQ(frame.pixels.getData()[frame.byteSize() - 1], f * 100 + width * height * 3 - 1);
+  }
+  EXPECT_FALSE(source.read(frame));
+  writer.join();
+  close(fd);
+}
+
+TEST_F(FrameSourceTests, RawStreamEndsAtPartialFrame) {
+  std::thread writer;
+  int fd = pipeFrom(std::string(4 * 4 * 3 + 10, 'x'), writer);
+  RawStreamSource source(fd, 4, 4);
+  Frame frame;
+  EXPECT_TRUE(source.read(frame));
+  EXPECT_EQ(source.truncatedBytes(), 0u);
+  EXPECT_FALSE(source.read(frame));
+  EXPECT_EQ(source.truncatedBytes(), 10u);
+  writer.join();
+  close(fd);
+}
+
+TEST_F(FrameSourceTests, RawStreamKeepsYuvFrames) {
+  // 5x3 NV12: 15 Y bytes, then 3 UV pairs for each of 2 chroma rows
+  const int width = 5, height = 3;
+  std::string data;
+  for (int i = 0; i < 27; ++i) data.push_back(static_cast<char>(i));
+  data += data;
+  std::thread writer;
+  int fd = pipeFrom(data, writer);
+  RawStreamSource source(fd, width, height, PixelFormat::NV12);
+  Frame frame;
+  for (int f = 0; f < 2; ++f) {
+    ASSERT_TRUE(source.read(frame));
+    EXPECT_EQ(frame.format, PixelFormat::NV12);
+    EXPECT_EQ(frame.byteSize(), 27u);
+    YuvImageView view = frame.yuvView();
+    EXPECT_EQ(view.lumaRow(2)[4], 14);
+    EXPECT_EQ(view.uRow(1)[0], 21);
+    EXPECT_EQ(view.vRow(1)[4], 26);
+  }
+  EXPECT_FALSE(source.read(frame));
+  writer.join();
+  close(fd);
+}
+
+TEST_F(FrameSourceTests, Y4mDecodesI420) {
+  const int width = 4, height = 2;
+  std::string data = "YUV4MPEG2 W4 H2 F30:1 Ip A1:1 C420jpeg\n";
+  data += "FRAME\n";
+  data += std::string(width * height, static_cast<char>(128)); // Y
+  data += std::string(2, static_cast<char>(128));               // U
+  data += std::string(2, static_cast<char>(128));               // V
+  data += "FRAME\n";
+  data += std::string(width * height, static_cast<char>(235));
+  data += std::string(2, static_cast<char>(128));
+  data += std::string(2, static_cast<char>(240)); // Strong red
+  std::thread writer;
+  int fd = pipeFrom(data, writer);
+  Y4mSource source(fd);
+  EXPECT_EQ(source.width(), width);
+  EXPECT_EQ(source.height(), height);
+  EXPECT_DOUBLE_EQ(source.fps(), 30.0);
+
+  Frame frame;
+  ASSERT_TRUE(source.read(frame));
+  for (size_t i = 0; i < frame.byteSize(); ++i) {
+    EXPECT_EQ(frame.pixels.getData()[i], 130); // Limited range mid gray
+  }
+  ASSERT_TRUE(source.read(frame));
+  EXPECT_EQ(frame.pixels.getData()[0], 255);
+  EXPECT_LT(frame.pixels.getData()[1], frame.pixels.getData()[0]);
+  EXPECT_FALSE(source.read(frame));
+  writer.join();
+  close(fd);
+}
+
+TEST_F(FrameSourceTests, Y4mRejectsOtherStreams) {
+  std::thread writer;
+  int fd = pipeFrom("P6\n4 4\n255\n", writer);
+  EXPECT_THROW(Y4mSource source(fd), std::runtime_error);
+  writer.join();
+  close(fd);
+}
+
+TEST_F(FrameSourceTests, ImageSequenceSkipsUndecodableFiles) {
+  std::vector<std::string> files = ImageSequenceSource::listDirectory(TOSTRING(IMAGE_DIR_PATH));
+  ASSERT_FALSE(files.empty());
+  ImageSequenceSource source(files);
+  Frame frame;
+  size_t frames = 0;
+  while (source.read(frame)) {
+    EXPECT_EQ(frame.format, PixelFormat::RGB24);
+    EXPECT_GT(frame.width, 0);
+    ++frames;
+  }
+  // The directory also holds a README that stb cannot decode
+  EXPECT_EQ(frames, files.size() - 1);
+}
+
+TEST_F(FrameSourceTests, OpenFrameSourceParsesSpecs) {
+  std::unique_ptr<FrameSource> source = openFrameSource("synthetic:bars:32x16");
+  Frame frame;
+  ASSERT_TRUE(source->read(frame));
+  EXPECT_EQ(source->name(), "synthetic");
+  EXPECT_EQ(frame.width, 32);
+  EXPECT_EQ(frame.height, 16);
+
+  EXPECT_EQ(openFrameSource(std::string("images:") + TOSTRING(IMAGE_DIR_PATH))->name(), "images");
+  EXPECT_THROW(openFrameSource("synthetic:plaid"), std::runtime_error);
+  EXPECT_THROW(openFrameSource("raw:640"), std::runtime_error);
+  EXPECT_THROW(openFrameSource("tape:0"), std::runtime_error);
+}
+
+TEST_F(FrameSourceTests, PipelineRunsUntilSourceEnds) {
+  PipelineConfig config;
+  config.max_capture_width = 64;
+  config.max_capture_height = 48;
+  config.output_width = 32;
+  config.show_status = false;
+  config.queue_depth = 1;
+
+  // An RGB source skips the BGR2RGB conversion in the resize stage
+  SyntheticSource source(64, 48, SyntheticPattern::ColorBars, 25);
+  size_t written = 0;
+  FramePipeline pipeline(config, source, [&](const char*, size_t) { ++written; });
+  pipeline.run();
+  EXPECT_EQ(pipeline.stats().stages[CAPTURE_STAGE].processed, 25u);
+  EXPECT_GT(written, 0u);
+}
+
+TEST_F(FrameSourceTests, PipelineEndsAtPartialFrame) {
+  // Five whole frames and the start of a sixth, as from a producer killed mid-frame
+  std::thread writer;
+  int fd = pipeFrom(std::string(64 * 48 * 3 * 5 + 1000, '\x40'), writer);
+  RawStreamSource source(fd, 64, 48);
+  PipelineConfig config;
+  config.max_capture_width = 64;
+  config.max_capture_height = 48;
+  config.output_width = 32;
+  config.show_status = false;
+  EXPECT_NO_THROW(outputAsciiPipeline(source, 0, config));
+  EXPECT_EQ(source.truncatedBytes(), 1000u);
+  writer.join();
+  close(fd);
+}
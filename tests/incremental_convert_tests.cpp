@@ -0,0 +1,230 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "incremental_convert.hpp"
+#include "ascii_image.hpp"
+
+
+class IncrementalConvertTests : public ::testing::Test {
+  protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+// A noisy still background with a bright square at (x, y)
+static std::vector<uint8_t> scene(int width, int height, int channels, int x, int y, int size) {
+  std::vector<uint8_t> data(static_cast<size_t>(width) * height * channels);
+  uint32_t seed = 3;
+  for (uint8_t& value : data) {
+    seed = seed * 1664525u + 1013904223u;
+    value = static_cast<uint8_t>(seed >> 24);
+  }
+  for (int row = y; row < std::min(height, y + size); ++row) {
+    for (int col = x; col < std::min(width, x + size); ++col) {
+      for (int c = 0; c < channels; ++c) data[(static_cast<size_t>(row) * width + col) * channels + c] = 250;
+    }
+  }
+  return data;
+}
+
+static std::string text(const RawImage& buffer, size_t size) {
+  return std::string(reinterpret_cast<const char*>(buffer.getData()), size);
+}
+
+TEST_F(IncrementalConvertTests, ParseNoiseThreshold) {
+  EXPECT_EQ(parseNoiseThreshold("0"), 0);
+  EXPECT_EQ(parseNoiseThreshold("255"), 255);
+  EXPECT_THROW(parseNoiseThreshold("256"), std::runtime_error);
+  EXPECT_THROW(parseNoiseThreshold("-1"), std::runtime_error);
+  EXPECT_THROW(parseNoiseThreshold("8px"), std::runtime_error);
+  EXPECT_THROW(parseNoiseThreshold(""), std::runtime_error);
+}
+
+TEST_F(IncrementalConvertTests, TileChangedKernelsAgree) {
+  const int row_bytes = 3 * 37, rows = 5;
+  std::vector<uint8_t> a(static_cast<size_t>(row_bytes) * rows, 100);
+  for (AsciiKernel kernel : { AsciiKernel::Scalar, AsciiKernel::SSSE3, AsciiKernel::AVX2 }) {
+    if (!isAsciiKernelSupported(kernel)) continue;
+    SCOPED_TRACE(asciiKernelName(kernel));
+    EXPECT_FALSE(tileChanged(kernel, a.data(), row_bytes, a.data(), row_bytes, row_bytes, rows, 0));
+    for (size_t i : { size_t(0), size_t(31), size_t(32), size_t(row_bytes - 1), a.size() - 1 }) {
+      for (int delta : { -9, -8, 8, 9 }) {
+        std::vector<uint8_t> b = a;
+        b[i] = static_cast<uint8_t>(b[i] + delta);
+        EXPECT_EQ(tileChanged(kernel, a.data(), row_bytes, b.data(), row_bytes, row_bytes, rows, 8), std::abs(delta) > 8)
+          << "byte " << i << " delta " << delta;
+      }
+    }
+    // Only row_bytes of every row are compared
+    std::vector<uint8_t> padded = a;
+    padded[row_bytes - 1] = 0;
+    EXPECT_FALSE(tileChanged(kernel, a.data(), row_bytes, padded.data(), row_bytes, row_bytes - 1, rows, 8));
+  }
+}
+
+TEST_F(IncrementalConvertTests, MatchesColoredAsciiFrameByFrame) {
+  const int width = 101, height = 37; // Partial tiles on the right and bottom
+  for (ColorMode mode : { ColorMode::Truecolor, ColorMode::Xterm256, ColorMode::Ansi16 }) {
+    for (int channels : { 3, 4 }) {
+      SCOPED_TRACE(std::to_string(channels) + " channels, mode " + std::to_string(static_cast<int>(mode)));
+      IncrementalConfig config;
+      config.tile_width = 16;
+      config.tile_height = 8;
+      config.noise_threshold = 0;
+      config.color_mode = mode;
+      IncrementalConverter converter(config);
+      RawImage expected(static_cast<int>(coloredAsciiBufferSize(width, height, mode)), 1, 1);
+      RawImage actual(static_cast<int>(coloredAsciiBufferSize(width, height, mode)), 1, 1);
+
+      for (int frame = 0; frame < 6; ++frame) {
+        // The square moves every other frame
+        std::vector<uint8_t> pixels = scene(width, height, channels, 10 + (frame / 2) * 7, 5, 12);
+        RawImageView view(pixels.data(), width, height, channels);
+        size_t expected_size = convertToColoredAscii(view, expected, mode);
+        size_t size = converter.convert(view, actual);
+        ASSERT_EQ(text(actual, size), text(expected, expected_size)) << "frame " << frame;
+        EXPECT_EQ(actual.getData()[size], '\0');
+
+        const IncrementalStats& stats = converter.lastStats();
+        EXPECT_EQ(stats.tiles, 7u * 5u);
+        EXPECT_EQ(stats.bytes_written, size);
+        if (frame == 0) {
+          EXPECT_TRUE(stats.full_convert);
+          EXPECT_EQ(stats.dirty_tiles, stats.tiles);
+        } else if (frame % 2 == 1) {
+          EXPECT_EQ(stats.dirty_tiles, 0u);
+        } else {
+          EXPECT_GT(stats.dirty_tiles, 0u);
+          EXPECT_LE(stats.dirty_tiles, 6u); // The tiles the square left and entered
+        }
+      }
+      EXPECT_EQ(converter.frames(), 6u);
+      EXPECT_EQ(converter.totals().tiles, 6u * 35u);
+    }
+  }
+}
+
+TEST_F(IncrementalConvertTests, NoiseBelowTheThresholdIsIgnoredUntilItAddsUp) {
+  const int width = 64, height = 32;
+  std::vector<uint8_t> pixels = scene(width, height, 3, 0, 0, 0);
+  for (uint8_t& value : pixels) value = std::min<uint8_t>(value, 200);
+  RawImageView view(pixels.data(), width, height, 3);
+  IncrementalConverter converter; // 32x16 tiles, threshold 8
+  RawImage first(static_cast<int>(coloredAsciiBufferSize(width, height)), 1, 1);
+  RawImage target(static_cast<int>(coloredAsciiBufferSize(width, height)), 1, 1);
+  size_t first_size = converter.convert(view, first);
+
+  // +3 on every byte three times: 3 and 6 stay below 8, 9 does not
+  for (int step = 1; step <= 3; ++step) {
+    for (uint8_t& value : pixels) value = static_cast<uint8_t>(value + 3);
+    size_t size = converter.convert(view, target);
+    if (step < 3) {
+      EXPECT_EQ(converter.lastStats().dirty_tiles, 0u) << step;
+      EXPECT_EQ(text(target, size), text(first, first_size));
+    } else {
+      EXPECT_EQ(converter.lastStats().dirty_tiles, 4u);
+      EXPECT_DOUBLE_EQ(converter.lastStats().dirtyRatio(), 1.0);
+      RawImage expected(static_cast<int>(coloredAsciiBufferSize(width, height)), 1, 1);
+      EXPECT_EQ(text(target, size), text(expected, convertToColoredAscii(view, expected)));
+    }
+  }
+}
+
+TEST_F(IncrementalConvertTests, ResetsOnSizeChangeAndInvalidate) {
+  IncrementalConfig config;
+  config.noise_threshold = 0;
+  IncrementalConverter converter(config);
+  RawImage target(static_cast<int>(coloredAsciiBufferSize(80, 40)), 1, 1);
+  std::vector<uint8_t> large = scene(80, 40, 3, 0, 0, 0);
+  std::vector<uint8_t> small = scene(40, 20, 3, 0, 0, 0);
+
+  converter.convert(RawImageView(large.data(), 80, 40, 3), target);
+  converter.convert(RawImageView(small.data(), 40, 20, 3), target);
+  EXPECT_TRUE(converter.lastStats().full_convert);
+  RawImage expected(static_cast<int>(coloredAsciiBufferSize(40, 20)), 1, 1);
+  size_t expected_size = convertToColoredAscii(RawImageView(small.data(), 40, 20, 3), expected);
+  converter.invalidate();
+  size_t size = converter.convert(RawImageView(small.data(), 40, 20, 3), target);
+  EXPECT_TRUE(converter.lastStats().full_convert);
+  EXPECT_EQ(text(target, size), text(expected, expected_size));
+  converter.convert(RawImageView(small.data(), 40, 20, 3), target);
+  EXPECT_FALSE(converter.lastStats().full_convert);
+  EXPECT_EQ(converter.lastStats().dirty_tiles, 0u);
+
+  RawImage too_small(16, 1, 1);
+  EXPECT_THROW(converter.convert(RawImageView(small.data(), 40, 20, 3), too_small), std::runtime_error);
+  config.tile_width = 0;
+  EXPECT_THROW(IncrementalConverter bad(config), std::runtime_error);
+  config.tile_width = 8;
+  config.noise_threshold = 256;
+  EXPECT_THROW(IncrementalConverter bad(config), std::runtime_error);
+}
+
+TEST_F(IncrementalConvertTests, CellSamplerSkipsStillTiles) {
+  const int width = 320, height = 240, size = 40;
+  CellSampler reference;
+  CellGrid expected, cells;
+  for (int channels : { 3, 1 }) {
+    IncrementalSamplerConfig config;
+    config.noise_threshold = 0;
+    IncrementalCellSampler sampler(config);
+    // A square moving right over a still background, 100 columns of 8 x 4 cell tiles
+    for (int frame = 0; frame < 6; ++frame) {
+      std::vector<uint8_t> pixels = scene(width, height, channels, 20 + frame * 15, 100, size);
+      RawImageView view(pixels.data(), width, height, channels);
+      sampler.sample(view, PixelFormat::RGB24, 100, cells);
+      reference.sample(view, PixelFormat::RGB24, 100, expected);
+      ASSERT_EQ(cells.width, expected.width);
+      ASSERT_EQ(cells.height, expected.height);
+      EXPECT_EQ(cells.glyphs, expected.glyphs) << "frame " << frame;
+      EXPECT_EQ(cells.colors, expected.colors) << "frame " << frame;
+      const IncrementalStats& stats = sampler.lastStats();
+      EXPECT_EQ(stats.tiles, 13u * 11u); // 100 x 41 cells
+      if (frame == 0) {
+        EXPECT_TRUE(stats.full_convert);
+      } else {
+        EXPECT_FALSE(stats.full_convert);
+        EXPECT_GT(stats.dirty_tiles, 0u);
+        EXPECT_LE(stats.dirty_tiles, 8u); // The tiles the square left and entered
+      }
+    }
+  }
+}
+
+TEST_F(IncrementalConvertTests, CellSamplerNoiseAndResets) {
+  const int width = 160, height = 120;
+  std::vector<uint8_t> pixels = scene(width, height, 3, 0, 0, 0);
+  for (uint8_t& value : pixels) value = std::min<uint8_t>(value, 200);
+  RawImageView view(pixels.data(), width, height, 3);
+  IncrementalCellSampler sampler; // Threshold 8
+  CellGrid first, cells;
+  sampler.sample(view, PixelFormat::RGB24, 40, first);
+
+  for (uint8_t& value : pixels) value = static_cast<uint8_t>(value + 5);
+  sampler.sample(view, PixelFormat::RGB24, 40, cells);
+  EXPECT_EQ(sampler.lastStats().dirty_tiles, 0u);
+  EXPECT_EQ(cells.colors, first.colors); // Below the threshold the old cells stay
+
+  for (uint8_t& value : pixels) value = static_cast<uint8_t>(value + 5);
+  sampler.sample(view, PixelFormat::RGB24, 40, cells);
+  EXPECT_DOUBLE_EQ(sampler.lastStats().dirtyRatio(), 1.0);
+
+  sampler.sample(view, PixelFormat::BGR24, 40, cells);
+  EXPECT_TRUE(sampler.lastStats().full_convert);
+  sampler.sample(view, PixelFormat::BGR24, 20, cells);
+  EXPECT_TRUE(sampler.lastStats().full_convert);
+  EXPECT_EQ(cells.width, 20);
+  sampler.invalidate();
+  sampler.sample(view, PixelFormat::BGR24, 20, cells);
+  EXPECT_TRUE(sampler.lastStats().full_convert);
+  EXPECT_EQ(sampler.frames(), 6u);
+
+  IncrementalSamplerConfig config;
+  config.tile_rows = 0;
+  EXPECT_THROW(IncrementalCellSampler bad(config), std::runtime_error);
+  config.tile_rows = 4;
+  config.noise_threshold = -1;
+  EXPECT_THROW(IncrementalCellSampler bad(config), std::runtime_error);
+}
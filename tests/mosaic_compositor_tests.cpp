@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "mosaic_compositor.hpp"
+
+
+class MosaicCompositorTests : public ::testing::Test {
+protected:
+  std::filesystem::path m_directory;
+
+  void SetUp() override {
+    m_directory = std::filesystem::temp_directory_path() / ("mosaic_compositor_" + std::to_string(getpid()));
+    std::filesystem::create_directories(m_directory);
+  }
+  void TearDown() override {
+    std::filesystem::remove_all(m_directory);
+  }
+
+  // `frames` frames of a moving synthetic pattern as a headerless raw file
+  std::string writeRaw(const std::string& name, int width, int height, PixelFormat format, size_t frames) {
+    SyntheticSource source(width, height, SyntheticPattern::ColorBars, frames);
+    std::string path = (m_directory / name).string();
+    std::ofstream file(path, std::ios::binary);
+    Frame frame;
+    std::vector<uint8_t> yuv;
+    while (source.read(frame)) {
+      if (format == PixelFormat::NV12) {
+        // Gray NV12 from the green channel is enough to exercise the YUV path
+        yuv.assign(yuvFrameSize(YuvFormat::NV12, width, height), 128);
+        for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) yuv[i] = frame.pixels.getData()[i * 3 + 1];
+        file.write(reinterpret_cast<const char*>(yuv.data()), static_cast<std::streamsize>(yuv.size()));
+      } else {
+        file.write(reinterpret_cast<const char*>(frame.pixels.getData()), static_cast<std::streamsize>(frame.byteSize()));
+      }
+    }
+    return path;
+  }
+};
+
+// A solid color for a fixed number of frames
+class SolidSource : public FrameSource
+{
+private:
+  int m_width, m_height;
+  uint8_t m_color[3];
+  size_t m_frames;
+  std::chrono::milliseconds m_delay;
+public:
+  SolidSource(int width, int height, uint8_t r, uint8_t g, uint8_t b, size_t frames,
+              std::chrono::milliseconds delay = std::chrono::milliseconds(0))
+  : m_width(width), m_height(height), m_color{ r, g, b }, m_frames(frames), m_delay(delay) {}
+  bool read(Frame& frame) override {
+    if (m_frames == 0) return false;
+    m_frames--;
+    std::this_thread::sleep_for(m_delay);
+    frame.reshape(m_width, m_height, PixelFormat::RGB24);
+    for (size_t i = 0; i < frame.byteSize(); ++i) frame.pixels.getData()[i] = m_color[i % 3];
+    return true;
+  }
+  std::string name() const override { return "solid"; }
+};
+
+class FailingSource : public FrameSource
+{
+public:
+  bool read(Frame&) override { throw std::runtime_error("device unplugged"); }
+  std::string name() const override { return "failing"; }
+};
+
+static std::string rowText(const CellGrid& grid, int y) {
+  return std::string(grid.glyphs.begin() + static_cast<size_t>(y) * grid.width,
+                     grid.glyphs.begin() + static_cast<size_t>(y + 1) * grid.width);
+}
+
+TEST_F(MosaicCompositorTests, TilesTheSources) {
+  const uint8_t colors[5][3] = { { 255, 0, 0 }, { 0, 255, 0 }, { 0, 0, 255 }, { 255, 255, 0 }, { 0, 255, 255 } };
+  std::vector<std::unique_ptr<FrameSource>> sources;
+  std::vector<FrameSource*> pointers;
+  for (const uint8_t* c : colors) {
+    sources.push_back(std::make_unique<SolidSource>(160, 90, c[0], c[1], c[2], 3)); // 16:9 into 4:3 tiles
+    pointers.push_back(sources.back().get());
+  }
+  sources.push_back(std::make_unique<FailingSource>());
+  pointers.push_back(sources.back().get());
+
+  MosaicConfig config;
+  config.tile_width = 20;
+  config.refresh_fps = 0;
+  size_t writes = 0;
+  ThreadPool pool(3);
+  MosaicCompositor compositor(config, pointers, [&writes](const char*, size_t) { writes++; }, pool);
+  compositor.run();
+
+  // 6 tiles as 3 x 2, a label row above each row of tiles
+  const CellGrid& mosaic = compositor.mosaic();
+  int tile_height = compositor.tileHeight();
+  EXPECT_EQ(compositor.gridColumns(), 3);
+  EXPECT_EQ(tile_height, cellRowsFor(640, 480, 20));
+  EXPECT_EQ(mosaic.width, 3 * 21 - 1);
+  EXPECT_EQ(mosaic.height, 2 * (tile_height + 1));
+  EXPECT_EQ(rowText(mosaic, 0).substr(0, 14), "1 solid ended ");
+  EXPECT_EQ(rowText(mosaic, 0).substr(21, 7), "2 solid");
+  EXPECT_EQ(rowText(mosaic, tile_height + 1).substr(42, 16), "6 failing failed");
+
+  for (int t = 0; t < 5; ++t) {
+    // The middle of the tile has the source's color, the letterbox above it is blank
+    int x = (t % 3) * 21 + 10, y = (t / 3) * (tile_height + 1) + 1;
+    const uint8_t* middle = &mosaic.colors[(static_cast<size_t>(y + tile_height / 2) * mosaic.width + x) * 3];
+    EXPECT_EQ(middle[0], colors[t][0]) << "tile " << t;
+    EXPECT_EQ(middle[1], colors[t][1]) << "tile " << t;
+    EXPECT_EQ(middle[2], colors[t][2]) << "tile " << t;
+    EXPECT_EQ(mosaic.glyphs[static_cast<size_t>(y) * mosaic.width + x], ' ') << "tile " << t;
+  }
+
+  // Every refresh showed one new frame of every source, the last one found them all ended
+  MosaicStats stats = compositor.stats();
+  EXPECT_EQ(stats.refreshes, 4u);
+  EXPECT_EQ(writes, 4u); // One write per refresh
+  ASSERT_EQ(stats.sources.size(), 6u);
+  for (int t = 0; t < 5; ++t) {
+    EXPECT_EQ(stats.sources[t].frames, 3u);
+    EXPECT_EQ(stats.sources[t].shown, 3u);
+    EXPECT_TRUE(stats.sources[t].ended);
+    EXPECT_TRUE(stats.sources[t].error.empty());
+  }
+  EXPECT_EQ(stats.sources[5].frames, 0u);
+  EXPECT_EQ(stats.sources[5].error, "device unplugged");
+
+  std::ostringstream report;
+  writeMosaicReport(stats, report);
+  EXPECT_NE(report.str().find("6 sources, 4 refreshes"), std::string::npos);
+  EXPECT_NE(report.str().find("6 failing: 0 frames"), std::string::npos);
+}
+
+TEST_F(MosaicCompositorTests, KeepsUpWithManyFileSources) {
+  const size_t frames = 30;
+  std::vector<std::unique_ptr<FrameSource>> sources;
+  std::vector<FrameSource*> pointers;
+  for (int i = 0; i < 12; ++i) {
+    PixelFormat format = i % 3 == 2 ? PixelFormat::NV12 : PixelFormat::RGB24;
+    std::string path = writeRaw("source" + std::to_string(i) + ".raw", 320, 240, format, frames);
+    sources.push_back(std::make_unique<RawStreamSource>(path, 320, 240, format));
+    pointers.push_back(sources.back().get());
+  }
+
+  MosaicConfig config;
+  config.tile_width = 32;
+  config.refresh_fps = 60;
+  ThreadPool pool(4);
+  size_t bytes = 0;
+  MosaicCompositor compositor(config, pointers, [&bytes](const char*, size_t size) { bytes += size; }, pool);
+  compositor.run();
+
+  // Converting a 320x240 frame into 32 columns takes well under a refresh, so
+  // every source advances on every refresh and every frame is shown
+  MosaicStats stats = compositor.stats();
+  EXPECT_EQ(compositor.gridColumns(), 4);
+  EXPECT_GE(stats.refreshes, frames + 1);
+  EXPECT_LE(stats.refreshes, frames + 4);
+  EXPECT_EQ(stats.bytes_written, bytes);
+  for (const MosaicSourceStats& source : stats.sources) {
+    EXPECT_EQ(source.frames, frames) << source.name;
+    EXPECT_GE(source.shown, frames - 2) << source.name;
+    EXPECT_LT(source.mean_latency_ms, 1000.0 / config.refresh_fps * 2) << source.name;
+    EXPECT_TRUE(source.ended && source.error.empty()) << source.name;
+  }
+}
+
+TEST_F(MosaicCompositorTests, SlowSourcesDoNotHoldBackTheOthers) {
+  SolidSource slow(64, 48, 200, 0, 0, 1000, std::chrono::milliseconds(40));
+  SyntheticSource fast1(64, 48, SyntheticPattern::Gradient), fast2(64, 48, SyntheticPattern::Noise);
+  MosaicConfig config;
+  config.tile_width = 16;
+  config.refresh_fps = 100;
+  config.max_refreshes = 30;
+  ThreadPool pool(3);
+  MosaicCompositor compositor(config, { &slow, &fast1, &fast2 }, WriteFunction(), pool);
+  auto start = std::chrono::steady_clock::now();
+  compositor.run();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  MosaicStats stats = compositor.stats();
+  EXPECT_EQ(stats.refreshes, 30u);
+  EXPECT_LT(elapsed.count(), 1.0); // 0.3 s of refreshes, not 30 x 40 ms
+  EXPECT_LE(stats.sources[0].frames, 12u);
+  EXPECT_GE(stats.sources[0].busy_refreshes, 15u);
+  EXPECT_GE(stats.sources[1].frames, 20u);
+  EXPECT_GE(stats.sources[2].frames, 20u);
+
+  // The constructor checks its arguments
+  config.tile_width = 0;
+  EXPECT_THROW(MosaicCompositor(config, { &fast1 }, WriteFunction(), pool), std::runtime_error);
+  config.tile_width = 16;
+  EXPECT_THROW(MosaicCompositor(config, {}, WriteFunction(), pool), std::runtime_error);
+}
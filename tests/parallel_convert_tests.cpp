@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include "ascii_image.hpp"
+#include "parallel_convert.hpp"
+
+// Helper macro to stringify preprocessor definitions
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+
+class ParallelConvertTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+static RawImage makeNoiseImage(int width, int height) {
+  RawImage img(width, height, 3);
+  std::mt19937 rng(42);
+  uint8_t* p = img.getData();
+  for (size_t i = 0; i < img.getSize(); ++i) {
+    // Runs of equal pixels exercise the color elision across band borders
+    p[i] = static_cast<uint8_t>((i / 30) % 7 == 0 ? 128 : rng() & 0xFF);
+  }
+  return img;
+}
+
+TEST_F(ParallelConvertTests, ParallelForVisitsEveryIndexOnce) {
+  ThreadPool pool(4);
+  std::vector<std::atomic<int>> visits(1000);
+  pool.parallelFor(visits.size(), [&visits](size_t i) { visits[i]++; });
+  for (size_t i = 0; i < visits.size(); ++i) {
+    EXPECT_EQ(visits[i].load(), 1) << i;
+  }
+  EXPECT_EQ(pool.threadCount(), 4u);
+}
+
+TEST_F(ParallelConvertTests, ParallelForRethrows) {
+  ThreadPool pool(3);
+  EXPECT_THROW(pool.parallelFor(10, [](size_t i) {
+    if (i == 7) throw std::runtime_error("band failed");
+  }), std::runtime_error);
+  // Pool is still usable afterwards
+  std::atomic<int> count{0};
+  pool.parallelFor(5, [&count](size_t) { count++; });
+  EXPECT_EQ(count.load(), 5);
+}
+
+TEST_F(ParallelConvertTests, GrayMatchesSequential) {
+  RawImage raw_img = makeNoiseImage(173, 97);
+  RawImage expected = convertToAscii(raw_img);
+  for (size_t threads : {1, 2, 3, 8}) {
+    ThreadPool pool(threads);
+    RawImage actual = convertToAsciiParallel(raw_img, pool);
+    ASSERT_EQ(expected.getSize(), actual.getSize());
+    EXPECT_EQ(0, std::memcmp(expected.getData(), actual.getData(), expected.getSize())) << threads << " threads";
+  }
+}
+
+TEST_F(ParallelConvertTests, ColoredMatchesSequential) {
+  RawImage raw_img = makeNoiseImage(173, 97);
+  size_t buffer_size = coloredAsciiBufferSize(raw_img.getWidth(), raw_img.getHeight());
+  RawImage expected(buffer_size, 1, 1), actual(buffer_size, 1, 1);
+  size_t expected_size = convertToColoredAscii(raw_img, expected);
+  for (size_t threads : {1, 2, 3, 8}) {
+    ThreadPool pool(threads);
+    size_t actual_size = convertToColoredAsciiParallel(raw_img, actual, pool);
+    ASSERT_EQ(expected_size, actual_size) << threads << " threads";
+    EXPECT_EQ(0, std::memcmp(expected.getData(), actual.getData(), expected_size + 1)) << threads << " threads";
+  }
+}
+
+TEST_F(ParallelConvertTests, RainbowMatchesSequential) {
+  RawImage raw_img(TOSTRING(IMAGE_FILE_PATH));
+  size_t buffer_size = coloredAsciiBufferSize(raw_img.getWidth(), raw_img.getHeight());
+  RawImage expected(buffer_size, 1, 1), actual(buffer_size, 1, 1);
+  ThreadPool pool(4);
+  for (int offset : {0, 17}) {
+    size_t expected_size = convertToRainbowAscii(raw_img, offset, expected);
+    size_t actual_size = convertToRainbowAsciiParallel(raw_img, offset, actual, pool);
+    ASSERT_EQ(expected_size, actual_size);
+    EXPECT_EQ(0, std::memcmp(expected.getData(), actual.getData(), expected_size + 1));
+  }
+}
+
+TEST_F(ParallelConvertTests, SegmentsCoverJoinedOutput) {
+  RawImage raw_img = makeNoiseImage(64, 40);
+  size_t buffer_size = coloredAsciiBufferSize(raw_img.getWidth(), raw_img.getHeight());
+  RawImage expected(buffer_size, 1, 1), banded(buffer_size, 1, 1);
+  size_t expected_size = convertToColoredAscii(raw_img, expected);
+
+  ThreadPool pool(2);
+  std::vector<AsciiSegment> segments;
+  size_t total = convertToColoredAsciiBands(raw_img, banded, segments, pool);
+  ASSERT_EQ(total, expected_size);
+  // Concatenating the segments, as writev would, gives the sequential output
+  std::string gathered;
+  for (const AsciiSegment& segment : segments) gathered.append(segment.data, segment.size);
+  EXPECT_EQ(gathered, std::string(reinterpret_cast<const char*>(expected.getData()), expected_size));
+}
+
+TEST_F(ParallelConvertTests, ScalingAcrossThreadCounts) {
+  const int width = 1920, height = 1080;
+  RawImage raw_img = makeNoiseImage(width, height);
+  RawImage colored_img(coloredAsciiBufferSize(width, height), 1, 1);
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    ThreadPool pool(threads);
+    auto start_time = std::chrono::high_resolution_clock::now();
+    RawImage gray_img = convertToAsciiParallel(raw_img, pool);
+    auto gray_time = std::chrono::high_resolution_clock::now();
+    convertToColoredAsciiParallel(raw_img, colored_img, pool);
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    std::chrono::duration<double, std::milli> gray_elapsed = gray_time - start_time;
+    std::chrono::duration<double, std::milli> colored_elapsed = end_time - gray_time;
+    std::cout << "1080p with " << threads << " threads: gray " << gray_elapsed.count() << " ms, colored "
+              << colored_elapsed.count() << " ms" << std::endl;
+  }
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "pixel_layout.hpp"
+#include "ascii_image.hpp"
+#include "dense_ascii.hpp"
+#include "parallel_convert.hpp"
+
+
+class PixelLayoutTests : public ::testing::Test {
+  protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+// Deterministic pixels of any channel count, alpha included
+static std::vector<uint8_t> noise(int width, int height, int channels, uint32_t seed) {
+  std::vector<uint8_t> data(static_cast<size_t>(width) * height * channels);
+  for (uint8_t& value : data) {
+    seed = seed * 1664525u + 1013904223u;
+    value = static_cast<uint8_t>(seed >> 24);
+  }
+  return data;
+}
+
+// The layout written out as RGB by hand, alpha over black
+static std::vector<uint8_t> expandToRgb(const std::vector<uint8_t>& data, PixelLayout layout) {
+  int channels = pixelLayoutChannels(layout);
+  size_t pixels = data.size() / channels;
+  std::vector<uint8_t> rgb(pixels * 3);
+  for (size_t i = 0; i < pixels; ++i) {
+    const uint8_t* p = data.data() + i * channels;
+    uint8_t* out = rgb.data() + i * 3;
+    int alpha = 255;
+    switch (layout) {
+      case PixelLayout::Gray: out[0] = out[1] = out[2] = p[0]; break;
+      case PixelLayout::GrayA: out[0] = out[1] = out[2] = p[0]; alpha = p[1]; break;
+      case PixelLayout::RGB: out[0] = p[0]; out[1] = p[1]; out[2] = p[2]; break;
+      case PixelLayout::RGBA: out[0] = p[0]; out[1] = p[1]; out[2] = p[2]; alpha = p[3]; break;
+      case PixelLayout::BGR: out[0] = p[2]; out[1] = p[1]; out[2] = p[0]; break;
+    }
+    for (int c = 0; c < 3; ++c) out[c] = static_cast<uint8_t>((out[c] * alpha + 127) / 255);
+  }
+  return rgb;
+}
+
+static std::string text(const RawImage& buffer, size_t size) {
+  return std::string(reinterpret_cast<const char*>(buffer.getData()), size);
+}
+
+static const PixelLayout LAYOUTS[] = { PixelLayout::Gray, PixelLayout::GrayA, PixelLayout::RGB, PixelLayout::RGBA,
+                                       PixelLayout::BGR };
+
+TEST_F(PixelLayoutTests, TablesAreBuiltAtCompileTime) {
+  static_assert(GLYPH_TABLE[0] == ' ', "darkest glyph");
+  static_assert(GLYPH_TABLE[255] == '$', "brightest glyph");
+  static_assert(lumaOf(255, 255, 255) == 255, "white");
+  static_assert(overBlack(200, 255) == 200 && overBlack(200, 0) == 0, "alpha bounds");
+  for (int i = 0; i < 256; ++i) {
+    EXPECT_EQ(GLYPH_TABLE[i], pixelToAscii(i)) << i;
+  }
+  for (int value = 0; value < 256; ++value) {
+    for (int alpha = 0; alpha < 256; ++alpha) {
+      ASSERT_EQ(overBlack(value, alpha), (value * alpha + 127) / 255) << value << " " << alpha;
+    }
+  }
+  EXPECT_EQ(pixelLayoutFor(2), PixelLayout::GrayA);
+  EXPECT_THROW(pixelLayoutFor(5), std::runtime_error);
+}
+
+TEST_F(PixelLayoutTests, EveryLayoutMatchesItsRgbExpansion) {
+  const int width = 37, height = 11;
+  for (PixelLayout layout : LAYOUTS) {
+    SCOPED_TRACE(pixelLayoutName(layout));
+    int channels = pixelLayoutChannels(layout);
+    std::vector<uint8_t> data = noise(width, height, channels, 7);
+    std::vector<uint8_t> rgb = expandToRgb(data, layout);
+    RawImageView view(data.data(), width, height, channels);
+    RawImageView rgb_view(rgb.data(), width, height, 3);
+
+    RawImage converted = convertToRgb(view, layout);
+    EXPECT_EQ(0, std::memcmp(converted.getData(), rgb.data(), rgb.size()));
+
+    EXPECT_STREQ(reinterpret_cast<const char*>(convertToAscii(view, layout).getData()),
+                 reinterpret_cast<const char*>(convertToAscii(rgb_view).getData()));
+
+    for (ColorMode mode : { ColorMode::Truecolor, ColorMode::Xterm256 }) {
+      RawImage expected(static_cast<int>(coloredAsciiBufferSize(width, height, mode)), 1, 1);
+      RawImage actual(static_cast<int>(coloredAsciiBufferSize(width, height, mode)), 1, 1);
+      size_t expected_size = convertToColoredAscii(rgb_view, expected, mode);
+      size_t actual_size = convertToColoredAscii(view, actual, mode, 0, layout);
+      EXPECT_EQ(text(actual, actual_size), text(expected, expected_size));
+    }
+  }
+}
+
+TEST_F(PixelLayoutTests, ConvertersFollowTheChannelCount) {
+  const int width = 30, height = 20;
+  ThreadPool pool(2);
+  for (PixelLayout layout : { PixelLayout::Gray, PixelLayout::GrayA, PixelLayout::RGBA }) {
+    SCOPED_TRACE(pixelLayoutName(layout));
+    int channels = pixelLayoutChannels(layout);
+    std::vector<uint8_t> data = noise(width, height, channels, 11);
+    std::vector<uint8_t> rgb = expandToRgb(data, layout);
+    // Padded rows, the stride is not width * channels
+    std::vector<uint8_t> padded(static_cast<size_t>(width * channels + 5) * height);
+    for (int y = 0; y < height; ++y) {
+      std::memcpy(padded.data() + static_cast<size_t>(y) * (width * channels + 5),
+                  data.data() + static_cast<size_t>(y) * width * channels, static_cast<size_t>(width) * channels);
+    }
+    RawImageView view(padded.data(), width, height, channels, width * channels + 5);
+    RawImageView rgb_view(rgb.data(), width, height, 3);
+
+    EXPECT_STREQ(reinterpret_cast<const char*>(convertToAscii(view).getData()),
+                 reinterpret_cast<const char*>(convertToAscii(rgb_view).getData()));
+    EXPECT_STREQ(reinterpret_cast<const char*>(convertToAsciiParallel(view, pool).getData()),
+                 reinterpret_cast<const char*>(convertToAscii(rgb_view).getData()));
+
+    RawImage expected(static_cast<int>(coloredAsciiBufferSize(width, height)), 1, 1);
+    RawImage actual(static_cast<int>(coloredAsciiBufferSize(width, height)), 1, 1);
+    size_t expected_size = convertToColoredAscii(rgb_view, expected);
+    EXPECT_EQ(text(actual, convertToColoredAscii(view, actual)), text(expected, expected_size));
+    EXPECT_EQ(text(actual, convertToColoredAsciiParallel(view, actual, pool)), text(expected, expected_size));
+    expected_size = convertToRainbowAscii(rgb_view, 5, expected);
+    EXPECT_EQ(text(actual, convertToRainbowAscii(view, 5, actual)), text(expected, expected_size));
+
+    CellGrid cells, rgb_cells;
+    buildColoredCells(view, cells);
+    buildColoredCells(rgb_view, rgb_cells);
+    EXPECT_EQ(cells.glyphs, rgb_cells.glyphs);
+    EXPECT_EQ(cells.colors, rgb_cells.colors);
+
+    RawImage half(static_cast<int>(halfBlockBufferSize(width, height)), 1, 1);
+    RawImage rgb_half(static_cast<int>(halfBlockBufferSize(width, height)), 1, 1);
+    EXPECT_EQ(text(half, convertToHalfBlockAscii(view, half)), text(rgb_half, convertToHalfBlockAscii(rgb_view, rgb_half)));
+    EXPECT_STREQ(reinterpret_cast<const char*>(convertToBrailleAscii(view).getData()),
+                 reinterpret_cast<const char*>(convertToBrailleAscii(rgb_view).getData()));
+  }
+}
+
+TEST_F(PixelLayoutTests, WrongChannelCountThrows) {
+  std::vector<uint8_t> data = noise(8, 8, 4, 3);
+  RawImageView view(data.data(), 8, 8, 4);
+  RawImage target(static_cast<int>(coloredAsciiBufferSize(8, 8)), 1, 1);
+  EXPECT_THROW(convertToAscii(view, PixelLayout::BGR), std::runtime_error);
+  EXPECT_THROW(convertToColoredAscii(view, target, ColorMode::Truecolor, 0, PixelLayout::Gray), std::runtime_error);
+  EXPECT_THROW(convertToRgb(view, PixelLayout::RGB), std::runtime_error);
+  RawImageView five(data.data(), 4, 8, 5);
+  EXPECT_THROW(convertToAscii(five), std::runtime_error);
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "ascii_image.hpp"
+#include "rainbow_animator.hpp"
+
+class RainbowAnimatorTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+static RawImage syntheticImage(int width, int height) {
+  SyntheticSource source(width, height, SyntheticPattern::Noise);
+  Frame frame;
+  source.read(frame);
+  return RawImage(width, height, 3, frame.view().getRow(0));
+}
+
+static std::string text(const AsciiSegment& segment) {
+  return std::string(segment.data, segment.size);
+}
+
+TEST_F(RainbowAnimatorTests, ColorsRepeatEveryPeriod) {
+  for (int offset : { -70, -1, 0, 5, 62, 130 }) {
+    for (int k = 0; k < 100; k += 7) {
+      uint8_t a[3], b[3];
+      getRainbowColor(k, 3, offset, a[0], a[1], a[2]);
+      getRainbowColor(k, 3, offset + RAINBOW_PERIOD, b[0], b[1], b[2]);
+      ASSERT_EQ(std::memcmp(a, b, 3), 0) << k << " " << offset;
+    }
+  }
+  // Neighbouring steps differ, the table is not degenerate
+  uint8_t a[3], b[3];
+  getRainbowColor(0, 0, 0, a[0], a[1], a[2]);
+  getRainbowColor(1, 0, 0, b[0], b[1], b[2]);
+  EXPECT_NE(std::memcmp(a, b, 3), 0);
+}
+
+TEST_F(RainbowAnimatorTests, FullRepaintFramesMatchConverter) {
+  RawImage img = syntheticImage(48, 20);
+  RainbowAnimator animator(img, RenderMode::FullRepaint);
+  RawImage expected(static_cast<int>(coloredAsciiBufferSize(48, 20)), 1, 1);
+
+  const size_t FRAMES = 2 * RAINBOW_PERIOD + 5;
+  for (size_t i = 0; i < FRAMES; ++i) {
+    RenderStats stats;
+    AsciiSegment frame = animator.frame(i, &stats);
+    size_t size = convertToRainbowAscii(img, static_cast<int>(i), expected);
+    ASSERT_EQ(text(frame), std::string(reinterpret_cast<const char*>(expected.getData()), size)) << i;
+    EXPECT_EQ(stats.bytes_written, size);
+    EXPECT_EQ(stats.changed_cells, 48u * 20u);
+  }
+  EXPECT_EQ(animator.cacheMisses(), static_cast<uint64_t>(RAINBOW_PERIOD));
+  EXPECT_EQ(animator.cacheHits(), FRAMES - RAINBOW_PERIOD);
+  EXPECT_EQ(animator.cachedFrames(), static_cast<size_t>(RAINBOW_PERIOD));
+}
+
+TEST_F(RainbowAnimatorTests, DifferentialFramesMatchRenderer) {
+  RawImage img = syntheticImage(40, 16);
+  const size_t frame_size = DiffRenderer::bufferSize(40, 16);
+  // Everything cached, a few frames cached, nothing cached
+  for (size_t limit : { RainbowAnimator::DEFAULT_CACHE_LIMIT, 3 * frame_size / 4, size_t(0) }) {
+    RainbowAnimator animator(img, RenderMode::Differential, limit);
+    DiffRenderer reference;
+    RawImage expected(static_cast<int>(frame_size), 1, 1);
+    CellGrid cells;
+
+    size_t index = 0;
+    for (int step = 0; step < 3 * RAINBOW_PERIOD; ++step) {
+      // Skip ahead once and lose the terminal once, neither may replay a stale transition
+      if (step == 70) index += 10;
+      if (step == 100) {
+        animator.invalidate();
+        reference.invalidate();
+      }
+      AsciiSegment frame = animator.frame(index);
+      buildRainbowCells(img, static_cast<int>(index), cells);
+      RenderStats stats = reference.render(cells, expected);
+      ASSERT_EQ(text(frame), std::string(reinterpret_cast<const char*>(expected.getData()), stats.bytes_written))
+        << "limit " << limit << " step " << step;
+      index++;
+    }
+    EXPECT_LE(animator.cachedBytes(), limit);
+    if (limit == 0) {
+      EXPECT_EQ(animator.cacheHits(), 0u);
+    } else {
+      EXPECT_GT(animator.cacheHits(), 0u);
+    }
+  }
+}
+
+TEST_F(RainbowAnimatorTests, CacheStaysWithinLimit) {
+  RawImage img = syntheticImage(120, 60);
+  RainbowAnimator unlimited(img, RenderMode::FullRepaint);
+  for (size_t i = 0; i < RAINBOW_PERIOD; ++i) unlimited.frame(i);
+  size_t period_bytes = unlimited.cachedBytes();
+
+  RainbowAnimator capped(img, RenderMode::FullRepaint, period_bytes / 4);
+  for (size_t i = 0; i < 3 * RAINBOW_PERIOD; ++i) capped.frame(i);
+  EXPECT_LE(capped.cachedBytes(), period_bytes / 4);
+  EXPECT_GT(capped.cachedFrames(), 0u);
+  EXPECT_LT(capped.cachedFrames(), static_cast<size_t>(RAINBOW_PERIOD));
+  EXPECT_EQ(capped.memoryUsage() - capped.cachedBytes(), unlimited.memoryUsage() - unlimited.cachedBytes());
+  std::cout << "Rainbow period of 120x60: " << period_bytes / 1024 << " KiB, capped at "
+            << capped.cachedFrames() << " frames" << std::endl;
+}
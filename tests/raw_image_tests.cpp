@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include <thread>
 #include "raw_image.hpp"
+#include "raw_image_view.hpp"
+#include "buffer_pool.hpp"
 
 // Helper macro to stringify preprocessor definitions
 #define STRINGIFY(x) #x
@@ -31,6 +33,27 @@ TEST_F(RawImageTests, LoadsImageCorrectly) {
   EXPECT_GT(raw_img.getChannels(), 0);
 }
 
+TEST_F(RawImageTests, KeepsTheDecoderBuffer) {
+  RawImage raw_img(TOSTRING(IMAGE_FILE_PATH));
+  EXPECT_TRUE(raw_img.isDecoderOwned());
+  const uint8_t* decoded = raw_img.getData();
+
+  // Moves hand the decoder's buffer on, copies are plain heap buffers
+  RawImage moved(std::move(raw_img));
+  EXPECT_TRUE(moved.isDecoderOwned());
+  EXPECT_EQ(moved.getData(), decoded);
+  EXPECT_FALSE(raw_img.isDecoderOwned());
+  RawImage copy = moved;
+  EXPECT_FALSE(copy.isDecoderOwned());
+  EXPECT_EQ(std::memcmp(copy.getData(), decoded, copy.getSize()), 0);
+  RawImage assigned(1, 1, 1);
+  assigned = std::move(moved);
+  EXPECT_TRUE(assigned.isDecoderOwned());
+  EXPECT_EQ(RawImage::get_live_count(), 2);
+
+  EXPECT_THROW(RawImage missing("/nonexistent/image.png"), std::runtime_error);
+}
+
 TEST_F(RawImageTests, ObjectCountIncrementsAndDecrements) {
   EXPECT_EQ(RawImage::get_live_count(), 0);
 
@@ -155,3 +178,67 @@ TEST_F(RawImageTests, PerformanceOfReturningRawImage) {
     std::cout << "\nRawImage creation/return (" << num_iterations << " iterations): "
               << elapsed.count() << " ms" << std::endl;
 }
+
+TEST_F(RawImageTests, ViewWrapsImageWithoutCopy) {
+  RawImage img(4, 3, 3);
+  RawImageView view = img;
+  EXPECT_EQ(view.getData(), img.getData());
+  EXPECT_EQ(view.getWidth(), 4);
+  EXPECT_EQ(view.getHeight(), 3);
+  EXPECT_EQ(view.getStride(), 12u);
+  EXPECT_TRUE(view.isContiguous());
+  EXPECT_EQ(view.getRow(2), img.getData() + 24);
+
+  RawImageView band = view.rows(1, 3);
+  EXPECT_EQ(band.getHeight(), 2);
+  EXPECT_EQ(band.getRow(0), img.getData() + 12);
+
+  RawImageView padded(img.getData(), 3, 3, 3, 12);
+  EXPECT_FALSE(padded.isContiguous());
+  EXPECT_EQ(padded.getRow(1), img.getData() + 12);
+}
+
+TEST_F(RawImageTests, PooledImageReturnsBufferToPool) {
+  BufferPool pool(64 * 64 * 3, 2);
+  {
+    RawImage a(64, 64, 3, pool);
+    RawImage b(32, 32, 3, pool);
+    EXPECT_TRUE(a.isPooled());
+    EXPECT_TRUE(b.isPooled());
+    EXPECT_TRUE(pool.owns(a.getData()));
+    EXPECT_EQ(pool.available(), 0u);
+    EXPECT_EQ(RawImage::get_live_count(), 2);
+  }
+  EXPECT_EQ(pool.available(), 2u);
+  EXPECT_EQ(RawImage::get_live_count(), 0);
+}
+
+TEST_F(RawImageTests, PooledImageFallsBackToHeap) {
+  BufferPool pool(16, 1);
+  RawImage too_large(8, 8, 3, pool);
+  EXPECT_FALSE(too_large.isPooled());
+  RawImage first(2, 2, 3, pool);
+  RawImage exhausted(2, 2, 3, pool);
+  EXPECT_TRUE(first.isPooled());
+  EXPECT_FALSE(exhausted.isPooled());
+  EXPECT_EQ(pool.misses(), 2u);
+}
+
+TEST_F(RawImageTests, MovedPooledImageKeepsPool) {
+  BufferPool pool(48, 2);
+  {
+    RawImage a(4, 4, 3, pool);
+    RawImage b(std::move(a));
+    EXPECT_TRUE(b.isPooled());
+    EXPECT_FALSE(a.isPooled());
+
+    RawImage c(4, 4, 3, pool);
+    c = std::move(b); // c's own buffer goes back first
+    EXPECT_EQ(pool.available(), 1u);
+
+    RawImage d = c; // Copies always go to the heap
+    EXPECT_FALSE(d.isPooled());
+  }
+  EXPECT_EQ(pool.available(), 2u);
+  EXPECT_EQ(RawImage::get_live_count(), 0);
+}
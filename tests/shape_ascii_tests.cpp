@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "shape_ascii.hpp"
+#include "dense_ascii.hpp"
+#include "frame_pipeline.hpp"
+
+
+class ShapeAsciiTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+static const AsciiKernel ALL_KERNELS[] = { AsciiKernel::Scalar, AsciiKernel::SSSE3, AsciiKernel::AVX2 };
+
+// Gray RGB picture, `ink` where draw(x, y) is true, `paper` elsewhere
+template <typename Draw>
+static std::vector<uint8_t> picture(int width, int height, uint8_t ink, uint8_t paper, Draw draw) {
+  std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8_t v = draw(x, y) ? ink : paper;
+      uint8_t* p = &rgb[(static_cast<size_t>(y) * width + x) * 3];
+      p[0] = p[1] = p[2] = v;
+    }
+  }
+  return rgb;
+}
+
+static std::string asciiText(const RawImage& image) {
+  return reinterpret_cast<const char*>(image.getData());
+}
+
+// The text with escape sequences removed
+static std::string glyphsOf(const char* text, size_t size) {
+  std::string glyphs;
+  for (size_t i = 0; i < size; ++i) {
+    if (text[i] == '\033') {
+      while (i < size && !std::isalpha(static_cast<unsigned char>(text[i]))) ++i;
+      continue;
+    }
+    glyphs += text[i];
+  }
+  return glyphs;
+}
+
+TEST_F(ShapeAsciiTests, GlyphSetIsDistinct) {
+  const std::vector<ShapeGlyph>& glyphs = shapeGlyphs();
+  ASSERT_GE(glyphs.size(), 32u);
+  EXPECT_EQ(glyphs[0].glyph, ' ');
+  EXPECT_EQ(glyphs[0].mask, 0u);
+  for (size_t i = 0; i < glyphs.size(); ++i) {
+    // Every glyph is its own nearest match, so no two masks are equal
+    EXPECT_EQ(nearestShapeGlyph(AsciiKernel::Scalar, glyphs[i].mask), static_cast<int>(i)) << glyphs[i].glyph;
+  }
+}
+
+TEST_F(ShapeAsciiTests, KernelsMatchScalar) {
+  std::mt19937 rng(3);
+  for (int i = 0; i < 20000; ++i) {
+    uint32_t pattern = rng();
+    if (i % 4 == 0) pattern &= rng(); // Sparser patterns tie more often
+    int expected = nearestShapeGlyph(AsciiKernel::Scalar, pattern);
+    for (AsciiKernel kernel : ALL_KERNELS) {
+      if (!isAsciiKernelSupported(kernel)) continue;
+      ASSERT_EQ(nearestShapeGlyph(kernel, pattern), expected) << asciiKernelName(kernel) << " " << pattern;
+    }
+  }
+}
+
+TEST_F(ShapeAsciiTests, LinesKeepTheirDirection) {
+  const int width = 16, height = 32;
+  auto convert = [&](auto draw) {
+    std::vector<uint8_t> rgb = picture(width, height, 230, 20, draw);
+    return asciiText(convertToShapeAscii(RawImageView(rgb.data(), width, height, 3)));
+  };
+  // 2 pixel wide bright lines through the middle of every cell
+  EXPECT_EQ(convert([](int x, int) { return x % 4 == 1 || x % 4 == 2; }), "||||\n||||\n||||\n||||\n");
+  EXPECT_EQ(convert([](int, int y) { return y % 8 >= 6; }), "____\n____\n____\n____\n");
+  // One pixel across per two rows, from the cell's top right to its bottom left
+  EXPECT_EQ(convert([](int x, int y) { return x % 4 == 3 - (y % 8) / 2; }), "////\n////\n////\n////\n");
+  EXPECT_EQ(convert([](int x, int y) { return x % 4 == (y % 8) / 2; }), "\\\\\\\\\n\\\\\\\\\n\\\\\\\\\n\\\\\\\\\n");
+}
+
+TEST_F(ShapeAsciiTests, FlatCellsTakeTheRamp) {
+  const int width = 10, height = 12; // Partial cells on the right and bottom
+  std::vector<uint8_t> rgb = picture(width, height, 0, 0, [](int, int) { return false; });
+  for (size_t i = 0; i < rgb.size(); ++i) rgb[i] = static_cast<uint8_t>(100 + (i / 3) % 7 * 3); // Below the contrast
+  std::string text = asciiText(convertToShapeAscii(RawImageView(rgb.data(), width, height, 3)));
+  ASSERT_EQ(text.size(), shapeAsciiBufferSize(width, height) - 1);
+  EXPECT_EQ(text.size(), 2u * 4);
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (i % 4 == 3) {
+      EXPECT_EQ(text[i], '\n');
+    } else {
+      EXPECT_NE(GLYPH_TABLE.end(), std::find(GLYPH_TABLE.begin() + 100, GLYPH_TABLE.begin() + 120, text[i]))
+        << "cell " << i;
+    }
+  }
+
+  // Rows past the image bottom do not count towards the mean
+  const uint8_t* luma[SHAPE_CELL_HEIGHT] = {};
+  std::vector<uint8_t> row = { 0, 255, 255, 0 };
+  for (int r = 0; r < 3; ++r) luma[r] = row.data();
+  ShapeCell cell = packShapeCell(luma, 0, 4);
+  EXPECT_EQ(cell.mean, 127);
+  EXPECT_EQ(cell.contrast, 255);
+  EXPECT_EQ(cell.pattern, 0x666u);
+}
+
+TEST_F(ShapeAsciiTests, CacheCountsHits) {
+  std::mt19937 rng(5);
+  ShapeMatcher matcher;
+  std::vector<uint32_t> patterns(300);
+  for (uint32_t& pattern : patterns) pattern = rng();
+  for (int pass = 0; pass < 3; ++pass) {
+    for (uint32_t pattern : patterns) {
+      ASSERT_EQ(matcher.glyphFor(pattern), shapeGlyphs()[nearestShapeGlyph(AsciiKernel::Scalar, pattern)].glyph);
+    }
+  }
+  // Colliding patterns evict each other, the rest hit on every later pass
+  EXPECT_EQ(matcher.hits() + matcher.misses(), 900u);
+  EXPECT_GE(matcher.hits(), 500u);
+}
+
+TEST_F(ShapeAsciiTests, ColoredTextFollowsTheShapes) {
+  const int width = 61, height = 37;
+  std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8_t* p = &rgb[(static_cast<size_t>(y) * width + x) * 3];
+      bool ring = std::abs((x - 30) * (x - 30) + (y - 18) * (y - 18) - 200) < 40;
+      p[0] = ring ? 250 : static_cast<uint8_t>(x * 2);
+      p[1] = ring ? 200 : 30;
+      p[2] = static_cast<uint8_t>(y * 5);
+    }
+  }
+  RawImageView view(rgb.data(), width, height, 3);
+  std::string mono = asciiText(convertToShapeAscii(view));
+
+  RawImage target(static_cast<int>(coloredShapeAsciiBufferSize(width, height)), 1, 1);
+  size_t size = convertToColoredShapeAscii(view, target);
+  const char* text = reinterpret_cast<const char*>(target.getData());
+  EXPECT_EQ(text[size], '\0');
+  EXPECT_EQ(std::string(text + size - COLOR_RESET_SIZE), "\033[0m");
+  EXPECT_EQ(glyphsOf(text, size), mono);
+
+  // 4-channel input is converted first
+  std::vector<uint8_t> rgba;
+  for (size_t i = 0; i < rgb.size(); i += 3) rgba.insert(rgba.end(), { rgb[i], rgb[i + 1], rgb[i + 2], 255 });
+  RawImage from_rgba(static_cast<int>(coloredShapeAsciiBufferSize(width, height)), 1, 1);
+  EXPECT_EQ(convertToColoredShapeAscii(RawImageView(rgba.data(), width, height, 4), from_rgba), size);
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(from_rgba.getData())), std::string(text));
+
+  RawImage small(static_cast<int>(shapeAsciiBufferSize(width, height)), 1, 1);
+  EXPECT_THROW(convertToColoredShapeAscii(view, small), std::runtime_error);
+}
+
+TEST_F(ShapeAsciiTests, RendererAndPipeline) {
+  EXPECT_EQ(parseGlyphMode("shape"), GlyphMode::Shape);
+  EXPECT_STREQ(glyphModeName(GlyphMode::Shape), "shape");
+
+  // The renderer draws the converter's text after its cursor home
+  const int width = 40, height = 24;
+  CellGrid pixels;
+  pixels.width = width;
+  pixels.height = height;
+  pixels.colors = picture(width, height, 240, 10, [](int x, int y) { return (x + y / 2) % 7 < 2; });
+  RawImage expected(static_cast<int>(coloredShapeAsciiBufferSize(width, height)), 1, 1);
+  size_t expected_size = convertToColoredShapeAscii(RawImageView(pixels.colors.data(), width, height, 3), expected);
+  DenseRenderer renderer(GlyphMode::Shape);
+  RawImage target(static_cast<int>(DenseRenderer::bufferSize(GlyphMode::Shape, width, height)), 1, 1);
+  renderer.render(pixels, target);
+  RenderStats stats = renderer.render(pixels, target);
+  EXPECT_EQ(stats.total_cells, 10u * 3);
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(target.getData())),
+            "\033[H" + std::string(reinterpret_cast<const char*>(expected.getData()), expected_size));
+
+  PipelineConfig config;
+  config.max_capture_width = 160;
+  config.max_capture_height = 120;
+  config.output_width = 40;
+  config.max_frames = 5;
+  config.queue_depth = 5;
+  config.show_status = false;
+  config.glyph_mode = GlyphMode::Shape;
+  SyntheticSource source(160, 120, SyntheticPattern::Noise);
+  std::string output;
+  FramePipeline pipeline(config, source, [&output](const char* data, size_t size) { output.append(data, size); });
+  pipeline.run();
+  ASSERT_GT(pipeline.stats().stages[WRITE_STAGE].processed, 0u);
+  std::string glyphs = glyphsOf(output.data(), output.size());
+  EXPECT_EQ(glyphs.find('\n'), 40u); // output_width terminal cells
+
+  config.color_mode = ColorMode::Ansi16;
+  EXPECT_THROW(FramePipeline(config, source, [](const char*, size_t) {}), std::runtime_error);
+}
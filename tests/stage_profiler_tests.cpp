@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "ascii_image.hpp"
+#include "frame_pipeline.hpp"
+#include "stage_profiler.hpp"
+
+class StageProfilerTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+static size_t countOf(const std::string& text, const std::string& pattern) {
+  size_t count = 0;
+  for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) count++;
+  return count;
+}
+
+static ProfileClock::time_point at(int64_t ns) {
+  return ProfileClock::time_point(std::chrono::nanoseconds(ns));
+}
+
+TEST_F(StageProfilerTests, BucketsRoundTrip) {
+  for (size_t bucket = 0; bucket < LatencyHistogram::BUCKET_COUNT; ++bucket) {
+    ASSERT_EQ(LatencyHistogram::bucketFor(LatencyHistogram::bucketValue(bucket)), bucket);
+  }
+  EXPECT_EQ(LatencyHistogram::bucketFor(0), 0u);
+  EXPECT_EQ(LatencyHistogram::bucketFor(63), 63u);
+  EXPECT_EQ(LatencyHistogram::bucketFor(UINT64_MAX), LatencyHistogram::BUCKET_COUNT - 1);
+}
+
+TEST_F(StageProfilerTests, PercentilesWithinBucketError) {
+  LatencyHistogram histogram;
+  // 1 us .. 100 ms
+  for (uint64_t us = 1; us <= 100000; ++us) histogram.record(us * 1000);
+  EXPECT_EQ(histogram.count(), 100000u);
+  EXPECT_EQ(histogram.min(), 1000u);
+  EXPECT_EQ(histogram.max(), 100000000u);
+  EXPECT_NEAR(histogram.mean(), 50000500.0, 1.0);
+  for (double p : { 50.0, 90.0, 99.0, 99.9 }) {
+    double expected = p / 100.0 * 100000000.0;
+    EXPECT_NEAR(static_cast<double>(histogram.percentile(p)), expected, expected * 0.035) << "p" << p;
+  }
+  EXPECT_EQ(histogram.percentile(100), histogram.max());
+  EXPECT_EQ(histogram.percentile(0), histogram.min());
+
+  LatencyHistogram small;
+  for (uint64_t ns : { 5, 7, 7, 9 }) small.record(ns);
+  EXPECT_EQ(small.percentile(50), 7u); // Exact below 64 ns
+  small.merge(histogram);
+  EXPECT_EQ(small.count(), 100004u);
+  EXPECT_EQ(small.min(), 5u);
+}
+
+TEST_F(StageProfilerTests, SlowFramesAreBlamedOnTheirSlowestStage) {
+  StageProfiler profiler(std::chrono::milliseconds(10));
+  FrameTiming fast, slow_output, slow_capture;
+  fast.stage_ns[PROFILE_CELLS] = 2000000;
+  slow_output.stage_ns[PROFILE_CELLS] = 2000000;
+  slow_output.stage_ns[PROFILE_OUTPUT] = 9000000;
+  slow_capture.stage_ns[PROFILE_CAPTURE] = 30000000;
+  profiler.endFrame(fast, 5000000);
+  profiler.endFrame(slow_output, 12000000);
+  profiler.endFrame(slow_output, 11000000);
+  profiler.endFrame(slow_capture, 31000000);
+
+  EXPECT_EQ(profiler.frames().count(), 4u);
+  EXPECT_EQ(profiler.framesOverBudget(), 3u);
+  EXPECT_EQ(profiler.budgetMisses(PROFILE_OUTPUT), 2u);
+  EXPECT_EQ(profiler.budgetMisses(PROFILE_CAPTURE), 1u);
+  EXPECT_EQ(profiler.budgetMisses(PROFILE_CELLS), 0u);
+}
+
+TEST_F(StageProfilerTests, ScopedTimerRecordsIntoStageAndFrame) {
+  StageProfiler profiler;
+  FrameTiming timing;
+  {
+    ScopedStageTimer timer(&profiler, PROFILE_RENDER, 0, &timing);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  {
+    ScopedStageTimer timer(&profiler, PROFILE_CAPTURE, 0, &timing);
+    timer.cancel();
+  }
+  { ScopedStageTimer timer(nullptr, PROFILE_CAPTURE); }
+  EXPECT_EQ(profiler.stage(PROFILE_RENDER).count(), 1u);
+  EXPECT_GE(profiler.stage(PROFILE_RENDER).max(), 2000000u);
+  EXPECT_EQ(timing.stage_ns[PROFILE_RENDER], profiler.stage(PROFILE_RENDER).max());
+  EXPECT_EQ(profiler.stage(PROFILE_CAPTURE).count(), 0u);
+  EXPECT_EQ(timing.stage_ns[PROFILE_CAPTURE], 0u);
+}
+
+TEST_F(StageProfilerTests, ReportsListEveryStage) {
+  StageProfiler profiler(std::chrono::milliseconds(1), 3);
+  for (int i = 0; i < 4; ++i) {
+    profiler.record(PROFILE_CAPTURE, at(i * 1000000), at(i * 1000000 + 250000), i);
+  }
+  EXPECT_EQ(profiler.traceEvents(), 3u);
+  EXPECT_EQ(profiler.traceDropped(), 1u);
+
+  std::ostringstream json, csv, trace;
+  profiler.writeJson(json);
+  profiler.writeCsv(csv);
+  profiler.writeChromeTrace(trace);
+
+  for (int i = 0; i < PROFILE_STAGE_COUNT; ++i) {
+    std::string name = profileStageName(static_cast<ProfileStage>(i));
+    EXPECT_EQ(countOf(json.str(), "\"name\": \"" + name + "\""), 1u) << name;
+    EXPECT_EQ(countOf(csv.str(), "\n" + name + ","), 1u) << name;
+  }
+  EXPECT_NE(json.str().find("\"count\": 4, \"mean_us\": 250.000"), std::string::npos) << json.str();
+  EXPECT_NE(csv.str().find("\ncapture,4,250.000,"), std::string::npos) << csv.str();
+
+  EXPECT_EQ(countOf(trace.str(), "\"ph\": \"X\""), 3u);
+  EXPECT_NE(trace.str().find("\"dur\": 250.000, \"args\": {\"frame\": 2}"), std::string::npos) << trace.str();
+  EXPECT_EQ(trace.str().front(), '{');
+}
+
+TEST_F(StageProfilerTests, PipelineTimesEveryStage) {
+  for (bool fused : { true, false }) {
+    StageProfiler profiler(std::chrono::seconds(1), 4096);
+    PipelineConfig config;
+    config.max_capture_width = 320;
+    config.max_capture_height = 240;
+    config.max_frames = 30;
+    config.show_status = false;
+    config.fused_sampling = fused;
+    config.profiler = &profiler;
+
+    SyntheticSource source(320, 240);
+    FramePipeline pipeline(config, source, [](const char*, size_t) {});
+    pipeline.run();
+    PipelineStats stats = pipeline.stats();
+
+    EXPECT_EQ(profiler.stage(PROFILE_CAPTURE).count(), 30u);
+    EXPECT_EQ(profiler.stage(PROFILE_RESIZE).count(), stats.stages[RESIZE_STAGE].processed);
+    EXPECT_EQ(profiler.stage(PROFILE_COLOR).count(), 0u); // Synthetic frames are RGB already
+    EXPECT_EQ(profiler.stage(PROFILE_CELLS).count(), stats.stages[CONVERT_STAGE].processed);
+    EXPECT_EQ(profiler.stage(PROFILE_OUTPUT).count(), stats.stages[WRITE_STAGE].processed);
+    EXPECT_EQ(profiler.frames().count(), stats.stages[WRITE_STAGE].processed);
+    EXPECT_GT(profiler.frames().count(), 0u);
+    EXPECT_EQ(profiler.framesOverBudget(), 0u);
+    if (fused) {
+      EXPECT_EQ(profiler.stage(PROFILE_RESIZE).count(), 0u);
+    }
+  }
+}
+
+TEST_F(StageProfilerTests, StreamLoopTimesEveryShownFrame) {
+  StageProfiler profiler;
+  SyntheticSource source(160, 120, SyntheticPattern::Noise);
+  outputAsciiStream(source, 20, RenderMode::Differential, &profiler);
+
+  EXPECT_EQ(profiler.stage(PROFILE_CAPTURE).count(), 20u);
+  EXPECT_EQ(profiler.stage(PROFILE_OUTPUT).count(), profiler.stage(PROFILE_RENDER).count());
+  // Frames the terminal writer skipped are timed but never finished
+  EXPECT_LE(profiler.frames().count(), profiler.stage(PROFILE_OUTPUT).count());
+  EXPECT_GT(profiler.frames().count(), 0u);
+  EXPECT_LE(profiler.frames().count(), 20u);
+}
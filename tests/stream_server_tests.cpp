@@ -0,0 +1,205 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "stream_server.hpp"
+#include "frame_source.hpp"
+
+class StreamServerTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+static const std::string CLEAR = "\033[H\033[2J";
+
+static std::string socketAddress(const char* name) {
+  return "unix:" + (std::filesystem::temp_directory_path() / (std::string(name) + "_" + std::to_string(getpid()) + ".sock")).string();
+}
+
+static bool waitFor(const std::function<bool()>& condition) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > deadline) return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+// Reads until `size` bytes arrived or nothing came for a second
+static std::string readBytes(int fd, size_t size) {
+  std::string data;
+  char buffer[65536];
+  while (data.size() < size) {
+    pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, 1000) <= 0) break;
+    ssize_t n = read(fd, buffer, std::min(sizeof(buffer), size - data.size()));
+    if (n <= 0) break;
+    data.append(buffer, static_cast<size_t>(n));
+  }
+  return data;
+}
+
+static std::vector<CellGrid> makeFrames(int width, int height, SyntheticPattern pattern, int count) {
+  SyntheticSource source(width, height, pattern, count);
+  Frame frame;
+  std::vector<CellGrid> frames(count);
+  for (CellGrid& cells : frames) {
+    source.read(frame);
+    buildColoredCells(frame.view(), cells);
+  }
+  return frames;
+}
+
+static std::string render(DiffRenderer& renderer, const CellGrid& cells) {
+  RawImage buffer(static_cast<int>(DiffRenderer::bufferSize(cells.width, cells.height)), 1, 1);
+  size_t size = renderer.render(cells, buffer).bytes_written;
+  return std::string(reinterpret_cast<const char*>(buffer.getData()), size);
+}
+
+// A full repaint without the clear of a first frame
+static std::string keyframe(const CellGrid& cells) {
+  DiffRenderer renderer(-1.0);
+  render(renderer, cells);
+  return CLEAR + render(renderer, cells);
+}
+
+TEST_F(StreamServerTests, ViewersReceiveTheSameStream) {
+  StreamServerConfig config;
+  config.client_queue_depth = 16;
+  StreamServer server(socketAddress("same_stream"), config);
+  int a = connectToStream(server.address());
+  int b = connectToStream(server.address());
+  ASSERT_TRUE(waitFor([&] { return server.clientCount() == 2; }));
+
+  std::vector<CellGrid> frames = makeFrames(40, 20, SyntheticPattern::Gradient, 5);
+  for (const CellGrid& cells : frames) server.publish(cells);
+
+  // A keyframe, then the frames of one differential renderer
+  DiffRenderer renderer;
+  render(renderer, frames[0]);
+  DiffRenderer first(-1.0);
+  std::string expected = CLEAR + render(first, frames[0]);
+  for (size_t i = 1; i < frames.size(); ++i) expected += render(renderer, frames[i]);
+
+  EXPECT_EQ(readBytes(a, expected.size()), expected);
+  EXPECT_EQ(readBytes(b, expected.size()), expected);
+  ASSERT_TRUE(waitFor([&] { return server.stats().clients[1].frames_sent == 5; }));
+  StreamServerStats stats = server.stats();
+  EXPECT_EQ(stats.frames_published, 5u);
+  EXPECT_EQ(stats.keyframes_rendered, 1u); // Shared by both clients
+  for (const StreamClientStats& client : stats.clients) {
+    EXPECT_EQ(client.keyframes_sent, 1u);
+    EXPECT_EQ(client.frames_dropped, 0u);
+    EXPECT_EQ(client.bytes_sent, expected.size());
+  }
+  close(a);
+  close(b);
+}
+
+TEST_F(StreamServerTests, LateViewerStartsWithKeyframe) {
+  StreamServer server(socketAddress("late"));
+  int early = connectToStream(server.address());
+  ASSERT_TRUE(waitFor([&] { return server.clientCount() == 1; }));
+  std::vector<CellGrid> frames = makeFrames(40, 20, SyntheticPattern::Gradient, 4);
+  for (int i = 0; i < 3; ++i) {
+    server.publish(frames[i]);
+    ASSERT_TRUE(waitFor([&] { return server.stats().clients[0].queued == 0; }));
+  }
+
+  int late = connectToStream(server.address());
+  ASSERT_TRUE(waitFor([&] { return server.clientCount() == 2; }));
+  server.publish(frames[3]);
+  std::string expected = keyframe(frames[3]);
+  EXPECT_EQ(readBytes(late, expected.size()), expected);
+  EXPECT_EQ(server.stats().keyframes_rendered, 2u);
+  close(early);
+  close(late);
+}
+
+TEST_F(StreamServerTests, SlowViewerDropsFramesWithoutStallingOthers) {
+  StreamServer server(socketAddress("slow"));
+  int fast = connectToStream(server.address());
+  ASSERT_TRUE(waitFor([&] { return server.clientCount() == 1; }));
+  int slow = connectToStream(server.address()); // Never reads
+  ASSERT_TRUE(waitFor([&] { return server.clientCount() == 2; }));
+
+  std::atomic<bool> done{false};
+  std::atomic<size_t> received{0};
+  std::thread reader([&] {
+    char buffer[65536];
+    while (!done.load()) {
+      pollfd p = { fast, POLLIN, 0 };
+      if (poll(&p, 1, 10) <= 0) continue;
+      ssize_t n = read(fast, buffer, sizeof(buffer));
+      if (n <= 0) break;
+      received += static_cast<size_t>(n);
+    }
+  });
+
+  // Every cell changes in every noise frame, each one is about 200 KB
+  std::vector<CellGrid> frames = makeFrames(160, 80, SyntheticPattern::Noise, 30);
+  std::chrono::duration<double, std::milli> slowest_publish(0);
+  for (const CellGrid& cells : frames) {
+    auto start = std::chrono::steady_clock::now();
+    server.publish(cells);
+    slowest_publish = std::max<std::chrono::duration<double, std::milli>>(slowest_publish, std::chrono::steady_clock::now() - start);
+    ASSERT_TRUE(waitFor([&] { return server.stats().clients[0].queued == 0; }));
+  }
+
+  StreamServerStats stats = server.stats();
+  const StreamClientStats& fast_stats = stats.clients[0];
+  const StreamClientStats& slow_stats = stats.clients[1];
+  EXPECT_EQ(fast_stats.frames_sent, 30u);
+  EXPECT_EQ(fast_stats.frames_dropped, 0u);
+  EXPECT_GT(slow_stats.frames_dropped, 0u);
+  EXPECT_LE(slow_stats.queued, StreamServerConfig().client_queue_depth);
+  EXPECT_TRUE(slow_stats.connected);
+  EXPECT_LT(slowest_publish.count(), 1000.0); // Rendering only, never waiting on the slow socket
+  EXPECT_TRUE(waitFor([&] { return received.load() == fast_stats.bytes_sent; }));
+
+  close(slow);
+  EXPECT_TRUE(waitFor([&] { return server.clientCount() == 1; }));
+  EXPECT_FALSE(server.stats().clients[1].connected);
+  done = true;
+  reader.join();
+  close(fast);
+}
+
+TEST_F(StreamServerTests, TcpViewerRelaysTheStream) {
+  EXPECT_THROW(StreamServer("udp:1234"), std::runtime_error);
+  EXPECT_THROW(StreamServer("tcp:http"), std::runtime_error);
+
+  auto server = std::make_unique<StreamServer>("tcp:0");
+  ASSERT_NE(server->address(), "tcp:0");
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  uint64_t relayed = 0;
+  std::thread viewer([&] { relayed = viewStream(server->address(), fds[1]); });
+  ASSERT_TRUE(waitFor([&] { return server->clientCount() == 1; }));
+
+  std::vector<CellGrid> frames = makeFrames(40, 20, SyntheticPattern::Checkerboard, 2);
+  server->publish(frames[0]);
+  server->publish(frames[1]);
+  ASSERT_TRUE(waitFor([&] { return server->stats().clients[0].frames_sent == 2; }));
+  server.reset(); // Closes the connection, the viewer returns
+  viewer.join();
+  close(fds[1]);
+
+  DiffRenderer renderer;
+  render(renderer, frames[0]);
+  DiffRenderer first(-1.0);
+  std::string expected = CLEAR + render(first, frames[0]) + render(renderer, frames[1]);
+  EXPECT_EQ(relayed, expected.size());
+  EXPECT_EQ(readBytes(fds[0], expected.size() + 1), expected);
+  close(fds[0]);
+}
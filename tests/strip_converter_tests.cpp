@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "strip_converter.hpp"
+
+class StripConverterTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+static std::string tempPath(const char* name) {
+  return (std::filesystem::temp_directory_path() / (std::string(name) + "_" + std::to_string(getpid()))).string();
+}
+
+static void writeFile(const std::string& path, const std::string& header, const uint8_t* data, size_t size) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << header;
+  file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+}
+
+static std::string readFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Converts into a temporary file and returns what was written
+static std::string convert(StripImageFile& image, const StripConvertConfig& config, StripConvertStats& stats) {
+  std::string path = tempPath("strip_output");
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  EXPECT_GE(fd, 0);
+  stats = convertInStrips(image, config, fd);
+  ::close(fd);
+  std::string text = readFile(path);
+  std::filesystem::remove(path);
+  return text;
+}
+
+// The plain text of a whole-image sample, one line per cell row
+static std::string sampledText(const RawImageView& view, PixelFormat format, int columns) {
+  CellGrid cells;
+  CellSampler sampler;
+  sampler.sample(view, format, columns, cells);
+  std::string text;
+  for (int row = 0; row < cells.height; ++row) {
+    text.append(cells.glyphs.data() + static_cast<size_t>(row) * cells.width, cells.width);
+    text += '\n';
+  }
+  return text;
+}
+
+static Frame noiseFrame(int width, int height) {
+  SyntheticSource source(width, height, SyntheticPattern::Noise, 1);
+  Frame frame;
+  source.read(frame);
+  return frame;
+}
+
+TEST_F(StripConverterTests, StripsMatchWholeImageSampling) {
+  Frame frame = noiseFrame(1283, 719);
+  std::string path = tempPath("strip_noise.ppm");
+  writeFile(path, "P6\n# comment\n1283 719\n255\n", frame.pixels.getData(), frame.byteSize());
+  StripImageFile image(path);
+  EXPECT_EQ(image.width(), 1283);
+  EXPECT_EQ(image.height(), 719);
+  EXPECT_EQ(image.channels(), 3);
+
+  // A strip of one row, of a few rows, and of the whole image
+  for (size_t strip_bytes : { size_t(1), size_t(3 * 1283 * 5), size_t(64) << 20 }) {
+    for (int columns : { 7, 100, 301 }) {
+      StripConvertConfig config;
+      config.columns = columns;
+      config.strip_bytes = strip_bytes;
+      StripConvertStats stats;
+      std::string text = convert(image, config, stats);
+      EXPECT_EQ(text, sampledText(frame.view(), PixelFormat::RGB24, columns)) << strip_bytes << " " << columns;
+      EXPECT_EQ(stats.columns, columns);
+      EXPECT_EQ(stats.rows, cellRowsFor(1283, 719, columns));
+      EXPECT_EQ(stats.output_bytes, text.size());
+      EXPECT_EQ(stats.source_bytes, frame.byteSize());
+    }
+  }
+  std::filesystem::remove(path);
+}
+
+TEST_F(StripConverterTests, GrayAndRawInputs) {
+  Frame frame = noiseFrame(300, 200);
+  std::vector<uint8_t> gray(300 * 200), expanded(300 * 200 * 3);
+  for (size_t i = 0; i < gray.size(); ++i) {
+    gray[i] = frame.pixels.getData()[i * 3];
+    expanded[i * 3] = expanded[i * 3 + 1] = expanded[i * 3 + 2] = gray[i];
+  }
+  StripConvertConfig config;
+  config.columns = 60;
+  config.strip_bytes = 1000;
+  StripConvertStats stats;
+
+  // Gray cells are the gray average, the same as RGB pixels with equal channels
+  std::string pgm = tempPath("strip_gray.pgm");
+  writeFile(pgm, "P5 300 200 255\n", gray.data(), gray.size());
+  StripImageFile gray_image(pgm);
+  EXPECT_EQ(gray_image.channels(), 1);
+  EXPECT_EQ(convert(gray_image, config, stats), sampledText(RawImageView(expanded.data(), 300, 200, 3), PixelFormat::RGB24, 60));
+
+  // Headerless BGR rows come out as the same colors as the RGB frame
+  std::vector<uint8_t> bgr(frame.byteSize());
+  for (size_t i = 0; i < bgr.size(); i += 3) {
+    bgr[i] = frame.pixels.getData()[i + 2];
+    bgr[i + 1] = frame.pixels.getData()[i + 1];
+    bgr[i + 2] = frame.pixels.getData()[i];
+  }
+  std::string raw = tempPath("strip_raw.bgr");
+  writeFile(raw, "", bgr.data(), bgr.size());
+  StripImageFile raw_image(raw, 300, 200, 3, PixelFormat::BGR24);
+  config.color = true;
+  std::string colored = convert(raw_image, config, stats);
+  std::string ppm = tempPath("strip_rgb.ppm");
+  writeFile(ppm, "P6\n300 200\n255\n", frame.pixels.getData(), frame.byteSize());
+  StripImageFile rgb_image(ppm);
+  EXPECT_EQ(colored, convert(rgb_image, config, stats));
+  EXPECT_EQ(colored.substr(0, 7), "\033[38;2;");
+  EXPECT_EQ(colored.substr(colored.size() - 4), "\033[0m");
+
+  config.color_mode = ColorMode::Ansi16;
+  std::string ansi16 = convert(rgb_image, config, stats);
+  EXPECT_LT(ansi16.size(), colored.size());
+  EXPECT_EQ(ansi16.substr(ansi16.size() - 4), "\033[0m");
+
+  // Too small for the given size
+  EXPECT_THROW(StripImageFile(raw, 300, 201, 3), std::runtime_error);
+  EXPECT_THROW(StripImageFile(raw, 300, 200, 4), std::runtime_error);
+  for (const std::string& path : { pgm, raw, ppm }) std::filesystem::remove(path);
+}
+
+TEST_F(StripConverterTests, RejectsUnsupportedFiles) {
+  std::string path = tempPath("strip_bad.ppm");
+  uint8_t pixels[12] = {};
+  writeFile(path, "P3\n2 2\n255\n", pixels, sizeof(pixels)); // ASCII PPM
+  EXPECT_THROW(StripImageFile image(path), std::runtime_error);
+  writeFile(path, "P6\n2 2\n65535\n", pixels, sizeof(pixels)); // 16-bit
+  EXPECT_THROW(StripImageFile image(path), std::runtime_error);
+  writeFile(path, "P6\n2 3\n255\n", pixels, sizeof(pixels)); // Truncated
+  EXPECT_THROW(StripImageFile image(path), std::runtime_error);
+  writeFile(path, "P6\n2\n", pixels, 0);
+  EXPECT_THROW(StripImageFile image(path), std::runtime_error);
+  writeFile(path, "P6\n2 2\n255\n", pixels, sizeof(pixels));
+  EXPECT_NO_THROW(StripImageFile image(path));
+  std::filesystem::remove(path);
+  EXPECT_THROW(StripImageFile image(path), std::runtime_error);
+}
+
+TEST_F(StripConverterTests, SmallMaxvalIsScaled) {
+  // A 4-bit gray ramp reads the same as the 8-bit one
+  std::vector<uint8_t> four_bit(64 * 16), eight_bit(64 * 16);
+  for (size_t i = 0; i < four_bit.size(); ++i) {
+    four_bit[i] = static_cast<uint8_t>(i % 64 / 4);
+    eight_bit[i] = static_cast<uint8_t>(four_bit[i] * 17);
+  }
+  std::string small = tempPath("strip_maxval15.pgm"), full = tempPath("strip_maxval255.pgm");
+  writeFile(small, "P5 64 16 15\n", four_bit.data(), four_bit.size());
+  writeFile(full, "P5 64 16 255\n", eight_bit.data(), eight_bit.size());
+  StripConvertConfig config;
+  config.columns = 16;
+  config.strip_bytes = 64 * 3;
+  StripConvertStats small_stats, full_stats;
+  StripImageFile small_image(small), full_image(full);
+  std::string text = convert(small_image, config, small_stats);
+  EXPECT_EQ(text, convert(full_image, config, full_stats));
+  EXPECT_EQ(text[15], GLYPH_TABLE[255]); // White is the bright end of the ramp
+  EXPECT_GT(small_stats.peak_bytes, full_stats.peak_bytes); // The scaled strip
+  std::filesystem::remove(small);
+  std::filesystem::remove(full);
+}
+
+TEST_F(StripConverterTests, PeakMemoryDoesNotGrowWithHeight) {
+  // 2000 wide gray, 6 rows per 12 KB strip
+  const size_t strip_bytes = 12000;
+  std::vector<uint8_t> pixels(static_cast<size_t>(2000) * 8000);
+  for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = static_cast<uint8_t>(i * 7 + i / 2000);
+  StripConvertConfig config;
+  config.columns = 80;
+  config.strip_bytes = strip_bytes;
+
+  size_t peaks[2];
+  int heights[2] = { 2000, 8000 };
+  for (int i = 0; i < 2; ++i) {
+    std::string path = tempPath("strip_tall.pgm");
+    std::string header = "P5\n2000 " + std::to_string(heights[i]) + "\n255\n";
+    writeFile(path, header, pixels.data(), static_cast<size_t>(2000) * heights[i]);
+    StripImageFile image(path);
+    StripConvertStats stats;
+    convert(image, config, stats);
+    std::filesystem::remove(path);
+    peaks[i] = stats.peak_bytes;
+    EXPECT_EQ(stats.source_bytes, static_cast<uint64_t>(2000) * heights[i]);
+    EXPECT_GT(stats.strips, stats.source_bytes / strip_bytes);
+    // The window, the pages on either side of it, and buffers of about the width
+    EXPECT_LT(stats.peak_bytes, strip_bytes + 2 * 4096 + 16 * 2000);
+  }
+  EXPECT_LE(peaks[1], peaks[0] + 4096);
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "ascii_image.hpp"
+#include "terminal_writer.hpp"
+
+class TerminalWriterTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+static std::string readAll(int fd) {
+  std::string data;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = ::read(fd, buffer, sizeof(buffer))) > 0) data.append(buffer, static_cast<size_t>(n));
+  return data;
+}
+
+static std::string readFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+// A frame whose number can be read back from every byte of it
+static std::string makeFrame(int number, size_t size) {
+  std::string frame(size, static_cast<char>('a' + number % 26));
+  frame.front() = '[';
+  frame.back() = ']';
+  return frame;
+}
+
+TEST_F(TerminalWriterTests, SegmentsArriveInOrder) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  std::string received;
+  std::thread reader([&] { received = readAll(fds[0]); });
+  {
+    TerminalWriter writer(fds[1]);
+    std::string big(100000, '#');
+    EXPECT_TRUE(writer.writeFrame({ { "\033[H", 3 }, { big.data(), big.size() }, { "", 0 }, { "status\n", 7 } }));
+    EXPECT_TRUE(writer.writeFrame("second", 6));
+    EXPECT_EQ(writer.stats().frames_written, 2u);
+    EXPECT_EQ(writer.stats().bytes_written, 3 + big.size() + 7 + 6);
+  }
+  ::close(fds[1]);
+  reader.join();
+  ::close(fds[0]);
+  EXPECT_EQ(received, "\033[H" + std::string(100000, '#') + "status\nsecond");
+}
+
+TEST_F(TerminalWriterTests, FullPipeSkipsFramesWithoutCuttingThem) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  // Nothing reads until the end. Frames are larger than PIPE_BUF, so the
+  // kernel may take part of one, and do not divide the 64 KiB pipe buffer.
+  const size_t FRAME_SIZE = 6000;
+  std::string written, received;
+  WriterStats stats;
+  std::thread reader;
+  {
+    TerminalWriter writer(fds[1], WriteMode::NonBlocking);
+    for (int i = 0; i < 20; ++i) {
+      std::string frame = makeFrame(i, FRAME_SIZE);
+      if (writer.writeFrame(frame.data(), frame.size())) written += frame;
+    }
+    stats = writer.stats();
+    EXPECT_FALSE(writer.ready());
+    EXPECT_GT(writer.pendingBytes(), 0u);
+
+    // Drain so flush() can finish the last frame
+    reader = std::thread([&] { received = readAll(fds[0]); });
+    writer.flush();
+    EXPECT_EQ(writer.pendingBytes(), 0u);
+  }
+  // The reader sees the end once the writer's own descriptor is closed too
+  ::close(fds[1]);
+  reader.join();
+  ::close(fds[0]);
+  // Only whole frames, in order
+  EXPECT_EQ(received, written);
+
+  EXPECT_GT(stats.frames_skipped, 0u);
+  EXPECT_GT(stats.partial_writes, 0u);
+  EXPECT_EQ(stats.frames_written + stats.frames_skipped, 20u);
+  EXPECT_EQ(written.size(), stats.frames_written * FRAME_SIZE);
+}
+
+TEST_F(TerminalWriterTests, SharedDescriptorStaysBlocking) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  {
+    TerminalWriter writer(fds[1], WriteMode::NonBlocking);
+    EXPECT_NE(writer.fd(), fds[1]);
+    EXPECT_TRUE(fcntl(writer.fd(), F_GETFL) & O_NONBLOCK);
+    EXPECT_FALSE(fcntl(fds[1], F_GETFL) & O_NONBLOCK);
+    // Both descriptors write into the same pipe, in call order
+    writer.writeFrame("frame ", 6);
+    ASSERT_EQ(::write(fds[1], "status", 6), 6);
+  }
+  ::close(fds[1]);
+  EXPECT_EQ(readAll(fds[0]), "frame status");
+  ::close(fds[0]);
+
+  // A socket cannot be reopened, it is written when poll() reports room
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  {
+    TerminalWriter writer(fds[1], WriteMode::NonBlocking);
+    EXPECT_EQ(writer.fd(), fds[1]);
+    EXPECT_FALSE(fcntl(fds[1], F_GETFL) & O_NONBLOCK);
+    EXPECT_TRUE(writer.writeFrame("frame", 5));
+  }
+  ::close(fds[1]);
+  EXPECT_EQ(readAll(fds[0]), "frame");
+  ::close(fds[0]);
+}
+
+TEST_F(TerminalWriterTests, FileOutputIsByteExact) {
+  std::string path = (std::filesystem::temp_directory_path() / "terminal_writer_test.txt").string();
+  {
+    TerminalWriter writer(path);
+    writer.writeFrame({ { "abc", 3 }, { "\0def", 4 } });
+  }
+  EXPECT_EQ(readFile(path), std::string("abc\0def", 7));
+
+  // The text stops at the terminating NUL, and never reads past the buffer
+  RawImage text(8, 1, 1);
+  std::memcpy(text.getData(), "ascii\n\0x", 8);
+  outputAsciiToFile(text, path.c_str());
+  EXPECT_EQ(readFile(path), "ascii\n");
+  std::memcpy(text.getData(), "12345678", 8);
+  outputAsciiToFile(text, path.c_str());
+  EXPECT_EQ(readFile(path), "12345678");
+
+  std::filesystem::remove(path);
+  EXPECT_THROW(TerminalWriter("/nonexistent/dir/file.txt"), std::runtime_error);
+}
@@ -0,0 +1,235 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "yuv_image.hpp"
+#include "ascii_image.hpp"
+#include "cell_sampler.hpp"
+
+
+class YuvImageTests : public ::testing::Test {
+  protected:
+  void SetUp() override {
+  }
+  void TearDown() override {
+  }
+};
+
+static const YuvFormat FORMATS[] = { YuvFormat::YUYV, YuvFormat::NV12, YuvFormat::I420 };
+
+// Smooth colored gradients with some noise, every value in gamut
+static std::vector<uint8_t> scene(int width, int height) {
+  std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+  uint32_t seed = 7;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      seed = seed * 1664525u + 1013904223u;
+      uint8_t* p = &rgb[(static_cast<size_t>(y) * width + x) * 3];
+      p[0] = static_cast<uint8_t>(x * 255 / width);
+      p[1] = static_cast<uint8_t>(y * 255 / height);
+      p[2] = static_cast<uint8_t>(128 + static_cast<int>(seed >> 28) - 8);
+    }
+  }
+  return rgb;
+}
+
+// What a camera or decoder would deliver for the RGB frame: BT.601 limited
+// range, chroma averaged over the pixels that share it
+static std::vector<uint8_t> encode(const std::vector<uint8_t>& rgb, int width, int height, YuvFormat format) {
+  std::vector<uint8_t> data(yuvFrameSize(format, width, height));
+  YuvImageView view(data.data(), width, height, format);
+  auto at = [&](int x, int y) { return &rgb[(static_cast<size_t>(y) * width + x) * 3]; };
+  for (int y = 0; y < height; ++y) {
+    uint8_t* luma = const_cast<uint8_t*>(view.lumaRow(y));
+    for (int x = 0; x < width; ++x) {
+      const uint8_t* p = at(x, y);
+      luma[x * view.lumaStep()] = static_cast<uint8_t>(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+    }
+  }
+  int rows_per_chroma = 1 << view.chromaShift();
+  for (int cy = 0; cy < view.chromaHeight(); ++cy) {
+    uint8_t* u = const_cast<uint8_t*>(view.uRow(cy));
+    uint8_t* v = const_cast<uint8_t*>(view.vRow(cy));
+    for (int cx = 0; cx < view.chromaWidth(); ++cx) {
+      int r = 0, g = 0, b = 0, n = 0;
+      for (int y = cy * rows_per_chroma; y < std::min(height, (cy + 1) * rows_per_chroma); ++y) {
+        for (int x = cx * 2; x < std::min(width, cx * 2 + 2); ++x, ++n) {
+          r += at(x, y)[0];
+          g += at(x, y)[1];
+          b += at(x, y)[2];
+        }
+      }
+      r /= n;
+      g /= n;
+      b /= n;
+      u[cx * view.chromaStep()] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+      v[cx * view.chromaStep()] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+  }
+  return data;
+}
+
+// The RGB the existing path starts from: the YUV frame converted pixel by pixel
+static std::vector<uint8_t> decode(const YuvImageView& view) {
+  std::vector<uint8_t> rgb(static_cast<size_t>(view.getWidth()) * view.getHeight() * 3);
+  convertYuvToRgb(view, rgb.data());
+  return rgb;
+}
+
+static std::string asciiText(const RawImage& image) {
+  return reinterpret_cast<const char*>(image.getData());
+}
+
+// Colored output without its glyphs, and the glyphs without the SGR sequences
+static std::string sgrsOf(const RawImage& buffer, size_t size) {
+  std::string text;
+  const char* p = reinterpret_cast<const char*>(buffer.getData());
+  for (size_t i = 0; i < size; ++i) {
+    if (p[i] == '\033') {
+      while (i < size && p[i] != 'm') text += p[i++];
+      text += 'm';
+    } else if (p[i] == '\n') {
+      text += '\n';
+    }
+  }
+  return text;
+}
+
+static std::string glyphsOf(const RawImage& buffer, size_t size) {
+  std::string text;
+  const char* p = reinterpret_cast<const char*>(buffer.getData());
+  for (size_t i = 0; i < size; ++i) {
+    if (p[i] == '\033') {
+      while (i < size && p[i] != 'm') ++i;
+      continue;
+    }
+    text += p[i];
+  }
+  return text;
+}
+
+// Whether glyph is what the RGB path draws for a luma within `slack` of `luma`
+static bool nearGlyph(char glyph, int luma, int slack) {
+  for (int l = std::max(0, luma - slack); l <= std::min(255, luma + slack); ++l) {
+    if (GLYPH_TABLE[l] == glyph) return true;
+  }
+  return false;
+}
+
+TEST_F(YuvImageTests, PackedLayouts) {
+  EXPECT_EQ(yuvFrameSize(YuvFormat::YUYV, 5, 3), 36u); // Odd widths are padded to a pixel pair
+  EXPECT_EQ(yuvFrameSize(YuvFormat::NV12, 5, 3), 27u);
+  EXPECT_EQ(yuvFrameSize(YuvFormat::I420, 5, 3), 27u);
+  EXPECT_EQ(yuvFrameSize(YuvFormat::I420, 640, 480), 640u * 480 * 3 / 2);
+
+  std::vector<uint8_t> data(36);
+  for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(i);
+  YuvImageView yuyv(data.data(), 5, 3, YuvFormat::YUYV);
+  EXPECT_EQ(yuyv.lumaRow(1)[2 * yuyv.lumaStep()], 16);
+  EXPECT_EQ(yuyv.uRow(1)[yuyv.chromaStep()], 17);
+  EXPECT_EQ(yuyv.vRow(2)[0], 27);
+  YuvImageView i420(data.data(), 5, 3, YuvFormat::I420);
+  EXPECT_EQ(i420.chromaHeight(), 2);
+  EXPECT_EQ(i420.uRow(1)[2], 20);
+  EXPECT_EQ(i420.vRow(0)[0], 21);
+  YuvImageView nv12(data.data(), 5, 3, YuvFormat::NV12);
+  EXPECT_EQ(nv12.uRow(1)[nv12.chromaStep() * 2], 25);
+  EXPECT_EQ(nv12.vRow(1)[nv12.chromaStep() * 2], 26);
+}
+
+TEST_F(YuvImageTests, GrayFramesMatchTheRgbPath) {
+  for (YuvFormat format : FORMATS) {
+    SCOPED_TRACE(yuvFormatName(format));
+    const int width = 37, height = 11;
+    std::vector<uint8_t> data(yuvFrameSize(format, width, height), 128); // Neutral chroma
+    YuvImageView view(data.data(), width, height, format);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        const_cast<uint8_t*>(view.lumaRow(y))[x * view.lumaStep()] = static_cast<uint8_t>((x * 7 + y * 31) % 256);
+      }
+    }
+    std::vector<uint8_t> rgb = decode(view);
+    EXPECT_EQ(asciiText(convertToAscii(view)), asciiText(convertToAscii(RawImageView(rgb.data(), width, height, 3))));
+
+    RawImage target(16, 1, 1);
+    EXPECT_THROW(convertToAscii(view, target), std::runtime_error);
+  }
+}
+
+TEST_F(YuvImageTests, ColoredFramesFollowTheRgbPath) {
+  const int width = 33, height = 9;
+  std::vector<uint8_t> source = scene(width, height);
+  for (YuvFormat format : FORMATS) {
+    SCOPED_TRACE(yuvFormatName(format));
+    std::vector<uint8_t> data = encode(source, width, height, format);
+    YuvImageView view(data.data(), width, height, format);
+    std::vector<uint8_t> rgb = decode(view);
+    RawImageView rgb_view(rgb.data(), width, height, 3);
+
+    // Glyphs from Y are within rounding of the glyphs from the decoded RGB
+    std::string ascii = asciiText(convertToAscii(view));
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        const uint8_t* p = &rgb[(static_cast<size_t>(y) * width + x) * 3];
+        EXPECT_TRUE(nearGlyph(ascii[static_cast<size_t>(y) * (width + 1) + x], lumaOf(p[0], p[1], p[2]), 2))
+          << x << "," << y;
+      }
+    }
+
+    // The colors are exactly the decoded ones
+    for (ColorMode mode : { ColorMode::Truecolor, ColorMode::Xterm256, ColorMode::Ansi16 }) {
+      RawImage expected(static_cast<int>(coloredAsciiBufferSize(width, height, mode)), 1, 1);
+      RawImage actual(static_cast<int>(coloredAsciiBufferSize(width, height, mode)), 1, 1);
+      size_t expected_size = convertToColoredAscii(rgb_view, expected, mode);
+      size_t size = convertToColoredAscii(view, actual, mode);
+      EXPECT_EQ(sgrsOf(actual, size), sgrsOf(expected, expected_size));
+      EXPECT_EQ(glyphsOf(actual, size), ascii);
+    }
+    RawImage small(16, 1, 1);
+    EXPECT_THROW(convertToColoredAscii(view, small), std::runtime_error);
+  }
+}
+
+TEST_F(YuvImageTests, CellsMatchSamplingTheDecodedFrame) {
+  const int width = 161, height = 121; // Cells straddle chroma samples
+  std::vector<uint8_t> source = scene(width, height);
+  CellSampler sampler;
+  for (YuvFormat format : FORMATS) {
+    SCOPED_TRACE(yuvFormatName(format));
+    std::vector<uint8_t> data = encode(source, width, height, format);
+    YuvImageView view(data.data(), width, height, format);
+    std::vector<uint8_t> rgb = decode(view);
+
+    for (int columns : { 7, 40, 161 }) {
+      CellGrid cells, expected;
+      sampler.sample(view, columns, cells);
+      sampler.sample(RawImageView(rgb.data(), width, height, 3), PixelFormat::RGB24, columns, expected);
+      ASSERT_EQ(cells.width, expected.width);
+      ASSERT_EQ(cells.height, expected.height);
+      for (size_t i = 0; i < cells.cellCount(); ++i) {
+        const uint8_t* color = &expected.colors[i * 3];
+        for (int c = 0; c < 3; ++c) EXPECT_NEAR(cells.colors[i * 3 + c], color[c], 4) << "cell " << i;
+        EXPECT_TRUE(nearGlyph(cells.glyphs[i], lumaOf(color[0], color[1], color[2]), 2)) << "cell " << i;
+      }
+    }
+  }
+
+  // Padded planes that live apart give the same cells as the packed frame
+  std::vector<uint8_t> packed = encode(source, width, height, YuvFormat::I420);
+  YuvImageView packed_view(packed.data(), width, height, YuvFormat::I420);
+  const size_t y_stride = width + 15, chroma_stride = packed_view.chromaWidth() + 9;
+  std::vector<uint8_t> y_plane(y_stride * height), u_plane(chroma_stride * packed_view.chromaHeight()),
+    v_plane(u_plane.size());
+  for (int y = 0; y < height; ++y) std::memcpy(&y_plane[y * y_stride], packed_view.lumaRow(y), width);
+  for (int y = 0; y < packed_view.chromaHeight(); ++y) {
+    std::memcpy(&u_plane[y * chroma_stride], packed_view.uRow(y), packed_view.chromaWidth());
+    std::memcpy(&v_plane[y * chroma_stride], packed_view.vRow(y), packed_view.chromaWidth());
+  }
+  YuvImageView planes(YuvFormat::I420, width, height, y_plane.data(), y_stride, u_plane.data(), v_plane.data(),
+                      chroma_stride);
+  CellGrid a, b;
+  sampler.sample(packed_view, 50, a);
+  sampler.sample(planes, 50, b);
+  EXPECT_EQ(a.colors, b.colors);
+  EXPECT_EQ(a.glyphs, b.glyphs);
+  EXPECT_EQ(asciiText(convertToAscii(planes)), asciiText(convertToAscii(packed_view)));
+}